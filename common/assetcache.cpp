@@ -0,0 +1,328 @@
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#include <sys/utime.h>
+#else
+#include <dirent.h>
+#include <utime.h>
+#endif
+
+#include "mappedfile.hpp"
+#include "assetcache.hpp"
+
+static const unsigned long long ASSETCACHE_DEFAULT_SIZE = 256ull << 20;
+
+// Temporary files (see temporaryFilePath) older than this were left by a program which crashed
+static const long long ASSETCACHE_STALE_SECONDS = 3600;
+
+static std::atomic<unsigned long long> cacheHits(0), cacheMisses(0), cacheWritten(0), cacheEvicted(0);
+static std::atomic<unsigned long long> hashedBytes(0), hashNanoseconds(0);
+
+// MurmurHash3, x64 128 bits version (by Austin Appleby, public domain) : several GB/s,
+// and 128 bits, so that two different files never get the same entry.
+static inline unsigned long long rotl64(unsigned long long x, int r){
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline unsigned long long fmix64(unsigned long long k){
+	k ^= k >> 33;
+	k *= 0xff51afd7ed558ccdull;
+	k ^= k >> 33;
+	k *= 0xc4ceb9fe1a85ec53ull;
+	k ^= k >> 33;
+	return k;
+}
+
+static void murmurHash3_128(const unsigned char * data, size_t size, unsigned long long out_hash[2]){
+	const unsigned long long c1 = 0x87c37b91114253d5ull, c2 = 0x4cf5ad432745937full;
+	unsigned long long h1 = 0, h2 = 0;
+	size_t blocks = size / 16;
+	for (size_t i = 0; i < blocks; i++){
+		unsigned long long k1, k2;
+		memcpy(&k1, data + 16 * i, 8); // Unaligned, and little-endian on the machines we run on
+		memcpy(&k2, data + 16 * i + 8, 8);
+		k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+		h1 = rotl64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+		k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+		h2 = rotl64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+	}
+	const unsigned char * tail = data + 16 * blocks;
+	unsigned long long k1 = 0, k2 = 0;
+	switch (size & 15){
+	case 15: k2 ^= (unsigned long long)tail[14] << 48; // fallthrough
+	case 14: k2 ^= (unsigned long long)tail[13] << 40; // fallthrough
+	case 13: k2 ^= (unsigned long long)tail[12] << 32; // fallthrough
+	case 12: k2 ^= (unsigned long long)tail[11] << 24; // fallthrough
+	case 11: k2 ^= (unsigned long long)tail[10] << 16; // fallthrough
+	case 10: k2 ^= (unsigned long long)tail[ 9] << 8; // fallthrough
+	case  9: k2 ^= (unsigned long long)tail[ 8];
+		k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2; // fallthrough
+	case  8: k1 ^= (unsigned long long)tail[ 7] << 56; // fallthrough
+	case  7: k1 ^= (unsigned long long)tail[ 6] << 48; // fallthrough
+	case  6: k1 ^= (unsigned long long)tail[ 5] << 40; // fallthrough
+	case  5: k1 ^= (unsigned long long)tail[ 4] << 32; // fallthrough
+	case  4: k1 ^= (unsigned long long)tail[ 3] << 24; // fallthrough
+	case  3: k1 ^= (unsigned long long)tail[ 2] << 16; // fallthrough
+	case  2: k1 ^= (unsigned long long)tail[ 1] << 8; // fallthrough
+	case  1: k1 ^= (unsigned long long)tail[ 0];
+		k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+	}
+	h1 ^= size; h2 ^= size;
+	h1 += h2; h2 += h1;
+	h1 = fmix64(h1); h2 = fmix64(h2);
+	h1 += h2; h2 += h1;
+	out_hash[0] = h1;
+	out_hash[1] = h2;
+}
+
+static bool makeDirectory(const std::string & path){
+#ifdef _WIN32
+	return _mkdir(path.c_str()) == 0 || errno == EEXIST;
+#else
+	return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+}
+
+// Makes the directory and its parents if needed
+static bool makeDirectories(const std::string & path){
+	for (size_t i = 1; i < path.size(); i++){
+		if ( (path[i] == '/' || path[i] == '\\') && path[i - 1] != ':' && !makeDirectory(path.substr(0, i)) )
+			return false;
+	}
+	return makeDirectory(path);
+}
+
+static std::string findCacheDirectory(){
+	// Always a directory of our own : trim() removes files, and must never touch the user's
+	std::string directory;
+	const char * variable = getenv("OGL_ASSET_CACHE");
+	if ( variable && variable[0] ){
+		directory = std::string(variable) + "/ogl-assets";
+	}else{
+#ifdef _WIN32
+		const char * base = getenv("LOCALAPPDATA");
+		if ( !base || !base[0] )
+			return std::string();
+		directory = std::string(base) + "\\ogl-assets";
+#else
+		const char * base = getenv("XDG_CACHE_HOME");
+		if ( base && base[0] ){
+			directory = std::string(base) + "/ogl-assets";
+		}else{
+			const char * home = getenv("HOME");
+			if ( !home || !home[0] )
+				return std::string();
+			directory = std::string(home) + "/.cache/ogl-assets";
+		}
+#endif
+	}
+	if ( !makeDirectories(directory) ){
+		printf("Impossible to make the asset cache directory %s : assets won't be cached\n", directory.c_str());
+		return std::string();
+	}
+	return directory;
+}
+
+static const std::string & cacheDirectory(){
+	static const std::string directory = findCacheDirectory(); // Thread-safe since C++11
+	return directory;
+}
+
+static unsigned long long cacheBudget(){
+	const char * variable = getenv("OGL_ASSET_CACHE_SIZE");
+	if ( variable && variable[0] )
+		return strtoull(variable, NULL, 10) << 20;
+	return ASSETCACHE_DEFAULT_SIZE;
+}
+
+std::string assetCachePath(const char * sourcePath, const char * kind){
+	const std::string & directory = cacheDirectory();
+	if ( directory.empty() )
+		return std::string();
+
+	MappedFile source;
+	if ( !source.open(sourcePath) )
+		return std::string();
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	unsigned long long hash[2];
+	murmurHash3_128(source.data(), source.size(), hash);
+	hashNanoseconds += (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	hashedBytes += source.size();
+
+	char name[64];
+	snprintf(name, sizeof(name), "%016llx%016llx.", hash[0], hash[1]);
+	return directory + "/" + name + kind;
+}
+
+void assetCacheHit(const std::string & entryPath){
+	cacheHits++;
+	// The modification time is the time of the last use (the access time isn't always kept)
+#ifdef _WIN32
+	_utime(entryPath.c_str(), NULL);
+#else
+	utime(entryPath.c_str(), NULL);
+#endif
+}
+
+void assetCacheMiss(){
+	cacheMisses++;
+}
+
+static void trim(unsigned long long maxBytes, const std::string & keptPath);
+
+void assetCacheWritten(const std::string & entryPath){
+	cacheWritten++;
+	// Even if it's bigger than the whole cache : it's about to be used
+	trim(cacheBudget(), entryPath);
+}
+
+struct CacheEntry{
+	std::string path;
+	unsigned long long size;
+	long long lastUse;
+	long long ageSeconds;
+	bool operator<(const CacheEntry & other) const { return lastUse < other.lastUse; }
+};
+
+// Entries are named "<32 hex digits>.<kind>" (see assetCachePath), and the files being written
+// "<entry>.<process>.<n>.tmp" : anything else in the directory isn't ours, and is left alone.
+static bool isEntryName(const std::string & name, bool & out_temporary){
+	if ( name.size() < 34 || name[32] != '.' )
+		return false;
+	for (size_t i = 0; i < 32; i++)
+		if ( !((name[i] >= '0' && name[i] <= '9') || (name[i] >= 'a' && name[i] <= 'f')) )
+			return false;
+	for (size_t i = 33; i < name.size(); i++)
+		if ( !((name[i] >= '0' && name[i] <= '9') || (name[i] >= 'a' && name[i] <= 'z') || name[i] == '.') )
+			return false;
+	out_temporary = name.compare(name.size() - 4, 4, ".tmp") == 0;
+	return true;
+}
+
+// Every entry of the cache, and the files being written (which aren't entries yet)
+static void listEntries(std::vector<CacheEntry> & out_entries, std::vector<CacheEntry> & out_temporaries){
+	out_entries.clear();
+	out_temporaries.clear();
+	const std::string & directory = cacheDirectory();
+	if ( directory.empty() )
+		return;
+#ifdef _WIN32
+	FILETIME now;
+	GetSystemTimeAsFileTime(&now);
+	long long nowTime = ((long long)now.dwHighDateTime << 32) | now.dwLowDateTime;
+	WIN32_FIND_DATAA found;
+	HANDLE search = FindFirstFileA((directory + "\\*").c_str(), &found);
+	if ( search == INVALID_HANDLE_VALUE )
+		return;
+	do{
+		bool temporary;
+		std::string name = found.cFileName;
+		if ( (found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) || !isEntryName(name, temporary) )
+			continue;
+		CacheEntry entry;
+		entry.path = directory + "/" + name;
+		entry.size = ((unsigned long long)found.nFileSizeHigh << 32) | found.nFileSizeLow;
+		entry.lastUse = ((long long)found.ftLastWriteTime.dwHighDateTime << 32) | found.ftLastWriteTime.dwLowDateTime;
+		entry.ageSeconds = (nowTime - entry.lastUse) / 10000000; // FILETIMEs are in 100 ns
+		(temporary ? out_temporaries : out_entries).push_back(entry);
+	}while ( FindNextFileA(search, &found) );
+	FindClose(search);
+#else
+	long long nowTime = (long long)time(NULL);
+	DIR * dir = opendir(directory.c_str());
+	if ( !dir )
+		return;
+	while ( struct dirent * found = readdir(dir) ){
+		bool temporary;
+		std::string name = found->d_name;
+		if ( !isEntryName(name, temporary) )
+			continue;
+		CacheEntry entry;
+		entry.path = directory + "/" + name;
+		struct stat info;
+		if ( stat(entry.path.c_str(), &info) != 0 || !S_ISREG(info.st_mode) )
+			continue;
+		entry.size = (unsigned long long)info.st_size;
+		// In nanoseconds : a program uses all its entries in the same second
+#ifdef __APPLE__
+		entry.lastUse = (long long)info.st_mtimespec.tv_sec * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+		entry.lastUse = (long long)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+		entry.ageSeconds = nowTime - (long long)info.st_mtime;
+		(temporary ? out_temporaries : out_entries).push_back(entry);
+	}
+	closedir(dir);
+#endif
+}
+
+static void trim(unsigned long long maxBytes, const std::string & keptPath){
+	std::vector<CacheEntry> entries, temporaries;
+	listEntries(entries, temporaries);
+
+	// Nobody is writing these anymore
+	for (size_t i = 0; i < temporaries.size(); i++){
+		if ( temporaries[i].ageSeconds > ASSETCACHE_STALE_SECONDS )
+			remove(temporaries[i].path.c_str());
+	}
+
+	unsigned long long total = 0;
+	for (size_t i = 0; i < entries.size(); i++)
+		total += entries[i].size;
+	if ( total <= maxBytes )
+		return;
+
+	// Oldest first. Files mapped by another program can still be removed (they disappear
+	// when they're closed), except on Windows, where they just stay.
+	std::sort(entries.begin(), entries.end());
+	for (size_t i = 0; i < entries.size() && total > maxBytes; i++){
+		if ( entries[i].path != keptPath && remove(entries[i].path.c_str()) == 0 ){
+			total -= entries[i].size;
+			cacheEvicted++;
+		}
+	}
+}
+
+void trimAssetCache(unsigned long long maxBytes){
+	trim(maxBytes, std::string());
+}
+
+AssetCacheStats assetCacheStats(){
+	AssetCacheStats stats;
+	stats.hits        = cacheHits;
+	stats.misses      = cacheMisses;
+	stats.written     = cacheWritten;
+	stats.evicted     = cacheEvicted;
+	stats.hashedBytes = hashedBytes;
+	stats.hashSeconds = hashNanoseconds * 1e-9;
+	std::vector<CacheEntry> entries, temporaries;
+	listEntries(entries, temporaries);
+	stats.entries = entries.size();
+	stats.totalBytes = 0;
+	for (size_t i = 0; i < entries.size(); i++)
+		stats.totalBytes += entries[i].size;
+	return stats;
+}
+
+void printAssetCacheStats(){
+	AssetCacheStats stats = assetCacheStats();
+	printf("Asset cache %s : %llu hits, %llu misses, %llu written, %llu evicted ; %.1f MB hashed in %.1f ms ; %llu entries, %.1f MB of %.1f MB\n",
+		cacheDirectory().empty() ? "(none)" : cacheDirectory().c_str(),
+		stats.hits, stats.misses, stats.written, stats.evicted,
+		stats.hashedBytes / 1048576.0, stats.hashSeconds * 1e3,
+		stats.entries, stats.totalBytes / 1048576.0, cacheBudget() / 1048576.0);
+}
@@ -0,0 +1,50 @@
+#ifndef ASSETCACHE_HPP
+#define ASSETCACHE_HPP
+
+#include <string>
+
+// A cache of processed assets (indexed meshes, decoded textures with their mipmaps), on the disk,
+// shared by every tutorial and every program which uses common/. Entries are named after a hash
+// of the content of the source file, not after its path : the copies of suzanne.obj in all the
+// tutorial directories are processed once, and an edited file is processed again.
+//
+// Directory : ogl-assets in $OGL_ASSET_CACHE, or else in the user's cache directory
+// ($XDG_CACHE_HOME, ~/.cache, or %LOCALAPPDATA% on Windows). Only files named like entries
+// are ever removed from it, and temporary files left by a crashed program after an hour.
+// Each entry is one file, which is mapped to be read (see meshcache.hpp, and decodeBMP in
+// texture.cpp which keeps its textures as DDS files). Reading an entry updates its modification
+// time, and when the cache gets bigger than $OGL_ASSET_CACHE_SIZE megabytes (256 by default),
+// the least recently used entries are removed.
+
+// Where the entry of the given kind (like "meshcache" or "tex1.bc5.dds") for the current content of
+// sourcePath is. Empty if sourcePath can't be read, or if there is no cache directory.
+// The kind must change with the format of the entry, or with the way it's made, and is made of
+// lowercase letters, digits and dots.
+std::string assetCachePath(const char * sourcePath, const char * kind);
+
+// For the loaders : an entry was read (it becomes the most recently used one), an asset had
+// to be processed, or its entry was just written (which may evict older ones).
+void assetCacheHit(const std::string & entryPath);
+void assetCacheMiss();
+void assetCacheWritten(const std::string & entryPath);
+
+// Removes the least recently used entries, until the cache takes at most maxBytes.
+void trimAssetCache(unsigned long long maxBytes);
+
+struct AssetCacheStats{
+	// This process
+	unsigned long long hits;
+	unsigned long long misses;
+	unsigned long long written;
+	unsigned long long evicted;
+	unsigned long long hashedBytes;
+	double hashSeconds;
+	// The whole cache
+	unsigned long long entries;
+	unsigned long long totalBytes;
+};
+
+AssetCacheStats assetCacheStats();
+void printAssetCacheStats();
+
+#endif
@@ -0,0 +1,151 @@
+#include <vector>
+#include <memory>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "objloader.hpp"
+#include "parallel.hpp"
+#include "assetloader.hpp"
+
+AssetLoader::AssetLoader(unsigned int threads) : pending(0), stopping(false){
+	if ( threads == 0 ){
+		threads = std::thread::hardware_concurrency();
+		if ( threads < 4 )
+			threads = 4;
+	}
+	for (unsigned int t = 0; t < threads; t++)
+		workers.push_back( std::thread(&AssetLoader::work, this) );
+}
+
+AssetLoader::~AssetLoader(){
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	jobAdded.notify_all();
+	for (size_t t = 0; t < workers.size(); t++)
+		workers[t].join();
+}
+
+void AssetLoader::work(){
+	// There are already enough workers for every core : the decoders must not start more threads
+	workerThread() = true;
+	for (;;){
+		std::function<void ()> job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while ( decodeQueue.empty() && !stopping )
+				jobAdded.wait(lock);
+			if ( stopping )
+				return;
+			job = decodeQueue.front();
+			decodeQueue.pop_front();
+		}
+		// The job decodes its asset, then puts its upload in uploadQueue
+		job();
+	}
+}
+
+void AssetLoader::add(const std::function<void ()> & decode, const std::function<void ()> & upload){
+	std::function<void ()> job = [this, decode, upload](){
+		if ( decode )
+			decode();
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			uploadQueue.push_back(upload);
+		}
+		jobDecoded.notify_one();
+	};
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		decodeQueue.push_back(job);
+		pending++;
+	}
+	jobAdded.notify_one();
+}
+
+void AssetLoader::uploadAll(bool wait){
+	for (;;){
+		std::function<void ()> upload;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			while ( wait && uploadQueue.empty() && pending > 0 )
+				jobDecoded.wait(lock);
+			if ( uploadQueue.empty() )
+				return;
+			upload = uploadQueue.front();
+			uploadQueue.pop_front();
+		}
+		// Outside of the lock : the workers go on while OpenGL copies the data
+		if ( upload )
+			upload();
+		std::lock_guard<std::mutex> lock(mutex);
+		pending--;
+	}
+}
+
+size_t AssetLoader::update(){
+	uploadAll(false);
+	std::lock_guard<std::mutex> lock(mutex);
+	return pending;
+}
+
+void AssetLoader::finish(){
+	uploadAll(true);
+}
+
+// A texture between its decode and its upload. It's shared by both (std::function must be
+// copyable, and TextureImage isn't), and freed after the upload.
+struct TextureJob{
+	TextureJob() : decoded(false) {}
+	TextureImage image;
+	bool decoded;
+};
+typedef std::shared_ptr<TextureJob> TextureJobPointer;
+
+static std::function<void ()> textureUpload(TextureJobPointer texture, GLuint * out_texture){
+	return [texture, out_texture](){
+		*out_texture = texture->decoded ? uploadTexture(texture->image) : 0;
+	};
+}
+
+void AssetLoader::loadBMP_custom(const char * imagepath, GLuint * out_texture){
+	TextureJobPointer texture = std::make_shared<TextureJob>();
+	std::string path = imagepath; // imagepath may not live until a worker gets to it
+	add([texture, path](){ texture->decoded = decodeBMP(path.c_str(), texture->image); },
+		textureUpload(texture, out_texture));
+}
+
+void AssetLoader::loadBMP_compressed(const char * imagepath, BlockFormat format, GLuint * out_texture){
+	TextureJobPointer texture = std::make_shared<TextureJob>();
+	std::string path = imagepath;
+	add([texture, path, format](){ texture->decoded = decodeBMP_compressed(path.c_str(), format, texture->image); },
+		textureUpload(texture, out_texture));
+}
+
+void AssetLoader::loadDDS(const char * imagepath, GLuint * out_texture){
+	TextureJobPointer texture = std::make_shared<TextureJob>();
+	std::string path = imagepath;
+	add([texture, path](){ texture->decoded = decodeDDS(path.c_str(), texture->image); },
+		textureUpload(texture, out_texture));
+}
+
+void AssetLoader::loadOBJ(
+	const char * path,
+	std::vector<glm::vec3> & out_vertices,
+	std::vector<glm::vec2> & out_uvs,
+	std::vector<glm::vec3> & out_normals,
+	bool * out_success
+){
+	std::string objPath = path;
+	std::vector<glm::vec3> * vertices = &out_vertices;
+	std::vector<glm::vec2> * uvs = &out_uvs;
+	std::vector<glm::vec3> * normals = &out_normals;
+	add([objPath, vertices, uvs, normals, out_success](){
+		bool success = ::loadOBJ(objPath.c_str(), *vertices, *uvs, *normals);
+		if ( out_success )
+			*out_success = success;
+	});
+}
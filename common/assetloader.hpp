@@ -0,0 +1,84 @@
+#ifndef ASSETLOADER_HPP
+#define ASSETLOADER_HPP
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <glm/glm.hpp>
+
+#include "texture.hpp"
+
+// Loads assets on worker threads : reading the files and decoding them (BMP, compression,
+// mipmaps, OBJ parsing...) happen in parallel, and only what needs OpenGL is left to the
+// OpenGL thread. Loading a scene then takes about as long as its slowest asset, not as
+// long as all of them together.
+//
+//	AssetLoader loader;
+//	GLuint texture;
+//	loader.loadDDS("uvmap.DDS", &texture);
+//	loader.loadOBJ("suzanne.obj", vertices, uvs, normals, &res);
+//	loader.finish(); // Now texture and the vectors are ready
+//
+// The workers already keep every core busy : what a decode calls runs on its worker only
+// (see workerThread in parallel.hpp), and a missing file doesn't wait for a key.
+//
+// Everything given to the loader (output variables, vectors) must stay alive until finish(),
+// or until update() returned 0, and must not be used before that. Only the thread which
+// created the loader may call its functions, and it must be the OpenGL one.
+class AssetLoader{
+public:
+	// threads : workers reading and decoding files. 0 : one per core, and at least 4, since
+	// they also wait for the disk.
+	AssetLoader(unsigned int threads = 0);
+	// Waits for the workers. The uploads which weren't done are dropped.
+	~AssetLoader();
+
+	// decode runs on a worker, then upload on the OpenGL thread, in update() or finish().
+	// Either one can be empty.
+	void add(const std::function<void ()> & decode, const std::function<void ()> & upload = std::function<void ()>());
+
+	// Same as loadBMP_custom, loadBMP_compressed and loadDDS (see texture.hpp).
+	// *out_texture is set when the texture is given to OpenGL : 0 if it couldn't be loaded.
+	void loadBMP_custom(const char * imagepath, GLuint * out_texture);
+	void loadBMP_compressed(const char * imagepath, BlockFormat format, GLuint * out_texture);
+	void loadDDS(const char * imagepath, GLuint * out_texture);
+
+	// Same as loadOBJ (see objloader.hpp). There's nothing to upload : the vectors are
+	// filled by the worker.
+	void loadOBJ(
+		const char * path,
+		std::vector<glm::vec3> & out_vertices,
+		std::vector<glm::vec2> & out_uvs,
+		std::vector<glm::vec3> & out_normals,
+		bool * out_success
+	);
+
+	// Uploads the assets which are decoded, without waiting for the others.
+	// Returns how many are still loading (0 : everything is ready). Can be called every frame.
+	size_t update();
+	// Waits for all the assets, and uploads each one as soon as it is decoded.
+	void finish();
+
+private:
+	// Not copyable : the workers use this object
+	AssetLoader(const AssetLoader &);
+	AssetLoader & operator=(const AssetLoader &);
+
+	void work();
+	void uploadAll(bool wait);
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable jobAdded;    // For the workers
+	std::condition_variable jobDecoded;  // For finish()
+	std::deque< std::function<void ()> > decodeQueue;
+	std::deque< std::function<void ()> > uploadQueue;
+	size_t pending; // Added, and not uploaded yet
+	bool stopping;
+};
+
+#endif
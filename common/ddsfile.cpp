@@ -0,0 +1,313 @@
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <string.h>
+
+#include "mappedfile.hpp"
+#include "ddsfile.hpp"
+
+// Offsets in the 124 bytes header, which comes right after "DDS "
+#define DDS_HEADER_SIZE        124
+#define DDS_HEADER_FLAGS       4
+#define DDS_HEADER_HEIGHT      8
+#define DDS_HEADER_WIDTH       12
+#define DDS_HEADER_DEPTH       20
+#define DDS_HEADER_PITCH       16 // Or linear size, for compressed formats
+#define DDS_HEADER_MIPMAPCOUNT 24
+#define DDS_PIXELFORMAT        72 // size, flags, FourCC, bits per pixel, R, G, B and A masks
+#define DDS_HEADER_CAPS        104
+#define DDS_HEADER_CAPS2       108
+
+#define DDSD_CAPS        0x1
+#define DDSD_HEIGHT      0x2
+#define DDSD_WIDTH       0x4
+#define DDSD_PITCH       0x8
+#define DDSD_PIXELFORMAT 0x1000
+#define DDSD_MIPMAPCOUNT 0x20000
+#define DDSD_LINEARSIZE  0x80000
+#define DDSD_DEPTH       0x800000
+#define DDPF_FOURCC      0x4
+#define DDPF_RGB         0x40
+#define DDSCAPS_COMPLEX  0x8
+#define DDSCAPS_TEXTURE  0x1000
+#define DDSCAPS_MIPMAP   0x400000
+#define DDSCAPS2_CUBEMAP 0x200
+#define DDSCAPS2_ALLFACES 0xFC00
+#define DDSCAPS2_VOLUME  0x200000
+
+// The DX10 header : DXGI format, resource dimension, misc flags, array size, misc flags 2
+#define DX10_HEADER_SIZE 20
+#define DX10_DIMENSION_TEXTURE3D 4
+#define DX10_MISC_TEXTURECUBE 0x4
+
+#define FOURCC(a, b, c, d) ((unsigned int)(a) | ((unsigned int)(b) << 8) | ((unsigned int)(c) << 16) | ((unsigned int)(d) << 24))
+
+// The files are little-endian, and the header isn't necessarily aligned in memory
+static unsigned int readUint(const unsigned char * p){
+	return (unsigned int)p[0] | ((unsigned int)p[1] << 8) | ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static void writeUint(unsigned char * p, unsigned int value){
+	p[0] = (unsigned char)value;
+	p[1] = (unsigned char)(value >> 8);
+	p[2] = (unsigned char)(value >> 16);
+	p[3] = (unsigned char)(value >> 24);
+}
+
+static DDSFormat formatFromFourCC(unsigned int fourCC){
+	switch (fourCC){
+	case FOURCC('D','X','T','1'): return DDS_FORMAT_BC1;
+	case FOURCC('D','X','T','2'):
+	case FOURCC('D','X','T','3'): return DDS_FORMAT_BC2;
+	case FOURCC('D','X','T','4'):
+	case FOURCC('D','X','T','5'): return DDS_FORMAT_BC3;
+	case FOURCC('A','T','I','1'):
+	case FOURCC('B','C','4','U'): return DDS_FORMAT_BC4;
+	case FOURCC('A','T','I','2'):
+	case FOURCC('B','C','5','U'): return DDS_FORMAT_BC5;
+	default: return DDS_FORMAT_UNKNOWN;
+	}
+}
+
+static DDSFormat formatFromDXGI(unsigned int dxgiFormat, bool & srgb, bool & signedFormat){
+	srgb = signedFormat = false;
+	switch (dxgiFormat){
+	case 71: return DDS_FORMAT_BC1;                       // BC1_UNORM
+	case 72: srgb = true; return DDS_FORMAT_BC1;          // BC1_UNORM_SRGB
+	case 74: return DDS_FORMAT_BC2;                       // BC2_UNORM
+	case 75: srgb = true; return DDS_FORMAT_BC2;          // BC2_UNORM_SRGB
+	case 77: return DDS_FORMAT_BC3;                       // BC3_UNORM
+	case 78: srgb = true; return DDS_FORMAT_BC3;          // BC3_UNORM_SRGB
+	case 80: return DDS_FORMAT_BC4;                       // BC4_UNORM
+	case 81: signedFormat = true; return DDS_FORMAT_BC4;  // BC4_SNORM
+	case 83: return DDS_FORMAT_BC5;                       // BC5_UNORM
+	case 84: signedFormat = true; return DDS_FORMAT_BC5;  // BC5_SNORM
+	case 95: return DDS_FORMAT_BC6H;                      // BC6H_UF16
+	case 96: signedFormat = true; return DDS_FORMAT_BC6H; // BC6H_SF16
+	case 98: return DDS_FORMAT_BC7;                       // BC7_UNORM
+	case 99: srgb = true; return DDS_FORMAT_BC7;          // BC7_UNORM_SRGB
+	case 28: return DDS_FORMAT_RGBA8;                     // R8G8B8A8_UNORM
+	case 29: srgb = true; return DDS_FORMAT_RGBA8;        // R8G8B8A8_UNORM_SRGB
+	case 87: return DDS_FORMAT_BGRA8;                     // B8G8R8A8_UNORM
+	case 91: srgb = true; return DDS_FORMAT_BGRA8;        // B8G8R8A8_UNORM_SRGB
+	default: return DDS_FORMAT_UNKNOWN;
+	}
+}
+
+// Uncompressed formats of the old header, from their bit masks
+static DDSFormat formatFromMasks(unsigned int bitCount, unsigned int red, unsigned int green, unsigned int blue){
+	if ( bitCount == 32 && red == 0x000000ff && green == 0x0000ff00 && blue == 0x00ff0000 )
+		return DDS_FORMAT_RGBA8;
+	if ( bitCount == 32 && red == 0x00ff0000 && green == 0x0000ff00 && blue == 0x000000ff )
+		return DDS_FORMAT_BGRA8;
+	if ( bitCount == 24 && red == 0x00ff0000 && green == 0x0000ff00 && blue == 0x000000ff )
+		return DDS_FORMAT_BGR8;
+	return DDS_FORMAT_UNKNOWN;
+}
+
+DDSFile::DDSFile(){
+	close();
+}
+
+void DDSFile::close(){
+	file.close();
+	levels.clear();
+	format = DDS_FORMAT_UNKNOWN;
+	srgb = signedFormat = cubemap = false;
+	width = height = depth = 0;
+	mipCount = arraySize = faces = 0;
+	blockWidth = bytesPerBlock = 0;
+}
+
+bool DDSFile::open(const char * path){
+	close();
+	if ( !file.open(path) ){
+		printf("%s could not be opened. Are you in the right directory ? Don't forget to read the FAQ !\n", path);
+		return false;
+	}
+	if ( !parse(file.data(), file.size()) ){
+		printf("Can't load %s\n", path);
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool DDSFile::parse(const unsigned char * data, size_t size){
+	levels.clear();
+	// Nothing left from the last file : the old header doesn't set all of them
+	format = DDS_FORMAT_UNKNOWN;
+	srgb = signedFormat = false;
+
+	if ( size < 4 + DDS_HEADER_SIZE || memcmp(data, "DDS ", 4) != 0 || readUint(data + 4) != DDS_HEADER_SIZE ){
+		printf("Not a correct DDS file\n");
+		return false;
+	}
+	const unsigned char * header = data + 4;
+	const unsigned char * pixelFormat = header + DDS_PIXELFORMAT;
+	unsigned int flags    = readUint(header + DDS_HEADER_FLAGS);
+	unsigned int caps2    = readUint(header + DDS_HEADER_CAPS2);
+	unsigned int pfFlags  = readUint(pixelFormat + 4);
+	unsigned int fourCC   = readUint(pixelFormat + 8);
+	width    = readUint(header + DDS_HEADER_WIDTH);
+	height   = readUint(header + DDS_HEADER_HEIGHT);
+	depth    = 1;
+	mipCount = readUint(header + DDS_HEADER_MIPMAPCOUNT);
+	arraySize = 1;
+	faces    = 1;
+	size_t dataOffset = 4 + DDS_HEADER_SIZE;
+
+	if ( (pfFlags & DDPF_FOURCC) && fourCC == FOURCC('D','X','1','0') ){
+		if ( size < dataOffset + DX10_HEADER_SIZE ){
+			printf("Not a correct DDS file\n");
+			return false;
+		}
+		const unsigned char * dx10 = data + dataOffset;
+		format = formatFromDXGI(readUint(dx10), srgb, signedFormat);
+		if ( readUint(dx10 + 4) == DX10_DIMENSION_TEXTURE3D )
+			depth = readUint(header + DDS_HEADER_DEPTH);
+		if ( readUint(dx10 + 8) & DX10_MISC_TEXTURECUBE )
+			faces = 6;
+		arraySize = readUint(dx10 + 12);
+		dataOffset += DX10_HEADER_SIZE;
+	}else{
+		if ( pfFlags & DDPF_FOURCC )
+			format = formatFromFourCC(fourCC);
+		else if ( pfFlags & DDPF_RGB )
+			format = formatFromMasks(readUint(pixelFormat + 12), readUint(pixelFormat + 16), readUint(pixelFormat + 20), readUint(pixelFormat + 24));
+		if ( caps2 & DDSCAPS2_CUBEMAP ){
+			// Cubemaps with missing faces can't be used by OpenGL anyway
+			if ( (caps2 & DDSCAPS2_ALLFACES) != DDSCAPS2_ALLFACES ){
+				printf("Unsupported DDS file : partial cubemap\n");
+				return false;
+			}
+			faces = 6;
+		}
+		if ( (caps2 & DDSCAPS2_VOLUME) && (flags & DDSD_DEPTH) )
+			depth = readUint(header + DDS_HEADER_DEPTH);
+	}
+	cubemap = faces == 6;
+
+	switch (format){
+	case DDS_FORMAT_BC1:
+	case DDS_FORMAT_BC4:   blockWidth = 4; bytesPerBlock = 8;  break;
+	case DDS_FORMAT_BC2:
+	case DDS_FORMAT_BC3:
+	case DDS_FORMAT_BC5:
+	case DDS_FORMAT_BC6H:
+	case DDS_FORMAT_BC7:   blockWidth = 4; bytesPerBlock = 16; break;
+	case DDS_FORMAT_RGBA8:
+	case DDS_FORMAT_BGRA8: blockWidth = 1; bytesPerBlock = 4;  break;
+	case DDS_FORMAT_BGR8:  blockWidth = 1; bytesPerBlock = 3;  break;
+	default:
+		printf("Unsupported DDS format\n");
+		return false;
+	}
+
+	// A chain can't go further than 1x1x1
+	unsigned int largest = width > height ? width : height;
+	if ( depth > largest )
+		largest = depth;
+	unsigned int maxMips = 1;
+	while ( maxMips < 32 && (largest >> maxMips) > 0 )
+		maxMips++;
+	if ( mipCount == 0 )
+		mipCount = 1; // No mipmaps
+	// (and each level takes at least a byte : a silly arraySize is caught before allocating the levels)
+	if ( width == 0 || height == 0 || depth == 0 || arraySize == 0 || mipCount > maxMips || (cubemap && width != height)
+		|| (unsigned long long)arraySize * faces * mipCount > size ){
+		printf("Not a correct DDS file\n");
+		return false;
+	}
+
+	// Everything one after the other : for each layer, for each face, the whole mipmap chain
+	unsigned long long offset = dataOffset;
+	levels.reserve((size_t)arraySize * faces * mipCount);
+	for (unsigned int layer = 0; layer < arraySize; layer++){
+		for (unsigned int face = 0; face < faces; face++){
+			for (unsigned int mip = 0; mip < mipCount; mip++){
+				DDSLevel level;
+				level.width  = width  >> mip ? width  >> mip : 1;
+				level.height = height >> mip ? height >> mip : 1;
+				level.depth  = depth  >> mip ? depth  >> mip : 1;
+				unsigned long long bytes = (((unsigned long long)level.width + blockWidth - 1) / blockWidth)
+					* (((unsigned long long)level.height + blockWidth - 1) / blockWidth) * level.depth * bytesPerBlock;
+				if ( bytes > size || offset > size - bytes ){
+					printf("Truncated DDS file\n");
+					levels.clear();
+					return false;
+				}
+				level.data = data + offset;
+				level.size = (size_t)bytes;
+				levels.push_back(level);
+				offset += bytes;
+			}
+		}
+	}
+	return true;
+}
+
+bool saveDDS(const char * path, DDSFormat format, const std::vector<DDSLevel> & mips){
+	unsigned int fourCC = 0;
+	switch (format){
+	case DDS_FORMAT_BC1: fourCC = FOURCC('D','X','T','1'); break;
+	case DDS_FORMAT_BC3: fourCC = FOURCC('D','X','T','5'); break;
+	case DDS_FORMAT_BC4: fourCC = FOURCC('A','T','I','1'); break;
+	case DDS_FORMAT_BC5: fourCC = FOURCC('A','T','I','2'); break;
+	case DDS_FORMAT_BGR8: break;
+	default:
+		printf("Can't write %s : unsupported DDS format\n", path);
+		return false;
+	}
+	if ( mips.empty() )
+		return false;
+
+	unsigned char header[4 + DDS_HEADER_SIZE];
+	memset(header, 0, sizeof(header));
+	memcpy(header, "DDS ", 4);
+	unsigned char * h = header + 4;
+	unsigned char * pixelFormat = h + DDS_PIXELFORMAT;
+	unsigned int flags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_MIPMAPCOUNT;
+	writeUint(h, DDS_HEADER_SIZE);
+	writeUint(h + DDS_HEADER_HEIGHT, mips[0].height);
+	writeUint(h + DDS_HEADER_WIDTH,  mips[0].width);
+	writeUint(h + DDS_HEADER_MIPMAPCOUNT, (unsigned int)mips.size());
+	writeUint(pixelFormat, 32);
+	if ( fourCC ){
+		flags |= DDSD_LINEARSIZE;
+		writeUint(h + DDS_HEADER_PITCH, (unsigned int)mips[0].size);
+		writeUint(pixelFormat + 4, DDPF_FOURCC);
+		writeUint(pixelFormat + 8, fourCC);
+	}else{
+		flags |= DDSD_PITCH;
+		writeUint(h + DDS_HEADER_PITCH, mips[0].width * 3);
+		writeUint(pixelFormat + 4,  DDPF_RGB);
+		writeUint(pixelFormat + 12, 24);
+		writeUint(pixelFormat + 16, 0x00ff0000);
+		writeUint(pixelFormat + 20, 0x0000ff00);
+		writeUint(pixelFormat + 24, 0x000000ff);
+	}
+	writeUint(h + DDS_HEADER_FLAGS, flags);
+	writeUint(h + DDS_HEADER_CAPS, DDSCAPS_TEXTURE | (mips.size() > 1 ? DDSCAPS_MIPMAP | DDSCAPS_COMPLEX : 0));
+
+	std::string temporaryPath = temporaryFilePath(path);
+	FILE * file = fopen(temporaryPath.c_str(), "wb");
+	if ( !file ){
+		printf("Impossible to write %s\n", path);
+		return false;
+	}
+	bool ok = fwrite(header, sizeof(header), 1, file) == 1;
+	for (size_t mip = 0; mip < mips.size() && ok; mip++)
+		ok = fwrite(mips[mip].data, 1, mips[mip].size, file) == mips[mip].size;
+	ok = (fclose(file) == 0) && ok;
+
+	if ( ok ){
+		remove(path); // rename() doesn't replace existing files on Windows
+		ok = rename(temporaryPath.c_str(), path) == 0;
+	}
+	if ( !ok ){
+		remove(temporaryPath.c_str());
+		printf("Impossible to write %s\n", path);
+	}
+	return ok;
+}
@@ -0,0 +1,79 @@
+#ifndef DDSFILE_HPP
+#define DDSFILE_HPP
+
+#include <vector>
+#include <stddef.h>
+
+#include "mappedfile.hpp"
+
+// DDS files, parsed on the CPU only (no OpenGL here : loadDDS in texture.cpp does the upload).
+// The file is mapped, and every mipmap level is a pointer straight into the mapping, with its
+// exact size computed from the format and the dimensions : nothing is read that isn't used.
+// Both the old header (FourCC or RGB masks) and the DX10 extended header are understood,
+// for plain textures, cubemaps (all 6 faces), texture arrays and volume textures.
+
+enum DDSFormat{
+	DDS_FORMAT_UNKNOWN,
+	DDS_FORMAT_BC1,   // DXT1
+	DDS_FORMAT_BC2,   // DXT2, DXT3
+	DDS_FORMAT_BC3,   // DXT4, DXT5
+	DDS_FORMAT_BC4,   // ATI1
+	DDS_FORMAT_BC5,   // ATI2
+	DDS_FORMAT_BC6H,
+	DDS_FORMAT_BC7,
+	DDS_FORMAT_RGBA8,
+	DDS_FORMAT_BGRA8,
+	DDS_FORMAT_BGR8,
+};
+
+struct DDSLevel{
+	const unsigned char * data;
+	size_t size; // Bytes
+	unsigned int width;
+	unsigned int height;
+	unsigned int depth;
+};
+
+class DDSFile{
+public:
+	DDSFile();
+
+	// Maps the file and parses it. Returns false (with a message) if it's not a DDS file
+	// this parser understands, or if it's too short for what its header says.
+	bool open(const char * path);
+	// Parses a DDS file which is already in memory. data must stay alive as long as the levels are used.
+	bool parse(const unsigned char * data, size_t size);
+	void close();
+
+	DDSFormat format;
+	bool srgb;         // DX10 header only : the old one doesn't say
+	bool signedFormat; // BC4 / BC5 SNORM, BC6H SF16
+	bool cubemap;      // faces == 6
+	unsigned int width;
+	unsigned int height;
+	unsigned int depth;      // 1, except for volume textures
+	unsigned int mipCount;   // At least 1
+	unsigned int arraySize;  // Texture array layers ; 1 for a plain texture or cubemap
+	unsigned int faces;      // 6 for a cubemap, 1 otherwise
+
+	// Blocks of 4x4 pixels, or single pixels for uncompressed formats
+	bool compressed() const { return blockWidth == 4; }
+	unsigned int blockWidth;
+	unsigned int bytesPerBlock;
+
+	// Faces go in the usual cubemap order : +X, -X, +Y, -Y, +Z, -Z
+	const DDSLevel & level(unsigned int layer, unsigned int face, unsigned int mip) const {
+		return levels[ ((size_t)layer * faces + face) * mipCount + mip ];
+	}
+
+private:
+	MappedFile file;
+	std::vector<DDSLevel> levels;
+};
+
+// Writes a plain 2D texture with its mipmap chain (level 0 first), with the old header :
+// BC1, BC3, BC4, BC5 or BGR8 only, which every DDS reader understands.
+// The file is written under another name, then renamed : readers never see half of it.
+bool saveDDS(const char * path, DDSFormat format, const std::vector<DDSLevel> & mips);
+
+#endif
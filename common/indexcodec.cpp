@@ -0,0 +1,260 @@
+#include <vector>
+#include <string.h>
+
+#include "indexcodec.hpp"
+
+// First byte of the encoded data, to recognize the format
+static const unsigned char INDEXCODEC_VERSION = 0xE1;
+
+// The data ends with a Fletcher-like checksum of the decoded indices : 2 sums, 4 bytes each.
+// Without it, most bit flips still decode to valid (but wrong) triangles.
+static const size_t INDEXCODEC_CHECKSUM_SIZE = 8;
+
+struct IndexChecksum{
+	unsigned int sum1, sum2;
+	IndexChecksum() : sum1(0), sum2(0) {}
+	void add(unsigned int a, unsigned int b, unsigned int c){
+		sum1 += a; sum2 += sum1;
+		sum1 += b; sum2 += sum1;
+		sum1 += c; sum2 += sum1;
+	}
+};
+
+// Both FIFOs have 16 slots. Only the last 15 edges and the last 14 vertices can be referenced,
+// the other codes mean something else.
+struct IndexCodecState{
+	unsigned int edges[16][2];
+	unsigned int vertices[16];
+	unsigned int edgeOffset;
+	unsigned int vertexOffset;
+	unsigned int next; // Next vertex never seen before
+	unsigned int last; // Last vertex stored explicitly
+
+	IndexCodecState(){
+		memset(edges, 0xff, sizeof(edges));
+		memset(vertices, 0xff, sizeof(vertices));
+		edgeOffset = vertexOffset = next = last = 0;
+	}
+
+	void pushEdge(unsigned int a, unsigned int b){
+		edges[edgeOffset & 15][0] = a;
+		edges[edgeOffset & 15][1] = b;
+		edgeOffset++;
+	}
+
+	void pushVertex(unsigned int v){
+		vertices[vertexOffset & 15] = v;
+		vertexOffset++;
+	}
+
+	// 0 is the last edge pushed, -1 if the edge isn't in the FIFO
+	int findEdge(unsigned int a, unsigned int b) const {
+		for (int i = 0; i < 15; i++){
+			const unsigned int * edge = edges[(edgeOffset - 1 - i) & 15];
+			if ( edge[0] == a && edge[1] == b )
+				return i;
+		}
+		return -1;
+	}
+
+	int findVertex(unsigned int v) const {
+		for (int i = 0; i < 14; i++)
+			if ( vertices[(vertexOffset - 1 - i) & 15] == v )
+				return i;
+		return -1;
+	}
+};
+
+static void writeVarint(std::vector<unsigned char> & out, unsigned int value){
+	while ( value >= 0x80 ){
+		out.push_back((unsigned char)(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back((unsigned char)value);
+}
+
+// Small negative differences become small numbers : 0, -1, 1, -2, 2... => 0, 1, 2, 3, 4...
+static unsigned int zigzag(unsigned int difference){
+	return (difference << 1) ^ (unsigned int)((int)difference >> 31);
+}
+
+static unsigned int unzigzag(unsigned int value){
+	return (value >> 1) ^ (0u - (value & 1));
+}
+
+// Code of a vertex (0 : next, 1-14 : FIFO, 15 : explicit). Updates next, and appends the explicit
+// vertices to `explicits`. isNew is true if the vertex has to go in the vertex FIFO.
+static unsigned int encodeVertex(IndexCodecState & state, unsigned int v, std::vector<unsigned int> & explicits, bool & isNew){
+	isNew = true;
+	if ( v == state.next ){
+		state.next++;
+		return 0;
+	}
+	int position = state.findVertex(v);
+	if ( position >= 0 ){
+		isNew = false;
+		return 1 + position;
+	}
+	explicits.push_back(v);
+	return 15;
+}
+
+size_t indexBufferBound(size_t indexCount){
+	// Code, second code, 3 varints of 5 bytes
+	return 1 + indexCount / 3 * (2 + 3 * 5) + INDEXCODEC_CHECKSUM_SIZE;
+}
+
+template <typename T_INDEX>
+void encodeIndexBuffer(const std::vector<T_INDEX> & indices, std::vector<unsigned char> & out_encoded){
+	out_encoded.clear();
+	out_encoded.reserve(1 + indices.size() / 2);
+	out_encoded.push_back(INDEXCODEC_VERSION);
+
+	IndexCodecState state;
+	IndexChecksum checksum;
+	std::vector<unsigned int> explicits;
+	for (size_t i = 0; i + 2 < indices.size(); i += 3){
+		unsigned int triangle[3] = { indices[i], indices[i+1], indices[i+2] };
+		explicits.clear();
+
+		// Is one of the edges in the FIFO ? Rotate the triangle so that it's its first edge.
+		int edge = -1, rotation = 0;
+		for (int r = 0; r < 3 && edge < 0; r++){
+			edge = state.findEdge(triangle[r], triangle[(r+1) % 3]);
+			rotation = r;
+		}
+
+		if ( edge >= 0 ){
+			unsigned int a = triangle[rotation], b = triangle[(rotation+1) % 3], c = triangle[(rotation+2) % 3];
+			bool isNew;
+			unsigned int code = encodeVertex(state, c, explicits, isNew);
+			out_encoded.push_back((unsigned char)(edge << 4 | code));
+			checksum.add(a, b, c);
+			if ( isNew )
+				state.pushVertex(c);
+			state.pushEdge(c, b);
+			state.pushEdge(a, c);
+		}else{
+			unsigned int a = triangle[0], b = triangle[1], c = triangle[2];
+			bool newA, newB, newC;
+			unsigned int codeA = encodeVertex(state, a, explicits, newA);
+			unsigned int codeB = encodeVertex(state, b, explicits, newB);
+			unsigned int codeC = encodeVertex(state, c, explicits, newC);
+			out_encoded.push_back((unsigned char)(0xF0 | codeA));
+			out_encoded.push_back((unsigned char)(codeB << 4 | codeC));
+			checksum.add(a, b, c);
+			if ( newA ) state.pushVertex(a);
+			if ( newB ) state.pushVertex(b);
+			if ( newC ) state.pushVertex(c);
+			state.pushEdge(b, a);
+			state.pushEdge(c, b);
+			state.pushEdge(a, c);
+		}
+
+		for (size_t e = 0; e < explicits.size(); e++){
+			writeVarint(out_encoded, zigzag(explicits[e] - state.last));
+			state.last = explicits[e];
+		}
+	}
+
+	unsigned int sums[2] = { checksum.sum1, checksum.sum2 };
+	for (int s = 0; s < 2; s++)
+		for (int shift = 0; shift < 32; shift += 8)
+			out_encoded.push_back((unsigned char)(sums[s] >> shift));
+}
+
+static unsigned int readUint32(const unsigned char * p){
+	return (unsigned int)p[0] | (unsigned int)p[1] << 8 | (unsigned int)p[2] << 16 | (unsigned int)p[3] << 24;
+}
+
+// Reads a varint without going past end. Returns false on truncated or too long data.
+static inline bool readVarint(const unsigned char * & p, const unsigned char * end, unsigned int & value){
+	value = 0;
+	for (int shift = 0; shift < 35; shift += 7){
+		if ( p == end )
+			return false;
+		unsigned char byte = *p++;
+		value |= (unsigned int)(byte & 0x7f) << shift;
+		if ( byte < 0x80 )
+			return true;
+	}
+	return false;
+}
+
+// Mirror of encodeVertex
+static inline bool decodeVertex(IndexCodecState & state, unsigned int code, const unsigned char * & p, const unsigned char * end, unsigned int & v, bool & isNew){
+	isNew = true;
+	if ( code == 0 ){
+		v = state.next++;
+	}else if ( code < 15 ){
+		v = state.vertices[(state.vertexOffset - code) & 15];
+		isNew = false;
+	}else{
+		unsigned int value;
+		if ( !readVarint(p, end, value) )
+			return false;
+		v = state.last += unzigzag(value);
+	}
+	return true;
+}
+
+template <typename T_INDEX>
+bool decodeIndexBuffer(T_INDEX * destination, size_t indexCount, size_t vertexCount, const unsigned char * encoded, size_t encodedSize){
+	if ( indexCount % 3 != 0 || encodedSize < 1 + INDEXCODEC_CHECKSUM_SIZE || encoded[0] != INDEXCODEC_VERSION )
+		return false;
+	const unsigned char * p = encoded + 1;
+	const unsigned char * end = encoded + encodedSize - INDEXCODEC_CHECKSUM_SIZE;
+
+	// The explicit vertices and the new ones are checked against vertexCount when they're decoded,
+	// so everything in the FIFOs is already valid.
+	IndexCodecState state;
+	IndexChecksum checksum;
+	for (size_t i = 0; i < indexCount; i += 3){
+		if ( p == end )
+			return false;
+		unsigned int code = *p++;
+		unsigned int a, b, c;
+		bool isNew;
+
+		if ( code < 0xF0 ){
+			// Shared edge : the fast path, almost every triangle
+			const unsigned int * edge = state.edges[(state.edgeOffset - 1 - (code >> 4)) & 15];
+			a = edge[0];
+			b = edge[1];
+			if ( !decodeVertex(state, code & 15, p, end, c, isNew) || c >= vertexCount || a >= vertexCount )
+				return false; // a : an edge which was never pushed
+			if ( isNew )
+				state.pushVertex(c);
+			state.pushEdge(c, b);
+			state.pushEdge(a, c);
+		}else{
+			if ( p == end )
+				return false;
+			unsigned int codes = *p++;
+			bool newA, newB, newC;
+			if ( !decodeVertex(state, code & 15,   p, end, a, newA) || a >= vertexCount
+			  || !decodeVertex(state, codes >> 4,  p, end, b, newB) || b >= vertexCount
+			  || !decodeVertex(state, codes & 15,  p, end, c, newC) || c >= vertexCount )
+				return false;
+			if ( newA ) state.pushVertex(a);
+			if ( newB ) state.pushVertex(b);
+			if ( newC ) state.pushVertex(c);
+			state.pushEdge(b, a);
+			state.pushEdge(c, b);
+			state.pushEdge(a, c);
+		}
+
+		destination[i+0] = (T_INDEX)a;
+		destination[i+1] = (T_INDEX)b;
+		destination[i+2] = (T_INDEX)c;
+		checksum.add(a, b, c);
+	}
+	return p == end && checksum.sum1 == readUint32(end) && checksum.sum2 == readUint32(end + 4);
+}
+
+#define INSTANTIATE_INDEXCODEC(T_INDEX) \
+	template void encodeIndexBuffer<T_INDEX>(const std::vector<T_INDEX> &, std::vector<unsigned char> &); \
+	template bool decodeIndexBuffer<T_INDEX>(T_INDEX *, size_t, size_t, const unsigned char *, size_t);
+
+INSTANTIATE_INDEXCODEC(unsigned short)
+INSTANTIATE_INDEXCODEC(unsigned int)
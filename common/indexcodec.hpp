@@ -0,0 +1,33 @@
+#ifndef INDEXCODEC_HPP
+#define INDEXCODEC_HPP
+
+#include <vector>
+
+// Compression of index buffers.
+// After optimizeVertexCache and optimizeVertexFetch, a triangle almost always shares an edge with
+// one of the last few triangles, and its third vertex is either the next vertex never seen before
+// or one of the last few vertices. So most triangles fit in a single byte :
+// - the position of the shared edge in a FIFO of the last 15 edges (high 4 bits),
+// - the third vertex : 0 for the next new vertex, 1 to 14 for a position in a FIFO of the last
+//   new vertices, or 15 when it follows in the stream, as a varint of the difference with the
+//   last such vertex (low 4 bits).
+// A triangle without a shared edge takes 0xF0 | code of its 1st vertex, then a byte with the codes
+// of the 2 others. Optimized meshes take ~1.5 bytes per triangle instead of 6 or 12, plus an
+// 8 bytes checksum of the indices at the end.
+//
+// The triangles can come back rotated ( (b,c,a) instead of (a,b,c) ) : same triangle, same winding.
+// Like the indexers, everything is instantiated for unsigned short and unsigned int indices.
+
+// Biggest possible size of the encoded indices
+size_t indexBufferBound(size_t indexCount);
+
+template <typename T_INDEX>
+void encodeIndexBuffer(const std::vector<T_INDEX> & indices, std::vector<unsigned char> & out_encoded);
+
+// Decodes indexCount indices into destination. Returns false if the data is corrupted : not the
+// right size, an index which isn't below vertexCount, or a wrong checksum. Even then, what was
+// written to destination is below vertexCount.
+template <typename T_INDEX>
+bool decodeIndexBuffer(T_INDEX * destination, size_t indexCount, size_t vertexCount, const unsigned char * encoded, size_t encodedSize);
+
+#endif
@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <string>
+#include <atomic>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <process.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "mappedfile.hpp"
+
+// mmap() refuses empty files, but an empty file is still a valid file
+static const unsigned char emptyFile[1] = { 0 };
+
+MappedFile::MappedFile() : fileData(NULL), fileSize(0), opened(false)
+#ifdef _WIN32
+	, fileHandle(NULL), mappingHandle(NULL)
+#endif
+{
+}
+
+MappedFile::~MappedFile(){
+	close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const char * path){
+	close();
+
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if ( file == INVALID_HANDLE_VALUE )
+		return false;
+
+	LARGE_INTEGER size;
+	if ( !GetFileSizeEx(file, &size) ){
+		CloseHandle(file);
+		return false;
+	}
+
+	fileHandle = file;
+	fileSize = (size_t)size.QuadPart;
+	opened = true;
+	if ( fileSize == 0 ){
+		fileData = emptyFile;
+		return true;
+	}
+
+	mappingHandle = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if ( mappingHandle == NULL ){
+		close();
+		return false;
+	}
+	fileData = (const unsigned char *)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if ( fileData == NULL ){
+		close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::close(){
+	if ( fileData && fileData != emptyFile )
+		UnmapViewOfFile(fileData);
+	if ( mappingHandle )
+		CloseHandle(mappingHandle);
+	if ( fileHandle )
+		CloseHandle(fileHandle);
+	fileData = NULL;
+	fileSize = 0;
+	mappingHandle = NULL;
+	fileHandle = NULL;
+	opened = false;
+}
+
+#else
+
+bool MappedFile::open(const char * path){
+	close();
+
+	int fd = ::open(path, O_RDONLY);
+	if ( fd < 0 )
+		return false;
+
+	struct stat st;
+	if ( fstat(fd, &st) != 0 ){
+		::close(fd);
+		return false;
+	}
+
+	fileSize = (size_t)st.st_size;
+	if ( fileSize == 0 ){
+		::close(fd);
+		fileData = emptyFile;
+		opened = true;
+		return true;
+	}
+
+	void * p = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd); // The mapping stays valid after the descriptor is closed
+	if ( p == MAP_FAILED ){
+		fileSize = 0;
+		return false;
+	}
+	// We'll read it from the beginning to the end
+	madvise(p, fileSize, MADV_SEQUENTIAL);
+
+	fileData = (const unsigned char *)p;
+	opened = true;
+	return true;
+}
+
+void MappedFile::close(){
+	if ( fileData && fileData != emptyFile )
+		munmap((void*)fileData, fileSize);
+	fileData = NULL;
+	fileSize = 0;
+	opened = false;
+}
+
+#endif
+
+bool getFileInfo(const char * path, unsigned long long & size, long long & mtime){
+#ifdef _WIN32
+	struct __stat64 st;
+	if ( _stat64(path, &st) != 0 )
+		return false;
+#else
+	struct stat st;
+	if ( stat(path, &st) != 0 )
+		return false;
+#endif
+	size  = (unsigned long long)st.st_size;
+	mtime = (long long)st.st_mtime;
+	return true;
+}
+
+std::string temporaryFilePath(const char * path){
+	static std::atomic<unsigned int> counter(0);
+#ifdef _WIN32
+	unsigned long process = (unsigned long)_getpid();
+#else
+	unsigned long process = (unsigned long)getpid();
+#endif
+	char suffix[64];
+	snprintf(suffix, sizeof(suffix), ".%lu.%u.tmp", process, counter++);
+	return std::string(path) + suffix;
+}
@@ -0,0 +1,46 @@
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+#include <string>
+#include <stddef.h>
+
+// A whole file, mapped read-only in memory.
+// Reading it is then just reading memory : no fread, no copy, and the OS
+// only loads the pages we actually touch.
+class MappedFile{
+public:
+	MappedFile();
+	~MappedFile();
+
+	// Maps the file. Returns false if it can't be opened or mapped.
+	bool open(const char * path);
+	void close();
+
+	bool isOpen() const { return opened; }
+	const unsigned char * data() const { return fileData; }
+	size_t size() const { return fileSize; }
+
+private:
+	// Not copyable : the mapping belongs to exactly one object
+	MappedFile(const MappedFile &);
+	MappedFile & operator=(const MappedFile &);
+
+	const unsigned char * fileData;
+	size_t fileSize;
+	bool opened;
+#ifdef _WIN32
+	void * fileHandle;
+	void * mappingHandle;
+#endif
+};
+
+// Size and last modification time (in seconds) of a file, without opening it.
+// Returns false if the file doesn't exist.
+bool getFileInfo(const char * path, unsigned long long & size, long long & mtime);
+
+// A name to write path under before renaming it to path, different in each process and
+// thread : programs writing the same file at the same time don't write in each other's.
+// Ends with ".tmp".
+std::string temporaryFilePath(const char * path);
+
+#endif
@@ -0,0 +1,332 @@
+#include <vector>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+#include "parallel.hpp"
+#include "simd.hpp"
+#include "meshbounds.hpp"
+
+// Vertices or triangles per chunk. Each chunk is summed in floats, then the chunks in doubles.
+static const size_t BOUNDS_CHUNK = 16384;
+
+// Bounding box of count vertices
+static void vertexBox(const glm::vec3 * vertices, size_t count, glm::vec3 & out_min, glm::vec3 & out_max){
+	glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+	size_t i = 0;
+#ifdef SIMD_SSE2
+	if ( count >= 4 ){
+		// 4 vertices are 12 floats, so 3 registers : (x y z x) (y z x y) (z x y z).
+		// No shuffling in the loop : each register keeps its own min and max, sorted out at the end.
+		const float * p = &vertices[0].x;
+		__m128 min0 = _mm_loadu_ps(p), min1 = _mm_loadu_ps(p + 4), min2 = _mm_loadu_ps(p + 8);
+		__m128 max0 = min0, max1 = min1, max2 = min2;
+		for (i = 4; i + 4 <= count; i += 4){
+			p = &vertices[i].x;
+			__m128 a = _mm_loadu_ps(p), b = _mm_loadu_ps(p + 4), c = _mm_loadu_ps(p + 8);
+			min0 = _mm_min_ps(min0, a); max0 = _mm_max_ps(max0, a);
+			min1 = _mm_min_ps(min1, b); max1 = _mm_max_ps(max1, b);
+			min2 = _mm_min_ps(min2, c); max2 = _mm_max_ps(max2, c);
+		}
+		float m[3][4], M[3][4];
+		_mm_storeu_ps(m[0], min0); _mm_storeu_ps(m[1], min1); _mm_storeu_ps(m[2], min2);
+		_mm_storeu_ps(M[0], max0); _mm_storeu_ps(M[1], max1); _mm_storeu_ps(M[2], max2);
+		lo = glm::vec3(std::min(std::min(m[0][0], m[0][3]), std::min(m[1][2], m[2][1])),
+		               std::min(std::min(m[0][1], m[1][0]), std::min(m[1][3], m[2][2])),
+		               std::min(std::min(m[0][2], m[1][1]), std::min(m[2][0], m[2][3])));
+		hi = glm::vec3(std::max(std::max(M[0][0], M[0][3]), std::max(M[1][2], M[2][1])),
+		               std::max(std::max(M[0][1], M[1][0]), std::max(M[1][3], M[2][2])),
+		               std::max(std::max(M[0][2], M[1][1]), std::max(M[2][0], M[2][3])));
+	}
+#endif
+	for (; i < count; i++){
+		lo = glm::min(lo, vertices[i]);
+		hi = glm::max(hi, vertices[i]);
+	}
+	out_min = lo;
+	out_max = hi;
+}
+
+// Area, area-weighted centroid and second moment of a set of triangles (relative to origin).
+// A triangle (p, q, r) of area A and centroid m adds A/12 * (9 m m^T + p p^T + q q^T + r r^T) to
+// the second moment : the exact integral over its surface (Gottschalk's OBB paper).
+struct TriangleMoments{
+	double area;
+	double centroid[3];  // Sum of A * m
+	double moment[6];    // xx, yy, zz, xy, xz, yz
+
+	TriangleMoments(){
+		area = 0.0;
+		for (int k = 0; k < 3; k++) centroid[k] = 0.0;
+		for (int k = 0; k < 6; k++) moment[k] = 0.0;
+	}
+};
+
+static inline void addTriangleMoments(const glm::vec3 & p, const glm::vec3 & q, const glm::vec3 & r, TriangleMoments & out){
+	float A = 0.5f * glm::length(glm::cross(q - p, r - p));
+	glm::vec3 m = (p + q + r) / 3.0f;
+	float w = A / 12.0f;
+	out.area += A;
+	for (int k = 0; k < 3; k++)
+		out.centroid[k] += A * m[k];
+	const int rows[6] = { 0, 1, 2, 0, 0, 1 }, columns[6] = { 0, 1, 2, 1, 2, 2 };
+	for (int k = 0; k < 6; k++){
+		int a = rows[k], b = columns[k];
+		out.moment[k] += w * (9.0f * m[a] * m[b] + p[a] * p[b] + q[a] * q[b] + r[a] * r[b]);
+	}
+}
+
+template <typename T_INDEX>
+static void chunkMoments(const T_INDEX * indices, size_t triangleCount, const glm::vec3 * vertices, const glm::vec3 & origin, TriangleMoments & out){
+	size_t t = 0;
+#ifdef SIMD_SSE2
+	// 4 triangles at once, one per lane
+	__m128 area = _mm_setzero_ps(), centroid[3], moment[6];
+	for (int k = 0; k < 3; k++) centroid[k] = _mm_setzero_ps();
+	for (int k = 0; k < 6; k++) moment[k] = _mm_setzero_ps();
+	const __m128 third = _mm_set1_ps(1.0f / 3.0f), nine = _mm_set1_ps(9.0f);
+	for (; t + 4 <= triangleCount; t += 4){
+		float corners[3][3][4]; // [corner][axis][lane]
+		for (int lane = 0; lane < 4; lane++)
+			for (int c = 0; c < 3; c++){
+				glm::vec3 v = vertices[ indices[3*(t + lane) + c] ] - origin;
+				corners[c][0][lane] = v.x;
+				corners[c][1][lane] = v.y;
+				corners[c][2][lane] = v.z;
+			}
+		__m128 P[3][3];
+		for (int c = 0; c < 3; c++)
+			for (int a = 0; a < 3; a++)
+				P[c][a] = _mm_loadu_ps(corners[c][a]);
+
+		__m128 e1[3], e2[3];
+		for (int a = 0; a < 3; a++){
+			e1[a] = _mm_sub_ps(P[1][a], P[0][a]);
+			e2[a] = _mm_sub_ps(P[2][a], P[0][a]);
+		}
+		__m128 cx = _mm_sub_ps(_mm_mul_ps(e1[1], e2[2]), _mm_mul_ps(e1[2], e2[1]));
+		__m128 cy = _mm_sub_ps(_mm_mul_ps(e1[2], e2[0]), _mm_mul_ps(e1[0], e2[2]));
+		__m128 cz = _mm_sub_ps(_mm_mul_ps(e1[0], e2[1]), _mm_mul_ps(e1[1], e2[0]));
+		__m128 A = _mm_mul_ps(_mm_set1_ps(0.5f), _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, cx), _mm_mul_ps(cy, cy)), _mm_mul_ps(cz, cz))));
+		__m128 w = _mm_mul_ps(A, _mm_set1_ps(1.0f / 12.0f));
+		area = _mm_add_ps(area, A);
+
+		__m128 m[3];
+		for (int a = 0; a < 3; a++){
+			m[a] = _mm_mul_ps(_mm_add_ps(_mm_add_ps(P[0][a], P[1][a]), P[2][a]), third);
+			centroid[a] = _mm_add_ps(centroid[a], _mm_mul_ps(A, m[a]));
+		}
+		const int rows[6] = { 0, 1, 2, 0, 0, 1 }, columns[6] = { 0, 1, 2, 1, 2, 2 };
+		for (int k = 0; k < 6; k++){
+			int a = rows[k], b = columns[k];
+			__m128 sum = _mm_mul_ps(nine, _mm_mul_ps(m[a], m[b]));
+			for (int c = 0; c < 3; c++)
+				sum = _mm_add_ps(sum, _mm_mul_ps(P[c][a], P[c][b]));
+			moment[k] = _mm_add_ps(moment[k], _mm_mul_ps(w, sum));
+		}
+	}
+	float lanes[4];
+	_mm_storeu_ps(lanes, area);
+	out.area += (double)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	for (int k = 0; k < 3; k++){
+		_mm_storeu_ps(lanes, centroid[k]);
+		out.centroid[k] += (double)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	}
+	for (int k = 0; k < 6; k++){
+		_mm_storeu_ps(lanes, moment[k]);
+		out.moment[k] += (double)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	}
+#endif
+	for (; t < triangleCount; t++)
+		addTriangleMoments(vertices[ indices[3*t] ] - origin, vertices[ indices[3*t+1] ] - origin, vertices[ indices[3*t+2] ] - origin, out);
+}
+
+// Eigenvectors of a symmetric 3x3 matrix (Jacobi rotations), sorted by decreasing eigenvalue
+static void symmetricEigenvectors(double a[3][3], glm::vec3 out_axes[3]){
+	double v[3][3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+	for (int sweep = 0; sweep < 32; sweep++){
+		double off = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+		double diagonal = a[0][0] * a[0][0] + a[1][1] * a[1][1] + a[2][2] * a[2][2];
+		if ( off <= 1e-24 * diagonal || off == 0.0 )
+			break;
+		for (int p = 0; p < 2; p++){
+			for (int q = p + 1; q < 3; q++){
+				if ( a[p][q] == 0.0 )
+					continue;
+				// Rotation which zeroes a[p][q]
+				double theta = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+				double t = (theta >= 0.0 ? 1.0 : -1.0) / (std::fabs(theta) + std::sqrt(theta * theta + 1.0));
+				double c = 1.0 / std::sqrt(t * t + 1.0), s = t * c;
+				for (int k = 0; k < 3; k++){
+					double akp = a[k][p], akq = a[k][q];
+					a[k][p] = c * akp - s * akq;
+					a[k][q] = s * akp + c * akq;
+				}
+				for (int k = 0; k < 3; k++){
+					double apk = a[p][k], aqk = a[q][k];
+					a[p][k] = c * apk - s * aqk;
+					a[q][k] = s * apk + c * aqk;
+				}
+				for (int k = 0; k < 3; k++){
+					double vkp = v[k][p], vkq = v[k][q];
+					v[k][p] = c * vkp - s * vkq;
+					v[k][q] = s * vkp + c * vkq;
+				}
+			}
+		}
+	}
+	int order[3] = { 0, 1, 2 };
+	std::sort(order, order + 3, [&](int x, int y){ return a[x][x] > a[y][y]; });
+	for (int k = 0; k < 2; k++)
+		out_axes[k] = glm::normalize(glm::vec3((float)v[0][order[k]], (float)v[1][order[k]], (float)v[2][order[k]]));
+	// Exactly orthonormal, and right-handed
+	out_axes[1] = glm::normalize(out_axes[1] - out_axes[0] * glm::dot(out_axes[0], out_axes[1]));
+	out_axes[2] = glm::cross(out_axes[0], out_axes[1]);
+}
+
+void boundingSphere(const glm::vec3 * points, size_t count, glm::vec3 & center, float & radius){
+	center = glm::vec3(0.0f);
+	radius = 0.0f;
+	if ( count == 0 )
+		return;
+
+	size_t extremes[6] = { 0, 0, 0, 0, 0, 0 }; // min x, max x, min y...
+	for (size_t i = 0; i < count; i++){
+		for (int axis = 0; axis < 3; axis++){
+			if ( points[i][axis] < points[ extremes[2*axis] ][axis] )
+				extremes[2*axis] = i;
+			if ( points[i][axis] > points[ extremes[2*axis+1] ][axis] )
+				extremes[2*axis+1] = i;
+		}
+	}
+	int widest = 0;
+	float widestLength = -1.0f;
+	for (int axis = 0; axis < 3; axis++){
+		glm::vec3 d = points[ extremes[2*axis+1] ] - points[ extremes[2*axis] ];
+		if ( glm::dot(d, d) > widestLength ){
+			widestLength = glm::dot(d, d);
+			widest = axis;
+		}
+	}
+	center = 0.5f * (points[ extremes[2*widest] ] + points[ extremes[2*widest+1] ]);
+	radius = 0.5f * std::sqrt(widestLength);
+
+	for (size_t i = 0; i < count; i++){
+		float distance = glm::length(points[i] - center);
+		if ( distance > radius ){
+			// New sphere : from the opposite side of the old one to this point
+			float newRadius = 0.5f * (radius + distance);
+			center += (newRadius - radius) / distance * (points[i] - center);
+			radius = newRadius;
+		}
+	}
+	// The float rounding of the moves can leave the last points a hair outside
+	radius *= 1.0f + 1e-6f;
+}
+
+template <typename T_INDEX>
+MeshBounds computeMeshBounds(const std::vector<T_INDEX> & indices, const std::vector<glm::vec3> & vertices){
+	MeshBounds bounds;
+	size_t triangleCount = indices.size() / 3;
+	size_t vertexCount = vertices.size();
+	bounds.triangleCount = (unsigned int)triangleCount;
+	bounds.vertexCount = (unsigned int)vertexCount;
+	bounds.aabbMin = bounds.aabbMax = bounds.sphereCenter = bounds.obbCenter = bounds.obbHalfSize = glm::vec3(0.0f);
+	bounds.sphereRadius = bounds.surfaceArea = 0.0f;
+	bounds.obbAxes[0] = glm::vec3(1, 0, 0);
+	bounds.obbAxes[1] = glm::vec3(0, 1, 0);
+	bounds.obbAxes[2] = glm::vec3(0, 0, 1);
+	if ( vertexCount == 0 )
+		return bounds;
+
+	// Bounding box : each chunk of vertices, then the chunks together
+	size_t vertexChunks = (vertexCount + BOUNDS_CHUNK - 1) / BOUNDS_CHUNK;
+	std::vector<glm::vec3> chunkMin(vertexChunks), chunkMax(vertexChunks);
+	parallelFor(vertexChunks, threadCount(vertexChunks, 4), [&](size_t begin, size_t end){
+		for (size_t c = begin; c < end; c++){
+			size_t first = c * BOUNDS_CHUNK;
+			vertexBox(&vertices[first], std::min(BOUNDS_CHUNK, vertexCount - first), chunkMin[c], chunkMax[c]);
+		}
+	});
+	bounds.aabbMin = chunkMin[0];
+	bounds.aabbMax = chunkMax[0];
+	for (size_t c = 1; c < vertexChunks; c++){
+		bounds.aabbMin = glm::min(bounds.aabbMin, chunkMin[c]);
+		bounds.aabbMax = glm::max(bounds.aabbMax, chunkMax[c]);
+	}
+
+	boundingSphere(vertices.data(), vertexCount, bounds.sphereCenter, bounds.sphereRadius);
+
+	// Area and moments of the surface, relative to the middle of the box : far away meshes
+	// would lose all the precision of the covariance otherwise
+	glm::vec3 origin = 0.5f * (bounds.aabbMin + bounds.aabbMax);
+	size_t triangleChunks = (triangleCount + BOUNDS_CHUNK - 1) / BOUNDS_CHUNK;
+	std::vector<TriangleMoments> moments(triangleChunks);
+	parallelFor(triangleChunks, threadCount(triangleChunks, 4), [&](size_t begin, size_t end){
+		for (size_t c = begin; c < end; c++){
+			size_t first = c * BOUNDS_CHUNK;
+			chunkMoments(&indices[3*first], std::min(BOUNDS_CHUNK, triangleCount - first), vertices.data(), origin, moments[c]);
+		}
+	});
+	TriangleMoments total;
+	for (size_t c = 0; c < triangleChunks; c++){
+		total.area += moments[c].area;
+		for (int k = 0; k < 3; k++) total.centroid[k] += moments[c].centroid[k];
+		for (int k = 0; k < 6; k++) total.moment[k] += moments[c].moment[k];
+	}
+	bounds.surfaceArea = (float)total.area;
+
+	// Covariance of the surface, and its principal axes. Without any area (points, lines), the
+	// OBB is the AABB.
+	if ( total.area > 0.0 ){
+		double mean[3] = { total.centroid[0] / total.area, total.centroid[1] / total.area, total.centroid[2] / total.area };
+		double covariance[3][3];
+		const int rows[6] = { 0, 1, 2, 0, 0, 1 }, columns[6] = { 0, 1, 2, 1, 2, 2 };
+		for (int k = 0; k < 6; k++){
+			int a = rows[k], b = columns[k];
+			covariance[a][b] = covariance[b][a] = total.moment[k] / total.area - mean[a] * mean[b];
+		}
+		symmetricEigenvectors(covariance, bounds.obbAxes);
+	}
+
+	// Extent of the vertices along the axes
+	std::vector<glm::vec3> projectedMin(vertexChunks), projectedMax(vertexChunks);
+	parallelFor(vertexChunks, threadCount(vertexChunks, 4), [&](size_t begin, size_t end){
+		for (size_t c = begin; c < end; c++){
+			glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+			size_t last = std::min((c + 1) * BOUNDS_CHUNK, vertexCount);
+			for (size_t v = c * BOUNDS_CHUNK; v < last; v++){
+				glm::vec3 p = vertices[v] - origin;
+				glm::vec3 projected(glm::dot(p, bounds.obbAxes[0]), glm::dot(p, bounds.obbAxes[1]), glm::dot(p, bounds.obbAxes[2]));
+				lo = glm::min(lo, projected);
+				hi = glm::max(hi, projected);
+			}
+			projectedMin[c] = lo;
+			projectedMax[c] = hi;
+		}
+	});
+	glm::vec3 lo = projectedMin[0], hi = projectedMax[0];
+	for (size_t c = 1; c < vertexChunks; c++){
+		lo = glm::min(lo, projectedMin[c]);
+		hi = glm::max(hi, projectedMax[c]);
+	}
+	glm::vec3 middle = 0.5f * (lo + hi);
+	bounds.obbCenter = origin + bounds.obbAxes[0] * middle.x + bounds.obbAxes[1] * middle.y + bounds.obbAxes[2] * middle.z;
+	// Rounding the center back to the mesh's coordinates moves it by up to an ulp of them
+	bounds.obbHalfSize = 0.5f * (hi - lo) + glm::vec3(2.0f * FLT_EPSILON * glm::length(bounds.obbCenter));
+	return bounds;
+}
+
+glm::mat4 obbMatrix(const MeshBounds & bounds){
+	return glm::mat4(
+		glm::vec4(bounds.obbAxes[0], 0.0f),
+		glm::vec4(bounds.obbAxes[1], 0.0f),
+		glm::vec4(bounds.obbAxes[2], 0.0f),
+		glm::vec4(bounds.obbCenter, 1.0f)
+	);
+}
+
+template MeshBounds computeMeshBounds<unsigned short>(const std::vector<unsigned short> &, const std::vector<glm::vec3> &);
+template MeshBounds computeMeshBounds<unsigned int>  (const std::vector<unsigned int> &,   const std::vector<glm::vec3> &);
@@ -0,0 +1,45 @@
+#ifndef MESHBOUNDS_HPP
+#define MESHBOUNDS_HPP
+
+#include <vector>
+#include <glm/glm.hpp>
+
+// Bounding volumes and a few numbers about a mesh, computed once when it's loaded (and kept in
+// its cache, see meshcache.hpp), so that culling and picking get tight bounds for free instead
+// of guessing a box of -1..1 for every model.
+struct MeshBounds{
+	// Axis-aligned bounding box
+	glm::vec3 aabbMin;
+	glm::vec3 aabbMax;
+
+	// Bounding sphere (Ritter's : a few % bigger than the smallest one)
+	glm::vec3 sphereCenter;
+	float sphereRadius;
+
+	// Oriented bounding box, along the principal axes of the surface (PCA) :
+	// the points inside are obbCenter + x * obbAxes[0] + y * obbAxes[1] + z * obbAxes[2],
+	// with |x| <= obbHalfSize.x and so on. The axes are orthonormal.
+	glm::vec3 obbCenter;
+	glm::vec3 obbAxes[3];
+	glm::vec3 obbHalfSize;
+
+	float surfaceArea;
+	unsigned int triangleCount;
+	unsigned int vertexCount;
+};
+
+// Everything in MeshBounds, for all the vertices (the indexed loaders don't leave unused ones).
+// The bounding box and the moments of the triangles (for the PCA) are computed with SSE, and
+// everything but the sphere on several threads.
+// Instantiated for unsigned short and unsigned int indices.
+template <typename T_INDEX>
+MeshBounds computeMeshBounds(const std::vector<T_INDEX> & indices, const std::vector<glm::vec3> & vertices);
+
+// Ritter's bounding sphere of a set of points : the most distant pair of extreme points along
+// x, y and z, grown to include the points which are still outside.
+void boundingSphere(const glm::vec3 * points, size_t count, glm::vec3 & center, float & radius);
+
+// Goes from the space of the OBB (a box from -obbHalfSize to obbHalfSize) to the space of the mesh
+glm::mat4 obbMatrix(const MeshBounds & bounds);
+
+#endif
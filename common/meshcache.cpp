@@ -0,0 +1,271 @@
+#include <vector>
+#include <string>
+#include <limits>
+#include <stdio.h>
+#include <string.h>
+
+#include <glm/glm.hpp>
+
+#include "mappedfile.hpp"
+#include "objloader.hpp"
+#include "meshbounds.hpp"
+#include "meshcache.hpp"
+#include "assetcache.hpp"
+#include "meshoptimizer.hpp"
+#include "indexcodec.hpp"
+
+static unsigned long long alignTo16(unsigned long long offset){
+	return (offset + 15) & ~15ull;
+}
+
+MeshCacheFile::MeshCacheFile(){
+	close();
+}
+
+void MeshCacheFile::close(){
+	file.close();
+	std::vector<unsigned char>().swap(decodedIndices);
+	indexSize = indexCount = vertexCount = 0;
+	indices = NULL;
+	vertices = normals = tangents = bitangents = NULL;
+	uvs = NULL;
+	bounds = MeshBounds();
+}
+
+// Checks that an array of count elements of elementSize bytes, at offset, fits in the file
+static bool arrayFits(unsigned long long offset, unsigned long long count, unsigned long long elementSize, unsigned long long fileSize){
+	if ( offset == 0 || offset % 4 != 0 || offset > fileSize )
+		return false;
+	return count * elementSize <= fileSize - offset;
+}
+
+bool MeshCacheFile::open(const char * cachePath){
+	close();
+
+	if ( !file.open(cachePath) )
+		return false;
+
+	const unsigned char * data = file.data();
+	unsigned long long size = file.size();
+	if ( size < sizeof(MeshCacheHeader) ){
+		close();
+		return false;
+	}
+
+	MeshCacheHeader header;
+	memcpy(&header, data, sizeof(header));
+	if ( memcmp(header.magic, MESHCACHE_MAGIC, 4) != 0 || header.version != MESHCACHE_VERSION || header.endian != MESHCACHE_ENDIAN ){
+		close();
+		return false;
+	}
+
+	bool hasTangents = (header.flags & MESHCACHE_TANGENTS) != 0;
+	if ( (header.indexSize != 2 && header.indexSize != 4)
+		|| !arrayFits(header.indicesOffset,  header.indicesSize, 1,                     size)
+		|| !arrayFits(header.verticesOffset, header.vertexCount, sizeof(glm::vec3),    size)
+		|| !arrayFits(header.uvsOffset,      header.vertexCount, sizeof(glm::vec2),    size)
+		|| !arrayFits(header.normalsOffset,  header.vertexCount, sizeof(glm::vec3),    size)
+		|| ( hasTangents && !arrayFits(header.tangentsOffset,   header.vertexCount, sizeof(glm::vec3), size) )
+		|| ( hasTangents && !arrayFits(header.bitangentsOffset, header.vertexCount, sizeof(glm::vec3), size) )
+	){
+		printf("Corrupted mesh cache %s\n", cachePath);
+		close();
+		return false;
+	}
+
+	// The decoder checks that every index is below vertexCount :
+	// a bad index would make OpenGL read outside of the VBO
+	decodedIndices.resize((size_t)header.indexCount * header.indexSize);
+	bool decoded = header.indexSize == 2
+		? decodeIndexBuffer((unsigned short *)decodedIndices.data(), header.indexCount, header.vertexCount, data + header.indicesOffset, (size_t)header.indicesSize)
+		: decodeIndexBuffer((unsigned int   *)decodedIndices.data(), header.indexCount, header.vertexCount, data + header.indicesOffset, (size_t)header.indicesSize);
+	if ( !decoded ){
+		printf("Corrupted mesh cache %s\n", cachePath);
+		close();
+		return false;
+	}
+
+	indexSize   = header.indexSize;
+	indexCount  = header.indexCount;
+	vertexCount = header.vertexCount;
+	indices    = decodedIndices.data();
+	vertices   = (const glm::vec3 *)(data + header.verticesOffset);
+	uvs        = (const glm::vec2 *)(data + header.uvsOffset);
+	normals    = (const glm::vec3 *)(data + header.normalsOffset);
+	tangents   = hasTangents ? (const glm::vec3 *)(data + header.tangentsOffset)   : NULL;
+	bitangents = hasTangents ? (const glm::vec3 *)(data + header.bitangentsOffset) : NULL;
+	bounds     = header.bounds;
+	return true;
+}
+
+std::string meshCachePath(const char * sourcePath, bool withTangents){
+	return assetCachePath(sourcePath, withTangents ? "tbn.meshcache" : "meshcache");
+}
+
+static bool writeArray(FILE * file, unsigned long long offset, const void * data, size_t size){
+	// Pad with zeros up to the offset of the array
+	static const char zeros[16] = { 0 };
+	long position = ftell(file);
+	if ( position < 0 || (unsigned long long)position > offset )
+		return false;
+	if ( fwrite(zeros, 1, (size_t)(offset - position), file) != offset - position )
+		return false;
+	return size == 0 || fwrite(data, 1, size, file) == size;
+}
+
+template <typename T_INDEX>
+bool saveMeshCache(
+	const char * cachePath,
+	const std::vector<T_INDEX> & indices,
+	const std::vector<glm::vec3> & vertices,
+	const std::vector<glm::vec2> & uvs,
+	const std::vector<glm::vec3> & normals,
+	const std::vector<glm::vec3> * tangents,
+	const std::vector<glm::vec3> * bitangents
+){
+	MeshCacheHeader header;
+	memset((void *)&header, 0, sizeof(header)); // Padding included : the file is always the same
+	memcpy(header.magic, MESHCACHE_MAGIC, 4);
+	header.version = MESHCACHE_VERSION;
+	header.endian  = MESHCACHE_ENDIAN;
+	header.flags   = (tangents && bitangents) ? MESHCACHE_TANGENTS : 0;
+	header.indexSize   = sizeof(T_INDEX);
+	header.indexCount  = (unsigned int)indices.size();
+	header.vertexCount = (unsigned int)vertices.size();
+	header.bounds = computeMeshBounds(indices, vertices);
+
+	std::vector<unsigned char> encodedIndices;
+	encodeIndexBuffer(indices, encodedIndices);
+	header.indicesSize = encodedIndices.size();
+
+	unsigned long long offset = alignTo16(sizeof(header));
+	header.indicesOffset  = offset; offset = alignTo16(offset + encodedIndices.size());
+	header.verticesOffset = offset; offset = alignTo16(offset + vertices.size() * sizeof(glm::vec3));
+	header.uvsOffset      = offset; offset = alignTo16(offset + uvs.size()      * sizeof(glm::vec2));
+	header.normalsOffset  = offset; offset = alignTo16(offset + normals.size()  * sizeof(glm::vec3));
+	if ( header.flags & MESHCACHE_TANGENTS ){
+		header.tangentsOffset   = offset; offset = alignTo16(offset + tangents->size()   * sizeof(glm::vec3));
+		header.bitangentsOffset = offset; offset = alignTo16(offset + bitangents->size() * sizeof(glm::vec3));
+	}
+
+	// Write in a temporary file, and only then replace the old cache :
+	// another program loading the same mesh never sees a half-written cache.
+	std::string temporaryPath = temporaryFilePath(cachePath);
+	FILE * file = fopen(temporaryPath.c_str(), "wb");
+	if ( !file ){
+		printf("Impossible to write the mesh cache %s\n", cachePath);
+		return false;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+		&& writeArray(file, header.indicesOffset,  encodedIndices.data(), encodedIndices.size())
+		&& writeArray(file, header.verticesOffset, vertices.data(), vertices.size() * sizeof(glm::vec3))
+		&& writeArray(file, header.uvsOffset,      uvs.data(),      uvs.size()      * sizeof(glm::vec2))
+		&& writeArray(file, header.normalsOffset,  normals.data(),  normals.size()  * sizeof(glm::vec3));
+	if ( ok && (header.flags & MESHCACHE_TANGENTS) ){
+		ok = writeArray(file, header.tangentsOffset,   tangents->data(),   tangents->size()   * sizeof(glm::vec3))
+		  && writeArray(file, header.bitangentsOffset, bitangents->data(), bitangents->size() * sizeof(glm::vec3));
+	}
+	ok = (fclose(file) == 0) && ok;
+
+	if ( ok ){
+		remove(cachePath); // rename() doesn't replace existing files on Windows
+		ok = rename(temporaryPath.c_str(), cachePath) == 0;
+	}
+	if ( !ok ){
+		remove(temporaryPath.c_str());
+		printf("Impossible to write the mesh cache %s\n", cachePath);
+	}
+	return ok;
+}
+
+template <typename T_INDEX>
+bool readMeshCache(
+	const MeshCacheFile & cache,
+	std::vector<T_INDEX> & indices,
+	std::vector<glm::vec3> & vertices,
+	std::vector<glm::vec2> & uvs,
+	std::vector<glm::vec3> & normals,
+	std::vector<glm::vec3> * tangents,
+	std::vector<glm::vec3> * bitangents
+){
+	if ( cache.vertexCount > 0 && cache.vertexCount - 1 > (size_t)std::numeric_limits<T_INDEX>::max() )
+		return false;
+	if ( (tangents || bitangents) && !cache.tangents )
+		return false;
+
+	if ( cache.indexSize == sizeof(T_INDEX) ){
+		const T_INDEX * begin = (const T_INDEX *)cache.indices;
+		indices.assign(begin, begin + cache.indexCount);
+	}else if ( cache.indexSize == 2 ){
+		const unsigned short * begin = (const unsigned short *)cache.indices;
+		indices.assign(begin, begin + cache.indexCount);
+	}else{
+		const unsigned int * begin = (const unsigned int *)cache.indices;
+		indices.assign(begin, begin + cache.indexCount);
+	}
+	vertices.assign(cache.vertices, cache.vertices + cache.vertexCount);
+	uvs     .assign(cache.uvs,      cache.uvs      + cache.vertexCount);
+	normals .assign(cache.normals,  cache.normals  + cache.vertexCount);
+	if ( tangents )
+		tangents  ->assign(cache.tangents,   cache.tangents   + cache.vertexCount);
+	if ( bitangents )
+		bitangents->assign(cache.bitangents, cache.bitangents + cache.vertexCount);
+	return true;
+}
+
+template <typename T_INDEX>
+bool loadIndexedOBJ(
+	const char * path,
+	std::vector<T_INDEX> & indices,
+	std::vector<glm::vec3> & vertices,
+	std::vector<glm::vec2> & uvs,
+	std::vector<glm::vec3> & normals,
+	MeshBounds * bounds
+){
+	std::string cachePath = meshCachePath(path, false);
+
+	// Warm start : a few memcpy's
+	MeshCacheFile cache;
+	if ( !cachePath.empty() && cache.open(cachePath.c_str()) && readMeshCache(cache, indices, vertices, uvs, normals, NULL, NULL) ){
+		printf("Loading cached mesh %s...\n", cachePath.c_str());
+		assetCacheHit(cachePath);
+		if ( bounds )
+			*bounds = cache.bounds;
+		return true;
+	}
+	cache.close();
+	assetCacheMiss();
+
+	// Cold start : do the real work, and save it for next time.
+	// Like readMeshCache, replace what was in the vectors.
+	indices.clear();
+	vertices.clear();
+	uvs.clear();
+	normals.clear();
+	if ( !loadOBJ(path, indices, vertices, uvs, normals) )
+		return false;
+	optimizeMesh(indices, vertices, uvs, normals, NULL, NULL);
+	// Read the cache back : the index compression can rotate the triangles,
+	// and the first load should give exactly the same thing as the next ones.
+	bool saved = !cachePath.empty() && saveMeshCache(cachePath.c_str(), indices, vertices, uvs, normals, NULL, NULL);
+	if ( saved )
+		assetCacheWritten(cachePath);
+	if ( saved && cache.open(cachePath.c_str()) && readMeshCache(cache, indices, vertices, uvs, normals, NULL, NULL) ){
+		if ( bounds )
+			*bounds = cache.bounds;
+	}else if ( bounds ){
+		*bounds = computeMeshBounds(indices, vertices);
+	}
+	return true;
+}
+
+#define INSTANTIATE_MESHCACHE(T_INDEX) \
+	template bool saveMeshCache<T_INDEX>(const char *, const std::vector<T_INDEX> &, const std::vector<glm::vec3> &, \
+		const std::vector<glm::vec2> &, const std::vector<glm::vec3> &, const std::vector<glm::vec3> *, const std::vector<glm::vec3> *); \
+	template bool readMeshCache<T_INDEX>(const MeshCacheFile &, std::vector<T_INDEX> &, std::vector<glm::vec3> &, \
+		std::vector<glm::vec2> &, std::vector<glm::vec3> &, std::vector<glm::vec3> *, std::vector<glm::vec3> *); \
+	template bool loadIndexedOBJ<T_INDEX>(const char *, std::vector<T_INDEX> &, std::vector<glm::vec3> &, \
+		std::vector<glm::vec2> &, std::vector<glm::vec3> &, MeshBounds *);
+
+INSTANTIATE_MESHCACHE(unsigned short)
+INSTANTIATE_MESHCACHE(unsigned int)
@@ -0,0 +1,122 @@
+#ifndef MESHCACHE_HPP
+#define MESHCACHE_HPP
+
+#include <string>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "mappedfile.hpp"
+#include "meshbounds.hpp"
+
+// Binary mesh cache.
+// Parsing an OBJ file and indexing it takes time, and gives the same result every time.
+// So the indexed mesh is saved in a binary file in the asset cache (assetcache.hpp),
+// and the next loads just map it and memcpy the arrays.
+//
+// File layout : a MeshCacheHeader, then each array at the offset given in the header
+// (aligned on 16 bytes). Everything is in the byte order of the machine which wrote it.
+// The indices are compressed with encodeIndexBuffer (indexcodec.hpp) : ~1.5 bytes per
+// triangle instead of 6 or 12, and decoding is much faster than reading them from a disk.
+// The file is named after the content of the .obj, so an edited .obj gets a new one.
+
+#define MESHCACHE_MAGIC   "OGLM"
+#define MESHCACHE_VERSION 10 // 2 : the meshes are optimized for the vertex cache, 3 : and for overdraw, 4 : compressed indices, 5 : computeTangents, 6 : generated normals, 7 : bounds, 8 : not for overdraw anymore, 9 : checksum of the indices, 10 : without the size and date of the source
+#define MESHCACHE_ENDIAN  0x01020304u
+
+enum MeshCacheFlags{
+	MESHCACHE_TANGENTS = 1, // tangents and bitangents are there too
+};
+
+struct MeshCacheHeader{
+	char magic[4];                // MESHCACHE_MAGIC
+	unsigned int version;         // MESHCACHE_VERSION
+	unsigned int endian;          // MESHCACHE_ENDIAN, as written by this machine
+	unsigned int flags;           // MeshCacheFlags
+	unsigned int indexSize;       // 2 or 4 bytes per index
+	unsigned int indexCount;
+	unsigned int vertexCount;
+	unsigned int padding;
+	// Offsets of the arrays from the beginning of the file, 0 when absent
+	unsigned long long indicesOffset;
+	unsigned long long indicesSize;  // Size of the compressed indices, in bytes
+	unsigned long long verticesOffset;
+	unsigned long long uvsOffset;
+	unsigned long long normalsOffset;
+	unsigned long long tangentsOffset;
+	unsigned long long bitangentsOffset;
+	MeshBounds bounds;            // computeMeshBounds, done when the cache is written
+};
+
+// A cache file, mapped in memory. The pointers point straight into the mapping
+// (except the indices, which are decoded in memory when the file is opened),
+// so they can be given to glBufferData without any copy, as long as the
+// MeshCacheFile is alive.
+class MeshCacheFile{
+public:
+	MeshCacheFile();
+
+	// Maps and checks the cache file
+	bool open(const char * cachePath);
+	void close();
+
+	unsigned int indexSize;
+	unsigned int indexCount;
+	unsigned int vertexCount;
+	const void      * indices;
+	const glm::vec3 * vertices;
+	const glm::vec2 * uvs;
+	const glm::vec3 * normals;
+	const glm::vec3 * tangents;   // NULL if there are no tangents
+	const glm::vec3 * bitangents; // NULL if there are no tangents
+	MeshBounds bounds;
+
+private:
+	MappedFile file;
+	std::vector<unsigned char> decodedIndices;
+};
+
+// Where the cache of an .obj file goes, in the asset cache : empty if there's none.
+// Meshes with tangents get their own file.
+std::string meshCachePath(const char * sourcePath, bool withTangents);
+
+// Writes a cache file. tangents and bitangents may be NULL.
+template <typename T_INDEX>
+bool saveMeshCache(
+	const char * cachePath,
+	const std::vector<T_INDEX> & indices,
+	const std::vector<glm::vec3> & vertices,
+	const std::vector<glm::vec2> & uvs,
+	const std::vector<glm::vec3> & normals,
+	const std::vector<glm::vec3> * tangents,
+	const std::vector<glm::vec3> * bitangents
+);
+
+// Copies an opened cache into vectors. tangents and bitangents may be NULL.
+// Returns false if the indices don't fit in T_INDEX, or if tangents are asked for but missing.
+template <typename T_INDEX>
+bool readMeshCache(
+	const MeshCacheFile & cache,
+	std::vector<T_INDEX> & indices,
+	std::vector<glm::vec3> & vertices,
+	std::vector<glm::vec2> & uvs,
+	std::vector<glm::vec3> & normals,
+	std::vector<glm::vec3> * tangents,
+	std::vector<glm::vec3> * bitangents
+);
+
+// Same result as the indexed loadOBJ followed by optimizeMesh (up to the rotation of the
+// triangles, see indexcodec.hpp), but cached : only the first load of a given .obj actually
+// parses, indexes and optimizes it.
+// If bounds isn't NULL, it gets the bounds of the mesh (see meshbounds.hpp), which are in
+// the cache too : they cost nothing after the first load.
+template <typename T_INDEX>
+bool loadIndexedOBJ(
+	const char * path,
+	std::vector<T_INDEX> & indices,
+	std::vector<glm::vec3> & vertices,
+	std::vector<glm::vec2> & uvs,
+	std::vector<glm::vec3> & normals,
+	MeshBounds * bounds = NULL
+);
+
+#endif
@@ -0,0 +1,266 @@
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+#include "meshbounds.hpp"
+#include "meshlets.hpp"
+
+// How much a triangle whose normal is perpendicular to the meshlet's costs, compared to a new vertex
+static const float MESHLET_CONE_WEIGHT = 0.5f;
+
+// How many of the next triangles are looked at when no triangle around the meshlet fits,
+// and how close to the meshlet's normal theirs must be (cos 45 degrees), to keep the cone narrow
+static const size_t MESHLET_LOOKAHEAD = 32;
+static const float MESHLET_LOOKAHEAD_COSINE = 0.7f;
+
+// The cone around the normals of the triangles, and its apex : a point behind all their planes
+// (see Meshlet). normals are unit vectors ; the degenerate triangles are not in the list.
+static void normalCone(const std::vector<glm::vec3> & normals, const std::vector<glm::vec3> & corners, const glm::vec3 & center, Meshlet & meshlet){
+	meshlet.coneApex = center;
+	meshlet.coneAxis = glm::vec3(0, 0, 1);
+	meshlet.coneCutoff = 2.0f; // Never culled
+
+	glm::vec3 sum(0.0f);
+	for (size_t t = 0; t < normals.size(); t++)
+		sum += normals[t];
+	float length = glm::length(sum);
+	if ( !(length > 1e-6f) )
+		return;
+	glm::vec3 axis = sum / length;
+
+	float minDot = 1.0f;
+	for (size_t t = 0; t < normals.size(); t++)
+		minDot = std::min(minDot, glm::dot(normals[t], axis));
+	if ( minDot <= 0.0f )
+		return; // More than a half-space of directions : no camera position sees only backs
+
+	// The apex goes back along the axis until it's behind every plane
+	float back = 0.0f;
+	for (size_t t = 0; t < normals.size(); t++)
+		back = std::max(back, glm::dot(center - corners[t], normals[t]) / glm::dot(axis, normals[t]));
+
+	meshlet.coneApex = center - axis * back;
+	meshlet.coneAxis = axis;
+	meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+}
+
+template <typename T_INDEX>
+void buildMeshlets(
+	std::vector<T_INDEX> & indices,
+	const std::vector<glm::vec3> & vertices,
+	std::vector<Meshlet> & out_meshlets,
+	unsigned int maxVertices,
+	unsigned int maxTriangles
+){
+	out_meshlets.clear();
+	size_t triangleCount = indices.size() / 3;
+	size_t vertexCount = vertices.size();
+	if ( triangleCount == 0 || maxVertices < 3 || maxTriangles < 1 )
+		return;
+	const unsigned int NONE = ~0u;
+
+	std::vector<glm::vec3> triangleNormals(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++){
+		const glm::vec3 & p0 = vertices[ indices[3*t] ];
+		glm::vec3 normal = glm::cross(vertices[ indices[3*t+1] ] - p0, vertices[ indices[3*t+2] ] - p0);
+		float length = glm::length(normal);
+		triangleNormals[t] = length > 0.0f ? normal / length : glm::vec3(0.0f);
+	}
+
+	// Triangles of each vertex, like in optimizeVertexCache : adjacency[offsets[v] .. offsets[v] + remaining[v])
+	// are the ones which aren't in a meshlet yet
+	std::vector<unsigned int> remaining(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		remaining[ indices[i] ]++;
+	std::vector<unsigned int> offsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+		offsets[v+1] = offsets[v] + remaining[v];
+	std::vector<unsigned int> adjacency(triangleCount * 3);
+	{
+		std::vector<unsigned int> filled(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < triangleCount * 3; i++)
+			adjacency[ filled[ indices[i] ]++ ] = (unsigned int)(i / 3);
+	}
+
+	std::vector<char> used(triangleCount, 0);
+	std::vector<unsigned int> inMeshlet(vertexCount, NONE); // Last meshlet which used the vertex
+	std::vector<T_INDEX> result;
+	result.reserve(triangleCount * 3);
+
+	std::vector<unsigned int> meshletVertices;
+	std::vector<glm::vec3> points, normals, corners;
+	size_t nextUnused = 0;
+
+	for (size_t done = 0; done < triangleCount; ){
+		while ( used[nextUnused] )
+			nextUnused++;
+		unsigned int meshletIndex = (unsigned int)out_meshlets.size();
+		Meshlet meshlet;
+		meshlet.indexOffset = (unsigned int)result.size();
+		meshletVertices.clear();
+		normals.clear();
+		corners.clear();
+		glm::vec3 normalSum(0.0f), positionSum(0.0f);
+
+		unsigned int best = (unsigned int)nextUnused;
+		unsigned int triangles = 0;
+		while ( best != NONE ){
+			// Add the triangle
+			used[best] = 1;
+			done++;
+			triangles++;
+			for (int k = 0; k < 3; k++){
+				unsigned int v = indices[3*best + k];
+				result.push_back((T_INDEX)v);
+				if ( inMeshlet[v] != meshletIndex ){
+					inMeshlet[v] = meshletIndex;
+					meshletVertices.push_back(v);
+					positionSum += vertices[v];
+				}
+				// Swap it after the remaining triangles of v
+				unsigned int * begin = &adjacency[ offsets[v] ];
+				for (unsigned int r = 0; r < remaining[v]; r++){
+					if ( begin[r] == best ){
+						std::swap(begin[r], begin[remaining[v] - 1]);
+						break;
+					}
+				}
+				remaining[v]--;
+			}
+			if ( triangleNormals[best] != glm::vec3(0.0f) ){
+				normals.push_back(triangleNormals[best]);
+				corners.push_back(vertices[ indices[3*best] ]);
+				normalSum += triangleNormals[best];
+			}
+			if ( triangles >= maxTriangles )
+				break;
+
+			// Next one : among the triangles around the meshlet's vertices, the cheapest which still fits
+			float sumLength = glm::length(normalSum);
+			glm::vec3 axis = sumLength > 0.0f ? normalSum / sumLength : glm::vec3(0.0f);
+			best = NONE;
+			float bestCost = 1e30f;
+			for (size_t m = 0; m < meshletVertices.size(); m++){
+				unsigned int v = meshletVertices[m];
+				for (unsigned int r = 0; r < remaining[v]; r++){
+					unsigned int t = adjacency[ offsets[v] + r ];
+					unsigned int extra = 0;
+					for (int k = 0; k < 3; k++)
+						extra += inMeshlet[ indices[3*t + k] ] != meshletIndex;
+					if ( meshletVertices.size() + extra > maxVertices )
+						continue;
+					float cost = extra + MESHLET_CONE_WEIGHT * (1.0f - glm::dot(triangleNormals[t], axis));
+					if ( cost < bestCost ){
+						bestCost = cost;
+						best = t;
+					}
+				}
+			}
+
+			// Nothing connected : UV seams and hard edges cut the mesh in pieces which only touch by
+			// their positions. Look a bit further in the (vertex cache) order for the closest triangle.
+			if ( best == NONE ){
+				glm::vec3 middle = positionSum / (float)meshletVertices.size();
+				float bestDistance = 1e30f;
+				size_t looked = 0;
+				for (size_t t = nextUnused; t < triangleCount && looked < MESHLET_LOOKAHEAD; t++){
+					if ( used[t] )
+						continue;
+					looked++;
+					unsigned int extra = 0;
+					for (int k = 0; k < 3; k++)
+						extra += inMeshlet[ indices[3*t + k] ] != meshletIndex;
+					if ( meshletVertices.size() + extra > maxVertices || glm::dot(triangleNormals[t], axis) < MESHLET_LOOKAHEAD_COSINE )
+						continue;
+					glm::vec3 d = vertices[ indices[3*t] ] - middle;
+					if ( glm::dot(d, d) < bestDistance ){
+						bestDistance = glm::dot(d, d);
+						best = (unsigned int)t;
+					}
+				}
+			}
+		}
+
+		meshlet.indexCount = (unsigned int)result.size() - meshlet.indexOffset;
+		meshlet.vertexCount = (unsigned int)meshletVertices.size();
+		points.clear();
+		for (size_t m = 0; m < meshletVertices.size(); m++)
+			points.push_back(vertices[ meshletVertices[m] ]);
+		boundingSphere(points.data(), points.size(), meshlet.center, meshlet.radius);
+		normalCone(normals, corners, meshlet.center, meshlet);
+		out_meshlets.push_back(meshlet);
+	}
+
+	// Whatever was after the last complete triangle stays there
+	result.insert(result.end(), indices.begin() + triangleCount * 3, indices.end());
+	indices.swap(result);
+}
+
+Frustum extractFrustum(const glm::mat4 & MVP){
+	// Rows of the matrix (glm is column-major : MVP[column][row])
+	glm::vec4 rows[4];
+	for (int r = 0; r < 4; r++)
+		rows[r] = glm::vec4(MVP[0][r], MVP[1][r], MVP[2][r], MVP[3][r]);
+
+	// -w <= x <= w, -w <= y <= w, -w <= z <= w
+	Frustum frustum;
+	for (int axis = 0; axis < 3; axis++){
+		frustum.planes[2*axis]   = rows[3] + rows[axis];
+		frustum.planes[2*axis+1] = rows[3] - rows[axis];
+	}
+	for (int p = 0; p < 6; p++)
+		frustum.planes[p] /= glm::length(glm::vec3(frustum.planes[p]));
+	return frustum;
+}
+
+bool sphereInFrustum(const Frustum & frustum, const glm::vec3 & center, float radius){
+	for (int p = 0; p < 6; p++)
+		if ( glm::dot(glm::vec3(frustum.planes[p]), center) + frustum.planes[p].w < -radius )
+			return false;
+	return true;
+}
+
+MeshletCullStats cullMeshlets(
+	const std::vector<Meshlet> & meshlets,
+	const glm::mat4 & MVP,
+	const glm::vec3 & cameraPosition,
+	std::vector<MeshletDrawRange> & out_ranges
+){
+	MeshletCullStats stats = { meshlets.size(), 0, 0, 0, 0, 0 };
+	out_ranges.clear();
+	Frustum frustum = extractFrustum(MVP);
+
+	for (size_t m = 0; m < meshlets.size(); m++){
+		const Meshlet & meshlet = meshlets[m];
+		stats.triangles += meshlet.indexCount / 3;
+
+		if ( !sphereInFrustum(frustum, meshlet.center, meshlet.radius) ){
+			stats.frustumCulled++;
+			continue;
+		}
+		glm::vec3 toApex = meshlet.coneApex - cameraPosition;
+		float distance = glm::length(toApex);
+		if ( distance > 0.0f && glm::dot(toApex, meshlet.coneAxis) >= meshlet.coneCutoff * distance ){
+			stats.backfaceCulled++;
+			continue;
+		}
+
+		stats.visible++;
+		stats.visibleTriangles += meshlet.indexCount / 3;
+		if ( !out_ranges.empty() && out_ranges.back().indexOffset + out_ranges.back().indexCount == meshlet.indexOffset ){
+			out_ranges.back().indexCount += meshlet.indexCount;
+		}else{
+			MeshletDrawRange range = { meshlet.indexOffset, meshlet.indexCount };
+			out_ranges.push_back(range);
+		}
+	}
+	return stats;
+}
+
+#define INSTANTIATE_MESHLETS(T_INDEX) \
+	template void buildMeshlets<T_INDEX>(std::vector<T_INDEX> &, const std::vector<glm::vec3> &, std::vector<Meshlet> &, unsigned int, unsigned int);
+
+INSTANTIATE_MESHLETS(unsigned short)
+INSTANTIATE_MESHLETS(unsigned int)
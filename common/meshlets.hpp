@@ -0,0 +1,86 @@
+#ifndef MESHLETS_HPP
+#define MESHLETS_HPP
+
+#include <vector>
+#include <glm/glm.hpp>
+
+// Meshlets : small clusters of neighbouring triangles (at most 64 vertices and 124 triangles,
+// like what mesh shaders like), each with a bounding sphere and a cone around its normals.
+// With those, whole clusters can be thrown away on the CPU, before the GPU sees them :
+// - if the sphere is outside of the view frustum,
+// - if the camera is inside the "back" of the cone : every triangle of the cluster faces away
+//   from it, so back-face culling would reject them all anyway.
+// buildMeshlets reorders the triangles so that each meshlet is a contiguous range of the index
+// buffer : drawing a meshlet is a plain glDrawElements with an offset, and meshlets which follow
+// each other in the buffer can be drawn with a single call.
+// Like the indexers, everything is instantiated for unsigned short and unsigned int indices.
+
+struct Meshlet{
+	unsigned int indexOffset;  // In the index buffer
+	unsigned int indexCount;   // 3 per triangle
+	unsigned int vertexCount;  // Different vertices used by the triangles
+
+	// Bounding sphere
+	glm::vec3 center;
+	float radius;
+
+	// Normal cone : every triangle faces away from a camera at position p if
+	// dot(normalize(coneApex - p), coneAxis) >= coneCutoff.
+	// coneCutoff is > 1 when the triangles go in too many directions for this to ever happen.
+	glm::vec3 coneApex;
+	glm::vec3 coneAxis;
+	float coneCutoff;
+};
+
+// Reorders the triangles of indices in meshlets, and fills out_meshlets.
+// Each meshlet grows from a triangle, adding the neighbouring triangles which need the fewest
+// new vertices and whose normals are the closest to the meshlet's, until it is full.
+// Works best on a mesh already optimized with optimizeVertexCache (the order of the meshlets
+// follows the order of the triangles).
+template <typename T_INDEX>
+void buildMeshlets(
+	std::vector<T_INDEX> & indices,
+	const std::vector<glm::vec3> & vertices,
+	std::vector<Meshlet> & out_meshlets,
+	unsigned int maxVertices = 64,
+	unsigned int maxTriangles = 124
+);
+
+// The 6 planes of the view frustum of MVP (left, right, bottom, top, near, far), in the space of
+// the vertices given to MVP : dot(plane.xyz, p) + plane.w >= 0 inside (Gribb & Hartmann).
+// With MVP = getProjectionMatrix() * getViewMatrix() * ModelMatrix, that's model space.
+struct Frustum{
+	glm::vec4 planes[6];
+};
+
+Frustum extractFrustum(const glm::mat4 & MVP);
+
+bool sphereInFrustum(const Frustum & frustum, const glm::vec3 & center, float radius);
+
+// A range of indices to draw : glDrawElements(GL_TRIANGLES, indexCount, type, indexOffset * sizeof(index))
+struct MeshletDrawRange{
+	unsigned int indexOffset;
+	unsigned int indexCount;
+};
+
+// What cullMeshlets did, to see how well it works
+struct MeshletCullStats{
+	size_t meshlets;
+	size_t frustumCulled;
+	size_t backfaceCulled;
+	size_t visible;
+	size_t triangles;         // In all the meshlets
+	size_t visibleTriangles;  // What is left to draw
+};
+
+// Tests every meshlet against the frustum of MVP, then against the camera position (in the same
+// space as the vertices : glm::inverse(ViewMatrix * ModelMatrix)[3]).
+// out_ranges are the visible meshlets, merged when they follow each other in the index buffer.
+MeshletCullStats cullMeshlets(
+	const std::vector<Meshlet> & meshlets,
+	const glm::mat4 & MVP,
+	const glm::vec3 & cameraPosition,
+	std::vector<MeshletDrawRange> & out_ranges
+);
+
+#endif
@@ -0,0 +1,466 @@
+#include <vector>
+#include <stdio.h>
+#include <cmath>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+#include "meshoptimizer.hpp"
+
+template <typename T_INDEX>
+VertexCacheStats analyzeVertexCache(const std::vector<T_INDEX> & indices, size_t vertexCount, unsigned int cacheSize){
+	// FIFO cache : a vertex is still in the cache if less than cacheSize vertices were
+	// added since it was. So we just remember when each vertex was added.
+	std::vector<unsigned int> addedAt(vertexCount, 0);
+	unsigned int time = cacheSize + 1; // Nothing is in the cache at the beginning
+	size_t misses = 0;
+	for (size_t i = 0; i < indices.size(); i++){
+		T_INDEX v = indices[i];
+		if ( time - addedAt[v] > cacheSize ){
+			addedAt[v] = time++;
+			misses++;
+		}
+	}
+
+	VertexCacheStats stats;
+	stats.acmr = indices.empty() ? 0.0f : (float)misses / (float)(indices.size() / 3);
+	stats.atvr = vertexCount == 0 ? 0.0f : (float)misses / (float)vertexCount;
+	return stats;
+}
+
+// Tom Forsyth's scoring. The simulated cache is LRU, and bigger than the real one :
+// the algorithm only needs to know which vertices were used recently.
+static const int   FORSYTH_CACHE_SIZE   = 32;
+static const float FORSYTH_DECAY_POWER  = 1.5f;
+static const float FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+static const float FORSYTH_VALENCE_SCALE = 2.0f;
+static const float FORSYTH_VALENCE_POWER = 0.5f;
+
+// How much we want to draw a triangle using this vertex now.
+// cachePosition is -1 if the vertex isn't in the cache.
+static float forsythScore(int cachePosition, unsigned int remainingTriangles){
+	if ( remainingTriangles == 0 )
+		return -1.0f; // Nothing left to draw with it
+
+	float score = 0.0f;
+	if ( cachePosition >= 0 ){
+		if ( cachePosition < 3 ){
+			// Used by the last triangle : fixed score, so that the next triangle
+			// doesn't favor one of its vertices over the others
+			score = FORSYTH_LAST_TRIANGLE_SCORE;
+		}else{
+			float scale = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+			score = std::pow(1.0f - (cachePosition - 3) * scale, FORSYTH_DECAY_POWER);
+		}
+	}
+	// Vertices with few triangles left get a boost, to finish them and get rid of them
+	score += FORSYTH_VALENCE_SCALE * std::pow((float)remainingTriangles, -FORSYTH_VALENCE_POWER);
+	return score;
+}
+
+template <typename T_INDEX>
+void optimizeVertexCache(std::vector<T_INDEX> & indices, size_t vertexCount){
+	size_t triangleCount = indices.size() / 3;
+	if ( triangleCount == 0 )
+		return;
+	const unsigned int NONE = ~0u;
+
+	// Triangles of each vertex : adjacency[offsets[v] .. offsets[v] + remaining[v]) are the
+	// ones which aren't drawn yet (drawn ones are swapped after them)
+	std::vector<unsigned int> remaining(vertexCount, 0);
+	for (size_t i = 0; i < indices.size(); i++)
+		remaining[ indices[i] ]++;
+	std::vector<unsigned int> offsets(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++)
+		offsets[v+1] = offsets[v] + remaining[v];
+	std::vector<unsigned int> adjacency(indices.size());
+	{
+		std::vector<unsigned int> filled(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++)
+			adjacency[ filled[ indices[i] ]++ ] = (unsigned int)(i / 3);
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+		vertexScore[v] = forsythScore(-1, remaining[v]);
+
+	// Start with the best triangle of the whole mesh
+	unsigned int best = 0;
+	float bestScore = -1.0f;
+	for (size_t t = 0; t < triangleCount; t++){
+		float score = vertexScore[indices[3*t]] + vertexScore[indices[3*t+1]] + vertexScore[indices[3*t+2]];
+		if ( score > bestScore ){
+			bestScore = score;
+			best = (unsigned int)t;
+		}
+	}
+
+	std::vector<char> drawn(triangleCount, 0);
+	std::vector<T_INDEX> result;
+	result.reserve(indices.size());
+
+	unsigned int cache[FORSYTH_CACHE_SIZE + 3];
+	int cacheCount = 0;
+	size_t nextUndrawn = 0; // When the cache gives nothing, continue in the original order
+
+	for (size_t n = 0; n < triangleCount; n++){
+		if ( best == NONE ){
+			while ( drawn[nextUndrawn] )
+				nextUndrawn++;
+			best = (unsigned int)nextUndrawn;
+		}
+
+		const T_INDEX * triangle = &indices[3*best];
+		result.insert(result.end(), triangle, triangle + 3);
+		drawn[best] = 1;
+
+		// This triangle doesn't need its vertices anymore
+		for (int j = 0; j < 3; j++){
+			unsigned int v = triangle[j];
+			unsigned int * list = &adjacency[ offsets[v] ];
+			unsigned int count = remaining[v];
+			for (unsigned int k = 0; k < count; k++){
+				if ( list[k] == best ){
+					list[k] = list[count-1];
+					list[count-1] = best;
+					break;
+				}
+			}
+			remaining[v]--;
+		}
+
+		// The vertices of the triangle go to the front of the LRU cache
+		unsigned int newCache[FORSYTH_CACHE_SIZE + 3];
+		int newCount = 0;
+		for (int j = 0; j < 3; j++){
+			unsigned int v = triangle[j];
+			bool seen = false;
+			for (int k = 0; k < newCount; k++)
+				seen = seen || newCache[k] == v;
+			if ( !seen )
+				newCache[newCount++] = v;
+		}
+		for (int k = 0; k < cacheCount; k++){
+			unsigned int v = cache[k];
+			if ( v != triangle[0] && v != triangle[1] && v != triangle[2] )
+				newCache[newCount++] = v;
+		}
+
+		// New scores for everything which moved in the cache, or fell out of it
+		for (int k = 0; k < newCount; k++){
+			unsigned int v = newCache[k];
+			cachePosition[v] = k < FORSYTH_CACHE_SIZE ? k : -1;
+			vertexScore[v] = forsythScore(cachePosition[v], remaining[v]);
+		}
+		cacheCount = newCount < FORSYTH_CACHE_SIZE ? newCount : FORSYTH_CACHE_SIZE;
+		for (int k = 0; k < cacheCount; k++)
+			cache[k] = newCache[k];
+
+		// Only the triangles of these vertices changed : the next one is among them
+		best = NONE;
+		bestScore = -1.0f;
+		for (int k = 0; k < newCount; k++){
+			unsigned int v = newCache[k];
+			const unsigned int * list = &adjacency[ offsets[v] ];
+			for (unsigned int a = 0; a < remaining[v]; a++){
+				unsigned int t = list[a];
+				float score = vertexScore[indices[3*t]] + vertexScore[indices[3*t+1]] + vertexScore[indices[3*t+2]];
+				if ( score > bestScore ){
+					bestScore = score;
+					best = t;
+				}
+			}
+		}
+	}
+	indices.swap(result);
+}
+
+// Size of the FIFO cache simulated by optimizeOverdraw, like in analyzeVertexCache
+static const unsigned int OVERDRAW_CACHE_SIZE = 16;
+
+template <typename T_INDEX>
+void optimizeOverdraw(std::vector<T_INDEX> & indices, const std::vector<glm::vec3> & vertices, float threshold){
+	size_t triangleCount = indices.size() / 3;
+	if ( triangleCount == 0 )
+		return;
+
+	// Same cache simulation as analyzeVertexCache. Moving the time forward by more than
+	// the cache size flushes the cache.
+	std::vector<unsigned int> addedAt(vertices.size(), 0);
+	unsigned int time = OVERDRAW_CACHE_SIZE + 1;
+	auto misses = [&](size_t t){
+		unsigned int count = 0;
+		for (int j = 0; j < 3; j++){
+			T_INDEX v = indices[3*t + j];
+			if ( time - addedAt[v] > OVERDRAW_CACHE_SIZE ){
+				addedAt[v] = time++;
+				count++;
+			}
+		}
+		return count;
+	};
+	auto flush = [&](){ time += OVERDRAW_CACHE_SIZE + 1; };
+
+	// Hard boundaries : triangles which miss all their vertices. The cache is flushed there
+	// anyway, so drawing them in another order costs nothing.
+	std::vector<size_t> hard;
+	for (size_t t = 0; t < triangleCount; t++)
+		if ( misses(t) == 3 )
+			hard.push_back(t);
+	hard.push_back(triangleCount);
+
+	// Soft boundaries : inside each hard cluster, cut as soon as the triangles since the
+	// last cut (starting with an empty cache) are within threshold of the ACMR of the whole cluster.
+	std::vector<size_t> clusters;
+	for (size_t h = 0; h + 1 < hard.size(); h++){
+		size_t start = hard[h], end = hard[h+1];
+
+		flush();
+		size_t clusterMisses = 0;
+		for (size_t t = start; t < end; t++)
+			clusterMisses += misses(t);
+		float clusterThreshold = threshold * (float)clusterMisses / (float)(end - start);
+
+		flush();
+		clusters.push_back(start);
+		size_t runningMisses = 0, runningTriangles = 0;
+		for (size_t t = start; t + 1 < end; t++){
+			runningMisses += misses(t);
+			runningTriangles++;
+			if ( (float)runningMisses <= clusterThreshold * (float)runningTriangles ){
+				clusters.push_back(t + 1);
+				flush();
+				runningMisses = runningTriangles = 0;
+			}
+		}
+	}
+	clusters.push_back(triangleCount);
+
+	// Sort the clusters : the ones far from the center of the mesh, and facing away from it, go first
+	size_t clusterCount = clusters.size() - 1;
+	std::vector<glm::vec3> clusterCentroids(clusterCount, glm::vec3(0.0f));
+	std::vector<glm::vec3> clusterNormals  (clusterCount, glm::vec3(0.0f));
+	std::vector<float>     clusterAreas    (clusterCount, 0.0f);
+	glm::vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+	for (size_t c = 0; c < clusterCount; c++){
+		for (size_t t = clusters[c]; t < clusters[c+1]; t++){
+			const glm::vec3 & a = vertices[ indices[3*t+0] ];
+			const glm::vec3 & b = vertices[ indices[3*t+1] ];
+			const glm::vec3 & d = vertices[ indices[3*t+2] ];
+			glm::vec3 normal = glm::cross(b - a, d - a); // Its length is twice the area
+			float area = glm::length(normal);
+			clusterCentroids[c] += (a + b + d) * (area / 3.0f);
+			clusterNormals[c]   += normal;
+			clusterAreas[c]     += area;
+		}
+		meshCentroid += clusterCentroids[c];
+		meshArea     += clusterAreas[c];
+	}
+	if ( meshArea > 0.0f )
+		meshCentroid /= meshArea;
+
+	std::vector<float> sortKey(clusterCount, 0.0f);
+	std::vector<size_t> order(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++){
+		order[c] = c;
+		float normalLength = glm::length(clusterNormals[c]);
+		if ( clusterAreas[c] > 0.0f && normalLength > 0.0f )
+			sortKey[c] = glm::dot(clusterCentroids[c] / clusterAreas[c] - meshCentroid, clusterNormals[c] / normalLength);
+	}
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b){ return sortKey[a] > sortKey[b]; });
+
+	std::vector<T_INDEX> result;
+	result.reserve(indices.size());
+	for (size_t i = 0; i < clusterCount; i++){
+		size_t c = order[i];
+		result.insert(result.end(), indices.begin() + 3*clusters[c], indices.begin() + 3*clusters[c+1]);
+	}
+	indices.swap(result);
+}
+
+// Top-left fill rule : a pixel exactly on an edge shared by two triangles belongs to only one of them.
+// With counter-clockwise triangles and y going up, these are the edges which go down, or left.
+static inline bool isTopLeft(const glm::vec3 & from, const glm::vec3 & to){
+	return to.y < from.y || (to.y == from.y && to.x < from.x);
+}
+
+// Twice the signed area of (a, b, p) : positive if p is on the left of a->b
+static inline float edgeFunction(const glm::vec3 & a, const glm::vec3 & b, float x, float y){
+	return (b.x - a.x) * (y - a.y) - (b.y - a.y) * (x - a.x);
+}
+
+// Draws the mesh seen from `direction`, into a depth buffer, and counts the shaded fragments
+template <typename T_INDEX>
+static void rasterizeOverdraw(
+	const std::vector<T_INDEX> & indices, const std::vector<glm::vec3> & vertices,
+	const glm::vec3 & center, float radius, const glm::vec3 & direction,
+	unsigned int resolution, std::vector<float> & depth, OverdrawStats & stats
+){
+	// The camera is on the side of `direction`, and looks at the center of the mesh.
+	// (right, up, backward) is right-handed, so front faces stay counter-clockwise on screen.
+	glm::vec3 backward = glm::normalize(direction);
+	glm::vec3 upHint = std::fabs(backward.y) < 0.99f ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0);
+	glm::vec3 right = glm::normalize(glm::cross(upHint, backward));
+	glm::vec3 up = glm::cross(backward, right);
+
+	float scale = resolution / (2.0f * radius);
+	std::vector<glm::vec3> screen(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++){
+		glm::vec3 p = vertices[i] - center;
+		screen[i] = glm::vec3( (glm::dot(p, right) + radius) * scale, (glm::dot(p, up) + radius) * scale, -glm::dot(p, backward) );
+	}
+
+	depth.assign((size_t)resolution * resolution, HUGE_VALF);
+	for (size_t t = 0; t < indices.size() / 3; t++){
+		const glm::vec3 & a = screen[ indices[3*t+0] ];
+		const glm::vec3 & b = screen[ indices[3*t+1] ];
+		const glm::vec3 & c = screen[ indices[3*t+2] ];
+		float area = edgeFunction(a, b, c.x, c.y);
+		if ( !(area > 0.0f) )
+			continue; // Back face, or degenerate
+
+		int minX = std::max(0, (int)std::floor(std::min(a.x, std::min(b.x, c.x))));
+		int minY = std::max(0, (int)std::floor(std::min(a.y, std::min(b.y, c.y))));
+		int maxX = std::min((int)resolution - 1, (int)std::ceil(std::max(a.x, std::max(b.x, c.x))));
+		int maxY = std::min((int)resolution - 1, (int)std::ceil(std::max(a.y, std::max(b.y, c.y))));
+		bool topLeft0 = isTopLeft(b, c), topLeft1 = isTopLeft(c, a), topLeft2 = isTopLeft(a, b);
+
+		for (int y = minY; y <= maxY; y++){
+			for (int x = minX; x <= maxX; x++){
+				// Pixel centers
+				float px = x + 0.5f, py = y + 0.5f;
+				float w0 = edgeFunction(b, c, px, py);
+				float w1 = edgeFunction(c, a, px, py);
+				float w2 = edgeFunction(a, b, px, py);
+				if ( w0 < 0.0f || w1 < 0.0f || w2 < 0.0f )
+					continue;
+				if ( (w0 == 0.0f && !topLeft0) || (w1 == 0.0f && !topLeft1) || (w2 == 0.0f && !topLeft2) )
+					continue;
+				float z = (w0 * a.z + w1 * b.z + w2 * c.z) / area;
+				float & pixel = depth[(size_t)y * resolution + x];
+				if ( z < pixel ){
+					pixel = z;
+					stats.shaded++;
+				}
+			}
+		}
+	}
+	for (size_t i = 0; i < depth.size(); i++)
+		if ( depth[i] != HUGE_VALF )
+			stats.covered++;
+}
+
+template <typename T_INDEX>
+OverdrawStats analyzeOverdraw(const std::vector<T_INDEX> & indices, const std::vector<glm::vec3> & vertices, unsigned int resolution){
+	OverdrawStats stats;
+	stats.covered = stats.shaded = 0;
+	stats.overdraw = 0.0f;
+	if ( vertices.empty() || indices.empty() )
+		return stats;
+
+	// Bounding sphere, roughly : center of the box, and farthest vertex
+	glm::vec3 minimum = vertices[0], maximum = vertices[0];
+	for (size_t i = 1; i < vertices.size(); i++){
+		minimum = glm::min(minimum, vertices[i]);
+		maximum = glm::max(maximum, vertices[i]);
+	}
+	glm::vec3 center = (minimum + maximum) * 0.5f;
+	float radius = 0.0f;
+	for (size_t i = 0; i < vertices.size(); i++)
+		radius = std::max(radius, glm::length(vertices[i] - center));
+	if ( radius == 0.0f )
+		return stats;
+	radius *= 1.01f; // So that nothing falls exactly on the border of the image
+
+	// The 6 axes and the 8 diagonals
+	std::vector<float> depth;
+	for (int axis = 0; axis < 3; axis++){
+		for (int sign = -1; sign <= 1; sign += 2){
+			glm::vec3 direction(0.0f);
+			direction[axis] = (float)sign;
+			rasterizeOverdraw(indices, vertices, center, radius, direction, resolution, depth, stats);
+		}
+	}
+	for (int d = 0; d < 8; d++){
+		glm::vec3 direction( d & 1 ? 1.0f : -1.0f, d & 2 ? 1.0f : -1.0f, d & 4 ? 1.0f : -1.0f );
+		rasterizeOverdraw(indices, vertices, center, radius, direction, resolution, depth, stats);
+	}
+
+	stats.overdraw = stats.covered ? (float)stats.shaded / (float)stats.covered : 0.0f;
+	return stats;
+}
+
+template <typename T_INDEX>
+size_t optimizeVertexFetchRemap(std::vector<T_INDEX> & indices, size_t vertexCount, std::vector<unsigned int> & remap){
+	remap.assign(vertexCount, ~0u);
+	unsigned int next = 0;
+	for (size_t i = 0; i < indices.size(); i++){
+		unsigned int & newIndex = remap[ indices[i] ];
+		if ( newIndex == ~0u )
+			newIndex = next++;
+		indices[i] = (T_INDEX)newIndex;
+	}
+	return next;
+}
+
+template <typename T_INDEX>
+void optimizeVertexFetch(
+	std::vector<T_INDEX> & indices,
+	std::vector<glm::vec3> & vertices,
+	std::vector<glm::vec2> & uvs,
+	std::vector<glm::vec3> & normals,
+	std::vector<glm::vec3> * tangents,
+	std::vector<glm::vec3> * bitangents
+){
+	std::vector<unsigned int> remap;
+	size_t count = optimizeVertexFetchRemap(indices, vertices.size(), remap);
+	remapVertexArray(vertices, remap, count);
+	remapVertexArray(uvs,      remap, count);
+	remapVertexArray(normals,  remap, count);
+	if ( tangents )
+		remapVertexArray(*tangents, remap, count);
+	if ( bitangents )
+		remapVertexArray(*bitangents, remap, count);
+}
+
+template <typename T_INDEX>
+void optimizeMesh(
+	std::vector<T_INDEX> & indices,
+	std::vector<glm::vec3> & vertices,
+	std::vector<glm::vec2> & uvs,
+	std::vector<glm::vec3> & normals,
+	std::vector<glm::vec3> * tangents,
+	std::vector<glm::vec3> * bitangents,
+	bool overdraw
+){
+	VertexCacheStats before = analyzeVertexCache(indices, vertices.size());
+	optimizeVertexCache(indices, vertices.size());
+	if ( overdraw ){
+		std::vector<T_INDEX> reordered = indices;
+		optimizeOverdraw(reordered, vertices);
+		OverdrawStats cacheOrder = analyzeOverdraw(indices, vertices), overdrawOrder = analyzeOverdraw(reordered, vertices);
+		printf("Overdraw : %.4f -> %.4f%s\n", cacheOrder.overdraw, overdrawOrder.overdraw,
+			overdrawOrder.shaded < cacheOrder.shaded ? "" : ", vertex cache order kept");
+		if ( overdrawOrder.shaded < cacheOrder.shaded )
+			indices.swap(reordered);
+	}
+	optimizeVertexFetch(indices, vertices, uvs, normals, tangents, bitangents);
+	VertexCacheStats after = analyzeVertexCache(indices, vertices.size());
+	printf("Vertex cache : ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", before.acmr, after.acmr, before.atvr, after.atvr);
+}
+
+#define INSTANTIATE_MESHOPTIMIZER(T_INDEX) \
+	template VertexCacheStats analyzeVertexCache<T_INDEX>(const std::vector<T_INDEX> &, size_t, unsigned int); \
+	template void optimizeVertexCache<T_INDEX>(std::vector<T_INDEX> &, size_t); \
+	template void optimizeOverdraw<T_INDEX>(std::vector<T_INDEX> &, const std::vector<glm::vec3> &, float); \
+	template OverdrawStats analyzeOverdraw<T_INDEX>(const std::vector<T_INDEX> &, const std::vector<glm::vec3> &, unsigned int); \
+	template size_t optimizeVertexFetchRemap<T_INDEX>(std::vector<T_INDEX> &, size_t, std::vector<unsigned int> &); \
+	template void optimizeVertexFetch<T_INDEX>(std::vector<T_INDEX> &, std::vector<glm::vec3> &, std::vector<glm::vec2> &, \
+		std::vector<glm::vec3> &, std::vector<glm::vec3> *, std::vector<glm::vec3> *); \
+	template void optimizeMesh<T_INDEX>(std::vector<T_INDEX> &, std::vector<glm::vec3> &, std::vector<glm::vec2> &, \
+		std::vector<glm::vec3> &, std::vector<glm::vec3> *, std::vector<glm::vec3> *, bool);
+
+INSTANTIATE_MESHOPTIMIZER(unsigned short)
+INSTANTIATE_MESHOPTIMIZER(unsigned int)
@@ -0,0 +1,93 @@
+#ifndef MESHOPTIMIZER_HPP
+#define MESHOPTIMIZER_HPP
+
+#include <vector>
+#include <glm/glm.hpp>
+
+// Reordering of indexed meshes, so that the GPU does less work for the same picture.
+// Nothing here changes what is drawn : only the order of the triangles and of the vertices.
+// Like the indexers, everything is instantiated for unsigned short and unsigned int indices.
+
+// How well the post-transform vertex cache is used, simulated on the CPU with a FIFO cache
+// of cacheSize vertices (roughly what GPUs have).
+// ACMR : average cache miss ratio, vertex shader runs per triangle. 3 is the worst, ~0.5 the best.
+// ATVR : average transform to vertex ratio, vertex shader runs per vertex. 1 is perfect.
+struct VertexCacheStats{
+	float acmr;
+	float atvr;
+};
+
+template <typename T_INDEX>
+VertexCacheStats analyzeVertexCache(const std::vector<T_INDEX> & indices, size_t vertexCount, unsigned int cacheSize = 16);
+
+// Reorders the triangles so that consecutive triangles share vertices as much as possible
+// (Tom Forsyth, "Linear-Speed Vertex Cache Optimisation").
+template <typename T_INDEX>
+void optimizeVertexCache(std::vector<T_INDEX> & indices, size_t vertexCount);
+
+// Renumbers the vertices in the order the triangles use them, so that the vertex fetch reads
+// the VBO almost sequentially. remap[old vertex] is the new vertex, or ~0u if no triangle uses it.
+// Returns the number of vertices still used.
+template <typename T_INDEX>
+size_t optimizeVertexFetchRemap(std::vector<T_INDEX> & indices, size_t vertexCount, std::vector<unsigned int> & remap);
+
+// Moves the elements of an attribute array like optimizeVertexFetchRemap said
+template <typename T>
+void remapVertexArray(std::vector<T> & array, const std::vector<unsigned int> & remap, size_t newCount){
+	std::vector<T> result(newCount);
+	for (size_t i = 0; i < array.size(); i++)
+		if ( remap[i] != ~0u )
+			result[ remap[i] ] = array[i];
+	array.swap(result);
+}
+
+// optimizeVertexFetchRemap + remapVertexArray on the usual arrays. tangents and bitangents may be NULL.
+template <typename T_INDEX>
+void optimizeVertexFetch(
+	std::vector<T_INDEX> & indices,
+	std::vector<glm::vec3> & vertices,
+	std::vector<glm::vec2> & uvs,
+	std::vector<glm::vec3> & normals,
+	std::vector<glm::vec3> * tangents,
+	std::vector<glm::vec3> * bitangents
+);
+
+// Reorders the triangles of a mesh already optimized with optimizeVertexCache, so that the
+// triangles which are likely to hide others are drawn first : with the depth test, the hidden
+// fragments are then rejected before the fragment shader runs.
+// The mesh is cut in clusters where the vertex cache would be flushed anyway, or where cutting
+// makes the ACMR at most `threshold` times worse. Then the clusters which face away from the
+// center of the mesh (the outer layer, which hides the rest from most points of view) go first.
+template <typename T_INDEX>
+void optimizeOverdraw(std::vector<T_INDEX> & indices, const std::vector<glm::vec3> & vertices, float threshold = 1.05f);
+
+// Software rasterizer, to measure overdraw without a GPU. The mesh is drawn with a depth test
+// and back-face culling (counter-clockwise front faces, like in the tutorials), in orthographic
+// projection, in a resolution x resolution image, from 14 directions around it.
+struct OverdrawStats{
+	size_t covered;  // Pixels covered by the mesh
+	size_t shaded;   // Fragments which passed the depth test : how many times the fragment shader runs
+	float overdraw;  // shaded / covered. 1 is perfect.
+};
+
+template <typename T_INDEX>
+OverdrawStats analyzeOverdraw(const std::vector<T_INDEX> & indices, const std::vector<glm::vec3> & vertices, unsigned int resolution = 256);
+
+// optimizeVertexCache then optimizeVertexFetch, and prints the ACMR and ATVR before and after.
+// tangents and bitangents may be NULL.
+// With overdraw, optimizeOverdraw runs in between, and its order is kept only if analyzeOverdraw
+// says it draws less than the vertex cache order. It's not the default : it costs some ACMR, and
+// on meshes which were in a good order already, it only wins back what optimizeVertexCache lost
+// (suzanne : overdraw 1.083 as exported, 1.119 after optimizeVertexCache, 1.083 after optimizeOverdraw).
+template <typename T_INDEX>
+void optimizeMesh(
+	std::vector<T_INDEX> & indices,
+	std::vector<glm::vec3> & vertices,
+	std::vector<glm::vec2> & uvs,
+	std::vector<glm::vec3> & normals,
+	std::vector<glm::vec3> * tangents,
+	std::vector<glm::vec3> * bitangents,
+	bool overdraw = false
+);
+
+#endif
@@ -0,0 +1,412 @@
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <float.h>
+
+#include <glm/glm.hpp>
+
+#include "vertexhash.hpp"
+#include "meshoptimizer.hpp"
+#include "meshsimplifier.hpp"
+
+// Sum of weighted squared distances to planes, as a symmetric 4x4 matrix.
+// weight is the sum of the weights, so that the error divided by it is a mean squared distance.
+struct Quadric{
+	double a2, b2, c2, ab, ac, bc, ad, bd, cd, d2;
+	double weight;
+};
+
+// normal must be normalized. Constraints (the planes along the borders) make moving away more
+// expensive, but don't count in the weight : the error stays an average over the triangles.
+static void addPlane(Quadric & q, const glm::vec3 & normal, const glm::vec3 & point, double weight, bool constraint){
+	double a = normal.x, b = normal.y, c = normal.z;
+	double d = -glm::dot(normal, point);
+	q.a2 += weight * a * a;  q.b2 += weight * b * b;  q.c2 += weight * c * c;
+	q.ab += weight * a * b;  q.ac += weight * a * c;  q.bc += weight * b * c;
+	q.ad += weight * a * d;  q.bd += weight * b * d;  q.cd += weight * c * d;
+	q.d2 += weight * d * d;
+	if ( !constraint )
+		q.weight += weight;
+}
+
+static void addQuadric(Quadric & q, const Quadric & r){
+	q.a2 += r.a2;  q.b2 += r.b2;  q.c2 += r.c2;
+	q.ab += r.ab;  q.ac += r.ac;  q.bc += r.bc;
+	q.ad += r.ad;  q.bd += r.bd;  q.cd += r.cd;
+	q.d2 += r.d2;
+	q.weight += r.weight;
+}
+
+// Mean squared distance from p to the planes
+static double evaluateQuadric(const Quadric & q, const glm::vec3 & p){
+	double x = p.x, y = p.y, z = p.z;
+	double error = q.a2*x*x + q.b2*y*y + q.c2*z*z
+		+ 2.0 * (q.ab*x*y + q.ac*x*z + q.bc*y*z + q.ad*x + q.bd*y + q.cd*z)
+		+ q.d2;
+	return q.weight > 0.0 ? std::max(error, 0.0) / q.weight : 0.0;
+}
+
+// Borders and seams weigh more than the surface around them, so that they stay where they are
+static const double SIMPLIFY_BORDER_WEIGHT = 10.0;
+
+enum SimplifyVertexKind{
+	SIMPLIFY_MANIFOLD, // Inside of the surface : can collapse on any neighbour
+	SIMPLIFY_BORDER,   // On the border of an open mesh : can only collapse along the border
+	SIMPLIFY_SEAM,     // On a UV seam or a hard edge : only along the seam, with its twin
+	SIMPLIFY_LOCKED    // Corners, non-manifold vertices... : never moves
+};
+
+// Values of openOut and openIn which aren't a vertex
+static const unsigned int SIMPLIFY_NO_EDGE = ~0u;
+static const unsigned int SIMPLIFY_SEVERAL_EDGES = ~1u;
+
+struct SimplifyEdge{
+	unsigned int a, b;
+};
+
+struct SimplifyCollapse{
+	unsigned int from, to;
+	double cost;
+	bool operator<(const SimplifyCollapse & other) const { return cost < other.cost; }
+};
+
+// Open edges : (a, b) is in a triangle, but (b, a) isn't. That's a border, or a seam if the
+// other side uses other vertices at the same positions.
+// openOut[v] is the end of the open edge which starts at v, openIn[v] the start of the one
+// which ends at v (or SIMPLIFY_NO_EDGE, or SIMPLIFY_SEVERAL_EDGES).
+static void findOpenEdges(
+	const std::vector<unsigned int> & indices,
+	VertexHashTable<SimplifyEdge> & edges,
+	std::vector<unsigned int> & openOut,
+	std::vector<unsigned int> & openIn
+){
+	edges.clear();
+	for (size_t i = 0; i < indices.size(); i++){
+		SimplifyEdge edge = { indices[i], indices[i - i%3 + (i+1)%3] };
+		unsigned int existing;
+		edges.findOrInsert(edge, (unsigned int)i, existing);
+	}
+	openOut.assign(openOut.size(), SIMPLIFY_NO_EDGE);
+	openIn .assign(openIn .size(), SIMPLIFY_NO_EDGE);
+	for (size_t i = 0; i < indices.size(); i++){
+		unsigned int a = indices[i], b = indices[i - i%3 + (i+1)%3];
+		SimplifyEdge opposite = { b, a };
+		unsigned int existing;
+		if ( edges.find(opposite, existing) )
+			continue;
+		openOut[a] = openOut[a] == SIMPLIFY_NO_EDGE ? b : SIMPLIFY_SEVERAL_EDGES;
+		openIn [b] = openIn [b] == SIMPLIFY_NO_EDGE ? a : SIMPLIFY_SEVERAL_EDGES;
+	}
+}
+
+static bool hasOneEdge(unsigned int edge){
+	return edge != SIMPLIFY_NO_EDGE && edge != SIMPLIFY_SEVERAL_EDGES;
+}
+
+static void classifyVertices(
+	const std::vector<unsigned int> & group,
+	const std::vector<unsigned int> & groupSize,
+	const std::vector<unsigned int> & wedge,
+	const std::vector<unsigned int> & openOut,
+	const std::vector<unsigned int> & openIn,
+	std::vector<unsigned char> & kind
+){
+	for (size_t v = 0; v < kind.size(); v++){
+		unsigned int size = groupSize[ group[v] ];
+		if ( openOut[v] == SIMPLIFY_NO_EDGE && openIn[v] == SIMPLIFY_NO_EDGE ){
+			kind[v] = size == 1 ? SIMPLIFY_MANIFOLD : SIMPLIFY_LOCKED;
+		}else if ( hasOneEdge(openOut[v]) && hasOneEdge(openIn[v]) && size == 1 ){
+			kind[v] = SIMPLIFY_BORDER;
+		}else if ( hasOneEdge(openOut[v]) && hasOneEdge(openIn[v]) && size == 2 ){
+			// A seam : the twin has the same open edges, the other way around
+			unsigned int w = wedge[v];
+			bool mirrored = hasOneEdge(openOut[w]) && hasOneEdge(openIn[w])
+				&& group[ openOut[v] ] == group[ openIn[w] ] && group[ openIn[v] ] == group[ openOut[w] ];
+			kind[v] = mirrored ? SIMPLIFY_SEAM : SIMPLIFY_LOCKED;
+		}else{
+			kind[v] = SIMPLIFY_LOCKED;
+		}
+	}
+}
+
+static bool canCollapse(const std::vector<unsigned char> & kind, const std::vector<unsigned int> & openOut, const std::vector<unsigned int> & openIn, unsigned int from, unsigned int to){
+	switch ( kind[from] ){
+		case SIMPLIFY_MANIFOLD :
+			return true;
+		case SIMPLIFY_BORDER :
+		case SIMPLIFY_SEAM :
+			return to == openOut[from] || to == openIn[from];
+		default :
+			return false;
+	}
+}
+
+// Would moving `from` onto `to` turn one of the triangles around `from` upside down, or flat ?
+// remap holds the collapses already done in this pass.
+static bool flipsTriangles(
+	const std::vector<unsigned int> & indices,
+	const std::vector<glm::vec3> & vertices,
+	const std::vector<unsigned int> & triangleOffsets,
+	const std::vector<unsigned int> & triangleList,
+	const std::vector<unsigned int> & remap,
+	unsigned int from, unsigned int to
+){
+	for (unsigned int i = triangleOffsets[from]; i < triangleOffsets[from + 1]; i++){
+		const unsigned int * triangle = &indices[ 3 * triangleList[i] ];
+		int k = triangle[0] == from ? 0 : triangle[1] == from ? 1 : 2;
+		unsigned int b = remap[ triangle[(k+1) % 3] ], c = remap[ triangle[(k+2) % 3] ];
+		if ( b == to || c == to || b == c )
+			continue; // This one disappears, or is already gone
+		glm::vec3 before = glm::cross(vertices[b] - vertices[from], vertices[c] - vertices[from]);
+		glm::vec3 after  = glm::cross(vertices[b] - vertices[to],   vertices[c] - vertices[to]);
+		if ( glm::dot(before, after) <= 0.0f )
+			return true;
+	}
+	return false;
+}
+
+// Number of triangles around `from` which also use `to` : they disappear with the collapse
+static size_t sharedTriangles(
+	const std::vector<unsigned int> & indices,
+	const std::vector<unsigned int> & triangleOffsets,
+	const std::vector<unsigned int> & triangleList,
+	const std::vector<unsigned int> & remap,
+	unsigned int from, unsigned int to
+){
+	size_t count = 0;
+	for (unsigned int i = triangleOffsets[from]; i < triangleOffsets[from + 1]; i++){
+		const unsigned int * triangle = &indices[ 3 * triangleList[i] ];
+		unsigned int a = remap[ triangle[0] ], b = remap[ triangle[1] ], c = remap[ triangle[2] ];
+		if ( (a == to || b == to || c == to) && a != b && b != c && c != a )
+			count++;
+	}
+	return count;
+}
+
+template <typename T_INDEX>
+float simplifyMesh(
+	const std::vector<T_INDEX> & in_indices,
+	const std::vector<glm::vec3> & vertices,
+	size_t targetIndexCount,
+	float targetError,
+	std::vector<T_INDEX> & out_indices
+){
+	size_t vertexCount = vertices.size();
+	std::vector<unsigned int> indices(in_indices.begin(), in_indices.end() - in_indices.size() % 3);
+
+	// Vertices at the same position (UV seams, hard normals) : group is the first of them,
+	// and wedge goes from one to the next, in a circle.
+	std::vector<unsigned int> group(vertexCount), wedge(vertexCount), groupSize(vertexCount, 0);
+	VertexHashTable<glm::vec3> positions(vertexCount);
+	for (unsigned int v = 0; v < vertexCount; v++){
+		unsigned int first;
+		if ( positions.findOrInsert(vertices[v], v, first) ){
+			group[v] = first;
+			wedge[v] = wedge[first];
+			wedge[first] = v;
+		}else{
+			group[v] = v;
+			wedge[v] = v;
+		}
+		groupSize[ group[v] ]++;
+	}
+
+	std::vector<unsigned int> openOut(vertexCount), openIn(vertexCount);
+	VertexHashTable<SimplifyEdge> edges(indices.size());
+	findOpenEdges(indices, edges, openOut, openIn);
+
+	// Quadrics, per group : the planes of the triangles, and planes perpendicular to the triangles
+	// along the borders and seams
+	std::vector<Quadric> quadrics(vertexCount, Quadric());
+	for (size_t i = 0; i < indices.size(); i += 3){
+		const glm::vec3 & p0 = vertices[ indices[i+0] ];
+		glm::vec3 normal = glm::cross(vertices[ indices[i+1] ] - p0, vertices[ indices[i+2] ] - p0);
+		float length = glm::length(normal);
+		if ( !(length > 0.0f) )
+			continue;
+		normal /= length;
+		for (int k = 0; k < 3; k++){
+			unsigned int a = indices[i+k], b = indices[i + (k+1)%3];
+			addPlane(quadrics[ group[a] ], normal, p0, 0.5 * length, false);
+			SimplifyEdge opposite = { b, a };
+			unsigned int existing;
+			if ( !edges.find(opposite, existing) ){
+				glm::vec3 edge = vertices[b] - vertices[a];
+				glm::vec3 side = glm::cross(edge, normal);
+				float sideLength = glm::length(side);
+				if ( sideLength > 0.0f ){
+					double weight = SIMPLIFY_BORDER_WEIGHT * glm::dot(edge, edge);
+					addPlane(quadrics[ group[a] ], side / sideLength, vertices[a], weight, true);
+					addPlane(quadrics[ group[b] ], side / sideLength, vertices[a], weight, true);
+				}
+			}
+		}
+	}
+
+	std::vector<unsigned char> kind(vertexCount), touched(vertexCount);
+	std::vector<unsigned int> remap(vertexCount);
+	std::vector<unsigned int> triangleOffsets(vertexCount + 1), triangleList;
+	std::vector<SimplifyCollapse> collapses;
+	size_t triangleCount = indices.size() / 3;
+	size_t targetTriangles = targetIndexCount / 3;
+	double errorLimit = (double)targetError * targetError;
+	double error = 0.0;
+
+	// Each pass collapses the cheapest edges whose neighbourhoods don't overlap
+	while ( triangleCount > targetTriangles ){
+		findOpenEdges(indices, edges, openOut, openIn);
+		classifyVertices(group, groupSize, wedge, openOut, openIn, kind);
+
+		// Triangles around each vertex
+		triangleOffsets.assign(vertexCount + 1, 0);
+		for (size_t i = 0; i < indices.size(); i++)
+			triangleOffsets[ indices[i] + 1 ]++;
+		for (size_t v = 0; v < vertexCount; v++)
+			triangleOffsets[v + 1] += triangleOffsets[v];
+		triangleList.resize(indices.size());
+		std::vector<unsigned int> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++)
+			triangleList[ fill[ indices[i] ]++ ] = (unsigned int)(i / 3);
+
+		// The cheapest way to collapse each edge
+		collapses.clear();
+		for (size_t i = 0; i < indices.size(); i++){
+			unsigned int a = indices[i], b = indices[i - i%3 + (i+1)%3];
+			SimplifyCollapse collapse;
+			collapse.cost = DBL_MAX;
+			if ( canCollapse(kind, openOut, openIn, a, b) ){
+				collapse.from = a; collapse.to = b;
+				collapse.cost = evaluateQuadric(quadrics[ group[a] ], vertices[b]);
+			}
+			if ( canCollapse(kind, openOut, openIn, b, a) ){
+				double cost = evaluateQuadric(quadrics[ group[b] ], vertices[a]);
+				if ( cost < collapse.cost ){
+					collapse.from = b; collapse.to = a;
+					collapse.cost = cost;
+				}
+			}
+			if ( collapse.cost <= errorLimit )
+				collapses.push_back(collapse);
+		}
+		std::sort(collapses.begin(), collapses.end());
+
+		// Only the cheapest ones in this pass : about as many as the collapses still needed
+		// (each one removes ~2 triangles). The others change once their neighbours have
+		// collapsed, so they wait for the next pass.
+		size_t goal = std::max<size_t>((triangleCount - targetTriangles) / 2, 1);
+		double passLimit = collapses.empty() ? 0.0 : collapses[ std::min(goal, collapses.size()) - 1 ].cost;
+
+		for (size_t v = 0; v < vertexCount; v++)
+			remap[v] = (unsigned int)v;
+		touched.assign(vertexCount, 0);
+		size_t collapsed = 0, remaining = triangleCount;
+		for (size_t c = 0; c < collapses.size() && remaining > targetTriangles; c++){
+			if ( collapses[c].cost > passLimit ){
+				if ( collapsed > 0 )
+					break;
+				passLimit = DBL_MAX; // Nothing was possible below the limit : better anything than nothing
+			}
+			unsigned int from = collapses[c].from, to = collapses[c].to;
+			if ( touched[from] || touched[to] )
+				continue;
+
+			// A seam vertex takes its twin with it, along the other side of the seam
+			unsigned int twin = SIMPLIFY_NO_EDGE, twinTo = SIMPLIFY_NO_EDGE;
+			if ( kind[from] == SIMPLIFY_SEAM ){
+				twin = wedge[from];
+				twinTo = to == openOut[from] ? openIn[twin] : openOut[twin];
+				if ( touched[twin] || touched[twinTo] )
+					continue;
+			}
+			if ( flipsTriangles(indices, vertices, triangleOffsets, triangleList, remap, from, to) )
+				continue;
+			if ( twin != SIMPLIFY_NO_EDGE && flipsTriangles(indices, vertices, triangleOffsets, triangleList, remap, twin, twinTo) )
+				continue;
+
+			// Both ends are done for this pass : `from` is gone, and `to` has a new quadric
+			remaining -= sharedTriangles(indices, triangleOffsets, triangleList, remap, from, to);
+			remap[from] = to;
+			touched[from] = touched[to] = 1;
+			if ( twin != SIMPLIFY_NO_EDGE ){
+				remaining -= sharedTriangles(indices, triangleOffsets, triangleList, remap, twin, twinTo);
+				remap[twin] = twinTo;
+				touched[twin] = touched[twinTo] = 1;
+			}
+			addQuadric(quadrics[ group[to] ], quadrics[ group[from] ]);
+			error = std::max(error, collapses[c].cost);
+			collapsed++;
+		}
+		if ( collapsed == 0 )
+			break; // Everything left is locked, would flip triangles, or is too expensive
+
+		// Apply the collapses, and remove the triangles which became degenerate
+		size_t kept = 0;
+		for (size_t i = 0; i < indices.size(); i += 3){
+			unsigned int a = remap[ indices[i] ], b = remap[ indices[i+1] ], c = remap[ indices[i+2] ];
+			if ( a == b || b == c || c == a )
+				continue;
+			indices[kept++] = a;
+			indices[kept++] = b;
+			indices[kept++] = c;
+		}
+		indices.resize(kept);
+
+		// On big flat regular meshes, the passes end up removing a handful of triangles each, since
+		// most collapses left would make flat triangles. Not worth a full pass each.
+		size_t removed = triangleCount - kept / 3;
+		triangleCount = kept / 3;
+		if ( removed < triangleCount / 1000 )
+			break;
+	}
+
+	out_indices.assign(indices.begin(), indices.end());
+	return (float)std::sqrt(error);
+}
+
+template <typename T_INDEX>
+void generateLODs(
+	const std::vector<T_INDEX> & indices,
+	const std::vector<glm::vec3> & vertices,
+	const std::vector<float> & ratios,
+	std::vector< MeshLOD<T_INDEX> > & out_lods
+){
+	out_lods.clear();
+	out_lods.resize(1);
+	out_lods[0].indices = indices;
+	out_lods[0].error = 0.0f;
+
+	for (size_t r = 0; r < ratios.size(); r++){
+		size_t target = (size_t)(indices.size() / 3 * ratios[r]) * 3;
+		if ( target >= out_lods.back().indices.size() )
+			continue;
+		// Simplifying the previous LOD is much faster than the full mesh each time.
+		// The errors add up : it's an upper bound more than an exact value.
+		MeshLOD<T_INDEX> lod;
+		float error = simplifyMesh(out_lods.back().indices, vertices, target, FLT_MAX, lod.indices);
+		if ( lod.indices.empty() || lod.indices.size() >= out_lods.back().indices.size() )
+			break; // Can't go any further
+		lod.error = out_lods.back().error + error;
+		optimizeVertexCache(lod.indices, vertices.size());
+		out_lods.push_back(lod);
+	}
+}
+
+template <typename T_INDEX>
+size_t selectLOD(const std::vector< MeshLOD<T_INDEX> > & lods, float distance, float projectionScale, float screenHeight, float maxPixelError){
+	// Size of a pixel at this distance, in the units of the mesh
+	float pixelSize = std::max(distance, 1e-6f) / (projectionScale * screenHeight * 0.5f);
+	size_t best = 0;
+	for (size_t i = 1; i < lods.size(); i++)
+		if ( lods[i].error <= maxPixelError * pixelSize )
+			best = i;
+	return best;
+}
+
+#define INSTANTIATE_SIMPLIFIER(T_INDEX) \
+	template float simplifyMesh<T_INDEX>(const std::vector<T_INDEX> &, const std::vector<glm::vec3> &, size_t, float, std::vector<T_INDEX> &); \
+	template void generateLODs<T_INDEX>(const std::vector<T_INDEX> &, const std::vector<glm::vec3> &, const std::vector<float> &, \
+		std::vector< MeshLOD<T_INDEX> > &); \
+	template size_t selectLOD<T_INDEX>(const std::vector< MeshLOD<T_INDEX> > &, float, float, float, float);
+
+INSTANTIATE_SIMPLIFIER(unsigned short)
+INSTANTIATE_SIMPLIFIER(unsigned int)
@@ -0,0 +1,55 @@
+#ifndef MESHSIMPLIFIER_HPP
+#define MESHSIMPLIFIER_HPP
+
+#include <vector>
+#include <glm/glm.hpp>
+
+// Mesh simplification, to draw far away objects with fewer triangles.
+// Edges are collapsed one after the other, the cheapest first : the cost of moving a vertex
+// is measured with quadric error metrics (Garland & Heckbert), the sum of the squared distances
+// to the planes of the triangles it used to touch.
+// A vertex always moves onto one of its neighbours, so the vertices themselves never change :
+// all the levels of detail share the same VBOs, only the indices change.
+// UV seams and hard normals (several vertices at the same position) are kept : a vertex on a
+// seam can only slide along the seam, together with its twin on the other side, and the corners
+// where more than 2 vertices meet never move. Borders of open meshes only shrink along themselves.
+// Like the indexers, everything is instantiated for unsigned short and unsigned int indices.
+
+// Collapses edges until there are at most targetIndexCount indices, or until the next collapse
+// would make an error bigger than targetError.
+// Returns the error of the result : roughly the biggest distance between the simplified
+// mesh and the original one, in the units of the vertices.
+template <typename T_INDEX>
+float simplifyMesh(
+	const std::vector<T_INDEX> & indices,
+	const std::vector<glm::vec3> & vertices,
+	size_t targetIndexCount,
+	float targetError,
+	std::vector<T_INDEX> & out_indices
+);
+
+// One level of detail
+template <typename T_INDEX>
+struct MeshLOD{
+	std::vector<T_INDEX> indices;
+	float error; // Like simplifyMesh's result. 0 for the full mesh.
+};
+
+// out_lods[0] is the full mesh, then one LOD per ratio (of the original triangle count, decreasing),
+// each made from the previous one and optimized for the vertex cache.
+// A LOD which can't get any smaller than the previous one isn't added.
+template <typename T_INDEX>
+void generateLODs(
+	const std::vector<T_INDEX> & indices,
+	const std::vector<glm::vec3> & vertices,
+	const std::vector<float> & ratios,
+	std::vector< MeshLOD<T_INDEX> > & out_lods
+);
+
+// The coarsest LOD whose error is smaller than maxPixelError pixels on the screen.
+// distance : from the camera to the object, projectionScale : ProjectionMatrix[1][1],
+// that is 1/tan(fieldOfView/2), screenHeight : in pixels.
+template <typename T_INDEX>
+size_t selectLOD(const std::vector< MeshLOD<T_INDEX> > & lods, float distance, float projectionScale, float screenHeight, float maxPixelError = 1.0f);
+
+#endif
@@ -0,0 +1,232 @@
+#include <cmath>
+#include <algorithm>
+
+#include "parallel.hpp"
+#include "mipmaps.hpp"
+
+// New pixels per thread, at least
+static const size_t MIP_GRAIN = 16384;
+
+// The Kaiser filter : sinc, windowed over KAISER_WIDTH new pixels on each side
+static const double KAISER_WIDTH = 3.0;
+static const double KAISER_ALPHA = 4.0;
+
+static const double PI = 3.14159265358979323846;
+
+// sRGB <-> linear light, for values in 0..1
+static double srgbToLinear(double value){
+	return value <= 0.04045 ? value / 12.92 : std::pow((value + 0.055) / 1.055, 2.4);
+}
+
+// Linear values are looked up in SRGB_STEPS steps, then corrected with the exact thresholds
+static const int SRGB_STEPS = 4096;
+
+struct SrgbTables{
+	float toLinear[256];
+	float toFloat[256]; // i / 255, for the channels which aren't sRGB
+	// thresholds[i] : the linear value halfway between sRGB i and i+1. Anything below it rounds to i or less.
+	// (thresholds[255] is past 1, to stop there)
+	float thresholds[256];
+	// guess[k] : the sRGB value of k / SRGB_STEPS. Near 0, thresholds are more than a step apart,
+	// so the right value is guess[k] or the next one.
+	unsigned char guess[SRGB_STEPS + 1];
+	SrgbTables(){
+		for (int i = 0; i < 256; i++)
+			toLinear[i] = (float)srgbToLinear(i / 255.0);
+		for (int i = 0; i < 256; i++)
+			toFloat[i] = i / 255.0f;
+		for (int i = 0; i < 255; i++)
+			thresholds[i] = (float)srgbToLinear((i + 0.5) / 255.0);
+		thresholds[255] = 2.0f;
+		int value = 0;
+		for (int k = 0; k <= SRGB_STEPS; k++){
+			while ( thresholds[value] <= (float)k / SRGB_STEPS )
+				value++;
+			guess[k] = (unsigned char)value;
+		}
+	}
+};
+
+static const SrgbTables & srgbTables(){
+	static const SrgbTables tables; // Thread-safe since C++11
+	return tables;
+}
+
+static inline unsigned char encodeLinear(float value){
+	int result = (int)(value * 255.0f + 0.5f);
+	return (unsigned char)std::min(std::max(result, 0), 255);
+}
+
+// value must be in 0..1
+static inline unsigned char encodeSrgb(float value, const SrgbTables & tables){
+	int result = tables.guess[(int)(value * SRGB_STEPS)];
+	if ( value >= tables.thresholds[result] )
+		result++;
+	return (unsigned char)result;
+}
+
+// Modified Bessel function of the first kind, order 0 (for the Kaiser window)
+static double besselI0(double x){
+	double sum = 1.0, term = 1.0;
+	for (int k = 1; k < 32; k++){
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+		if ( term < sum * 1e-12 )
+			break;
+	}
+	return sum;
+}
+
+static double kaiser(double x){
+	if ( std::fabs(x) >= KAISER_WIDTH )
+		return 0.0;
+	double sinc = x == 0.0 ? 1.0 : std::sin(PI * x) / (PI * x);
+	double r = x / KAISER_WIDTH;
+	return sinc * besselI0(KAISER_ALPHA * std::sqrt(1.0 - r * r)) / besselI0(KAISER_ALPHA);
+}
+
+// The weights of the old pixels in each new pixel, for one direction. The same for every row
+// (or column), so they're computed once per level and direction.
+struct FilterTaps{
+	std::vector<size_t> offsets; // Taps of new pixel i : offsets[i] to offsets[i+1]
+	std::vector<unsigned int> sources;
+	std::vector<float> weights;
+};
+
+static void computeTaps(MipFilter filter, unsigned int oldSize, unsigned int newSize, FilterTaps & taps){
+	taps.offsets.assign(1, 0);
+	taps.sources.clear();
+	taps.weights.clear();
+	double scale = (double)oldSize / newSize; // 2, or a bit more when oldSize is odd
+	for (unsigned int i = 0; i < newSize; i++){
+		size_t first = taps.sources.size();
+		double total = 0.0;
+		if ( filter == MIP_FILTER_BOX ){
+			// How much of each old pixel is under [i, i+1) of the new ones
+			double begin = i * scale, end = (i + 1) * scale;
+			for (unsigned int j = (unsigned int)begin; j < oldSize && j < end; j++){
+				double weight = std::min(end, j + 1.0) - std::max(begin, (double)j);
+				if ( weight <= 0.0 )
+					continue;
+				taps.sources.push_back(j);
+				taps.weights.push_back((float)weight);
+				total += weight;
+			}
+		}else{
+			// Distances between pixel centers, in new pixels. Outside the image, the edge pixel is used.
+			double center = (i + 0.5) * scale;
+			int begin = (int)std::floor(center - KAISER_WIDTH * scale), end = (int)std::ceil(center + KAISER_WIDTH * scale);
+			for (int j = begin; j <= end; j++){
+				double weight = kaiser((j + 0.5 - center) / scale);
+				if ( weight == 0.0 )
+					continue;
+				unsigned int source = (unsigned int)std::min(std::max(j, 0), (int)oldSize - 1);
+				if ( taps.sources.size() > first && taps.sources.back() == source ){
+					taps.weights.back() += (float)weight;
+				}else{
+					taps.sources.push_back(source);
+					taps.weights.push_back((float)weight);
+				}
+				total += weight;
+			}
+		}
+		for (size_t k = first; k < taps.weights.size(); k++)
+			taps.weights[k] = (float)(taps.weights[k] / total);
+		taps.offsets.push_back(taps.sources.size());
+	}
+}
+
+void buildMipChain(const unsigned char * pixels, unsigned int width, unsigned int height, unsigned int channels,
+	MipFilter filter, bool srgb, std::vector<MipLevel> & out_levels){
+
+	out_levels.clear();
+	if ( width == 0 || height == 0 || channels == 0 || channels > 4 )
+		return;
+	const SrgbTables & tables = srgbTables();
+	// Which channels are sRGB, and how their bytes become floats (linear light for the sRGB ones)
+	bool srgbChannel[4];
+	const float * toFloat[4];
+	for (unsigned int c = 0; c < 4; c++){
+		srgbChannel[c] = srgb && c < 3;
+		toFloat[c] = srgbChannel[c] ? tables.toLinear : tables.toFloat;
+	}
+
+	// Level 1 is made from the bytes of the image ; the next ones from the floats of the
+	// previous level, so that they aren't rounded again and again. The floats always have
+	// 4 channels (the missing ones stay 0) : the loops on them have a fixed length, and get vectorized.
+	std::vector<float> current, next;
+
+	FilterTaps tapsX, tapsY;
+	while ( width > 1 || height > 1 ){
+		unsigned int newWidth = width > 1 ? width / 2 : 1, newHeight = height > 1 ? height / 2 : 1;
+		computeTaps(filter, width, newWidth, tapsX);
+		computeTaps(filter, height, newHeight, tapsY);
+
+		out_levels.push_back(MipLevel());
+		MipLevel & level = out_levels.back();
+		level.width = newWidth;
+		level.height = newHeight;
+		level.pixels.resize((size_t)newWidth * newHeight * channels);
+		next.resize((size_t)newWidth * newHeight * 4);
+
+		// Each thread makes a band of new rows : first the vertical filter, on whole old rows,
+		// then the horizontal one
+		unsigned char * out = &level.pixels[0];
+		unsigned int oldWidth = width;
+		size_t maxTapsY = 0;
+		for (size_t y = 0; y < newHeight; y++)
+			maxTapsY = std::max(maxTapsY, tapsY.offsets[y + 1] - tapsY.offsets[y]);
+		parallelFor(newHeight, threadCount((size_t)newWidth * newHeight, MIP_GRAIN), [&](size_t begin, size_t end){
+			std::vector<float> row((size_t)oldWidth * 4);
+			// For level 1 : the old rows of the image in floats, in a ring. The next new row
+			// needs most of the same old rows (the taps of a row are consecutive old rows).
+			std::vector<float> ring;
+			std::vector<size_t> ringRows;
+			if ( current.empty() ){
+				ring.assign(maxTapsY * oldWidth * 4, 0.0f);
+				ringRows.assign(maxTapsY, (size_t)-1);
+			}
+			for (size_t y = begin; y < end; y++){
+				std::fill(row.begin(), row.end(), 0.0f);
+				for (size_t k = tapsY.offsets[y]; k < tapsY.offsets[y + 1]; k++){
+					size_t sourceRow = tapsY.sources[k];
+					const float * source;
+					if ( current.empty() ){
+						size_t slot = sourceRow % maxTapsY;
+						float * converted = &ring[slot * oldWidth * 4];
+						if ( ringRows[slot] != sourceRow ){
+							const unsigned char * bytes = pixels + sourceRow * oldWidth * channels;
+							for (size_t x = 0; x < oldWidth; x++)
+								for (unsigned int c = 0; c < channels; c++)
+									converted[4 * x + c] = toFloat[c][bytes[channels * x + c]];
+							ringRows[slot] = sourceRow;
+						}
+						source = converted;
+					}else{
+						source = &current[sourceRow * oldWidth * 4];
+					}
+					float weight = tapsY.weights[k];
+					for (size_t i = 0; i < row.size(); i++)
+						row[i] += weight * source[i];
+				}
+				for (size_t x = 0; x < newWidth; x++){
+					float * value = &next[(y * newWidth + x) * 4];
+					float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+					for (size_t k = tapsX.offsets[x]; k < tapsX.offsets[x + 1]; k++)
+						for (int c = 0; c < 4; c++)
+							sum[c] += tapsX.weights[k] * row[(size_t)tapsX.sources[k] * 4 + c];
+					// The Kaiser filter can overshoot a little
+					for (int c = 0; c < 4; c++)
+						value[c] = std::min(std::max(sum[c], 0.0f), 1.0f);
+					unsigned char * pixel = out + (y * newWidth + x) * channels;
+					for (unsigned int c = 0; c < channels; c++)
+						pixel[c] = srgbChannel[c] ? encodeSrgb(value[c], tables) : encodeLinear(value[c]);
+				}
+			}
+		});
+
+		current.swap(next);
+		width = newWidth;
+		height = newHeight;
+	}
+}
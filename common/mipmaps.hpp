@@ -0,0 +1,31 @@
+#ifndef MIPMAPS_HPP
+#define MIPMAPS_HPP
+
+#include <vector>
+
+// Mipmaps made on the CPU, instead of glGenerateMipmap : the same result with every driver,
+// they can be made before there is an OpenGL context (or offline), and they can be compressed
+// (see texturecompression.hpp), which glGenerateMipmap can't do.
+// Each level is filtered from the one above it, in floats, one band of rows per thread.
+
+enum MipFilter{
+	MIP_FILTER_BOX,    // The average of the pixels under each new pixel. Cheap, a bit blurry.
+	MIP_FILTER_KAISER, // Windowed sinc (Kaiser window, 12 taps per direction) : sharper, may ring a little.
+};
+
+struct MipLevel{
+	unsigned int width;
+	unsigned int height;
+	std::vector<unsigned char> pixels; // width * height pixels, rows one after the other
+};
+
+// pixels : the width * height image, with `channels` bytes per pixel (1 to 4), in any order.
+// With srgb, the first 3 channels are colors stored in sRGB, like nearly every image :
+// they are filtered as linear light, and stored back in sRGB. Otherwise (normal maps, masks...),
+// and always for the 4th channel (alpha), the values are filtered as they are.
+// Fills out_levels with levels 1, 2, ... down to 1x1 (level 0 is the image itself). Each size
+// is half the previous one, rounded down, like OpenGL ; edges are clamped.
+void buildMipChain(const unsigned char * pixels, unsigned int width, unsigned int height, unsigned int channels,
+	MipFilter filter, bool srgb, std::vector<MipLevel> & out_levels);
+
+#endif
@@ -1,10 +1,19 @@
 #include <vector>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string>
 #include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <limits>
 
 #include <glm/glm.hpp>
 
+#include "mappedfile.hpp"
+#include "parallel.hpp"
+#include "vertexhash.hpp"
+#include "vertexnormals.hpp"
 #include "objloader.hpp"
 
 // Very, VERY simple OBJ loader.
@@ -17,6 +26,490 @@
 // - More secure. Change another line and you can inject code.
 // - Loading from memory, stream, etc
 
+// Text parsing helpers.
+// We parse the file ourselves, straight from memory, instead of using fscanf :
+// fscanf is slow, depends on the current locale, and needs fixed-size buffers.
+
+static inline bool isBlank(char c){
+	return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static inline bool isDigit(char c){
+	return c >= '0' && c <= '9';
+}
+
+static inline const char * skipBlanks(const char * p, const char * end){
+	while ( p < end && isBlank(*p) )
+		p++;
+	return p;
+}
+
+// Returns a pointer to the beginning of the next line
+static inline const char * skipLine(const char * p, const char * end){
+	const char * eol = (const char *)memchr(p, '\n', end - p);
+	return eol ? eol + 1 : end;
+}
+
+// Slow but exact fallback : let the C library do it.
+static bool parseFloatSlow(const char * & p, const char * end, float & result){
+	char buffer[128];
+	size_t length = 0;
+	while ( p + length < end && length < sizeof(buffer)-1 && !isBlank(p[length]) && p[length] != '\n' )
+		length++;
+	memcpy(buffer, p, length);
+	buffer[length] = '\0';
+	char * parsed_end;
+	result = strtof(buffer, &parsed_end);
+	if ( parsed_end == buffer )
+		return false;
+	p += parsed_end - buffer;
+	return true;
+}
+
+// Parses a float, and gives exactly the same result as fscanf("%f").
+// Most of the numbers in an OBJ file look like "-0.123456" : an integer mantissa
+// of less than 24 bits, and a small power of ten. Both are exact in a float,
+// so a single IEEE multiplication or division gives the correctly rounded result.
+// Everything else goes through double or, in the weird cases, through strtof.
+static bool parseFloat(const char * & p, const char * end, float & result){
+	static const float  powers_f[] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+	static const double powers_d[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+	                                   1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+	p = skipBlanks(p, end);
+	const char * start = p;
+	const char * c = p;
+
+	bool negative = false;
+	if ( c < end && (*c == '-' || *c == '+') ){
+		negative = (*c == '-');
+		c++;
+	}
+
+	// Leading zeros don't count as significant digits
+	const char * digits_start = c;
+	while ( c < end && *c == '0' )
+		c++;
+	bool any_digit = c != digits_start;
+
+	unsigned long long mantissa = 0;
+	int exponent = 0; // power of ten to apply to the mantissa
+	const char * significant = c;
+	unsigned int d;
+	while ( c < end && (d = (unsigned char)*c - '0') <= 9 ){
+		mantissa = mantissa*10 + d;
+		c++;
+	}
+	int digits = (int)(c - significant);
+	if ( c < end && *c == '.' ){
+		c++;
+		const char * fraction = c;
+		const char * fraction_significant = c;
+		if ( mantissa == 0 ){
+			while ( c < end && *c == '0' )
+				c++;
+			fraction_significant = c;
+		}
+		while ( c < end && (d = (unsigned char)*c - '0') <= 9 ){
+			mantissa = mantissa*10 + d;
+			c++;
+		}
+		any_digit = any_digit || c != fraction;
+		digits   += (int)(c - fraction_significant);
+		exponent -= (int)(c - fraction);
+	}
+	any_digit = any_digit || digits > 0;
+	if ( !any_digit || digits > 19 ){
+		// "nan", "inf", garbage, or too many digits for 64 bits
+		p = start;
+		return parseFloatSlow(p, end, result);
+	}
+	if ( c < end && (*c == 'e' || *c == 'E') ){
+		const char * e = c + 1;
+		bool negative_exponent = false;
+		if ( e < end && (*e == '-' || *e == '+') ){
+			negative_exponent = (*e == '-');
+			e++;
+		}
+		if ( e < end && isDigit(*e) ){
+			int value = 0;
+			while ( e < end && isDigit(*e) ){
+				if ( value < 100000 )
+					value = value*10 + (*e - '0');
+				e++;
+			}
+			exponent += negative_exponent ? -value : value;
+			c = e;
+		}
+	}
+	if ( c < end && (*c == 'x' || *c == 'X') ){
+		// Hexadecimal float
+		p = start;
+		return parseFloatSlow(p, end, result);
+	}
+
+	float value;
+	if ( mantissa == 0 ){
+		value = 0.0f;
+	}else if ( mantissa <= (1ull << 24) && exponent >= -10 && exponent <= 10 ){
+		value = (float)mantissa;
+		value = exponent < 0 ? value / powers_f[-exponent] : value * powers_f[exponent];
+	}else if ( mantissa <= (1ull << 53) && exponent >= -22 && exponent <= 22 ){
+		double d = (double)mantissa;
+		d = exponent < 0 ? d / powers_d[-exponent] : d * powers_d[exponent];
+		value = (float)d;
+		// Rounding twice (to double, then to float) is only wrong when the double lands exactly
+		// halfway between two floats. It almost never happens, but let's be exact.
+		float other = nextafterf(value, d > (double)value ? HUGE_VALF : -HUGE_VALF);
+		if ( d - (double)value == (double)other - d ){
+			p = start;
+			return parseFloatSlow(p, end, result);
+		}
+	}else{
+		p = start;
+		return parseFloatSlow(p, end, result);
+	}
+
+	result = negative ? -value : value;
+	p = c;
+	return true;
+}
+
+static bool parseInt(const char * & p, const char * end, int & result){
+	p = skipBlanks(p, end);
+	const char * c = p;
+	bool negative = false;
+	if ( c < end && (*c == '-' || *c == '+') ){
+		negative = (*c == '-');
+		c++;
+	}
+	const char * digits = c;
+	unsigned int value = 0;
+	unsigned int d;
+	while ( c < end && (d = (unsigned char)*c - '0') <= 9 ){
+		value = value*10 + d;
+		c++;
+	}
+	// No digit, or more than what an int can hold
+	if ( c == digits || c - digits > 9 )
+		return false;
+	result = negative ? -(int)value : (int)value;
+	p = c;
+	return true;
+}
+
+// Everything we read in an OBJ file, before de-indexing.
+// Indices are 1-based like in the file, and 0 means "not given" (f v//vn, f v/vt, f v).
+// Negative (relative) indices count back from the end of what was read so far. parseOBJ()
+// stores them as OBJ_RELATIVE + the index relative to the beginning of its chunk,
+// and resolveRelativeOBJ() turns them into normal indices once the chunk's offset is known.
+struct OBJData{
+	std::vector<glm::vec3> vertices;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+	std::vector<int> vertexIndices, uvIndices, normalIndices;
+	bool hasRelative;
+
+	OBJData() : hasRelative(false) {}
+};
+
+// parseInt() reads at most 9 digits, so file indices are < 2^30 and OBJ_RELATIVE + anything stays negative
+static const int OBJ_RELATIVE = -(1 << 30);
+
+// Counts the lines of each kind, so that parseOBJ() can allocate everything once.
+// Scanning for newlines with memchr is much cheaper than growing the vectors.
+static void reserveOBJ(const char * begin, const char * end, OBJData & obj){
+	size_t v = 0, vt = 0, vn = 0, f = 0;
+	for ( const char * p = begin; p < end; p = skipLine(p, end) ){
+		if ( end - p < 2 )
+			break;
+		if ( p[0] == 'v' ){
+			if      ( isBlank(p[1]) ) v++;
+			else if ( p[1] == 't' )   vt++;
+			else if ( p[1] == 'n' )   vn++;
+		}else if ( p[0] == 'f' && isBlank(p[1]) ){
+			f++;
+		}
+	}
+	obj.vertices.reserve(obj.vertices.size() + v);
+	obj.uvs     .reserve(obj.uvs     .size() + vt);
+	obj.normals .reserve(obj.normals .size() + vn);
+	obj.vertexIndices.reserve(obj.vertexIndices.size() + 3*f);
+	obj.uvIndices    .reserve(obj.uvIndices    .size() + 3*f);
+	obj.normalIndices.reserve(obj.normalIndices.size() + 3*f);
+}
+
+// Reads one face corner : v, v/vt, v//vn or v/vt/vn.
+// Missing indices are 0, negative ones are returned as they are.
+static bool parseCorner(const char * & p, const char * end, int corner[3]){
+	corner[0] = corner[1] = corner[2] = 0;
+	if ( !parseInt(p, end, corner[0]) )
+		return false;
+	if ( p < end && *p == '/' ){
+		p++;
+		if ( p < end && *p != '/' && !parseInt(p, end, corner[1]) )
+			return false;
+		if ( p < end && *p == '/' ){
+			p++;
+			if ( !parseInt(p, end, corner[2]) )
+				return false;
+		}
+	}
+	return true;
+}
+
+// Reads all the corners of an "f" line, 3 ints each, into polygon.
+static bool parseFace(const char * & p, const char * end, std::vector<int> & polygon){
+	polygon.clear();
+	for (;;){
+		p = skipBlanks(p, end);
+		if ( p == end || *p == '\n' || *p == '#' )
+			break;
+		int corner[3];
+		if ( !parseCorner(p, end, corner) )
+			return false;
+		polygon.insert(polygon.end(), corner, corner + 3);
+	}
+	return polygon.size() >= 3*3;
+}
+
+// Polygons are cut in a fan of triangles : (0,1,2), (0,2,3), (0,3,4)...
+// It's exact for convex polygons, which is what exporters write.
+// Returns the corner of the polygon which is the j-th corner of the i-th triangle.
+static inline size_t fanCorner(size_t triangle, int j){
+	return j == 0 ? 0 : triangle + j;
+}
+
+static inline glm::vec3 parseVec3(const char * & p, const char * end){
+	glm::vec3 v(0.0f);
+	parseFloat(p, end, v.x);
+	parseFloat(p, end, v.y);
+	parseFloat(p, end, v.z);
+	return v;
+}
+
+static inline glm::vec2 parseUV(const char * & p, const char * end){
+	glm::vec2 uv(0.0f);
+	parseFloat(p, end, uv.x);
+	parseFloat(p, end, uv.y);
+	uv.y = -uv.y; // Invert V coordinate since we will only use DDS texture, which are inverted. Remove if you want to use TGA or BMP loaders.
+	return uv;
+}
+
+// Reads the first word of the line
+static inline size_t parseLineHeader(const char * & p, const char * end, const char * & header){
+	p = skipBlanks(p, end);
+	header = p;
+	while ( p < end && !isBlank(*p) && *p != '\n' )
+		p++;
+	return p - header;
+}
+
+// Parses the OBJ text in [begin, end)
+static bool parseOBJ(const char * begin, const char * end, OBJData & obj){
+	reserveOBJ(begin, end, obj);
+
+	std::vector<int> polygon; // corners of the current face, 3 ints each
+
+	const char * p = begin;
+	while ( p < end ){
+		const char * header;
+		size_t headerLength = parseLineHeader(p, end, header);
+
+		// else : parse lineHeader
+
+		if ( headerLength == 1 && header[0] == 'v' ){
+			obj.vertices.push_back( parseVec3(p, end) );
+		}else if ( headerLength == 2 && header[0] == 'v' && header[1] == 't' ){
+			obj.uvs.push_back( parseUV(p, end) );
+		}else if ( headerLength == 2 && header[0] == 'v' && header[1] == 'n' ){
+			obj.normals.push_back( parseVec3(p, end) );
+		}else if ( headerLength == 1 && header[0] == 'f' ){
+			if ( !parseFace(p, end, polygon) ){
+				printf("File can't be read by our simple parser :-( Try exporting with other options\n");
+				return false;
+			}
+			const size_t counts[3] = { obj.vertices.size(), obj.uvs.size(), obj.normals.size() };
+			for (size_t i = 0; i < polygon.size(); i++){
+				if ( polygon[i] < 0 ){
+					polygon[i] = OBJ_RELATIVE + (int)counts[i%3] + polygon[i] + 1; // -1 is the last one read
+					obj.hasRelative = true;
+				}
+			}
+			size_t triangles = polygon.size()/3 - 2;
+			for (size_t i = 0; i < triangles; i++){
+				for (int j = 0; j < 3; j++){
+					const int * corner = &polygon[3*fanCorner(i, j)];
+					obj.vertexIndices.push_back(corner[0]);
+					obj.uvIndices    .push_back(corner[1]);
+					obj.normalIndices.push_back(corner[2]);
+				}
+			}
+		}
+		// Anything else is probably a comment : eat up the rest of the line
+		p = skipLine(p, end);
+	}
+	return true;
+}
+
+// Turns the relative indices of a chunk into file indices : the chunk's own data
+// starts right after the `vertexOffset` vertices, `uvOffset` uvs... of the previous chunks.
+// An index which goes before the beginning of the file becomes -1, which is invalid.
+static void resolveRelativeOBJ(std::vector<int> & indices, size_t first, size_t last, size_t offset){
+	for (size_t i = first; i < last; i++){
+		if ( indices[i] >= 0 )
+			continue;
+		long long index = (long long)indices[i] - OBJ_RELATIVE + (long long)offset;
+		indices[i] = index > 0 ? (int)index : -1;
+	}
+}
+
+// Big files are cut into chunks of at least this size, at line boundaries, and each chunk is parsed
+// by its own thread. Smaller chunks aren't worth the thread creation and the final merge.
+static const size_t OBJ_CHUNK_SIZE = 4 << 20;
+
+// Parses [begin, end) like parseOBJ, with one thread per chunk, then merges the chunks.
+// Face indices in OBJ files refer to the whole file, so each chunk's data just has to go
+// after all the data of the previous chunks : the offsets are prefix sums of the chunk sizes.
+static bool parseOBJ_parallel(const char * begin, const char * end, OBJData & obj){
+	unsigned int chunks = threadCount(end - begin, OBJ_CHUNK_SIZE);
+	if ( chunks == 1 ){
+		if ( !parseOBJ(begin, end, obj) )
+			return false;
+		if ( obj.hasRelative ){
+			resolveRelativeOBJ(obj.vertexIndices, 0, obj.vertexIndices.size(), 0);
+			resolveRelativeOBJ(obj.uvIndices,     0, obj.uvIndices.size(),     0);
+			resolveRelativeOBJ(obj.normalIndices, 0, obj.normalIndices.size(), 0);
+			obj.hasRelative = false;
+		}
+		return true;
+	}
+
+	// Chunk boundaries, moved forward to the next beginning of line
+	std::vector<const char *> bounds(chunks + 1);
+	bounds[0] = begin;
+	bounds[chunks] = end;
+	for (unsigned int c = 1; c < chunks; c++){
+		const char * p = begin + (end - begin) * (size_t)c / chunks;
+		bounds[c] = p > bounds[c-1] ? skipLine(p - 1, end) : bounds[c-1];
+	}
+
+	std::vector<OBJData> parsed(chunks);
+	std::vector<char> ok(chunks, 0);
+	parallelFor(chunks, chunks, [&](size_t first, size_t last){
+		for (size_t c = first; c < last; c++)
+			ok[c] = parseOBJ(bounds[c], bounds[c+1], parsed[c]);
+	});
+	for (unsigned int c = 0; c < chunks; c++)
+		if ( !ok[c] )
+			return false;
+
+	// Where each chunk goes in the merged arrays
+	std::vector<size_t> vertexOffset(chunks + 1, 0), uvOffset(chunks + 1, 0), normalOffset(chunks + 1, 0), cornerOffset(chunks + 1, 0);
+	for (unsigned int c = 0; c < chunks; c++){
+		vertexOffset[c+1] = vertexOffset[c] + parsed[c].vertices.size();
+		uvOffset    [c+1] = uvOffset    [c] + parsed[c].uvs.size();
+		normalOffset[c+1] = normalOffset[c] + parsed[c].normals.size();
+		cornerOffset[c+1] = cornerOffset[c] + parsed[c].vertexIndices.size();
+	}
+	obj.vertices.resize( vertexOffset[chunks] );
+	obj.uvs     .resize( uvOffset    [chunks] );
+	obj.normals .resize( normalOffset[chunks] );
+	obj.vertexIndices.resize( cornerOffset[chunks] );
+	obj.uvIndices    .resize( cornerOffset[chunks] );
+	obj.normalIndices.resize( cornerOffset[chunks] );
+
+	parallelFor(chunks, chunks, [&](size_t first, size_t last){
+		for (size_t c = first; c < last; c++){
+			OBJData & chunk = parsed[c];
+			std::copy(chunk.vertices.begin(), chunk.vertices.end(), obj.vertices.begin() + vertexOffset[c]);
+			std::copy(chunk.uvs     .begin(), chunk.uvs     .end(), obj.uvs     .begin() + uvOffset    [c]);
+			std::copy(chunk.normals .begin(), chunk.normals .end(), obj.normals .begin() + normalOffset[c]);
+			std::copy(chunk.vertexIndices.begin(), chunk.vertexIndices.end(), obj.vertexIndices.begin() + cornerOffset[c]);
+			std::copy(chunk.uvIndices    .begin(), chunk.uvIndices    .end(), obj.uvIndices    .begin() + cornerOffset[c]);
+			std::copy(chunk.normalIndices.begin(), chunk.normalIndices.end(), obj.normalIndices.begin() + cornerOffset[c]);
+			if ( chunk.hasRelative ){
+				resolveRelativeOBJ(obj.vertexIndices, cornerOffset[c], cornerOffset[c+1], vertexOffset[c]);
+				resolveRelativeOBJ(obj.uvIndices,     cornerOffset[c], cornerOffset[c+1], uvOffset[c]);
+				resolveRelativeOBJ(obj.normalIndices, cornerOffset[c], cornerOffset[c+1], normalOffset[c]);
+			}
+			chunk = OBJData(); // Free the memory as soon as possible
+		}
+	});
+	return true;
+}
+
+// Gets the attribute of a corner. A missing UV or normal (index 0) is all zeros,
+// a missing position is an error. Returns false if the index is outside of the file.
+template <typename T>
+static inline bool fetchOBJ(const std::vector<T> & array, int index, bool optional, T & result){
+	if ( index == 0 && optional ){
+		result = T(0.0f);
+		return true;
+	}
+	size_t i = (size_t)index - 1;
+	if ( i >= array.size() )
+		return false;
+	result = array[i];
+	return true;
+}
+
+// Files without normals get smooth ones, with hard edges above this angle (degrees)
+static const float OBJ_CREASE_ANGLE = 60.0f;
+
+// A v index and one of the normals computed for it
+struct OBJGeneratedNormal{
+	int vertex;
+	glm::vec3 normal;
+};
+
+// If the file has no vn at all, computes normals for its corners (see vertexnormals.hpp) and
+// stores them as if they were in the file : the rest of the loaders doesn't see the difference.
+// Corners with the same v and the same normal get the same vn index, so they're still welded.
+static void addMissingNormals(OBJData & obj, const char * path){
+	size_t corners = obj.vertexIndices.size();
+	if ( !obj.normals.empty() || corners == 0 )
+		return;
+	std::vector<unsigned int> positions(corners);
+	for (size_t i = 0; i < corners; i++){
+		int v = obj.vertexIndices[i];
+		if ( v < 1 || (size_t)v > obj.vertices.size() )
+			return; // The loaders report it
+		positions[i] = (unsigned int)(v - 1);
+	}
+	std::vector<glm::vec3> cornerNormals(corners);
+	computeCornerNormals(positions.data(), corners, obj.vertices.data(), obj.vertices.size(), OBJ_CREASE_ANGLE, NORMALS_WEIGHT_ANGLE, cornerNormals.data());
+
+	VertexHashTable<OBJGeneratedNormal> table(corners / 2);
+	for (size_t i = 0; i < corners; i++){
+		OBJGeneratedNormal key = { obj.vertexIndices[i], cornerNormals[i] };
+		unsigned int index;
+		if ( !table.findOrInsert(key, (unsigned int)obj.normals.size(), index) ){
+			index = (unsigned int)obj.normals.size();
+			obj.normals.push_back(cornerNormals[i]);
+		}
+		obj.normalIndices[i] = (int)index + 1;
+	}
+	printf("No normals in %s : computed smooth ones, with hard edges above %g degrees\n", path, OBJ_CREASE_ANGLE);
+}
+
+// Puts the attributes of corners [first, last) at the same place in out_XXXX.
+// Returns the first corner with an invalid index, or last if there is none.
+static size_t expandOBJ(
+	const OBJData & obj, size_t first, size_t last,
+	glm::vec3 * out_vertices, glm::vec2 * out_uvs, glm::vec3 * out_normals
+){
+	for( size_t i=first; i<last; i++ ){
+		// Get the attributes thanks to the indices
+		// and put them in buffers
+		if ( !fetchOBJ(obj.vertices, obj.vertexIndices[i], false, out_vertices[i]) ||
+		     !fetchOBJ(obj.uvs,      obj.uvIndices[i],     true,  out_uvs[i])      ||
+		     !fetchOBJ(obj.normals,  obj.normalIndices[i], true,  out_normals[i]) )
+			return i;
+	}
+	return last;
+}
+
 bool loadOBJ(
 	const char * path, 
 	std::vector<glm::vec3> & out_vertices, 
@@ -25,91 +518,459 @@ bool loadOBJ(
 ){
 	printf("Loading OBJ file %s...\n", path);
 
-	std::vector<unsigned int> vertexIndices, uvIndices, normalIndices;
-	std::vector<glm::vec3> temp_vertices; 
-	std::vector<glm::vec2> temp_uvs;
-	std::vector<glm::vec3> temp_normals;
+	MappedFile file;
+	if( !file.open(path) ){
+		printf("Impossible to open the file ! Are you in the right path ? See Tutorial 1 for details\n");
+		if ( !workerThread() )
+			getchar();
+		return false;
+	}
 
+	const char * begin = (const char *)file.data();
+	OBJData obj;
+	if ( !parseOBJ_parallel(begin, begin + file.size(), obj) )
+		return false;
+	file.close();
+	addMissingNormals(obj, path);
+
+	// For each vertex of each triangle, in parallel too
+	size_t first = out_vertices.size();
+	size_t corners = obj.vertexIndices.size();
+	out_vertices.resize( first + corners );
+	out_uvs     .resize( first + corners );
+	out_normals .resize( first + corners );
 
-	FILE * file = fopen(path, "r");
-	if( file == NULL ){
+	// Each thread does a slice of the corners, and remembers the first invalid one it found
+	std::atomic<size_t> invalid(corners);
+	parallelFor(corners, threadCount(corners, OBJ_CHUNK_SIZE / 64), [&](size_t begin, size_t end){
+		size_t bad = expandOBJ(obj, begin, end, out_vertices.data() + first, out_uvs.data() + first, out_normals.data() + first);
+		if ( bad == end )
+			return;
+		size_t current = invalid;
+		while ( bad < current && !invalid.compare_exchange_weak(current, bad) ) {}
+	});
+	if ( invalid != corners ){
+		printf("Invalid index in triangle %u of %s\n", (unsigned int)(invalid/3 + 1), path);
+		out_vertices.resize(first);
+		out_uvs     .resize(first);
+		out_normals .resize(first);
+		return false;
+	}
+	return true;
+}
+
+
+// The (v, vt, vn) indices of a face corner, as written in the file.
+// Two corners with the same triple are the same vertex.
+struct OBJCorner{
+	int vertex, uv, normal;
+};
+
+template <typename T_INDEX>
+bool loadOBJ(
+	const char * path,
+	std::vector<T_INDEX> & out_indices,
+	std::vector<glm::vec3> & out_vertices,
+	std::vector<glm::vec2> & out_uvs,
+	std::vector<glm::vec3> & out_normals
+){
+	printf("Loading OBJ file %s...\n", path);
+
+	MappedFile file;
+	if( !file.open(path) ){
 		printf("Impossible to open the file ! Are you in the right path ? See Tutorial 1 for details\n");
-		getchar();
+		if ( !workerThread() )
+			getchar();
 		return false;
 	}
 
-	while( 1 ){
+	const char * begin = (const char *)file.data();
+	OBJData obj;
+	if ( !parseOBJ_parallel(begin, begin + file.size(), obj) )
+		return false;
+	file.close();
+	addMissingNormals(obj, path);
+
+	size_t firstIndex  = out_indices.size();
+	size_t firstVertex = out_vertices.size();
+	size_t corners = obj.vertexIndices.size();
+	out_indices.reserve(firstIndex + corners);
 
-		char lineHeader[128];
-		// read the first word of the line
-		int res = fscanf(file, "%s", lineHeader);
-		if (res == EOF)
-			break; // EOF = End Of File. Quit the loop.
+	// A smooth closed mesh has about 1 vertex for 6 corners, a flat-shaded one 1 for 3 :
+	// corners/2 keys is plenty, and the table grows if it's not.
+	VertexHashTable<OBJCorner> table(corners / 2);
 
-		// else : parse lineHeader
-		
-		if ( strcmp( lineHeader, "v" ) == 0 ){
-			glm::vec3 vertex;
-			fscanf(file, "%f %f %f\n", &vertex.x, &vertex.y, &vertex.z );
-			temp_vertices.push_back(vertex);
-		}else if ( strcmp( lineHeader, "vt" ) == 0 ){
+	for (size_t i = 0; i < corners; i++){
+		OBJCorner corner = { obj.vertexIndices[i], obj.uvIndices[i], obj.normalIndices[i] };
+		unsigned int index;
+		if ( !table.findOrInsert(corner, (unsigned int)out_vertices.size(), index) ){
+			// First time we see this corner : it's a new vertex
+			glm::vec3 vertex, normal;
 			glm::vec2 uv;
-			fscanf(file, "%f %f\n", &uv.x, &uv.y );
-			uv.y = -uv.y; // Invert V coordinate since we will only use DDS texture, which are inverted. Remove if you want to use TGA or BMP loaders.
-			temp_uvs.push_back(uv);
-		}else if ( strcmp( lineHeader, "vn" ) == 0 ){
-			glm::vec3 normal;
-			fscanf(file, "%f %f %f\n", &normal.x, &normal.y, &normal.z );
-			temp_normals.push_back(normal);
-		}else if ( strcmp( lineHeader, "f" ) == 0 ){
-			std::string vertex1, vertex2, vertex3;
-			unsigned int vertexIndex[3], uvIndex[3], normalIndex[3];
-			int matches = fscanf(file, "%d/%d/%d %d/%d/%d %d/%d/%d\n", &vertexIndex[0], &uvIndex[0], &normalIndex[0], &vertexIndex[1], &uvIndex[1], &normalIndex[1], &vertexIndex[2], &uvIndex[2], &normalIndex[2] );
-			if (matches != 9){
-				printf("File can't be read by our simple parser :-( Try exporting with other options\n");
-				fclose(file);
+			bool valid = fetchOBJ(obj.vertices, corner.vertex, false, vertex)
+			          && fetchOBJ(obj.uvs,      corner.uv,     true,  uv)
+			          && fetchOBJ(obj.normals,  corner.normal, true,  normal);
+			if ( !valid ){
+				printf("Invalid index in triangle %u of %s\n", (unsigned int)(i/3 + 1), path);
+			}else if ( out_vertices.size() > (size_t)std::numeric_limits<T_INDEX>::max() ){
+				printf("Too many vertices (%u) for %u-bit indices. Use 32-bit indices instead.\n", (unsigned int)(out_vertices.size() + 1), (unsigned int)(8*sizeof(T_INDEX)));
+				valid = false;
+			}
+			if ( !valid ){
+				out_indices .resize(firstIndex);
+				out_vertices.resize(firstVertex);
+				out_uvs     .resize(firstVertex);
+				out_normals .resize(firstVertex);
 				return false;
 			}
-			vertexIndices.push_back(vertexIndex[0]);
-			vertexIndices.push_back(vertexIndex[1]);
-			vertexIndices.push_back(vertexIndex[2]);
-			uvIndices    .push_back(uvIndex[0]);
-			uvIndices    .push_back(uvIndex[1]);
-			uvIndices    .push_back(uvIndex[2]);
-			normalIndices.push_back(normalIndex[0]);
-			normalIndices.push_back(normalIndex[1]);
-			normalIndices.push_back(normalIndex[2]);
-		}else{
-			// Probably a comment, eat up the rest of the line
-			char stupidBuffer[1000];
-			fgets(stupidBuffer, 1000, file);
-		}
-
-	}
-
-	// For each vertex of each triangle
-	for( unsigned int i=0; i<vertexIndices.size(); i++ ){
-
-		// Get the indices of its attributes
-		unsigned int vertexIndex = vertexIndices[i];
-		unsigned int uvIndex = uvIndices[i];
-		unsigned int normalIndex = normalIndices[i];
-		
-		// Get the attributes thanks to the index
-		glm::vec3 vertex = temp_vertices[ vertexIndex-1 ];
-		glm::vec2 uv = temp_uvs[ uvIndex-1 ];
-		glm::vec3 normal = temp_normals[ normalIndex-1 ];
-		
-		// Put the attributes in buffers
-		out_vertices.push_back(vertex);
-		out_uvs     .push_back(uv);
-		out_normals .push_back(normal);
-	
+			index = (unsigned int)out_vertices.size();
+			out_vertices.push_back( vertex );
+			out_uvs     .push_back( uv );
+			out_normals .push_back( normal );
+		}
+		out_indices.push_back( (T_INDEX)index );
 	}
-	fclose(file);
 	return true;
 }
 
+template bool loadOBJ<unsigned short>(const char *, std::vector<unsigned short> &, std::vector<glm::vec3> &, std::vector<glm::vec2> &, std::vector<glm::vec3> &);
+template bool loadOBJ<unsigned int>  (const char *, std::vector<unsigned int> &,   std::vector<glm::vec3> &, std::vector<glm::vec2> &, std::vector<glm::vec3> &);
+
+
+// Streaming loader : for files which don't fit in memory.
+
+// Reads a text file by blocks of whole lines : a block never ends in the middle of a line.
+// The buffer grows for lines longer than a block, but never above maxSize : longer lines
+// stop the reading, see lineTooLong().
+class LineBlockReader{
+public:
+	LineBlockReader() : file(NULL), maxSize(0), filled(0), consumed(0), atEnd(false), tooLong(false) {}
+	~LineBlockReader(){
+		if ( file )
+			fclose(file);
+	}
+
+	bool open(const char * path, size_t blockSize, size_t maxBufferSize){
+		file = fopen(path, "rb");
+		buffer.resize(blockSize);
+		maxSize = std::max(blockSize, maxBufferSize);
+		return file != NULL;
+	}
+
+	bool rewind(){
+		filled = consumed = 0;
+		atEnd = false;
+		return fseek(file, 0, SEEK_SET) == 0;
+	}
+
+	// Gives the next lines. Returns false at the end of the file.
+	bool next(const char * & begin, const char * & end){
+		// The unfinished line at the end of the previous block goes first
+		memmove(&buffer[0], &buffer[consumed], filled - consumed);
+		filled -= consumed;
+		consumed = 0;
+		for (;;){
+			if ( !atEnd && filled < buffer.size() ){
+				filled += fread(&buffer[filled], 1, buffer.size() - filled, file);
+				atEnd = feof(file) || ferror(file);
+			}
+			if ( filled == 0 )
+				return false;
+
+			// Cut the block after its last newline
+			size_t length = filled;
+			while ( length > 0 && buffer[length-1] != '\n' )
+				length--;
+			if ( length == 0 ){
+				if ( !atEnd ){
+					// A line longer than the whole buffer
+					if ( buffer.size() >= maxSize ){
+						tooLong = true;
+						return false;
+					}
+					buffer.resize( std::min(2*buffer.size(), maxSize) );
+					continue;
+				}
+				length = filled; // Last line, without a newline
+			}
+			consumed = length;
+			begin = &buffer[0];
+			end   = begin + length;
+			return true;
+		}
+	}
+
+	bool failed() const { return file && ferror(file); }
+	bool lineTooLong() const { return tooLong; }
+
+private:
+	FILE * file;
+	std::vector<char> buffer;
+	size_t maxSize;
+	size_t filled;   // bytes of the buffer which come from the file
+	size_t consumed; // bytes of the buffer already given by next()
+	bool atEnd;
+	bool tooLong;
+};
+
+static bool seekFile(FILE * file, unsigned long long offset){
+#ifdef _WIN32
+	return _fseeki64(file, (long long)offset, SEEK_SET) == 0;
+#else
+	return fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+// An array which stays in memory while it's smaller than memoryLimit, and moves to a
+// temporary file when it gets bigger. Then it's read back through a cache of pages
+// which also fits in memoryLimit. Pages are evicted with the CLOCK algorithm,
+// a cheap approximation of "least recently used".
+// Writing must be finished before the first get().
+template <typename T>
+class SpilledArray{
+public:
+	SpilledArray(size_t memoryLimit) : limit(memoryLimit), file(NULL), count(0), hand(0) {}
+	~SpilledArray(){
+		if ( file )
+			fclose(file);
+	}
+
+	bool push_back(const T & value){
+		if ( !file ){
+			if ( (count+1) * sizeof(T) <= limit ){
+				// Grow the vector ourselves : doubling it could go way above the limit
+				if ( memory.size() == memory.capacity() )
+					memory.reserve( std::min(2*memory.capacity() + 1024/sizeof(T), limit/sizeof(T)) );
+				memory.push_back(value);
+				count++;
+				return true;
+			}
+			// Too big : everything goes to a temporary file
+			file = tmpfile();
+			if ( !file || fwrite(memory.data(), sizeof(T), memory.size(), file) != memory.size() )
+				return false;
+			std::vector<T>().swap(memory);
+		}
+		if ( fwrite(&value, sizeof(T), 1, file) != 1 )
+			return false;
+		count++;
+		return true;
+	}
+
+	size_t size() const { return count; }
+	bool spilled() const { return file != NULL; }
+
+	// Returns false if i is out of the array, or if the file can't be read
+	bool get(size_t i, T & result){
+		if ( i >= count )
+			return false;
+		if ( !file ){
+			result = memory[i];
+			return true;
+		}
+		size_t page = i / PAGE_ELEMENTS;
+		if ( pageSlot.empty() )
+			pageSlot.assign( count / PAGE_ELEMENTS + 1, (unsigned int)NO_SLOT );
+		unsigned int slot = pageSlot[page];
+		if ( slot == NO_SLOT && !loadPage(page, slot) )
+			return false;
+		slots[slot].referenced = true;
+		result = slots[slot].data[ i - page*PAGE_ELEMENTS ];
+		return true;
+	}
+
+private:
+	enum { PAGE_ELEMENTS = (4 << 10) / sizeof(T), NO_SLOT = 0xFFFFFFFFu };
+
+	struct Slot{
+		size_t page;
+		bool referenced;
+		std::vector<T> data;
+	};
+
+	bool loadPage(size_t page, unsigned int & slot){
+		size_t maxSlots = std::max( limit / (PAGE_ELEMENTS * sizeof(T)), (size_t)2 );
+		if ( slots.size() < maxSlots ){
+			slot = (unsigned int)slots.size();
+			slots.push_back( Slot() );
+			slots[slot].data.resize(PAGE_ELEMENTS);
+		}else{
+			// Give a second chance to the pages used since the hand last passed
+			while ( slots[hand].referenced ){
+				slots[hand].referenced = false;
+				hand = (hand + 1) % slots.size();
+			}
+			slot = (unsigned int)hand;
+			hand = (hand + 1) % slots.size();
+			pageSlot[ slots[slot].page ] = NO_SLOT;
+		}
+
+		slots[slot].page = page;
+		slots[slot].referenced = false;
+		size_t first = page * PAGE_ELEMENTS;
+		size_t elements = std::min((size_t)PAGE_ELEMENTS, count - first);
+		if ( !seekFile(file, (unsigned long long)first * sizeof(T)) || fread(slots[slot].data.data(), sizeof(T), elements, file) != elements )
+			return false;
+		pageSlot[page] = slot;
+		return true;
+	}
+
+	size_t limit;
+	FILE * file;
+	size_t count;
+	std::vector<T> memory;              // While the array isn't spilled
+	std::vector<unsigned int> pageSlot; // Where each page is in the cache, or NO_SLOT
+	std::vector<Slot> slots;
+	size_t hand;
+};
+
+template <typename T>
+static inline bool fetchSpilled(SpilledArray<T> & array, int index, bool optional, T & result){
+	if ( index == 0 && optional ){
+		result = T(0.0f);
+		return true;
+	}
+	return index > 0 && array.get((size_t)index - 1, result);
+}
+
+// Memory used by one triangle of a batch, in the worst case : 3 indices, 3 new vertices
+// of 32 bytes, and their 3 keys in a hash table which is at most a quarter full.
+static const size_t OBJ_BATCH_BYTES_PER_TRIANGLE = 3*sizeof(unsigned int) + 3*32 + 3*4*(sizeof(OBJCorner) + sizeof(unsigned int));
+
+bool loadOBJ_streaming(
+	const char * path,
+	size_t memoryBudget,
+	const std::function<bool (const OBJBatch & batch)> & callback
+){
+	printf("Streaming OBJ file %s...\n", path);
+
+	if ( memoryBudget < (1 << 20) ){
+		printf("A memory budget of at least 1 MB is needed to stream %s\n", path);
+		return false;
+	}
+	// 1/16 to read the text (up to 2 blocks for long lines), 1/2 for the v/vt/vn arrays, and the rest for the batch
+	size_t blockSize = std::min(memoryBudget / 16, (size_t)(1 << 20));
+	SpilledArray<glm::vec3> vertices(memoryBudget / 6);
+	SpilledArray<glm::vec2> uvs     (memoryBudget / 6);
+	SpilledArray<glm::vec3> normals (memoryBudget / 6);
+	size_t batchTriangles = (memoryBudget - memoryBudget/2 - 2*blockSize) / OBJ_BATCH_BYTES_PER_TRIANGLE;
+
+	LineBlockReader reader;
+	if ( !reader.open(path, blockSize, 2*blockSize) ){
+		printf("Impossible to open the file ! Are you in the right path ? See Tutorial 1 for details\n");
+		if ( !workerThread() )
+			getchar();
+		return false;
+	}
+
+	// First pass : the v/vt/vn lines only. Faces can use any of them, so they have to be kept.
+	const char * begin;
+	const char * end;
+	while ( reader.next(begin, end) ){
+		for ( const char * p = begin; p < end; p = skipLine(p, end) ){
+			const char * header;
+			size_t headerLength = parseLineHeader(p, end, header);
+			bool ok = true;
+			if ( headerLength == 1 && header[0] == 'v' )
+				ok = vertices.push_back( parseVec3(p, end) );
+			else if ( headerLength == 2 && header[0] == 'v' && header[1] == 't' )
+				ok = uvs.push_back( parseUV(p, end) );
+			else if ( headerLength == 2 && header[0] == 'v' && header[1] == 'n' )
+				ok = normals.push_back( parseVec3(p, end) );
+			if ( !ok ){
+				printf("Impossible to write a temporary file while streaming %s\n", path);
+				return false;
+			}
+		}
+	}
+	if ( reader.lineTooLong() ){
+		printf("A line of %s is longer than %u bytes : too long for a memory budget of %u bytes\n", path, (unsigned int)(2*blockSize), (unsigned int)memoryBudget);
+		return false;
+	}
+	if ( reader.failed() || !reader.rewind() ){
+		printf("Impossible to read %s\n", path);
+		return false;
+	}
+
+	// Second pass : the faces, welded by (v, vt, vn) like the indexed loadOBJ, but only inside a batch
+	OBJBatch batch;
+	batch.firstTriangle = 0;
+	batch.indices .reserve(3*batchTriangles);
+	batch.vertices.reserve(3*batchTriangles);
+	batch.uvs     .reserve(3*batchTriangles);
+	batch.normals .reserve(3*batchTriangles);
+	VertexHashTable<OBJCorner> table(3*batchTriangles);
+	std::vector<int> polygon;
+	size_t counts[3] = { 0, 0, 0 }; // v, vt and vn lines read so far, for the negative indices
+	size_t triangle = 0;
+
+	while ( reader.next(begin, end) ){
+		for ( const char * p = begin; p < end; p = skipLine(p, end) ){
+			const char * header;
+			size_t headerLength = parseLineHeader(p, end, header);
+			if ( headerLength == 1 && header[0] == 'v' ){
+				counts[0]++;
+			}else if ( headerLength == 2 && header[0] == 'v' && header[1] == 't' ){
+				counts[1]++;
+			}else if ( headerLength == 2 && header[0] == 'v' && header[1] == 'n' ){
+				counts[2]++;
+			}else if ( headerLength == 1 && header[0] == 'f' ){
+				if ( !parseFace(p, end, polygon) ){
+					printf("File can't be read by our simple parser :-( Try exporting with other options\n");
+					return false;
+				}
+				for (size_t i = 0; i < polygon.size(); i++){
+					if ( polygon[i] < 0 ){
+						long long index = (long long)counts[i%3] + polygon[i] + 1; // -1 is the last one read
+						polygon[i] = index > 0 ? (int)index : -1;
+					}
+				}
+
+				size_t triangles = polygon.size()/3 - 2;
+				for (size_t i = 0; i < triangles; i++, triangle++){
+					for (int j = 0; j < 3; j++){
+						const int * c = &polygon[3*fanCorner(i, j)];
+						OBJCorner corner = { c[0], c[1], c[2] };
+						unsigned int index;
+						if ( !table.findOrInsert(corner, (unsigned int)batch.vertices.size(), index) ){
+							glm::vec3 vertex, normal;
+							glm::vec2 uv;
+							if ( !fetchSpilled(vertices, corner.vertex, false, vertex) ||
+							     !fetchSpilled(uvs,      corner.uv,     true,  uv)     ||
+							     !fetchSpilled(normals,  corner.normal, true,  normal) ){
+								printf("Invalid index in triangle %u of %s\n", (unsigned int)(triangle + 1), path);
+								return false;
+							}
+							index = (unsigned int)batch.vertices.size();
+							batch.vertices.push_back( vertex );
+							batch.uvs     .push_back( uv );
+							batch.normals .push_back( normal );
+						}
+						batch.indices.push_back(index);
+					}
+
+					if ( batch.indices.size() >= 3*batchTriangles ){
+						if ( !callback(batch) )
+							return false;
+						batch.firstTriangle += batch.indices.size() / 3;
+						batch.indices .clear();
+						batch.vertices.clear();
+						batch.uvs     .clear();
+						batch.normals .clear();
+						table.clear();
+					}
+				}
+			}
+		}
+	}
+	if ( reader.failed() ){
+		printf("Impossible to read %s\n", path);
+		return false;
+	}
+	if ( !batch.indices.empty() && !callback(batch) )
+		return false;
+	return true;
+}
 
 #ifdef USE_ASSIMP // don't use this #define, it's only for me (it AssImp fails to compile on your machine, at least all the other tutorials still work)
 
@@ -131,7 +992,8 @@ bool loadAssImp(
 	const aiScene* scene = importer.ReadFile(path, 0/*aiProcess_JoinIdenticalVertices | aiProcess_SortByPType*/);
 	if( !scene) {
 		fprintf( stderr, importer.GetErrorString());
-		getchar();
+		if ( !workerThread() )
+			getchar();
 		return false;
 	}
 	const aiMesh* mesh = scene->mMeshes[0]; // In this simple example code we always use the 1rst mesh (in OBJ files there is often only one anyway)
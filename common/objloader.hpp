@@ -1,6 +1,14 @@
 #ifndef OBJLOADER_H
 #define OBJLOADER_H
 
+#include <functional>
+
+// Reads the triangles of an OBJ file, without indexing them : 3 vertices per triangle.
+// Faces can be polygons (they're cut in triangles) and their corners can be
+// v, v/vt, v//vn or v/vt/vn. Missing UVs and normals are zeros, except in files without any
+// vn line : those get smooth normals, with hard edges where faces make more than 60 degrees
+// (see vertexnormals.hpp).
+// Negative indices count back from the last v, vt or vn read so far.
 bool loadOBJ(
 	const char * path, 
 	std::vector<glm::vec3> & out_vertices, 
@@ -8,7 +16,42 @@ bool loadOBJ(
 	std::vector<glm::vec3> & out_normals
 );
 
+// Same thing, but indexed : corners which use the same v/vt/vn triple in the file
+// become the same vertex. The triples are welded while the file is read, so there is
+// no need for loadOBJ + indexVBO (which makes 3 copies of everything, then compares floats).
+// Instantiated for unsigned short and unsigned int. Returns false if the mesh
+// has more vertices than T_INDEX can address.
+template <typename T_INDEX>
+bool loadOBJ(
+	const char * path,
+	std::vector<T_INDEX> & out_indices,
+	std::vector<glm::vec3> & out_vertices,
+	std::vector<glm::vec2> & out_uvs,
+	std::vector<glm::vec3> & out_normals
+);
+
+// A piece of an OBJ file, as given by loadOBJ_streaming : indexed triangles, with
+// their own vertices. A vertex used by triangles of several batches is in each of them.
+struct OBJBatch{
+	size_t firstTriangle; // Number of triangles in the previous batches
+	std::vector<unsigned int> indices;
+	std::vector<glm::vec3> vertices;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+};
 
+// Reads an OBJ file of any size, and gives its triangles to callback, one batch at a time.
+// Everything (the text being read, the v/vt/vn of the file, the current batch) fits in about
+// memoryBudget bytes : when the v/vt/vn don't, they go to temporary files, and are read
+// back through a cache. The batch given to the callback is only valid during the call.
+// Returns false on errors, on a line longer than memoryBudget / 8 (or 2 MB), or if callback
+// returned false to stop the loading.
+// Missing normals stay zeros : they would need all the faces at once.
+bool loadOBJ_streaming(
+	const char * path,
+	size_t memoryBudget,
+	const std::function<bool (const OBJBatch & batch)> & callback
+);
 
 bool loadAssImp(
 	const char * path, 
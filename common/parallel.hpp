@@ -0,0 +1,51 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#include <thread>
+#include <vector>
+
+// True on the threads of a pool which already has a thread per core (like the workers of
+// AssetLoader) : what they call runs on one thread, instead of each of them starting one
+// more per core. Also, nobody is there to press a key after an error.
+inline bool & workerThread(){
+	static thread_local bool worker = false;
+	return worker;
+}
+
+// How many threads are worth using for `work` items,
+// if each thread should get at least `grain` of them. 1 on a worker thread.
+inline unsigned int threadCount(size_t work, size_t grain){
+	if ( workerThread() )
+		return 1;
+	unsigned int cores = std::thread::hardware_concurrency();
+	if ( cores == 0 )
+		cores = 1; // unknown
+	size_t wanted = grain ? work / grain : work;
+	if ( wanted < 1 )
+		wanted = 1;
+	return wanted < cores ? (unsigned int)wanted : cores;
+}
+
+// Cuts [0, count) into `threads` contiguous slices, and calls job(begin, end)
+// on each slice in its own thread. The calling thread takes the first slice,
+// so with threads == 1 no thread is created at all.
+// job must not write to anything another slice writes to.
+template <typename T_JOB>
+void parallelFor(size_t count, unsigned int threads, T_JOB job){
+	if ( threads < 1 )
+		threads = 1;
+	if ( threads > count )
+		threads = count > 0 ? (unsigned int)count : 1;
+
+	std::vector<std::thread> workers;
+	for (unsigned int t = 1; t < threads; t++){
+		size_t begin = count * t / threads;
+		size_t end   = count * (t+1) / threads;
+		workers.push_back( std::thread(job, begin, end) );
+	}
+	job( (size_t)0, count / threads );
+	for (size_t t = 0; t < workers.size(); t++)
+		workers[t].join();
+}
+
+#endif
@@ -0,0 +1,171 @@
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+#include "parallel.hpp"
+#include "simd.hpp"
+#include "raypicking.hpp"
+
+// Below this, a ray is parallel to the planes of a slab (like TestRayOBBIntersection)
+static const float PARALLEL_EPSILON = 0.001f;
+
+// Ray-box tests per thread, at least
+static const size_t PICKING_GRAIN = 65536;
+
+OBBBatch::OBBBatch(){
+	clear();
+}
+
+void OBBBatch::clear(){
+	centerX.clear(); centerY.clear(); centerZ.clear();
+	for (int k = 0; k < 3; k++){
+		axisX[k].clear(); axisY[k].clear(); axisZ[k].clear();
+		halfSize[k].clear();
+	}
+	count = 0;
+}
+
+// Resizes every array ; new boxes are empty
+static void resizeAll(OBBBatch & boxes, size_t size){
+	boxes.centerX.resize(size, 0.0f);
+	boxes.centerY.resize(size, 0.0f);
+	boxes.centerZ.resize(size, 0.0f);
+	for (int k = 0; k < 3; k++){
+		boxes.axisX[k].resize(size, 0.0f);
+		boxes.axisY[k].resize(size, 0.0f);
+		boxes.axisZ[k].resize(size, 0.0f);
+		boxes.halfSize[k].resize(size, -1.0f);
+	}
+}
+
+size_t OBBBatch::add(const glm::mat4 & modelMatrix, const glm::vec3 & boxMin, const glm::vec3 & boxMax){
+	// Drop the padding, add the box, and pad again
+	resizeAll(*this, count);
+
+	glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(0.5f * (boxMin + boxMax), 1.0f));
+	centerX.push_back(center.x);
+	centerY.push_back(center.y);
+	centerZ.push_back(center.z);
+	for (int k = 0; k < 3; k++){
+		// The scale of the matrix goes in the size of the box, the axes stay unit vectors
+		glm::vec3 axis(modelMatrix[k]);
+		float scale = glm::length(axis);
+		if ( scale > 0.0f )
+			axis /= scale;
+		axisX[k].push_back(axis.x);
+		axisY[k].push_back(axis.y);
+		axisZ[k].push_back(axis.z);
+		halfSize[k].push_back(0.5f * (boxMax[k] - boxMin[k]) * scale);
+	}
+	size_t index = count++;
+
+	// Empty boxes (negative sizes) up to a multiple of 4 : nothing ever hits them
+	resizeAll(*this, (count + 3) & ~(size_t)3);
+	return index;
+}
+
+#ifndef SIMD_SSE2
+// Nearest hit of one ray, one box at a time
+static RayHit intersectRay(const glm::vec3 & origin, const glm::vec3 & direction, const OBBBatch & boxes, float maxDistance){
+	RayHit hit = { -1, maxDistance };
+	for (size_t i = 0; i < boxes.count; i++){
+		glm::vec3 delta = glm::vec3(boxes.centerX[i], boxes.centerY[i], boxes.centerZ[i]) - origin;
+		float tMin = 0.0f, tMax = hit.distance;
+		bool inside = true;
+		for (int k = 0; k < 3 && inside; k++){
+			glm::vec3 axis(boxes.axisX[k][i], boxes.axisY[k][i], boxes.axisZ[k][i]);
+			float h = boxes.halfSize[k][i];
+			float e = glm::dot(axis, delta);
+			float f = glm::dot(axis, direction);
+			if ( std::fabs(f) > PARALLEL_EPSILON ){
+				float t1 = (e - h) / f, t2 = (e + h) / f;
+				tMin = std::max(tMin, std::min(t1, t2));
+				tMax = std::min(tMax, std::max(t1, t2));
+				inside = tMin <= tMax;
+			}else{
+				inside = std::fabs(e) <= h;
+			}
+		}
+		if ( inside && (hit.box < 0 || tMin < hit.distance) ){
+			hit.box = (int)i;
+			hit.distance = tMin;
+		}
+	}
+	return hit;
+}
+#else
+// Nearest hit of one ray, 4 boxes at a time
+static RayHit intersectRay(const glm::vec3 & origin, const glm::vec3 & direction, const OBBBatch & boxes, float maxDistance){
+	RayHit hit = { -1, maxDistance };
+	const __m128 ox = _mm_set1_ps(origin.x), oy = _mm_set1_ps(origin.y), oz = _mm_set1_ps(origin.z);
+	const __m128 dx = _mm_set1_ps(direction.x), dy = _mm_set1_ps(direction.y), dz = _mm_set1_ps(direction.z);
+	const __m128 epsilon = _mm_set1_ps(PARALLEL_EPSILON), one = _mm_set1_ps(1.0f), zero = _mm_setzero_ps();
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+
+	size_t padded = boxes.centerX.size();
+	for (size_t i = 0; i < padded; i += 4){
+		__m128 deltaX = _mm_sub_ps(_mm_loadu_ps(&boxes.centerX[i]), ox);
+		__m128 deltaY = _mm_sub_ps(_mm_loadu_ps(&boxes.centerY[i]), oy);
+		__m128 deltaZ = _mm_sub_ps(_mm_loadu_ps(&boxes.centerZ[i]), oz);
+		__m128 tMin = zero, tMax = _mm_set1_ps(hit.distance);
+		// The padding boxes have negative sizes
+		__m128 inside = _mm_cmpge_ps(_mm_loadu_ps(&boxes.halfSize[0][i]), zero);
+		int mask = 0;
+
+		for (int k = 0; k < 3; k++){
+			__m128 ax = _mm_loadu_ps(&boxes.axisX[k][i]);
+			__m128 ay = _mm_loadu_ps(&boxes.axisY[k][i]);
+			__m128 az = _mm_loadu_ps(&boxes.axisZ[k][i]);
+			__m128 h = _mm_loadu_ps(&boxes.halfSize[k][i]);
+			__m128 e = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, deltaX), _mm_mul_ps(ay, deltaY)), _mm_mul_ps(az, deltaZ));
+			__m128 f = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, dx), _mm_mul_ps(ay, dy)), _mm_mul_ps(az, dz));
+
+			// Lanes where the ray is parallel to the slab : inside if |e| <= h, and f = 1
+			// keeps the division below harmless (its result isn't used)
+			__m128 parallel = _mm_cmple_ps(_mm_andnot_ps(signBit, f), epsilon);
+			__m128 parallelInside = _mm_cmple_ps(_mm_andnot_ps(signBit, e), h);
+			f = _mm_or_ps(_mm_and_ps(parallel, one), _mm_andnot_ps(parallel, f));
+
+			__m128 t1 = _mm_div_ps(_mm_sub_ps(e, h), f);
+			__m128 t2 = _mm_div_ps(_mm_add_ps(e, h), f);
+			__m128 nearT = _mm_min_ps(t1, t2), farT = _mm_max_ps(t1, t2);
+			tMin = _mm_or_ps(_mm_and_ps(parallel, tMin), _mm_andnot_ps(parallel, _mm_max_ps(tMin, nearT)));
+			tMax = _mm_or_ps(_mm_and_ps(parallel, tMax), _mm_andnot_ps(parallel, _mm_min_ps(tMax, farT)));
+			inside = _mm_andnot_ps(_mm_andnot_ps(parallelInside, parallel), inside);
+			// Most boxes are already missed after one slab
+			mask = _mm_movemask_ps(_mm_and_ps(inside, _mm_cmple_ps(tMin, tMax)));
+			if ( mask == 0 )
+				break;
+		}
+		if ( mask == 0 )
+			continue;
+
+		// Rare : a box nearer than the nearest one so far
+		float distances[4];
+		_mm_storeu_ps(distances, tMin);
+		for (int lane = 0; lane < 4; lane++){
+			if ( (mask & (1 << lane)) && (hit.box < 0 || distances[lane] < hit.distance) ){
+				hit.box = (int)(i + lane);
+				hit.distance = distances[lane];
+			}
+		}
+	}
+	return hit;
+}
+#endif
+
+void intersectRaysOBBs(
+	const glm::vec3 * origins,
+	const glm::vec3 * directions,
+	size_t rayCount,
+	const OBBBatch & boxes,
+	RayHit * out_hits,
+	float maxDistance
+){
+	parallelFor(rayCount, threadCount(rayCount * boxes.count, PICKING_GRAIN), [&](size_t begin, size_t end){
+		for (size_t r = begin; r < end; r++)
+			out_hits[r] = intersectRay(origins[r], directions[r], boxes, maxDistance);
+	});
+}
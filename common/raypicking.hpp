@@ -0,0 +1,45 @@
+#ifndef RAYPICKING_HPP
+#define RAYPICKING_HPP
+
+#include <vector>
+#include <glm/glm.hpp>
+
+// Ray / oriented bounding box intersections, for a lot of boxes at once.
+// Same slab test as TestRayOBBIntersection in misc05_picking_custom.cpp, but the boxes are
+// stored as a structure of arrays : the SSE version tests 4 boxes per instruction, and only
+// keeps looking for boxes nearer than the nearest hit so far.
+
+// A set of boxes. Box i is centerX[i], centerY[i], centerZ[i] + x * axis 0 + y * axis 1 + z * axis 2,
+// with |x| <= halfSize[0][i] and so on ; axisX[k][i] is the x of the (unit) axis k of box i.
+// The arrays are padded with empty boxes up to a multiple of 4.
+struct OBBBatch{
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> axisX[3], axisY[3], axisZ[3];
+	std::vector<float> halfSize[3];
+	size_t count; // Boxes, without the padding
+
+	OBBBatch();
+	void clear();
+
+	// Adds the box boxMin..boxMax, transformed by modelMatrix (rotation, translation, and
+	// scale along the axes : no shear). Returns its index.
+	size_t add(const glm::mat4 & modelMatrix, const glm::vec3 & boxMin, const glm::vec3 & boxMax);
+};
+
+struct RayHit{
+	int box;        // Index of the nearest box, -1 if the ray hits nothing
+	float distance; // From the ray origin to where it enters the box (0 if it starts inside)
+};
+
+// Nearest box hit by each ray. directions must be normalized ; only hits between 0 and
+// maxDistance along the rays count. Lots of rays are split between several threads.
+void intersectRaysOBBs(
+	const glm::vec3 * origins,
+	const glm::vec3 * directions,
+	size_t rayCount,
+	const OBBBatch & boxes,
+	RayHit * out_hits,
+	float maxDistance = 100000.0f
+);
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef SIMD_HPP
+#define SIMD_HPP
+
+// SSE2 is there on every x86-64 CPU, and the compilers enable it by default there.
+// Code using it checks SIMD_SSE2, and keeps a plain C++ version for the other CPUs.
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#endif
@@ -1,7 +1,17 @@
 #include <vector>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <stdio.h>
 #include <glm/glm.hpp>
 
+#include "objloader.hpp"
+#include "meshcache.hpp"
+#include "assetcache.hpp"
+#include "meshoptimizer.hpp"
 #include "tangentspace.hpp"
+#include "parallel.hpp"
+#include "simd.hpp"
 
 void computeTangentBasis(
 	// inputs
@@ -70,4 +80,314 @@ void computeTangentBasis(
 
 }
 
+// Squared lengths below this are zero (tangents and bitangents of degenerate triangles)
+static const float TANGENT_EPSILON = 1e-20f;
 
+// Triangles or vertices per thread, at least
+static const size_t TANGENT_GRAIN = 16384;
+
+// acos with a polynomial (Abramowitz & Stegun 4.4.45), within 7e-5 radians : good enough for weights,
+// and the SSE version below gives exactly the same thing.
+static inline float fastAcos(float x){
+	x = std::min(std::max(x, -1.0f), 1.0f);
+	float a = std::fabs(x);
+	float r = std::sqrt(1.0f - a) * (1.5707288f + a * (-0.2121144f + a * (0.0742610f - 0.0187293f * a)));
+	return x < 0.0f ? 3.14159265f - r : r;
+}
+
+// What each triangle gives to its corners : its tangent and bitangent (unit vectors, or zero when
+// the UVs are degenerate), and its angle at each corner.
+struct TriangleTangent{
+	glm::vec3 tangent;
+	glm::vec3 bitangent;
+	float angles[3];
+};
+
+static inline float cornerCosine(const glm::vec3 & a, const glm::vec3 & b){
+	float lengths = std::sqrt(glm::dot(a, a) * glm::dot(b, b));
+	return lengths > 0.0f ? glm::dot(a, b) / lengths : 1.0f; // Flat corner : no weight
+}
+
+static void triangleTangent(
+	const glm::vec3 & p0, const glm::vec3 & p1, const glm::vec3 & p2,
+	const glm::vec2 & uv0, const glm::vec2 & uv1, const glm::vec2 & uv2,
+	TriangleTangent & out
+){
+	glm::vec3 deltaPos1 = p1 - p0;
+	glm::vec3 deltaPos2 = p2 - p0;
+	glm::vec2 deltaUV1 = uv1 - uv0;
+	glm::vec2 deltaUV2 = uv2 - uv0;
+
+	// Same as computeTangentBasis, but only the sign of the determinant matters, since the
+	// result is normalized : no division by zero when the UVs are all on a line.
+	float det = deltaUV1.x * deltaUV2.y - deltaUV1.y * deltaUV2.x;
+	float sign = det > 0.0f ? 1.0f : det < 0.0f ? -1.0f : 0.0f;
+	glm::vec3 tangent   = (deltaPos1 * deltaUV2.y - deltaPos2 * deltaUV1.y) * sign;
+	glm::vec3 bitangent = (deltaPos2 * deltaUV1.x - deltaPos1 * deltaUV2.x) * sign;
+	float t2 = glm::dot(tangent, tangent), b2 = glm::dot(bitangent, bitangent);
+	if ( t2 > TANGENT_EPSILON && b2 > TANGENT_EPSILON ){
+		out.tangent   = tangent / std::sqrt(t2);
+		out.bitangent = bitangent / std::sqrt(b2);
+	}else{
+		out.tangent = out.bitangent = glm::vec3(0.0f);
+	}
+
+	out.angles[0] = fastAcos(cornerCosine(p1 - p0, p2 - p0));
+	out.angles[1] = fastAcos(cornerCosine(p2 - p1, p0 - p1));
+	out.angles[2] = fastAcos(cornerCosine(p0 - p2, p1 - p2));
+}
+
+#ifdef SIMD_SSE2
+// 4 triangles at once, one per lane : the same computations as triangleTangent
+struct Vec3x4{
+	__m128 x, y, z;
+};
+
+static inline Vec3x4 sub4(const Vec3x4 & a, const Vec3x4 & b){
+	Vec3x4 r = { _mm_sub_ps(a.x, b.x), _mm_sub_ps(a.y, b.y), _mm_sub_ps(a.z, b.z) };
+	return r;
+}
+
+static inline __m128 dot4(const Vec3x4 & a, const Vec3x4 & b){
+	return _mm_add_ps(_mm_add_ps(_mm_mul_ps(a.x, b.x), _mm_mul_ps(a.y, b.y)), _mm_mul_ps(a.z, b.z));
+}
+
+static inline __m128 fastAcos4(__m128 x){
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 signBit = _mm_set1_ps(-0.0f);
+	x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-1.0f)), one);
+	__m128 a = _mm_andnot_ps(signBit, x);
+	__m128 poly = _mm_add_ps(_mm_set1_ps(0.0742610f), _mm_mul_ps(a, _mm_set1_ps(-0.0187293f)));
+	poly = _mm_add_ps(_mm_set1_ps(-0.2121144f), _mm_mul_ps(a, poly));
+	poly = _mm_add_ps(_mm_set1_ps(1.5707288f), _mm_mul_ps(a, poly));
+	__m128 r = _mm_mul_ps(_mm_sqrt_ps(_mm_sub_ps(one, a)), poly);
+	__m128 negative = _mm_cmplt_ps(x, _mm_setzero_ps());
+	__m128 reflected = _mm_sub_ps(_mm_set1_ps(3.14159265f), r);
+	return _mm_or_ps(_mm_and_ps(negative, reflected), _mm_andnot_ps(negative, r));
+}
+
+static inline __m128 cornerAngle4(const Vec3x4 & a, const Vec3x4 & b){
+	__m128 lengths = _mm_sqrt_ps(_mm_mul_ps(dot4(a, a), dot4(b, b)));
+	__m128 valid = _mm_cmpgt_ps(lengths, _mm_setzero_ps());
+	__m128 cosine = _mm_div_ps(dot4(a, b), _mm_or_ps(lengths, _mm_andnot_ps(valid, _mm_set1_ps(1.0f))));
+	cosine = _mm_or_ps(_mm_and_ps(valid, cosine), _mm_andnot_ps(valid, _mm_set1_ps(1.0f)));
+	return fastAcos4(cosine);
+}
+
+template <typename T_INDEX>
+static void triangleTangents4(
+	const T_INDEX * indices,
+	const std::vector<glm::vec3> & vertices,
+	const std::vector<glm::vec2> & uvs,
+	TriangleTangent * out
+){
+	// Gather the corners of the 4 triangles in the lanes
+	float position[3][3][4], uv[3][2][4];
+	for (int lane = 0; lane < 4; lane++){
+		for (int k = 0; k < 3; k++){
+			const glm::vec3 & p = vertices[ indices[3*lane + k] ];
+			const glm::vec2 & t = uvs[ indices[3*lane + k] ];
+			position[k][0][lane] = p.x;
+			position[k][1][lane] = p.y;
+			position[k][2][lane] = p.z;
+			uv[k][0][lane] = t.x;
+			uv[k][1][lane] = t.y;
+		}
+	}
+	Vec3x4 p[3];
+	__m128 u[3], v[3];
+	for (int k = 0; k < 3; k++){
+		p[k].x = _mm_loadu_ps(position[k][0]);
+		p[k].y = _mm_loadu_ps(position[k][1]);
+		p[k].z = _mm_loadu_ps(position[k][2]);
+		u[k] = _mm_loadu_ps(uv[k][0]);
+		v[k] = _mm_loadu_ps(uv[k][1]);
+	}
+
+	Vec3x4 deltaPos1 = sub4(p[1], p[0]);
+	Vec3x4 deltaPos2 = sub4(p[2], p[0]);
+	__m128 du1 = _mm_sub_ps(u[1], u[0]), dv1 = _mm_sub_ps(v[1], v[0]);
+	__m128 du2 = _mm_sub_ps(u[2], u[0]), dv2 = _mm_sub_ps(v[2], v[0]);
+
+	__m128 det = _mm_sub_ps(_mm_mul_ps(du1, dv2), _mm_mul_ps(dv1, du2));
+	__m128 zero = _mm_setzero_ps();
+	__m128 sign = _mm_or_ps(
+		_mm_and_ps(_mm_cmpgt_ps(det, zero), _mm_set1_ps(1.0f)),
+		_mm_and_ps(_mm_cmplt_ps(det, zero), _mm_set1_ps(-1.0f)));
+
+	Vec3x4 tangent, bitangent;
+	tangent.x   = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(deltaPos1.x, dv2), _mm_mul_ps(deltaPos2.x, dv1)), sign);
+	tangent.y   = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(deltaPos1.y, dv2), _mm_mul_ps(deltaPos2.y, dv1)), sign);
+	tangent.z   = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(deltaPos1.z, dv2), _mm_mul_ps(deltaPos2.z, dv1)), sign);
+	bitangent.x = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(deltaPos2.x, du1), _mm_mul_ps(deltaPos1.x, du2)), sign);
+	bitangent.y = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(deltaPos2.y, du1), _mm_mul_ps(deltaPos1.y, du2)), sign);
+	bitangent.z = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(deltaPos2.z, du1), _mm_mul_ps(deltaPos1.z, du2)), sign);
+
+	__m128 t2 = dot4(tangent, tangent), b2 = dot4(bitangent, bitangent);
+	__m128 epsilon = _mm_set1_ps(TANGENT_EPSILON);
+	__m128 valid = _mm_and_ps(_mm_cmpgt_ps(t2, epsilon), _mm_cmpgt_ps(b2, epsilon));
+	// Exact square roots and divisions, so that the lanes give the same as triangleTangent
+	__m128 tScale = _mm_and_ps(valid, _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(_mm_max_ps(t2, epsilon))));
+	__m128 bScale = _mm_and_ps(valid, _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(_mm_max_ps(b2, epsilon))));
+
+	float results[9][4];
+	_mm_storeu_ps(results[0], _mm_mul_ps(tangent.x, tScale));
+	_mm_storeu_ps(results[1], _mm_mul_ps(tangent.y, tScale));
+	_mm_storeu_ps(results[2], _mm_mul_ps(tangent.z, tScale));
+	_mm_storeu_ps(results[3], _mm_mul_ps(bitangent.x, bScale));
+	_mm_storeu_ps(results[4], _mm_mul_ps(bitangent.y, bScale));
+	_mm_storeu_ps(results[5], _mm_mul_ps(bitangent.z, bScale));
+	_mm_storeu_ps(results[6], cornerAngle4(deltaPos1, deltaPos2));
+	_mm_storeu_ps(results[7], cornerAngle4(sub4(p[2], p[1]), sub4(p[0], p[1])));
+	_mm_storeu_ps(results[8], cornerAngle4(sub4(p[0], p[2]), sub4(p[1], p[2])));
+
+	for (int lane = 0; lane < 4; lane++){
+		out[lane].tangent   = glm::vec3(results[0][lane], results[1][lane], results[2][lane]);
+		out[lane].bitangent = glm::vec3(results[3][lane], results[4][lane], results[5][lane]);
+		for (int k = 0; k < 3; k++)
+			out[lane].angles[k] = results[6 + k][lane];
+	}
+}
+#endif
+
+// Any unit vector orthogonal to n, for the vertices whose triangles all have degenerate UVs
+static glm::vec3 anyTangent(const glm::vec3 & n){
+	glm::vec3 axis = std::fabs(n.x) < 0.9f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+	glm::vec3 t = axis - n * glm::dot(n, axis);
+	return glm::normalize(t);
+}
+
+template <typename T_INDEX>
+void computeTangents(
+	const std::vector<T_INDEX> & indices,
+	const std::vector<glm::vec3> & vertices,
+	const std::vector<glm::vec2> & uvs,
+	const std::vector<glm::vec3> & normals,
+	std::vector<glm::vec4> & out_tangents
+){
+	size_t triangleCount = indices.size() / 3;
+	size_t vertexCount = vertices.size();
+
+	// Each triangle, on its own : SIMD, and on several threads
+	std::vector<TriangleTangent> triangles(triangleCount);
+	parallelFor(triangleCount, threadCount(triangleCount, TANGENT_GRAIN), [&](size_t begin, size_t end){
+		size_t t = begin;
+#ifdef SIMD_SSE2
+		for (; t + 4 <= end; t += 4)
+			triangleTangents4(&indices[3*t], vertices, uvs, &triangles[t]);
+#endif
+		for (; t < end; t++)
+			triangleTangent(vertices[ indices[3*t] ], vertices[ indices[3*t+1] ], vertices[ indices[3*t+2] ],
+				uvs[ indices[3*t] ], uvs[ indices[3*t+1] ], uvs[ indices[3*t+2] ], triangles[t]);
+	});
+
+	// Corners of each vertex : corners[offsets[v] .. offsets[v+1]) (3*triangle + corner).
+	// Each vertex then sums its own corners, so the threads never write to the same place.
+	std::vector<unsigned int> offsets(vertexCount + 1, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		offsets[ indices[i] + 1 ]++;
+	for (size_t v = 0; v < vertexCount; v++)
+		offsets[v+1] += offsets[v];
+	std::vector<unsigned int> corners(triangleCount * 3);
+	{
+		std::vector<unsigned int> filled(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < triangleCount * 3; i++)
+			corners[ filled[ indices[i] ]++ ] = (unsigned int)i;
+	}
+
+	out_tangents.resize(vertexCount);
+	parallelFor(vertexCount, threadCount(vertexCount, TANGENT_GRAIN), [&](size_t begin, size_t end){
+		for (size_t v = begin; v < end; v++){
+			// Weighted by the angle of each triangle at the vertex : the result doesn't depend
+			// on how the faces around it are cut in triangles.
+			glm::vec3 tangent(0.0f), bitangent(0.0f);
+			for (unsigned int c = offsets[v]; c < offsets[v+1]; c++){
+				const TriangleTangent & triangle = triangles[ corners[c] / 3 ];
+				float angle = triangle.angles[ corners[c] % 3 ];
+				tangent   += triangle.tangent * angle;
+				bitangent += triangle.bitangent * angle;
+			}
+
+			// Gram-Schmidt orthogonalize, then the handedness (see computeTangentBasis)
+			glm::vec3 n = normals[v];
+			float nLength = glm::length(n);
+			n = nLength > 0.0f ? n / nLength : glm::vec3(0, 0, 1);
+			glm::vec3 t = tangent - n * glm::dot(n, tangent);
+			if ( glm::dot(t, t) <= TANGENT_EPSILON ){
+				// The tangent is along the normal, or there is none : try with the bitangent
+				glm::vec3 b = bitangent - n * glm::dot(n, bitangent);
+				t = glm::dot(b, b) > TANGENT_EPSILON ? glm::cross(b, n) : anyTangent(n);
+			}
+			t = glm::normalize(t);
+			float handedness = glm::dot(glm::cross(n, t), bitangent) < 0.0f ? -1.0f : 1.0f;
+			out_tangents[v] = glm::vec4(t, handedness);
+		}
+	});
+}
+
+template <typename T_INDEX>
+bool loadIndexedOBJ_TBN(
+	const char * path,
+	std::vector<T_INDEX> & indices,
+	std::vector<glm::vec3> & vertices,
+	std::vector<glm::vec2> & uvs,
+	std::vector<glm::vec3> & normals,
+	std::vector<glm::vec3> & tangents,
+	std::vector<glm::vec3> & bitangents,
+	MeshBounds * bounds
+){
+	std::string cachePath = meshCachePath(path, true);
+
+	MeshCacheFile cache;
+	if ( !cachePath.empty() && cache.open(cachePath.c_str()) && readMeshCache(cache, indices, vertices, uvs, normals, &tangents, &bitangents) ){
+		printf("Loading cached mesh %s...\n", cachePath.c_str());
+		assetCacheHit(cachePath);
+		if ( bounds )
+			*bounds = cache.bounds;
+		return true;
+	}
+	cache.close();
+	assetCacheMiss();
+
+	// Like readMeshCache, replace what was in the vectors
+	indices.clear();
+	vertices.clear();
+	uvs.clear();
+	normals.clear();
+	if ( !loadOBJ(path, indices, vertices, uvs, normals) )
+		return false;
+
+	std::vector<glm::vec4> tangentsAndHandedness;
+	computeTangents(indices, vertices, uvs, normals, tangentsAndHandedness);
+	tangents.resize(vertices.size());
+	bitangents.resize(vertices.size());
+	for (size_t v = 0; v < vertices.size(); v++){
+		tangents[v] = glm::vec3(tangentsAndHandedness[v]);
+		bitangents[v] = bitangentFromTangent(normals[v], tangentsAndHandedness[v]);
+	}
+	optimizeMesh(indices, vertices, uvs, normals, &tangents, &bitangents);
+	// Read the cache back : the index compression can rotate the triangles,
+	// and the first load should give exactly the same thing as the next ones.
+	bool saved = !cachePath.empty() && saveMeshCache(cachePath.c_str(), indices, vertices, uvs, normals, &tangents, &bitangents);
+	if ( saved )
+		assetCacheWritten(cachePath);
+	if ( saved && cache.open(cachePath.c_str()) && readMeshCache(cache, indices, vertices, uvs, normals, &tangents, &bitangents) ){
+		if ( bounds )
+			*bounds = cache.bounds;
+	}else if ( bounds ){
+		*bounds = computeMeshBounds(indices, vertices);
+	}
+	return true;
+}
+
+template bool loadIndexedOBJ_TBN<unsigned short>(const char *, std::vector<unsigned short> &, std::vector<glm::vec3> &,
+	std::vector<glm::vec2> &, std::vector<glm::vec3> &, std::vector<glm::vec3> &, std::vector<glm::vec3> &, MeshBounds *);
+template bool loadIndexedOBJ_TBN<unsigned int>(const char *, std::vector<unsigned int> &, std::vector<glm::vec3> &,
+	std::vector<glm::vec2> &, std::vector<glm::vec3> &, std::vector<glm::vec3> &, std::vector<glm::vec3> &, MeshBounds *);
+
+#define INSTANTIATE_TANGENTS(T_INDEX) \
+	template void computeTangents<T_INDEX>(const std::vector<T_INDEX> &, const std::vector<glm::vec3> &, \
+		const std::vector<glm::vec2> &, const std::vector<glm::vec3> &, std::vector<glm::vec4> &);
+
+INSTANTIATE_TANGENTS(unsigned short)
+INSTANTIATE_TANGENTS(unsigned int)
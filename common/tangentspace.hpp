@@ -1,6 +1,11 @@
 #ifndef TANGENTSPACE_HPP
 #define TANGENTSPACE_HPP
 
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "meshbounds.hpp"
+
 void computeTangentBasis(
 	// inputs
 	std::vector<glm::vec3> & vertices,
@@ -11,5 +16,39 @@ void computeTangentBasis(
 	std::vector<glm::vec3> & bitangents
 );
 
+// Tangents of an indexed mesh, directly per vertex : no 3 copies per triangle to merge afterwards.
+// xyz is the tangent, orthogonal to the normal, and w the handedness (+1 or -1) :
+// the bitangent is w * cross(normal, tangent), see bitangentFromTangent.
+// Each triangle adds its tangent and bitangent to its 3 vertices, weighted by its angle at the
+// vertex. Triangles whose UVs are degenerate (all on a line) add nothing ; a vertex with only
+// such triangles gets any tangent orthogonal to its normal, instead of NaN.
+// The triangles are done 4 at a time with SSE, and the triangles and vertices on several threads.
+// Instantiated for unsigned short and unsigned int indices.
+template <typename T_INDEX>
+void computeTangents(
+	const std::vector<T_INDEX> & indices,
+	const std::vector<glm::vec3> & vertices,
+	const std::vector<glm::vec2> & uvs,
+	const std::vector<glm::vec3> & normals,
+	std::vector<glm::vec4> & out_tangents
+);
+
+inline glm::vec3 bitangentFromTangent(const glm::vec3 & normal, const glm::vec4 & tangent){
+	return glm::cross(normal, glm::vec3(tangent)) * tangent.w;
+}
+
+// loadOBJ (indexed) + computeTangents + optimizeMesh, cached in the asset cache just like
+// loadIndexedOBJ (see meshcache.hpp), bounds included. The bitangents come from bitangentFromTangent.
+template <typename T_INDEX>
+bool loadIndexedOBJ_TBN(
+	const char * path,
+	std::vector<T_INDEX> & indices,
+	std::vector<glm::vec3> & vertices,
+	std::vector<glm::vec2> & uvs,
+	std::vector<glm::vec3> & normals,
+	std::vector<glm::vec3> & tangents,
+	std::vector<glm::vec3> & bitangents,
+	MeshBounds * bounds = NULL
+);
 
 #endif
\ No newline at end of file
@@ -1,13 +1,34 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <vector>
+#include <string>
 
 #include <GL/glew.h>
 
 #include <glfw3.h>
 
+#include "ddsfile.hpp"
+#include "texturecompression.hpp"
+#include "mipmaps.hpp"
+#include "mappedfile.hpp"
+#include "assetcache.hpp"
+#include "parallel.hpp"
+#include "texture.hpp"
 
-GLuint loadBMP_custom(const char * imagepath){
+
+// Mipmaps of the BMP files (see mipmaps.hpp)
+static const MipFilter BMP_MIP_FILTER = MIP_FILTER_KAISER;
+
+// decodeDDS reads one byte per page of the mapping
+static const size_t DDS_PAGE_SIZE = 4096;
+
+// Kinds of the BMP textures in the asset cache. Change the number when the mipmaps or the
+// compression change : the old entries are then just not used anymore.
+#define TEXTURE_CACHE_KIND "tex1"
+
+// Reads a 24 bits BMP file : width * height pixels, in BGR, bottom row first
+static bool readBMP(const char * imagepath, unsigned int & width, unsigned int & height, std::vector<unsigned char> & out_bgr){
 
 	printf("Reading image %s\n", imagepath);
 
@@ -15,13 +36,10 @@ GLuint loadBMP_custom(const char * imagepath){
 	unsigned char header[54];
 	unsigned int dataPos;
 	unsigned int imageSize;
-	unsigned int width, height;
-	// Actual RGB data
-	unsigned char * data;
 
 	// Open the file
 	FILE * file = fopen(imagepath,"rb");
-	if (!file)							    {printf("%s could not be opened. Are you in the right directory ? Don't forget to read the FAQ !\n", imagepath); getchar(); return 0;}
+	if (!file)							    {printf("%s could not be opened. Are you in the right directory ? Don't forget to read the FAQ !\n", imagepath); if ( !workerThread() ) getchar(); return false;}
 
 	// Read the header, i.e. the 54 first bytes
 
@@ -29,17 +47,17 @@ GLuint loadBMP_custom(const char * imagepath){
 	if ( fread(header, 1, 54, file)!=54 ){ 
 		printf("Not a correct BMP file\n");
 		fclose(file);
-		return 0;
+		return false;
 	}
 	// A BMP files always begins with "BM"
 	if ( header[0]!='B' || header[1]!='M' ){
 		printf("Not a correct BMP file\n");
 		fclose(file);
-		return 0;
+		return false;
 	}
 	// Make sure this is a 24bpp file
-	if ( *(int*)&(header[0x1E])!=0  )         {printf("Not a correct BMP file\n");    fclose(file); return 0;}
-	if ( *(int*)&(header[0x1C])!=24 )         {printf("Not a correct BMP file\n");    fclose(file); return 0;}
+	if ( *(int*)&(header[0x1E])!=0  )         {printf("Not a correct BMP file\n");    fclose(file); return false;}
+	if ( *(int*)&(header[0x1C])!=24 )         {printf("Not a correct BMP file\n");    fclose(file); return false;}
 
 	// Read the information about the image
 	dataPos    = *(int*)&(header[0x0A]);
@@ -47,46 +65,173 @@ GLuint loadBMP_custom(const char * imagepath){
 	width      = *(int*)&(header[0x12]);
 	height     = *(int*)&(header[0x16]);
 
+	// Each row is padded to a multiple of 4 bytes
+	unsigned int rowSize = (width * 3 + 3) & ~3u;
+
 	// Some BMP files are misformatted, guess missing information
-	if (imageSize==0)    imageSize=width*height*3; // 3 : one byte for each Red, Green and Blue component
+	if (imageSize==0)    imageSize=rowSize*height; // 3 : one byte for each Red, Green and Blue component
 	if (dataPos==0)      dataPos=54; // The BMP header is done that way
 
-	// Create a buffer
-	data = new unsigned char [imageSize];
-
-	// Read the actual data from the file into the buffer
-	fread(data,1,imageSize,file);
+	// Read the actual data from the file, without the padding of the rows
+	out_bgr.resize((size_t)width * height * 3);
+	bool ok = fseek(file, dataPos, SEEK_SET) == 0;
+	for (unsigned int y = 0; y < height && ok; y++){
+		ok = fread(&out_bgr[(size_t)y * width * 3], 1, width * 3, file) == width * 3
+			&& fseek(file, rowSize - width * 3, SEEK_CUR) == 0;
+	}
 
 	// Everything is in memory now, the file wan be closed
 	fclose (file);
+	if ( !ok ){
+		printf("Not a correct BMP file\n");
+		return false;
+	}
+	return true;
+}
 
-	// Create one OpenGL texture
-	GLuint textureID;
-	glGenTextures(1, &textureID);
-	
-	// "Bind" the newly created texture : all future texture functions will modify this texture
-	glBindTexture(GL_TEXTURE_2D, textureID);
+// The mapping is only read from the disk when its pages are touched : touch them all now,
+// rather than in uploadTexture (which is on the OpenGL thread)
+static void touchDDS(const DDSFile & dds){
+	volatile unsigned char sum = 0;
+	for (unsigned int layer = 0; layer < dds.arraySize; layer++)
+		for (unsigned int face = 0; face < dds.faces; face++)
+			for (unsigned int mip = 0; mip < dds.mipCount; mip++){
+				const DDSLevel & level = dds.level(layer, face, mip);
+				for (size_t i = 0; i < level.size; i += DDS_PAGE_SIZE)
+					sum += level.data[i];
+			}
+}
 
-	// Give the image to OpenGL
-	glTexImage2D(GL_TEXTURE_2D, 0,GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, data);
+// A BMP texture which is already in the asset cache
+static bool openCachedTexture(const std::string & entryPath, TextureImage & out_image){
+	unsigned long long size;
+	long long mtime;
+	if ( entryPath.empty() || !getFileInfo(entryPath.c_str(), size, mtime) )
+		return false; // Not there, and that's not an error
+	out_image.levels.clear();
+	for (unsigned int face = 0; face < 6; face++)
+		out_image.ddsMipmaps[face].clear();
+	if ( !out_image.dds.open(entryPath.c_str()) )
+		return false;
+	printf("Loading cached texture %s...\n", entryPath.c_str());
+	out_image.compressed = out_image.dds.compressed();
+	out_image.fromDDS = true;
+	out_image.repeatTrilinear = true;
+	touchDDS(out_image.dds);
+	assetCacheHit(entryPath);
+	return true;
+}
 
-	// OpenGL has now copied the data. Free our own version
-	delete [] data;
-	fclose(file);
+static void saveCachedTexture(const std::string & entryPath, DDSFormat format, const TextureImage & image){
+	if ( entryPath.empty() )
+		return;
+	std::vector<DDSLevel> mips(image.levels.size());
+	for (size_t level = 0; level < image.levels.size(); level++){
+		mips[level].data   = &image.levels[level].pixels[0];
+		mips[level].size   = image.levels[level].pixels.size();
+		mips[level].width  = image.levels[level].width;
+		mips[level].height = image.levels[level].height;
+		mips[level].depth  = 1;
+	}
+	if ( saveDDS(entryPath.c_str(), format, mips) )
+		assetCacheWritten(entryPath);
+}
 
-	// Poor filtering, or ...
-	//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST); 
+bool decodeBMP(const char * imagepath, TextureImage & out_image){
 
-	// ... nice trilinear filtering.
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR); 
-	glGenerateMipmap(GL_TEXTURE_2D);
+	std::string entryPath = assetCachePath(imagepath, TEXTURE_CACHE_KIND ".bgr.dds");
+	if ( openCachedTexture(entryPath, out_image) )
+		return true;
+	assetCacheMiss();
 
-	// Return the ID of the texture we just created
-	return textureID;
+	// Actual RGB data
+	unsigned int width, height;
+	out_image.levels.assign(1, MipLevel());
+	if ( !readBMP(imagepath, width, height, out_image.levels[0].pixels) )
+		return false;
+	out_image.levels[0].width = width;
+	out_image.levels[0].height = height;
+	out_image.compressed = false;
+	out_image.fromDDS = false;
+	out_image.repeatTrilinear = true;
+
+	// And its mipmaps, made on the CPU rather than by glGenerateMipmap : the same with every
+	// driver, and filtered in linear light (the BMP is in sRGB, like any picture)
+	std::vector<MipLevel> mipmaps;
+	buildMipChain(&out_image.levels[0].pixels[0], width, height, 3, BMP_MIP_FILTER, true, mipmaps);
+	out_image.levels.insert(out_image.levels.end(), mipmaps.begin(), mipmaps.end());
+	saveCachedTexture(entryPath, DDS_FORMAT_BGR8, out_image);
+	return true;
+}
+
+GLuint loadBMP_custom(const char * imagepath){
+	TextureImage image;
+	if ( !decodeBMP(imagepath, image) )
+		return 0;
+	return uploadTexture(image);
+}
+
+bool decodeBMP_compressed(const char * imagepath, BlockFormat format, TextureImage & out_image){
+
+	static const char * const kinds[] = {
+		TEXTURE_CACHE_KIND ".bc1.dds", TEXTURE_CACHE_KIND ".bc3.dds", TEXTURE_CACHE_KIND ".bc4.dds", TEXTURE_CACHE_KIND ".bc5.dds"
+	};
+	static const DDSFormat ddsFormats[] = { DDS_FORMAT_BC1, DDS_FORMAT_BC3, DDS_FORMAT_BC4, DDS_FORMAT_BC5 };
+	std::string entryPath = assetCachePath(imagepath, kinds[format]);
+	if ( openCachedTexture(entryPath, out_image) )
+		return true;
+	assetCacheMiss();
+
+	unsigned int width, height;
+	std::vector<unsigned char> bgr;
+	if ( !readBMP(imagepath, width, height, bgr) )
+		return false;
+
+	// The compressor wants RGBA
+	std::vector<unsigned char> rgba((size_t)width * height * 4);
+	for (size_t i = 0; i < (size_t)width * height; i++){
+		rgba[4*i+0] = bgr[3*i+2];
+		rgba[4*i+1] = bgr[3*i+1];
+		rgba[4*i+2] = bgr[3*i+0];
+		rgba[4*i+3] = 255;
+	}
+
+	// BC1 and BC3 are for colors (sRGB), BC4 and BC5 for data (normal maps...)
+	bool srgb = format == BLOCK_BC1 || format == BLOCK_BC3;
+	std::vector<MipLevel> mipmaps;
+	buildMipChain(&rgba[0], width, height, 4, BMP_MIP_FILTER, srgb, mipmaps);
+
+	// glGenerateMipmap can't make the mipmaps of a compressed texture :
+	// each level is compressed here
+	out_image.levels.resize(mipmaps.size() + 1);
+	out_image.compressed = true;
+	out_image.blockFormat = format;
+	out_image.fromDDS = false;
+	out_image.repeatTrilinear = true;
+	size_t totalSize = 0;
+	for (size_t level = 0; level <= mipmaps.size(); level++){
+		const unsigned char * pixels = level == 0 ? &rgba[0] : &mipmaps[level - 1].pixels[0];
+		if ( level > 0 ){
+			width = mipmaps[level - 1].width;
+			height = mipmaps[level - 1].height;
+		}
+		MipLevel & blocks = out_image.levels[level];
+		blocks.width = width;
+		blocks.height = height;
+		blocks.pixels.resize(compressedSize(format, width, height));
+		compressImage(format, pixels, width, height, &blocks.pixels[0]);
+		totalSize += blocks.pixels.size();
+	}
+	printf("Compressed %s : %u KB of video memory\n", imagepath, (unsigned int)(totalSize / 1024));
+	saveCachedTexture(entryPath, ddsFormats[format], out_image);
+	return true;
+}
+
+GLuint loadBMP_compressed(const char * imagepath, BlockFormat format){
+	TextureImage image;
+	if ( !decodeBMP_compressed(imagepath, format, image) )
+		return 0;
+	return uploadTexture(image);
 }
 
 // Since GLFW 3, glfwLoadTexture2D() has been removed. You have to use another texture loading library, 
@@ -116,99 +261,183 @@ GLuint loadBMP_custom(const char * imagepath){
 
 
 
-#define FOURCC_DXT1 0x31545844 // Equivalent to "DXT1" in ASCII
-#define FOURCC_DXT3 0x33545844 // Equivalent to "DXT3" in ASCII
-#define FOURCC_DXT5 0x35545844 // Equivalent to "DXT5" in ASCII
+// The OpenGL format of a DDS file. For uncompressed formats, pixelFormat is the layout of
+// the pixels in the file (they're always GL_UNSIGNED_BYTE).
+static bool glFormatOfDDS(const DDSFile & dds, GLenum & internalFormat, GLenum & pixelFormat){
+	pixelFormat = 0;
+	switch (dds.format){
+	case DDS_FORMAT_BC1:   internalFormat = dds.srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT1_EXT; break;
+	case DDS_FORMAT_BC2:   internalFormat = dds.srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT : GL_COMPRESSED_RGBA_S3TC_DXT3_EXT; break;
+	case DDS_FORMAT_BC3:   internalFormat = dds.srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; break;
+	case DDS_FORMAT_BC4:   internalFormat = dds.signedFormat ? GL_COMPRESSED_SIGNED_RED_RGTC1 : GL_COMPRESSED_RED_RGTC1; break;
+	case DDS_FORMAT_BC5:   internalFormat = dds.signedFormat ? GL_COMPRESSED_SIGNED_RG_RGTC2 : GL_COMPRESSED_RG_RGTC2; break;
+	case DDS_FORMAT_BC6H:  internalFormat = dds.signedFormat ? GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT : GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT; break;
+	case DDS_FORMAT_BC7:   internalFormat = dds.srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM; break;
+	case DDS_FORMAT_RGBA8: internalFormat = dds.srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8; pixelFormat = GL_RGBA; break;
+	case DDS_FORMAT_BGRA8: internalFormat = dds.srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8; pixelFormat = GL_BGRA; break;
+	case DDS_FORMAT_BGR8:  internalFormat = GL_RGB8; pixelFormat = GL_BGR; break;
+	default: return false;
+	}
+	return true;
+}
 
-GLuint loadDDS(const char * imagepath){
+bool decodeDDS(const char * imagepath, TextureImage & out_image){
+
+	// Map the file and find every level in it (see common/ddsfile.hpp) : no malloc, no fread.
+	// The pointers given to OpenGL point straight into the mapping.
+	out_image.levels.clear();
+	out_image.compressed = false;
+	out_image.fromDDS = true;
+	out_image.repeatTrilinear = false;
+	DDSFile & dds = out_image.dds;
+	if ( !dds.open(imagepath) ){
+		if ( !workerThread() )
+			getchar();
+		return false;
+	}
 
-	unsigned char header[124];
+	GLenum internalFormat, pixelFormat;
+	if ( !glFormatOfDDS(dds, internalFormat, pixelFormat) )
+		return false;
+	if ( dds.cubemap && dds.arraySize > 1 ){
+		printf("%s : cubemap arrays are not supported\n", imagepath);
+		return false;
+	}
 
-	FILE *fp; 
- 
-	/* try to open the file */ 
-	fp = fopen(imagepath, "rb"); 
-	if (fp == NULL){
-		printf("%s could not be opened. Are you in the right directory ? Don't forget to read the FAQ !\n", imagepath); getchar(); 
-		return 0;
+	// Uncompressed 2D textures and cubemaps without mipmaps : make them here (as pictures, in sRGB)
+	for (unsigned int face = 0; face < 6; face++)
+		out_image.ddsMipmaps[face].clear();
+	if ( !dds.compressed() && dds.mipCount == 1 && dds.depth == 1 && (dds.arraySize == 1 || dds.cubemap) ){
+		for (unsigned int face = 0; face < dds.faces; face++){
+			const DDSLevel & level = dds.level(0, face, 0);
+			buildMipChain(level.data, level.width, level.height, dds.bytesPerBlock, MIP_FILTER_KAISER, true, out_image.ddsMipmaps[face]);
+		}
 	}
-   
-	/* verify the type of file */ 
-	char filecode[4]; 
-	fread(filecode, 1, 4, fp); 
-	if (strncmp(filecode, "DDS ", 4) != 0) { 
-		fclose(fp); 
-		return 0; 
-	}
-	
-	/* get the surface desc */ 
-	fread(&header, 124, 1, fp); 
-
-	unsigned int height      = *(unsigned int*)&(header[8 ]);
-	unsigned int width	     = *(unsigned int*)&(header[12]);
-	unsigned int linearSize	 = *(unsigned int*)&(header[16]);
-	unsigned int mipMapCount = *(unsigned int*)&(header[24]);
-	unsigned int fourCC      = *(unsigned int*)&(header[80]);
-
- 
-	unsigned char * buffer;
-	unsigned int bufsize;
-	/* how big is it going to be including all mipmaps? */ 
-	bufsize = mipMapCount > 1 ? linearSize * 2 : linearSize; 
-	buffer = (unsigned char*)malloc(bufsize * sizeof(unsigned char)); 
-	fread(buffer, 1, bufsize, fp); 
-	/* close the file pointer */ 
-	fclose(fp);
-
-	unsigned int components  = (fourCC == FOURCC_DXT1) ? 3 : 4; 
-	unsigned int format;
-	switch(fourCC) 
-	{ 
-	case FOURCC_DXT1: 
-		format = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT; 
-		break; 
-	case FOURCC_DXT3: 
-		format = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT; 
-		break; 
-	case FOURCC_DXT5: 
-		format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; 
-		break; 
-	default: 
-		free(buffer); 
-		return 0; 
+
+	touchDDS(dds);
+	return true;
+}
+
+// The levels of a BMP, as made by decodeBMP or decodeBMP_compressed
+static void uploadLevels(const TextureImage & image){
+	GLenum internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+	switch (image.blockFormat){
+	case BLOCK_BC1: internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT; break;
+	case BLOCK_BC3: internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; break;
+	case BLOCK_BC4: internalFormat = GL_COMPRESSED_RED_RGTC1; break;
+	case BLOCK_BC5: internalFormat = GL_COMPRESSED_RG_RGTC2; break;
 	}
 
-	// Create one OpenGL texture
-	GLuint textureID;
-	glGenTextures(1, &textureID);
+	// Give the image to OpenGL
+	glPixelStorei(GL_UNPACK_ALIGNMENT,1);
+	for (size_t level = 0; level < image.levels.size(); level++){
+		const MipLevel & mip = image.levels[level];
+		if ( image.compressed )
+			glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)level, internalFormat, mip.width, mip.height, 0, (GLsizei)mip.pixels.size(), &mip.pixels[0]);
+		else
+			glTexImage2D(GL_TEXTURE_2D, (GLint)level, GL_RGB, mip.width, mip.height, 0, GL_BGR, GL_UNSIGNED_BYTE, &mip.pixels[0]);
+	}
+}
 
-	// "Bind" the newly created texture : all future texture functions will modify this texture
-	glBindTexture(GL_TEXTURE_2D, textureID);
+static void uploadDDS(const TextureImage & image, GLenum target){
+	const DDSFile & dds = image.dds;
+	GLenum internalFormat, pixelFormat;
+	glFormatOfDDS(dds, internalFormat, pixelFormat);
 	glPixelStorei(GL_UNPACK_ALIGNMENT,1);	
-	
-	unsigned int blockSize = (format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT) ? 8 : 16; 
-	unsigned int offset = 0;
 
 	/* load the mipmaps */ 
-	for (unsigned int level = 0; level < mipMapCount && (width || height); ++level) 
-	{ 
-		unsigned int size = ((width+3)/4)*((height+3)/4)*blockSize; 
-		glCompressedTexImage2D(GL_TEXTURE_2D, level, format, width, height,  
-			0, size, buffer + offset); 
-	 
-		offset += size; 
-		width  /= 2; 
-		height /= 2; 
+	for (unsigned int mip = 0; mip < dds.mipCount; mip++){
+		const DDSLevel & first = dds.level(0, 0, mip);
+		if ( target == GL_TEXTURE_2D_ARRAY ){
+			// Every layer has its own mipmap chain in the file : allocate the level for all
+			// the layers, then fill each one
+			if ( dds.compressed() )
+				glCompressedTexImage3D(target, mip, internalFormat, first.width, first.height, dds.arraySize, 0, (GLsizei)(first.size * dds.arraySize), NULL);
+			else
+				glTexImage3D(target, mip, internalFormat, first.width, first.height, dds.arraySize, 0, pixelFormat, GL_UNSIGNED_BYTE, NULL);
+			for (unsigned int layer = 0; layer < dds.arraySize; layer++){
+				const DDSLevel & level = dds.level(layer, 0, mip);
+				if ( dds.compressed() )
+					glCompressedTexSubImage3D(target, mip, 0, 0, layer, level.width, level.height, 1, internalFormat, (GLsizei)level.size, level.data);
+				else
+					glTexSubImage3D(target, mip, 0, 0, layer, level.width, level.height, 1, pixelFormat, GL_UNSIGNED_BYTE, level.data);
+			}
+		}else if ( target == GL_TEXTURE_3D ){
+			if ( dds.compressed() )
+				glCompressedTexImage3D(target, mip, internalFormat, first.width, first.height, first.depth, 0, (GLsizei)first.size, first.data);
+			else
+				glTexImage3D(target, mip, internalFormat, first.width, first.height, first.depth, 0, pixelFormat, GL_UNSIGNED_BYTE, first.data);
+		}else{
+			// GL_TEXTURE_2D, or each face of the cubemap
+			for (unsigned int face = 0; face < dds.faces; face++){
+				GLenum faceTarget = dds.cubemap ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : GL_TEXTURE_2D;
+				const DDSLevel & level = dds.level(0, face, mip);
+				if ( dds.compressed() )
+					glCompressedTexImage2D(faceTarget, mip, internalFormat, level.width, level.height, 0, (GLsizei)level.size, level.data);
+				else
+					glTexImage2D(faceTarget, mip, internalFormat, level.width, level.height, 0, pixelFormat, GL_UNSIGNED_BYTE, level.data);
+			}
+		}
+	}
 
-		// Deal with Non-Power-Of-Two textures. This code is not included in the webpage to reduce clutter.
-		if(width < 1) width = 1;
-		if(height < 1) height = 1;
+	// The mipmaps made by decodeDDS
+	unsigned int mipCount = dds.mipCount;
+	for (unsigned int face = 0; face < dds.faces; face++){
+		GLenum faceTarget = dds.cubemap ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : GL_TEXTURE_2D;
+		const std::vector<MipLevel> & mipmaps = image.ddsMipmaps[face];
+		for (size_t mip = 0; mip < mipmaps.size(); mip++)
+			glTexImage2D(faceTarget, (GLint)mip + 1, internalFormat, mipmaps[mip].width, mipmaps[mip].height, 0, pixelFormat, GL_UNSIGNED_BYTE, &mipmaps[mip].pixels[0]);
+	}
+	mipCount += (unsigned int)image.ddsMipmaps[0].size();
 
-	} 
+	// Files without all their mipmaps are complete textures too
+	glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, mipCount - 1);
+}
 
-	free(buffer); 
+GLuint uploadTexture(const TextureImage & image){
+
+	// A plain texture, a cubemap, an array of textures, or a volume texture
+	GLenum target = GL_TEXTURE_2D;
+	if ( image.fromDDS ){
+		if ( image.dds.cubemap )
+			target = GL_TEXTURE_CUBE_MAP;
+		else if ( image.dds.depth > 1 )
+			target = GL_TEXTURE_3D;
+		else if ( image.dds.arraySize > 1 )
+			target = GL_TEXTURE_2D_ARRAY;
+	}
 
-	return textureID;
+	// Create one OpenGL texture
+	GLuint textureID;
+	glGenTextures(1, &textureID);
 
+	// "Bind" the newly created texture : all future texture functions will modify this texture
+	glBindTexture(target, textureID);
+
+	if ( image.fromDDS )
+		uploadDDS(image, target);
+	else
+		uploadLevels(image);
+
+	if ( image.repeatTrilinear ){
+		// Poor filtering, or ...
+		//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		//glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST); 
+
+		// ... nice trilinear filtering.
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR); 
+	}
 
-}
\ No newline at end of file
+	// Return the ID of the texture we just created
+	return textureID;
+}
+
+GLuint loadDDS(const char * imagepath){
+	TextureImage image;
+	if ( !decodeDDS(imagepath, image) )
+		return 0;
+	return uploadTexture(image);
+}
@@ -1,16 +1,56 @@
 #ifndef TEXTURE_HPP
 #define TEXTURE_HPP
 
-// Load a .BMP file using our custom loader
+#include <vector>
+
+#include "ddsfile.hpp"
+#include "mipmaps.hpp"
+#include "texturecompression.hpp"
+
+// Load a .BMP file using our custom loader. Its mipmaps are made on the CPU (see mipmaps.hpp).
 GLuint loadBMP_custom(const char * imagepath);
 
+// Same thing, but compressed on the CPU (see texturecompression.hpp), mipmaps included :
+// 4x (BC3, BC5) to 8x (BC1, BC4) less video memory. BC5 is the one for normal maps.
+GLuint loadBMP_compressed(const char * imagepath, BlockFormat format);
+
 //// Since GLFW 3, glfwLoadTexture2D() has been removed. You have to use another texture loading library, 
 //// or do it yourself (just like loadBMP_custom and loadDDS)
 //// Load a .TGA file using GLFW's own loader
 //GLuint loadTGA_glfw(const char * imagepath);
 
-// Load a .DDS file using GLFW's own loader
+// Load a .DDS file (see ddsfile.hpp) : BC1 to BC7 or uncompressed, with its mipmaps
+// (made on the CPU for uncompressed 2D textures and cubemaps which have none).
+// Cubemaps, texture arrays and volume textures give a GL_TEXTURE_CUBE_MAP,
+// GL_TEXTURE_2D_ARRAY or GL_TEXTURE_3D texture instead of a GL_TEXTURE_2D one.
 GLuint loadDDS(const char * imagepath);
 
+// The loaders above are each a decode and an upload. decode* read the file and prepare
+// everything on the CPU : they don't need OpenGL, and can run on any thread (see assetloader.hpp).
+// uploadTexture then only gives the result to OpenGL, on the OpenGL thread.
+struct TextureImage{
+	TextureImage() : compressed(false), blockFormat(BLOCK_BC1), fromDDS(false), repeatTrilinear(false) {}
+
+	// BMP : every mipmap level, level 0 first. Pixels in BGR, or blocks of blockFormat when compressed.
+	std::vector<MipLevel> levels;
+	bool compressed;
+	BlockFormat blockFormat;
+
+	// DDS : the mapped file (not copyable), and the mipmaps made for each face of
+	// uncompressed files which have none
+	bool fromDDS;
+	DDSFile dds;
+	std::vector<MipLevel> ddsMipmaps[6];
+
+	// GL_REPEAT and trilinear filtering, like every BMP texture (even when it comes from the asset cache)
+	bool repeatTrilinear;
+};
+
+// decodeBMP and decodeBMP_compressed keep their result in the asset cache (see assetcache.hpp),
+// as a DDS file : the next time, it's just mapped.
+bool decodeBMP(const char * imagepath, TextureImage & out_image);
+bool decodeBMP_compressed(const char * imagepath, BlockFormat format, TextureImage & out_image);
+bool decodeDDS(const char * imagepath, TextureImage & out_image);
+GLuint uploadTexture(const TextureImage & image);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,313 @@
+#include <string.h>
+#include <cmath>
+#include <algorithm>
+
+#include "parallel.hpp"
+#include "simd.hpp"
+#include "texturecompression.hpp"
+
+// Blocks per thread, at least
+static const size_t BLOCKS_GRAIN = 1024;
+
+static size_t bytesPerBlock(BlockFormat format){
+	return (format == BLOCK_BC1 || format == BLOCK_BC4) ? 8 : 16;
+}
+
+size_t compressedSize(BlockFormat format, unsigned int width, unsigned int height){
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * bytesPerBlock(format);
+}
+
+// The 16 RGBA pixels of block (bx, by), repeating the last row and column of the image if needed
+static void loadBlock(const unsigned char * rgba, unsigned int width, unsigned int height, unsigned int bx, unsigned int by, unsigned char block[64]){
+	for (unsigned int y = 0; y < 4; y++){
+		unsigned int sy = std::min(by * 4 + y, height - 1);
+		const unsigned char * row = rgba + (size_t)sy * width * 4;
+		if ( bx * 4 + 3 < width ){
+			memcpy(block + 16 * y, row + bx * 16, 16);
+			continue;
+		}
+		for (unsigned int x = 0; x < 4; x++){
+			unsigned int sx = std::min(bx * 4 + x, width - 1);
+			memcpy(block + 16 * y + 4 * x, row + sx * 4, 4);
+		}
+	}
+}
+
+// round(value * 31 / 255) and back
+static inline int quantize5(int value){ return (value * 31 + 127) / 255; }
+static inline int quantize6(int value){ return (value * 63 + 127) / 255; }
+static inline int expand5(int value){ return (value << 3) | (value >> 2); }
+static inline int expand6(int value){ return (value << 2) | (value >> 4); }
+
+static inline void unpack565(int color, int out[3]){
+	out[0] = expand5((color >> 11) & 31);
+	out[1] = expand6((color >> 5) & 63);
+	out[2] = expand5(color & 31);
+}
+
+// For each pixel, where it is on the line from origin along axis :
+// round(dot(pixel - origin, axis) * scale), clamped to 0..maxT
+static void colorProjections(const unsigned char * block, const int origin[3], const int axis[3], float scale, int maxT, int out_t[16]){
+	int base = origin[0] * axis[0] + origin[1] * axis[1] + origin[2] * axis[2];
+#ifdef SIMD_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i axis16 = _mm_setr_epi16((short)axis[0], (short)axis[1], (short)axis[2], 0, (short)axis[0], (short)axis[1], (short)axis[2], 0);
+	const __m128i base4 = _mm_set1_epi32(base), maxT4 = _mm_set1_epi32(maxT);
+	const __m128 scale4 = _mm_set1_ps(scale);
+	for (int i = 0; i < 4; i++){
+		// 4 pixels : r*ar + g*ag and b*ab for each one, then the sums of the pairs
+		__m128i pixels = _mm_loadu_si128((const __m128i *)(block + 16 * i));
+		__m128 low  = _mm_castsi128_ps(_mm_madd_epi16(_mm_unpacklo_epi8(pixels, zero), axis16));
+		__m128 high = _mm_castsi128_ps(_mm_madd_epi16(_mm_unpackhi_epi8(pixels, zero), axis16));
+		__m128i dot = _mm_add_epi32(_mm_castps_si128(_mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0))),
+		                            _mm_castps_si128(_mm_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1))));
+		__m128i t = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(dot, base4)), scale4));
+		// Clamp (no _mm_min_epi32 before SSE4.1)
+		t = _mm_andnot_si128(_mm_srai_epi32(t, 31), t);
+		__m128i over = _mm_cmpgt_epi32(t, maxT4);
+		t = _mm_or_si128(_mm_and_si128(over, maxT4), _mm_andnot_si128(over, t));
+		_mm_storeu_si128((__m128i *)(out_t + 4 * i), t);
+	}
+#else
+	for (int i = 0; i < 16; i++){
+		const unsigned char * p = block + 4 * i;
+		int dot = p[0] * axis[0] + p[1] * axis[1] + p[2] * axis[2] - base;
+		int t = (int)std::floor(dot * scale + 0.5f);
+		out_t[i] = std::min(std::max(t, 0), maxT);
+	}
+#endif
+}
+
+// Same thing for one channel : round((maxValue - value) * scale), clamped to 0..7
+static void channelProjections(const unsigned char * block, int channel, int maxValue, float scale, int out_t[16]){
+#ifdef SIMD_SSE2
+	const __m128i mask = _mm_set1_epi32(0xff), seven = _mm_set1_epi32(7), max4 = _mm_set1_epi32(maxValue);
+	const __m128 scale4 = _mm_set1_ps(scale);
+	for (int i = 0; i < 4; i++){
+		__m128i pixels = _mm_loadu_si128((const __m128i *)(block + 16 * i));
+		__m128i value;
+		switch (channel){ // The shift must be a constant
+		case 0:  value = _mm_and_si128(pixels, mask); break;
+		case 1:  value = _mm_and_si128(_mm_srli_epi32(pixels, 8), mask); break;
+		case 2:  value = _mm_and_si128(_mm_srli_epi32(pixels, 16), mask); break;
+		default: value = _mm_srli_epi32(pixels, 24); break;
+		}
+		__m128i t = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_sub_epi32(max4, value)), scale4));
+		__m128i over = _mm_cmpgt_epi32(t, seven);
+		t = _mm_or_si128(_mm_and_si128(over, seven), _mm_andnot_si128(over, t));
+		_mm_storeu_si128((__m128i *)(out_t + 4 * i), t);
+	}
+#else
+	for (int i = 0; i < 16; i++){
+		int t = (int)std::floor((maxValue - block[4 * i + channel]) * scale + 0.5f);
+		out_t[i] = std::min(t, 7);
+	}
+#endif
+}
+
+// BC1 color block. With allowTransparent, pixels with alpha < 128 use the transparent color.
+static void encodeColorBlock(const unsigned char * block, bool allowTransparent, unsigned char * out){
+	// Bounding box and mean of the colors (of the opaque pixels only, when some are transparent)
+	bool transparent = false;
+	for (int i = 0; i < 16 && allowTransparent; i++)
+		transparent = transparent || block[4 * i + 3] < 128;
+	int lo[3] = { 255, 255, 255 }, hi[3] = { 0, 0, 0 }, sum[3] = { 0, 0, 0 }, count = 0;
+	for (int i = 0; i < 16; i++){
+		if ( transparent && block[4 * i + 3] < 128 )
+			continue;
+		for (int c = 0; c < 3; c++){
+			int value = block[4 * i + c];
+			lo[c] = std::min(lo[c], value);
+			hi[c] = std::max(hi[c], value);
+			sum[c] += value;
+		}
+		count++;
+	}
+	if ( count == 0 ){
+		for (int c = 0; c < 3; c++)
+			lo[c] = hi[c] = 0;
+	}
+
+	// Which diagonal of the box : the channels going the other way than the widest channel
+	// (negative covariance) get their min and max swapped
+	int widest = 0;
+	for (int c = 1; c < 3; c++)
+		if ( hi[c] - lo[c] > hi[widest] - lo[widest] )
+			widest = c;
+	int covariance[3] = { 0, 0, 0 };
+	for (int i = 0; i < 16; i++){
+		if ( transparent && block[4 * i + 3] < 128 )
+			continue;
+		int w = count * block[4 * i + widest] - sum[widest];
+		for (int c = 0; c < 3; c++)
+			covariance[c] += w * (count * block[4 * i + c] - sum[c]);
+	}
+	int end0[3], end1[3];
+	for (int c = 0; c < 3; c++){
+		// Inset the box a little : the extremes are rarely worth an endpoint each
+		int inset = (hi[c] - lo[c]) >> 4;
+		end0[c] = hi[c] - inset;
+		end1[c] = lo[c] + inset;
+		if ( covariance[c] < 0 )
+			std::swap(end0[c], end1[c]);
+	}
+
+	int color0 = (quantize5(end0[0]) << 11) | (quantize6(end0[1]) << 5) | quantize5(end0[2]);
+	int color1 = (quantize5(end1[0]) << 11) | (quantize6(end1[1]) << 5) | quantize5(end1[2]);
+	// color0 > color1 : 4 colors. color0 <= color1 : 3 colors and transparent.
+	if ( (color0 < color1) != transparent )
+		std::swap(color0, color1);
+
+	unsigned int indices = 0;
+	if ( color0 != color1 ){
+		int c0[3], c1[3], axis[3];
+		unpack565(color0, c0);
+		unpack565(color1, c1);
+		for (int c = 0; c < 3; c++)
+			axis[c] = c1[c] - c0[c];
+		int length2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+		int steps = transparent ? 2 : 3;
+		int t[16];
+		colorProjections(block, c0, axis, (float)steps / (float)length2, steps, t);
+		// Steps along the line, to indices : color0, the mixes, then color1
+		static const unsigned int fourColors[4]  = { 0, 2, 3, 1 };
+		static const unsigned int threeColors[3] = { 0, 2, 1 };
+		for (int i = 0; i < 16; i++){
+			unsigned int index = transparent ? threeColors[t[i]] : fourColors[t[i]];
+			if ( transparent && block[4 * i + 3] < 128 )
+				index = 3;
+			indices |= index << (2 * i);
+		}
+	}else if ( transparent ){
+		for (int i = 0; i < 16; i++)
+			if ( block[4 * i + 3] < 128 )
+				indices |= 3u << (2 * i);
+	}
+
+	out[0] = (unsigned char)(color0 & 0xff);
+	out[1] = (unsigned char)(color0 >> 8);
+	out[2] = (unsigned char)(color1 & 0xff);
+	out[3] = (unsigned char)(color1 >> 8);
+	for (int k = 0; k < 4; k++)
+		out[4 + k] = (unsigned char)(indices >> (8 * k));
+}
+
+// BC4 block, for one channel of the pixels
+static void encodeChannelBlock(const unsigned char * block, int channel, unsigned char * out){
+	int lo = 255, hi = 0;
+	for (int i = 0; i < 16; i++){
+		lo = std::min(lo, (int)block[4 * i + channel]);
+		hi = std::max(hi, (int)block[4 * i + channel]);
+	}
+	// value0 > value1 : the 6 values between them are interpolated
+	out[0] = (unsigned char)hi;
+	out[1] = (unsigned char)lo;
+	unsigned long long indices = 0;
+	if ( hi > lo ){
+		int t[16];
+		channelProjections(block, channel, hi, 7.0f / (float)(hi - lo), t);
+		// Steps from value0 to value1, to indices
+		static const unsigned int eightValues[8] = { 0, 2, 3, 4, 5, 6, 7, 1 };
+		for (int i = 0; i < 16; i++)
+			indices |= (unsigned long long)eightValues[t[i]] << (3 * i);
+	}
+	for (int k = 0; k < 6; k++)
+		out[2 + k] = (unsigned char)(indices >> (8 * k));
+}
+
+static void decodeColorBlock(const unsigned char * in, bool alwaysFourColors, unsigned char block[64]){
+	int color0 = in[0] | (in[1] << 8), color1 = in[2] | (in[3] << 8);
+	int palette[4][4];
+	unpack565(color0, palette[0]);
+	unpack565(color1, palette[1]);
+	palette[0][3] = palette[1][3] = 255;
+	for (int c = 0; c < 3; c++){
+		if ( color0 > color1 || alwaysFourColors ){
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}else{
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+	}
+	palette[2][3] = 255;
+	palette[3][3] = ( color0 > color1 || alwaysFourColors ) ? 255 : 0;
+	unsigned int indices = in[4] | (in[5] << 8) | (in[6] << 16) | ((unsigned int)in[7] << 24);
+	for (int i = 0; i < 16; i++){
+		const int * color = palette[(indices >> (2 * i)) & 3];
+		for (int c = 0; c < 4; c++)
+			block[4 * i + c] = (unsigned char)color[c];
+	}
+}
+
+static void decodeChannelBlock(const unsigned char * in, int channel, unsigned char block[64]){
+	int palette[8];
+	palette[0] = in[0];
+	palette[1] = in[1];
+	if ( palette[0] > palette[1] ){
+		for (int k = 1; k < 7; k++)
+			palette[k + 1] = ((7 - k) * palette[0] + k * palette[1]) / 7;
+	}else{
+		for (int k = 1; k < 5; k++)
+			palette[k + 1] = ((5 - k) * palette[0] + k * palette[1]) / 5;
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+	unsigned long long indices = 0;
+	for (int k = 0; k < 6; k++)
+		indices |= (unsigned long long)in[2 + k] << (8 * k);
+	for (int i = 0; i < 16; i++)
+		block[4 * i + channel] = (unsigned char)palette[(indices >> (3 * i)) & 7];
+}
+
+void compressImage(BlockFormat format, const unsigned char * rgba, unsigned int width, unsigned int height, unsigned char * out_blocks){
+	size_t blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	size_t blockSize = bytesPerBlock(format);
+	parallelFor(blocksY, threadCount(blocksX * blocksY, BLOCKS_GRAIN), [&](size_t begin, size_t end){
+		unsigned char block[64];
+		for (size_t by = begin; by < end; by++){
+			for (size_t bx = 0; bx < blocksX; bx++){
+				unsigned char * out = out_blocks + (by * blocksX + bx) * blockSize;
+				loadBlock(rgba, width, height, (unsigned int)bx, (unsigned int)by, block);
+				switch (format){
+				case BLOCK_BC1: encodeColorBlock(block, true, out); break;
+				case BLOCK_BC3: encodeChannelBlock(block, 3, out); encodeColorBlock(block, false, out + 8); break;
+				case BLOCK_BC4: encodeChannelBlock(block, 0, out); break;
+				case BLOCK_BC5: encodeChannelBlock(block, 0, out); encodeChannelBlock(block, 1, out + 8); break;
+				}
+			}
+		}
+	});
+}
+
+void decompressImage(BlockFormat format, const unsigned char * blocks, unsigned int width, unsigned int height, unsigned char * out_rgba){
+	size_t blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	size_t blockSize = bytesPerBlock(format);
+	parallelFor(blocksY, threadCount(blocksX * blocksY, BLOCKS_GRAIN), [&](size_t begin, size_t end){
+		unsigned char block[64];
+		for (size_t by = begin; by < end; by++){
+			for (size_t bx = 0; bx < blocksX; bx++){
+				const unsigned char * in = blocks + (by * blocksX + bx) * blockSize;
+				switch (format){
+				case BLOCK_BC1: decodeColorBlock(in, false, block); break;
+				case BLOCK_BC3: decodeColorBlock(in + 8, true, block); decodeChannelBlock(in, 3, block); break;
+				case BLOCK_BC4:
+				case BLOCK_BC5:
+					for (int i = 0; i < 16; i++){
+						block[4 * i + 1] = block[4 * i + 2] = 0;
+						block[4 * i + 3] = 255;
+					}
+					decodeChannelBlock(in, 0, block);
+					if ( format == BLOCK_BC5 )
+						decodeChannelBlock(in + 8, 1, block);
+					break;
+				}
+				// Only the pixels which are in the image
+				for (size_t y = 0; y < 4 && by * 4 + y < height; y++){
+					size_t columns = std::min((size_t)4, width - bx * 4);
+					memcpy(out_rgba + ((by * 4 + y) * width + bx * 4) * 4, block + 16 * y, columns * 4);
+				}
+			}
+		}
+	});
+}
@@ -0,0 +1,38 @@
+#ifndef TEXTURECOMPRESSION_HPP
+#define TEXTURECOMPRESSION_HPP
+
+#include <stddef.h>
+
+// Block compression (BCn / DXTn) on the CPU : the GPU formats which keep textures 4 to 8 times
+// smaller in video memory. Images are cut in blocks of 4x4 pixels, each block becomes :
+//  - BC1 (DXT1) : 8 bytes. 2 colors in 565, and 2 bits per pixel to pick between them and 2 mixes.
+//                 Pixels with alpha < 128 become transparent (black).
+//  - BC3 (DXT5) : 16 bytes. BC1's colors, and the alpha like BC4.
+//  - BC4 (ATI1) : 8 bytes. The red channel only : 2 values, and 3 bits per pixel.
+//  - BC5 (ATI2) : 16 bytes. Red and green, each one like BC4 : for normal maps (z is
+//                 sqrt(1 - x*x - y*y), see tutorial13's fragment shader).
+// The encoder is the fast kind (endpoints from the bounding box of the block, slightly inset,
+// and pixels projected on the line between them, with SSE), meant to run at load time. The
+// decoder gives back what the GPU would show : to check the encoder, or where the GPU can't.
+// Both split the image between several threads.
+
+enum BlockFormat{
+	BLOCK_BC1,
+	BLOCK_BC3,
+	BLOCK_BC4,
+	BLOCK_BC5,
+};
+
+// Bytes for a whole image of width x height pixels (rounded up to whole blocks)
+size_t compressedSize(BlockFormat format, unsigned int width, unsigned int height);
+
+// rgba : width * height pixels of 4 bytes, rows one after the other, top row first or not
+// (the blocks follow the rows of the image). Images which aren't a multiple of 4 pixels are fine :
+// the last pixel of each row and column is repeated to fill the blocks.
+// out_blocks must have compressedSize() bytes.
+void compressImage(BlockFormat format, const unsigned char * rgba, unsigned int width, unsigned int height, unsigned char * out_blocks);
+
+// Back to width * height RGBA pixels. BC4 gives (r, 0, 0, 255), and BC5 (r, g, 0, 255), like OpenGL.
+void decompressImage(BlockFormat format, const unsigned char * blocks, unsigned int width, unsigned int height, unsigned char * out_rgba);
+
+#endif
@@ -1,12 +1,12 @@
 #include <vector>
-#include <map>
+#include <limits>
+#include <stdio.h>
 
 #include <glm/glm.hpp>
 
+#include "vertexhash.hpp"
 #include "vboindexer.hpp"
 
-#include <string.h> // for memcmp
-
 
 // Returns true iif v1 can be considered equal to v2
 bool is_near(float v1, float v2){
@@ -16,14 +16,14 @@ bool is_near(float v1, float v2){
 // Searches through all already-exported vertices
 // for a similar one.
 // Similar = same position + same UVs + same normal
-bool getSimilarVertexIndex( 
-	glm::vec3 & in_vertex, 
-	glm::vec2 & in_uv, 
-	glm::vec3 & in_normal, 
+bool getSimilarVertexIndex(
+	glm::vec3 & in_vertex,
+	glm::vec2 & in_uv,
+	glm::vec3 & in_normal,
 	std::vector<glm::vec3> & out_vertices,
 	std::vector<glm::vec2> & out_uvs,
 	std::vector<glm::vec3> & out_normals,
-	unsigned short & result
+	unsigned int & result
 ){
 	// Lame linear search
 	for ( unsigned int i=0; i<out_vertices.size(); i++ ){
@@ -46,132 +46,330 @@ bool getSimilarVertexIndex(
 	return false;
 }
 
-void indexVBO_slow(
+// Returns false (and complains) if a vertex count doesn't fit in T_INDEX.
+// Without this check, the 65536th vertex of a mesh would silently become vertex 0.
+// Called before the vertex is added : on failure, nothing half-done is left in the outputs.
+template <typename T_INDEX>
+static bool checkIndexRange(size_t vertex_count){
+	if ( vertex_count - 1 > (size_t)std::numeric_limits<T_INDEX>::max() ){
+		printf("Too many vertices (%u) for %u-bit indices. Use 32-bit indices instead.\n", (unsigned int)vertex_count, (unsigned int)(8*sizeof(T_INDEX)));
+		return false;
+	}
+	return true;
+}
+
+// The outputs as they were given : on failure, they go back to that, as if nothing happened
+// (they may already hold another mesh, which the new one was appended to)
+template <typename T_INDEX>
+struct IndexerOutputSizes{
+	size_t indices, vertices;
+
+	IndexerOutputSizes(const std::vector<T_INDEX> & out_indices, const std::vector<glm::vec3> & out_vertices)
+		: indices(out_indices.size()), vertices(out_vertices.size()) {}
+
+	void restore(std::vector<T_INDEX> & out_indices, std::vector<glm::vec3> & out_vertices,
+	             std::vector<glm::vec2> & out_uvs, std::vector<glm::vec3> & out_normals) const {
+		out_indices.resize(indices);
+		out_vertices.resize(vertices);
+		out_uvs.resize(vertices);
+		out_normals.resize(vertices);
+	}
+};
+
+template <typename T_INDEX>
+bool indexVBO_slow(
 	std::vector<glm::vec3> & in_vertices,
 	std::vector<glm::vec2> & in_uvs,
 	std::vector<glm::vec3> & in_normals,
 
-	std::vector<unsigned short> & out_indices,
+	std::vector<T_INDEX> & out_indices,
 	std::vector<glm::vec3> & out_vertices,
 	std::vector<glm::vec2> & out_uvs,
 	std::vector<glm::vec3> & out_normals
 ){
+	IndexerOutputSizes<T_INDEX> entry(out_indices, out_vertices);
+
 	// For each input vertex
 	for ( unsigned int i=0; i<in_vertices.size(); i++ ){
 
 		// Try to find a similar vertex in out_XXXX
-		unsigned short index;
+		unsigned int index;
 		bool found = getSimilarVertexIndex(in_vertices[i], in_uvs[i], in_normals[i],     out_vertices, out_uvs, out_normals, index);
 
 		if ( found ){ // A similar vertex is already in the VBO, use it instead !
-			out_indices.push_back( index );
+			out_indices.push_back( (T_INDEX)index );
 		}else{ // If not, it needs to be added in the output data.
+			if ( !checkIndexRange<T_INDEX>(out_vertices.size() + 1) ){
+				entry.restore(out_indices, out_vertices, out_uvs, out_normals);
+				return false;
+			}
 			out_vertices.push_back( in_vertices[i]);
 			out_uvs     .push_back( in_uvs[i]);
 			out_normals .push_back( in_normals[i]);
-			out_indices .push_back( (unsigned short)out_vertices.size() - 1 );
+			out_indices .push_back( (T_INDEX)(out_vertices.size() - 1) );
 		}
 	}
+	return true;
 }
 
 struct PackedVertex{
 	glm::vec3 position;
 	glm::vec2 uv;
 	glm::vec3 normal;
-	bool operator<(const PackedVertex that) const{
-		return memcmp((void*)this, (void*)&that, sizeof(PackedVertex))>0;
-	};
 };
 
-bool getSimilarVertexIndex_fast( 
-	PackedVertex & packed, 
-	std::map<PackedVertex,unsigned short> & VertexToOutIndex,
-	unsigned short & result
-){
-	std::map<PackedVertex,unsigned short>::iterator it = VertexToOutIndex.find(packed);
-	if ( it == VertexToOutIndex.end() ){
-		return false;
-	}else{
-		result = it->second;
-		return true;
-	}
-}
-
-void indexVBO(
+template <typename T_INDEX>
+bool indexVBO(
 	std::vector<glm::vec3> & in_vertices,
 	std::vector<glm::vec2> & in_uvs,
 	std::vector<glm::vec3> & in_normals,
 
-	std::vector<unsigned short> & out_indices,
+	std::vector<T_INDEX> & out_indices,
 	std::vector<glm::vec3> & out_vertices,
 	std::vector<glm::vec2> & out_uvs,
-	std::vector<glm::vec3> & out_normals
+	std::vector<glm::vec3> & out_normals,
+
+	VertexHashStats * stats
 ){
-	std::map<PackedVertex,unsigned short> VertexToOutIndex;
+	// In the worst case, every input vertex is unique.
+	// Sizing the table for that means it never has to grow.
+	VertexHashTable<PackedVertex> VertexToOutIndex( in_vertices.size() );
+
+	IndexerOutputSizes<T_INDEX> entry(out_indices, out_vertices);
+	out_indices.reserve( out_indices.size() + in_vertices.size() );
+
+	bool ok = true;
 
 	// For each input vertex
 	for ( unsigned int i=0; i<in_vertices.size(); i++ ){
 
 		PackedVertex packed = {in_vertices[i], in_uvs[i], in_normals[i]};
-		
 
-		// Try to find a similar vertex in out_XXXX
-		unsigned short index;
-		bool found = getSimilarVertexIndex_fast( packed, VertexToOutIndex, index);
+		// Try to find a similar vertex in out_XXXX.
+		// If there is none, the current vertex will be given the next index.
+		unsigned int index;
+		bool found = VertexToOutIndex.findOrInsert( packed, (unsigned int)out_vertices.size(), index );
 
 		if ( found ){ // A similar vertex is already in the VBO, use it instead !
-			out_indices.push_back( index );
+			out_indices.push_back( (T_INDEX)index );
 		}else{ // If not, it needs to be added in the output data.
+			if ( !checkIndexRange<T_INDEX>(out_vertices.size() + 1) ){
+				entry.restore(out_indices, out_vertices, out_uvs, out_normals);
+				ok = false;
+				break;
+			}
 			out_vertices.push_back( in_vertices[i]);
 			out_uvs     .push_back( in_uvs[i]);
 			out_normals .push_back( in_normals[i]);
-			unsigned short newindex = (unsigned short)out_vertices.size() - 1;
+			T_INDEX newindex = (T_INDEX)(out_vertices.size() - 1);
 			out_indices .push_back( newindex );
-			VertexToOutIndex[ packed ] = newindex;
 		}
 	}
+
+	if ( stats )
+		*stats = VertexToOutIndex.stats;
+	return ok;
+}
+
+bool indexVBO_auto(
+	std::vector<glm::vec3> & in_vertices,
+	std::vector<glm::vec2> & in_uvs,
+	std::vector<glm::vec3> & in_normals,
+
+	MeshIndices & out_indices,
+	std::vector<glm::vec3> & out_vertices,
+	std::vector<glm::vec2> & out_uvs,
+	std::vector<glm::vec3> & out_normals
+){
+	// Weld with 32-bit indices, since we don't know yet how many vertices we'll get...
+	out_indices.indices16.clear();
+	out_indices.indices32.clear();
+	out_indices.use32bits = true;
+	if ( !indexVBO(in_vertices, in_uvs, in_normals, out_indices.indices32, out_vertices, out_uvs, out_normals) )
+		return false;
+
+	// ... and go back to 16 bits if they are enough : half the index bandwidth.
+	if ( out_vertices.size() <= 65536 ){
+		out_indices.indices16.assign( out_indices.indices32.begin(), out_indices.indices32.end() );
+		std::vector<unsigned int>().swap( out_indices.indices32 );
+		out_indices.use32bits = false;
+	}
+	return true;
 }
 
 
 
+// Same search as getSimilarVertexIndex, but only looks at the vertices which are close enough to matter.
+// Space is cut into cubic cells twice as big as the is_near() tolerance, so that a similar vertex
+// is always in the same cell or in one of the 7 neighbour cells on the closest sides.
+// Each cell keeps the list of its vertices, in increasing order, so the first similar vertex
+// in a cell is the lowest one; the lowest of the 27 cells is what the linear search returns.
+class SimilarVertexGrid{
+public:
+	SimilarVertexGrid(size_t expected_vertices) : CellToIndex(expected_vertices) {}
 
+	bool find(
+		glm::vec3 & in_vertex,
+		glm::vec2 & in_uv,
+		glm::vec3 & in_normal,
+		std::vector<glm::vec3> & out_vertices,
+		std::vector<glm::vec2> & out_uvs,
+		std::vector<glm::vec3> & out_normals,
+		unsigned int & result
+	){
+		Cell c;
+		if ( !getCell(in_vertex, c) )
+			return false; // NaN or infinite : is_near() is never true
 
+		// A similar vertex is at most half a cell away, so on each axis, only the neighbour
+		// on the closest side can contain one (both sides if we're right in the middle)
+		int lo[3], hi[3];
+		int cellcoords[3] = { c.x, c.y, c.z };
+		for (int k=0; k<3; k++){
+			double f = (double)in_vertex[k] / cellSize() - (double)cellcoords[k];
+			lo[k] = f < 0.51 ? -1 : 0;
+			hi[k] = f > 0.49 ?  1 : 0;
+		}
+
+		bool found = false;
+		for (int dx=lo[0]; dx<=hi[0]; dx++)
+		for (int dy=lo[1]; dy<=hi[1]; dy++)
+		for (int dz=lo[2]; dz<=hi[2]; dz++){
+			Cell neighbour = { c.x+dx, c.y+dy, c.z+dz };
+			unsigned int cell;
+			if ( !CellToIndex.find(neighbour, cell) )
+				continue;
+			for ( unsigned int i = cellFirst[cell]; i != NONE && (!found || i < result); i = next[i] ){
+				if (
+					is_near( in_vertex.x , out_vertices[i].x ) &&
+					is_near( in_vertex.y , out_vertices[i].y ) &&
+					is_near( in_vertex.z , out_vertices[i].z ) &&
+					is_near( in_uv.x     , out_uvs     [i].x ) &&
+					is_near( in_uv.y     , out_uvs     [i].y ) &&
+					is_near( in_normal.x , out_normals [i].x ) &&
+					is_near( in_normal.y , out_normals [i].y ) &&
+					is_near( in_normal.z , out_normals [i].z )
+				){
+					result = i;
+					found = true;
+					break;
+				}
+			}
+		}
+		return found;
+	}
+
+	// Registers the vertex which was just added at the end of out_vertices
+	void add(glm::vec3 & vertex, unsigned int index){
+		if ( next.size() <= index )
+			next.resize(index+1, NONE);
+		Cell c;
+		if ( !getCell(vertex, c) )
+			return;
+		unsigned int cell;
+		if ( CellToIndex.findOrInsert(c, (unsigned int)cellFirst.size(), cell) ){
+			next[ cellLast[cell] ] = index;
+			cellLast[cell] = index;
+		}else{
+			cellFirst.push_back(index);
+			cellLast .push_back(index);
+		}
+	}
 
+private:
+	enum { NONE = 0xFFFFFFFFu };
+	static double cellSize(){ return 2.0*0.01; }
 
-void indexVBO_TBN(
+	struct Cell{
+		int x, y, z;
+	};
+
+	static bool getCell(const glm::vec3 & v, Cell & c){
+		int * coords[3] = { &c.x, &c.y, &c.z };
+		for (int k=0; k<3; k++){
+			double scaled = floor( (double)v[k] / cellSize() );
+			if ( scaled != scaled || fabs(v[k]) == std::numeric_limits<float>::infinity() )
+				return false;
+			// Very far away vertices all end up in the border cells. It's slower, but still correct.
+			if ( scaled < -1e9 ) scaled = -1e9;
+			if ( scaled >  1e9 ) scaled =  1e9;
+			*coords[k] = (int)scaled;
+		}
+		return true;
+	}
+
+	VertexHashTable<Cell> CellToIndex;
+	std::vector<unsigned int> cellFirst, cellLast; // first and last vertex of each cell
+	std::vector<unsigned int> next;                // next vertex in the same cell, or NONE
+};
+
+template <typename T_INDEX>
+bool indexVBO_TBN(
 	std::vector<glm::vec3> & in_vertices,
 	std::vector<glm::vec2> & in_uvs,
 	std::vector<glm::vec3> & in_normals,
 	std::vector<glm::vec3> & in_tangents,
 	std::vector<glm::vec3> & in_bitangents,
 
-	std::vector<unsigned short> & out_indices,
+	std::vector<T_INDEX> & out_indices,
 	std::vector<glm::vec3> & out_vertices,
 	std::vector<glm::vec2> & out_uvs,
 	std::vector<glm::vec3> & out_normals,
 	std::vector<glm::vec3> & out_tangents,
 	std::vector<glm::vec3> & out_bitangents
 ){
+	IndexerOutputSizes<T_INDEX> entry(out_indices, out_vertices);
+	// The tangents of the vertices which were already there get the ones of their twins added :
+	// kept as they were, for a failure. Nearly always empty.
+	std::vector<glm::vec3> entry_tangents(out_tangents), entry_bitangents(out_bitangents);
+
+	// Same result as getSimilarVertexIndex(), but O(n) instead of O(n^2)
+	SimilarVertexGrid grid( in_vertices.size() );
+	for ( unsigned int i=0; i<out_vertices.size(); i++ )
+		grid.add( out_vertices[i], i );
+
 	// For each input vertex
 	for ( unsigned int i=0; i<in_vertices.size(); i++ ){
 
 		// Try to find a similar vertex in out_XXXX
-		unsigned short index;
-		bool found = getSimilarVertexIndex(in_vertices[i], in_uvs[i], in_normals[i],     out_vertices, out_uvs, out_normals, index);
+		unsigned int index;
+		bool found = grid.find(in_vertices[i], in_uvs[i], in_normals[i],     out_vertices, out_uvs, out_normals, index);
 
 		if ( found ){ // A similar vertex is already in the VBO, use it instead !
-			out_indices.push_back( index );
+			out_indices.push_back( (T_INDEX)index );
 
 			// Average the tangents and the bitangents
 			out_tangents[index] += in_tangents[i];
 			out_bitangents[index] += in_bitangents[i];
 		}else{ // If not, it needs to be added in the output data.
+			if ( !checkIndexRange<T_INDEX>(out_vertices.size() + 1) ){
+				entry.restore(out_indices, out_vertices, out_uvs, out_normals);
+				out_tangents.swap(entry_tangents);
+				out_bitangents.swap(entry_bitangents);
+				return false;
+			}
 			out_vertices.push_back( in_vertices[i]);
 			out_uvs     .push_back( in_uvs[i]);
 			out_normals .push_back( in_normals[i]);
 			out_tangents .push_back( in_tangents[i]);
 			out_bitangents .push_back( in_bitangents[i]);
-			out_indices .push_back( (unsigned short)out_vertices.size() - 1 );
+			out_indices .push_back( (T_INDEX)(out_vertices.size() - 1) );
+			grid.add( out_vertices.back(), (unsigned int)(out_vertices.size() - 1) );
 		}
 	}
+	return true;
 }
+
+
+// The templates are defined here, so we have to instantiate them for the index types that OpenGL accepts.
+// (GL_UNSIGNED_BYTE indices are not worth it)
+#define INSTANTIATE_INDEXVBO(T_INDEX) \
+	template bool indexVBO_slow<T_INDEX>(std::vector<glm::vec3> &, std::vector<glm::vec2> &, std::vector<glm::vec3> &, \
+		std::vector<T_INDEX> &, std::vector<glm::vec3> &, std::vector<glm::vec2> &, std::vector<glm::vec3> &); \
+	template bool indexVBO<T_INDEX>(std::vector<glm::vec3> &, std::vector<glm::vec2> &, std::vector<glm::vec3> &, \
+		std::vector<T_INDEX> &, std::vector<glm::vec3> &, std::vector<glm::vec2> &, std::vector<glm::vec3> &, VertexHashStats *); \
+	template bool indexVBO_TBN<T_INDEX>(std::vector<glm::vec3> &, std::vector<glm::vec2> &, std::vector<glm::vec3> &, std::vector<glm::vec3> &, std::vector<glm::vec3> &, \
+		std::vector<T_INDEX> &, std::vector<glm::vec3> &, std::vector<glm::vec2> &, std::vector<glm::vec3> &, std::vector<glm::vec3> &, std::vector<glm::vec3> &);
+
+INSTANTIATE_INDEXVBO(unsigned short)
+INSTANTIATE_INDEXVBO(unsigned int)
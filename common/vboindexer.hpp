@@ -1,26 +1,53 @@
 #ifndef VBOINDEXER_HPP
 #define VBOINDEXER_HPP
 
-void indexVBO(
+struct VertexHashStats; // see vertexhash.hpp
+
+// All the indexers are templated on the index type, like TriangleDiscreteCoordinates<T_INDEX>.
+// They are instantiated for unsigned short (GL_UNSIGNED_SHORT) and unsigned int (GL_UNSIGNED_INT).
+// They return false if the mesh has more vertices than T_INDEX can address, with the outputs
+// as they were before the call.
+
+// Merges vertices which have exactly the same position, UV and normal.
+// Uses a hash table, so this is O(n). If stats is not NULL, it receives
+// the number of lookups, probes and collisions of the hash table.
+template <typename T_INDEX>
+bool indexVBO(
+	std::vector<glm::vec3> & in_vertices,
+	std::vector<glm::vec2> & in_uvs,
+	std::vector<glm::vec3> & in_normals,
+
+	std::vector<T_INDEX> & out_indices,
+	std::vector<glm::vec3> & out_vertices,
+	std::vector<glm::vec2> & out_uvs,
+	std::vector<glm::vec3> & out_normals,
+
+	VertexHashStats * stats = NULL
+);
+
+// Same thing, but merges vertices which are only approximately equal. O(n^2).
+template <typename T_INDEX>
+bool indexVBO_slow(
 	std::vector<glm::vec3> & in_vertices,
 	std::vector<glm::vec2> & in_uvs,
 	std::vector<glm::vec3> & in_normals,
 
-	std::vector<unsigned short> & out_indices,
+	std::vector<T_INDEX> & out_indices,
 	std::vector<glm::vec3> & out_vertices,
 	std::vector<glm::vec2> & out_uvs,
 	std::vector<glm::vec3> & out_normals
 );
 
 
-void indexVBO_TBN(
+template <typename T_INDEX>
+bool indexVBO_TBN(
 	std::vector<glm::vec3> & in_vertices,
 	std::vector<glm::vec2> & in_uvs,
 	std::vector<glm::vec3> & in_normals,
 	std::vector<glm::vec3> & in_tangents,
 	std::vector<glm::vec3> & in_bitangents,
 
-	std::vector<unsigned short> & out_indices,
+	std::vector<T_INDEX> & out_indices,
 	std::vector<glm::vec3> & out_vertices,
 	std::vector<glm::vec2> & out_uvs,
 	std::vector<glm::vec3> & out_normals,
@@ -28,4 +55,32 @@ void indexVBO_TBN(
 	std::vector<glm::vec3> & out_bitangents
 );
 
-#endif
\ No newline at end of file
+
+// Index buffer which is 16-bit when the mesh is small enough, and 32-bit otherwise.
+// Only one of the two vectors is filled. Draw it with
+// glDrawElements(GL_TRIANGLES, indices.size(), indices.use32bits ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT, (void*)0);
+struct MeshIndices{
+	std::vector<unsigned short> indices16;
+	std::vector<unsigned int>   indices32;
+	bool use32bits;
+
+	MeshIndices() : use32bits(false) {}
+	size_t size() const { return use32bits ? indices32.size() : indices16.size(); }
+	size_t elementSize() const { return use32bits ? sizeof(unsigned int) : sizeof(unsigned short); }
+	const void * data() const { return use32bits ? (const void*)indices32.data() : (const void*)indices16.data(); }
+	unsigned int operator[](size_t i) const { return use32bits ? indices32[i] : indices16[i]; }
+};
+
+// Same as indexVBO, but picks the smallest index type that fits.
+bool indexVBO_auto(
+	std::vector<glm::vec3> & in_vertices,
+	std::vector<glm::vec2> & in_uvs,
+	std::vector<glm::vec3> & in_normals,
+
+	MeshIndices & out_indices,
+	std::vector<glm::vec3> & out_vertices,
+	std::vector<glm::vec2> & out_uvs,
+	std::vector<glm::vec3> & out_normals
+);
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef VERTEXHASH_HPP
+#define VERTEXHASH_HPP
+
+#include <vector>
+#include <string.h> // for memcmp
+
+// Counters reported by VertexHashTable, to check that the hash behaves.
+// A lookup is one call to findOrInsert(). A probe is one slot we had to look at.
+// A collision is a lookup whose first slot was taken by another key.
+struct VertexHashStats{
+	size_t lookups;
+	size_t probes;
+	size_t collisions;
+};
+
+// Open-addressing (linear probing) hash table, mapping a plain-old-data key
+// to an index in the output VBO.
+// Keys are compared bit by bit with memcmp, exactly like the std::map<PackedVertex,...>
+// used to do, so two vertices are merged if and only if they have the same bytes.
+// The table is sized once from the expected number of keys, so that it never
+// gets more than half full and never needs to rehash in the common case.
+template <typename T_KEY>
+class VertexHashTable{
+public:
+	VertexHashTable(size_t expected_keys){
+		stats.lookups = stats.probes = stats.collisions = 0;
+		count = 0;
+		resize( expected_keys );
+	}
+
+	// If an equal key is already in the table, write its value in result and return true.
+	// If not, insert (key, value) and return false.
+	bool findOrInsert(const T_KEY & key, unsigned int value, unsigned int & result){
+		if ( 2*(count+1) > values.size() )
+			resize( 2*values.size() );
+
+		stats.lookups++;
+		size_t slot = hash(key) & mask;
+		for (size_t probe = 0; ; probe++){
+			stats.probes++;
+			if ( values[slot] == EMPTY ){
+				keys  [slot] = key;
+				values[slot] = value;
+				count++;
+				return false;
+			}
+			if ( memcmp(&keys[slot], &key, sizeof(T_KEY)) == 0 ){
+				result = values[slot];
+				return true;
+			}
+			if ( probe == 0 )
+				stats.collisions++;
+			slot = (slot + 1) & mask;
+		}
+	}
+
+	// Same thing, but never inserts anything : returns false if the key isn't there.
+	bool find(const T_KEY & key, unsigned int & result){
+		stats.lookups++;
+		size_t slot = hash(key) & mask;
+		for (size_t probe = 0; ; probe++){
+			stats.probes++;
+			if ( values[slot] == EMPTY )
+				return false;
+			if ( memcmp(&keys[slot], &key, sizeof(T_KEY)) == 0 ){
+				result = values[slot];
+				return true;
+			}
+			if ( probe == 0 )
+				stats.collisions++;
+			slot = (slot + 1) & mask;
+		}
+	}
+
+	size_t size() const { return count; }
+
+	// Removes all the keys, but keeps the memory for the next ones
+	void clear(){
+		values.assign(values.size(), (unsigned int)EMPTY);
+		count = 0;
+	}
+
+	VertexHashStats stats;
+
+private:
+	enum { EMPTY = 0xFFFFFFFFu };
+
+	// Hash the key 32 bits at a time (MurmurHash2 mixing).
+	// All our keys are made of floats and ints, so their size is a multiple of 4.
+	static unsigned int hash(const T_KEY & key){
+		const unsigned int m = 0x5bd1e995;
+		const unsigned char * data = (const unsigned char *)&key;
+		unsigned int h = (unsigned int)sizeof(T_KEY);
+		for (size_t i = 0; i + 4 <= sizeof(T_KEY); i += 4){
+			unsigned int k;
+			memcpy(&k, data + i, 4);
+			k *= m;
+			k ^= k >> 24;
+			k *= m;
+			h *= m;
+			h ^= k;
+		}
+		h ^= h >> 13;
+		h *= m;
+		h ^= h >> 15;
+		return h;
+	}
+
+	void resize(size_t expected_keys){
+		// Power of two, at least twice the number of keys : load factor <= 0.5
+		size_t capacity = 16;
+		while ( capacity < 2*expected_keys )
+			capacity *= 2;
+
+		std::vector<T_KEY> old_keys;
+		std::vector<unsigned int> old_values;
+		old_keys.swap(keys);
+		old_values.swap(values);
+
+		keys  .resize(capacity);
+		values.assign(capacity, (unsigned int)EMPTY);
+		mask = capacity - 1;
+
+		for (size_t i = 0; i < old_values.size(); i++){
+			if ( old_values[i] == EMPTY )
+				continue;
+			size_t slot = hash(old_keys[i]) & mask;
+			while ( values[slot] != EMPTY )
+				slot = (slot + 1) & mask;
+			keys  [slot] = old_keys[i];
+			values[slot] = old_values[i];
+		}
+	}
+
+	std::vector<T_KEY> keys;
+	std::vector<unsigned int> values;
+	size_t mask;
+	size_t count;
+};
+
+#endif
@@ -0,0 +1,399 @@
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include <cmath>
+#include <algorithm>
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include "vboindexer.hpp"
+#include "vertexlayout.hpp"
+
+// Bytes taken by `components` values, rounded up to 4 bytes
+static unsigned int packedSize(VertexPacking packing, int components){
+	if ( packing == VERTEX_INT_2_10_10_10 )
+		return 4;
+	if ( packing == VERTEX_OCT16 )
+		components--; // 2 values for the direction (and 1 for the handedness of tangents)
+	unsigned int size = (packing == VERTEX_FLOAT ? 4 : 2) * components;
+	return (size + 3) & ~3u;
+}
+
+static VertexAttribute makeAttribute(unsigned int & offset, VertexPacking packing, int components){
+	VertexAttribute attribute;
+	attribute.offset = offset;
+	attribute.components = packing == VERTEX_INT_2_10_10_10 ? 4 : packing == VERTEX_OCT16 ? components - 1 : components;
+	switch ( packing ){
+		case VERTEX_FLOAT          : attribute.type = GL_FLOAT;               break;
+		case VERTEX_SNORM16        : attribute.type = GL_SHORT;               break;
+		case VERTEX_HALF           : attribute.type = GL_HALF_FLOAT;          break;
+		case VERTEX_UNORM16        : attribute.type = GL_UNSIGNED_SHORT;      break;
+		case VERTEX_OCT16          : attribute.type = GL_SHORT;               break;
+		case VERTEX_INT_2_10_10_10 : attribute.type = GL_INT_2_10_10_10_REV;  break;
+	}
+	attribute.normalized = packing != VERTEX_FLOAT && packing != VERTEX_HALF;
+	offset += packedSize(packing, components);
+	return attribute;
+}
+
+// Unit vectors only
+static bool isDirectionPacking(VertexPacking packing){
+	return packing == VERTEX_SNORM16 || packing == VERTEX_OCT16 || packing == VERTEX_INT_2_10_10_10;
+}
+
+bool makeVertexLayout(VertexPacking positionPacking, VertexPacking normalPacking, VertexPacking uvPacking, bool withTangents, VertexLayout & layout){
+	if ( isDirectionPacking(positionPacking) || isDirectionPacking(uvPacking) ){
+		printf("Positions and UVs can't be packed like unit vectors : use VERTEX_UNORM16 or VERTEX_HALF instead\n");
+		return false;
+	}
+	if ( normalPacking == VERTEX_UNORM16 ){
+		printf("Normals can't be VERTEX_UNORM16 : use VERTEX_SNORM16, VERTEX_OCT16 or VERTEX_INT_2_10_10_10 instead\n");
+		return false;
+	}
+	layout = VertexLayout();
+	layout.positionPacking = positionPacking;
+	layout.normalPacking = normalPacking;
+	layout.uvPacking = uvPacking;
+	layout.hasTangents = withTangents;
+	layout.positionOffset = glm::vec3(0.0f);
+	layout.positionScale  = glm::vec3(1.0f);
+	layout.uvOffset = glm::vec2(0.0f);
+	layout.uvScale  = glm::vec2(1.0f);
+
+	unsigned int offset = 0;
+	layout.position = makeAttribute(offset, positionPacking, 3);
+	layout.normal   = makeAttribute(offset, normalPacking,   3);
+	layout.uv       = makeAttribute(offset, uvPacking,       2);
+	if ( withTangents )
+		layout.tangent = makeAttribute(offset, normalPacking, 4);
+	layout.stride = offset;
+	return true;
+}
+
+// Bounding box of an array, as an offset and a scale. A flat box gets a scale of 1 on that axis,
+// so that nothing divides by 0.
+template <typename T>
+static void computeBounds(const std::vector<T> & values, T & offset, T & scale){
+	if ( values.empty() ){
+		offset = T(0.0f);
+		scale  = T(1.0f);
+		return;
+	}
+	T minimum = values[0], maximum = values[0];
+	for (size_t i = 1; i < values.size(); i++){
+		minimum = glm::min(minimum, values[i]);
+		maximum = glm::max(maximum, values[i]);
+	}
+	offset = minimum;
+	scale  = maximum - minimum;
+	for (int c = 0; c < (int)scale.length(); c++)
+		if ( !(scale[c] > 0.0f) )
+			scale[c] = 1.0f;
+}
+
+void computeQuantizationBounds(VertexLayout & layout, const std::vector<glm::vec3> & vertices, const std::vector<glm::vec2> & uvs){
+	if ( layout.positionPacking == VERTEX_UNORM16 )
+		computeBounds(vertices, layout.positionOffset, layout.positionScale);
+	if ( layout.uvPacking == VERTEX_UNORM16 )
+		computeBounds(uvs, layout.uvOffset, layout.uvScale);
+}
+
+// Scalars : positions and UVs. offset and scale are only used by VERTEX_UNORM16.
+static void packValues(unsigned char * destination, VertexPacking packing, const float * values, int count, const float * offset, const float * scale){
+	for (int i = 0; i < count; i++){
+		if ( packing == VERTEX_FLOAT ){
+			memcpy(destination + 4*i, &values[i], 4);
+		}else{
+			glm::uint16 packed;
+			if ( packing == VERTEX_UNORM16 )
+				packed = glm::packUnorm1x16( (values[i] - offset[i]) / scale[i] );
+			else
+				packed = packing == VERTEX_SNORM16 ? glm::packSnorm1x16(values[i]) : glm::packHalf1x16(values[i]);
+			memcpy(destination + 2*i, &packed, 2);
+		}
+	}
+}
+
+static void unpackValues(const unsigned char * source, VertexPacking packing, float * values, int count, const float * offset, const float * scale){
+	for (int i = 0; i < count; i++){
+		if ( packing == VERTEX_FLOAT ){
+			memcpy(&values[i], source + 4*i, 4);
+		}else{
+			glm::uint16 packed;
+			memcpy(&packed, source + 2*i, 2);
+			if ( packing == VERTEX_UNORM16 )
+				values[i] = offset[i] + glm::unpackUnorm1x16(packed) * scale[i];
+			else
+				values[i] = packing == VERTEX_SNORM16 ? glm::unpackSnorm1x16(packed) : glm::unpackHalf1x16(packed);
+		}
+	}
+}
+
+// Octahedral mapping : the unit sphere is projected on the octahedron |x|+|y|+|z| = 1,
+// whose lower half is folded over the upper one, which is then flattened on the [-1,1] square.
+// Every direction gets about the same precision, so 2 values are enough.
+static glm::vec2 octWrap(const glm::vec2 & v){
+	return (1.0f - glm::abs(glm::vec2(v.y, v.x))) * glm::vec2(v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f);
+}
+
+// In GLSL, the same thing :
+//   vec3 n = vec3(oct, 1.0 - abs(oct.x) - abs(oct.y));
+//   if ( n.z < 0.0 ) n.xy = (1.0 - abs(n.yx)) * sign(n.xy); // (with sign(0) = 1)
+//   n = normalize(n);
+static glm::vec3 octDecode(const glm::vec2 & oct){
+	glm::vec3 n(oct.x, oct.y, 1.0f - std::fabs(oct.x) - std::fabs(oct.y));
+	if ( n.z < 0.0f ){
+		glm::vec2 xy = octWrap(glm::vec2(n.x, n.y));
+		n.x = xy.x;
+		n.y = xy.y;
+	}
+	return glm::normalize(n);
+}
+
+// Rounding each coordinate to the nearest 16-bit value isn't always the closest direction :
+// tries the 4 neighbours and keeps the best one.
+static void octEncode(const glm::vec3 & v, glm::int16 packed[2]){
+	packed[0] = packed[1] = 0;
+	float sum = std::fabs(v.x) + std::fabs(v.y) + std::fabs(v.z);
+	if ( !(sum > 0.0f) )
+		return;
+	glm::vec3 n = v / sum;
+	glm::vec2 oct(n.x, n.y);
+	if ( n.z < 0.0f )
+		oct = octWrap(oct);
+
+	glm::vec3 direction = glm::normalize(v);
+	float best = -2.0f;
+	for (int i = 0; i < 4; i++){
+		float x = i & 1 ? std::ceil(oct.x * 32767.0f) : std::floor(oct.x * 32767.0f);
+		float y = i & 2 ? std::ceil(oct.y * 32767.0f) : std::floor(oct.y * 32767.0f);
+		x = glm::clamp(x, -32767.0f, 32767.0f);
+		y = glm::clamp(y, -32767.0f, 32767.0f);
+		float score = glm::dot(octDecode(glm::vec2(x, y) / 32767.0f), direction);
+		if ( score > best ){
+			best = score;
+			packed[0] = (glm::int16)x;
+			packed[1] = (glm::int16)y;
+		}
+	}
+}
+
+// Unit vectors : normals, and tangents with their handedness in w if hasW
+static void packDirection(unsigned char * destination, VertexPacking packing, const glm::vec4 & direction, bool hasW){
+	int count = hasW ? 4 : 3;
+	if ( packing == VERTEX_INT_2_10_10_10 ){
+		glm::uint32 packed = glm::packSnorm3x10_1x2( hasW ? direction : glm::vec4(glm::vec3(direction), 0.0f) );
+		memcpy(destination, &packed, 4);
+	}else if ( packing == VERTEX_OCT16 ){
+		glm::int16 packed[3];
+		octEncode(glm::vec3(direction), packed);
+		packed[2] = direction.w < 0.0f ? -32767 : 32767;
+		memcpy(destination, packed, hasW ? 6 : 4);
+	}else{
+		packValues(destination, packing, &direction.x, count, NULL, NULL);
+	}
+}
+
+static glm::vec4 unpackDirection(const unsigned char * source, VertexPacking packing, bool hasW){
+	glm::vec4 direction(0.0f);
+	if ( packing == VERTEX_INT_2_10_10_10 ){
+		glm::uint32 packed;
+		memcpy(&packed, source, 4);
+		direction = glm::unpackSnorm3x10_1x2(packed);
+	}else if ( packing == VERTEX_OCT16 ){
+		glm::int16 packed[3] = { 0, 0, 0 };
+		memcpy(packed, source, hasW ? 6 : 4);
+		direction = glm::vec4( octDecode(glm::vec2(packed[0], packed[1]) / 32767.0f), packed[2] / 32767.0f );
+	}else{
+		unpackValues(source, packing, &direction.x, hasW ? 4 : 3, NULL, NULL);
+	}
+	if ( !hasW )
+		direction.w = 0.0f;
+	return direction;
+}
+
+// Normalized integers can only hold [-1, 1], and the shader normalizes anyway
+static glm::vec3 prepareDirection(const glm::vec3 & v, VertexPacking packing){
+	if ( !isDirectionPacking(packing) )
+		return v;
+	float length = glm::length(v);
+	return length > 0.0f ? v / length : v;
+}
+
+// +1 if (tangent, bitangent, normal) is right-handed, -1 if the UVs are mirrored
+static float handedness(const glm::vec3 & normal, const glm::vec3 & tangent, const glm::vec3 & bitangent){
+	return glm::dot(glm::cross(normal, tangent), bitangent) < 0.0f ? -1.0f : 1.0f;
+}
+
+void buildInterleavedVertices(
+	VertexLayout & layout,
+	const std::vector<glm::vec3> & vertices,
+	const std::vector<glm::vec2> & uvs,
+	const std::vector<glm::vec3> & normals,
+	const std::vector<glm::vec3> * tangents,
+	const std::vector<glm::vec3> * bitangents,
+	std::vector<unsigned char> & out_interleaved
+){
+	computeQuantizationBounds(layout, vertices, uvs);
+	out_interleaved.assign(vertices.size() * layout.stride, 0); // Zeros in the padding
+
+	for (size_t i = 0; i < vertices.size(); i++){
+		unsigned char * vertex = &out_interleaved[i * layout.stride];
+		glm::vec3 normal = prepareDirection(normals[i], layout.normalPacking);
+		packValues(vertex + layout.position.offset, layout.positionPacking, &vertices[i].x, 3, &layout.positionOffset.x, &layout.positionScale.x);
+		packValues(vertex + layout.uv.offset,       layout.uvPacking,       &uvs[i].x,      2, &layout.uvOffset.x,       &layout.uvScale.x);
+		packDirection(vertex + layout.normal.offset, layout.normalPacking, glm::vec4(normal, 0.0f), false);
+		if ( layout.hasTangents ){
+			glm::vec4 tangent( prepareDirection((*tangents)[i], layout.normalPacking), handedness(normals[i], (*tangents)[i], (*bitangents)[i]) );
+			packDirection(vertex + layout.tangent.offset, layout.normalPacking, tangent, true);
+		}
+	}
+}
+
+void decodeInterleavedVertex(
+	const VertexLayout & layout,
+	const std::vector<unsigned char> & interleaved,
+	size_t i,
+	glm::vec3 & position, glm::vec2 & uv, glm::vec3 & normal, glm::vec4 & tangent
+){
+	const unsigned char * vertex = &interleaved[i * layout.stride];
+	unpackValues(vertex + layout.position.offset, layout.positionPacking, &position.x, 3, &layout.positionOffset.x, &layout.positionScale.x);
+	unpackValues(vertex + layout.uv.offset,       layout.uvPacking,       &uv.x,       2, &layout.uvOffset.x,       &layout.uvScale.x);
+	normal = glm::vec3( unpackDirection(vertex + layout.normal.offset, layout.normalPacking, false) );
+	tangent = glm::vec4(0.0f);
+	if ( layout.hasTangents )
+		tangent = unpackDirection(vertex + layout.tangent.offset, layout.normalPacking, true);
+}
+
+float packingErrorBound(VertexPacking packing, float value, float scale){
+	switch ( packing ){
+		case VERTEX_FLOAT :
+			return 0.0f;
+		case VERTEX_SNORM16 :
+			return 0.5f / 32767.0f + 1e-7f;
+		case VERTEX_HALF :
+			// Half an ulp of a half : 11 bits of mantissa, and denormals below 2^-14
+			return std::max(std::fabs(value), 6.1035156e-5f) * (1.0f / 2048.0f);
+		case VERTEX_UNORM16 :
+			// Half a step, plus the rounding of offset + value * scale in floats
+			return std::fabs(scale) * (0.5f / 65535.0f) + (std::fabs(value) + std::fabs(scale)) * 1e-6f;
+		case VERTEX_OCT16 :
+			// The mapping stretches the steps : up to 3.7 steps per component on the sphere
+			// (measured on 2M random directions), so 5 steps to be safe
+			return 5.0f / 32767.0f;
+		case VERTEX_INT_2_10_10_10 :
+			return 0.5f / 511.0f + 1e-7f;
+	}
+	return 0.0f;
+}
+
+// Compares `count` values and updates maxError. Returns false if one is out of bounds.
+static bool compareValues(VertexPacking packing, const float * decoded, const float * expected, const float * scale, int count, float & maxError){
+	bool ok = true;
+	for (int i = 0; i < count; i++){
+		float error = std::fabs(decoded[i] - expected[i]);
+		if ( !(error <= packingErrorBound(packing, expected[i], scale ? scale[i] : 1.0f)) ) // Also catches NaNs and overflows to infinity
+			ok = false;
+		if ( !(error <= maxError) )
+			maxError = error;
+	}
+	return ok;
+}
+
+bool validateInterleavedVertices(
+	const VertexLayout & layout,
+	const std::vector<unsigned char> & interleaved,
+	const std::vector<glm::vec3> & vertices,
+	const std::vector<glm::vec2> & uvs,
+	const std::vector<glm::vec3> & normals,
+	const std::vector<glm::vec3> * tangents,
+	const std::vector<glm::vec3> * bitangents,
+	InterleavedErrors * errors
+){
+	InterleavedErrors found;
+	memset(&found, 0, sizeof(found));
+	if ( interleaved.size() != vertices.size() * layout.stride || (layout.hasTangents && (!tangents || !bitangents)) ){
+		if ( errors )
+			*errors = found;
+		return false;
+	}
+
+	bool ok = true;
+	for (size_t i = 0; i < vertices.size(); i++){
+		glm::vec3 position, normal;
+		glm::vec2 uv;
+		glm::vec4 tangent;
+		decodeInterleavedVertex(layout, interleaved, i, position, uv, normal, tangent);
+
+		glm::vec3 expectedNormal = prepareDirection(normals[i], layout.normalPacking);
+		ok = compareValues(layout.positionPacking, &position.x, &vertices[i].x,    &layout.positionScale.x, 3, found.position) && ok;
+		ok = compareValues(layout.normalPacking,   &normal.x,   &expectedNormal.x, NULL,                    3, found.normal)   && ok;
+		ok = compareValues(layout.uvPacking,       &uv.x,       &uvs[i].x,         &layout.uvScale.x,       2, found.uv)       && ok;
+		if ( layout.hasTangents ){
+			glm::vec3 expectedTangent = prepareDirection((*tangents)[i], layout.normalPacking);
+			ok = compareValues(layout.normalPacking, &tangent.x, &expectedTangent.x, NULL, 3, found.tangent) && ok;
+			if ( tangent.w != handedness(normals[i], (*tangents)[i], (*bitangents)[i]) ){
+				found.badHandedness++;
+				ok = false;
+			}
+		}
+	}
+	if ( errors )
+		*errors = found;
+	return ok;
+}
+
+template <typename T_INDEX>
+bool indexVBO_interleaved(
+	std::vector<glm::vec3> & in_vertices,
+	std::vector<glm::vec2> & in_uvs,
+	std::vector<glm::vec3> & in_normals,
+
+	VertexLayout & layout,
+	std::vector<T_INDEX> & out_indices,
+	std::vector<unsigned char> & out_interleaved
+){
+	std::vector<glm::vec3> vertices;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+	if ( !indexVBO(in_vertices, in_uvs, in_normals, out_indices, vertices, uvs, normals) )
+		return false;
+	buildInterleavedVertices(layout, vertices, uvs, normals, NULL, NULL, out_interleaved);
+	return true;
+}
+
+template <typename T_INDEX>
+bool indexVBO_TBN_interleaved(
+	std::vector<glm::vec3> & in_vertices,
+	std::vector<glm::vec2> & in_uvs,
+	std::vector<glm::vec3> & in_normals,
+	std::vector<glm::vec3> & in_tangents,
+	std::vector<glm::vec3> & in_bitangents,
+
+	VertexLayout & layout,
+	std::vector<T_INDEX> & out_indices,
+	std::vector<unsigned char> & out_interleaved
+){
+	if ( !layout.hasTangents ){
+		printf("indexVBO_TBN_interleaved needs a vertex layout with tangents\n");
+		return false;
+	}
+	std::vector<glm::vec3> vertices, normals, tangents, bitangents;
+	std::vector<glm::vec2> uvs;
+	if ( !indexVBO_TBN(in_vertices, in_uvs, in_normals, in_tangents, in_bitangents, out_indices, vertices, uvs, normals, tangents, bitangents) )
+		return false;
+	buildInterleavedVertices(layout, vertices, uvs, normals, &tangents, &bitangents, out_interleaved);
+	return true;
+}
+
+#define INSTANTIATE_INTERLEAVED(T_INDEX) \
+	template bool indexVBO_interleaved<T_INDEX>(std::vector<glm::vec3> &, std::vector<glm::vec2> &, std::vector<glm::vec3> &, \
+		VertexLayout &, std::vector<T_INDEX> &, std::vector<unsigned char> &); \
+	template bool indexVBO_TBN_interleaved<T_INDEX>(std::vector<glm::vec3> &, std::vector<glm::vec2> &, std::vector<glm::vec3> &, \
+		std::vector<glm::vec3> &, std::vector<glm::vec3> &, VertexLayout &, std::vector<T_INDEX> &, std::vector<unsigned char> &);
+
+INSTANTIATE_INTERLEAVED(unsigned short)
+INSTANTIATE_INTERLEAVED(unsigned int)
@@ -0,0 +1,132 @@
+#ifndef VERTEXLAYOUT_HPP
+#define VERTEXLAYOUT_HPP
+
+#include <vector>
+#include <glm/glm.hpp>
+
+// Interleaved vertices : instead of one VBO for the positions, one for the UVs,
+// one for the normals..., all the attributes of a vertex are next to each other
+// in a single VBO. The GPU reads one small block per vertex instead of 3 to 5
+// scattered ones, and the 16-bit packings make the whole thing smaller.
+
+enum VertexPacking{
+	VERTEX_FLOAT,          // 32-bit floats. Exact.
+	VERTEX_SNORM16,        // 16-bit signed normalized integers, for unit vectors : they're normalized before packing.
+	VERTEX_HALF,           // 16-bit floats. About 3 significant digits.
+	VERTEX_UNORM16,        // 16-bit unsigned normalized integers, within the bounds of the mesh. For positions and UVs.
+	VERTEX_OCT16,          // Unit vectors, octahedral mapping : 2 16-bit signed normalized integers instead of 3.
+	                       // The shader has to decode it, see octDecode in vertexlayout.cpp.
+	VERTEX_INT_2_10_10_10  // Unit vectors, 10 bits per component, and 2 for the handedness of tangents. 4 bytes.
+};
+
+// One attribute, as glVertexAttribPointer wants it
+struct VertexAttribute{
+	unsigned int offset;  // From the beginning of the vertex, in bytes
+	int components;
+	unsigned int type;    // GL_FLOAT, GL_SHORT, GL_HALF_FLOAT, GL_UNSIGNED_SHORT or GL_INT_2_10_10_10_REV
+	bool normalized;
+};
+
+// Position, normal, UV, then tangent if there are tangents.
+// The tangent is a vec4 : w is the handedness of the tangent space (+1 or -1),
+// and the bitangent is cross(normal, tangent.xyz) * tangent.w in the shader.
+// With VERTEX_INT_2_10_10_10, OpenGL before 4.2 reads a w of -1 as -1/3 : use sign(tangent.w).
+//
+// VERTEX_UNORM16 positions and UVs are stored in [0, 1] within the bounds of the mesh :
+// the real value is offset + stored value * scale, which the vertex shader has to do.
+// For the other packings, offset is 0 and scale is 1.
+//
+// Float positions, normals and UVs take 32 bytes per vertex. With VERTEX_UNORM16 positions,
+// VERTEX_INT_2_10_10_10 normals and VERTEX_HALF UVs, 16 bytes (20 instead of 48 with tangents).
+struct VertexLayout{
+	VertexPacking positionPacking;
+	VertexPacking normalPacking; // Normals and tangents
+	VertexPacking uvPacking;
+	bool hasTangents;
+	unsigned int stride;
+	VertexAttribute position, normal, uv, tangent;
+	glm::vec3 positionOffset, positionScale;
+	glm::vec2 uvOffset, uvScale;
+};
+
+// Computes the offsets and the stride. Every attribute starts on 4 bytes.
+// Positions and UVs aren't unit vectors, so they can't be VERTEX_SNORM16, VERTEX_OCT16 or
+// VERTEX_INT_2_10_10_10, and normals can't be VERTEX_UNORM16 : returns false in these cases.
+bool makeVertexLayout(VertexPacking positionPacking, VertexPacking normalPacking, VertexPacking uvPacking, bool withTangents, VertexLayout & layout);
+
+// Sets the offset and scale of the VERTEX_UNORM16 attributes to the bounding box of the mesh
+void computeQuantizationBounds(VertexLayout & layout, const std::vector<glm::vec3> & vertices, const std::vector<glm::vec2> & uvs);
+
+// Biggest error that packing `value` can make, per component. scale is the scale of the
+// attribute in the layout (only used by VERTEX_UNORM16). Unit vectors are normalized first.
+float packingErrorBound(VertexPacking packing, float value, float scale);
+
+// Packs SoA arrays (like the outputs of indexVBO) into an interleaved buffer, ready for glBufferData.
+// Calls computeQuantizationBounds first.
+// tangents and bitangents are only used if the layout has tangents.
+void buildInterleavedVertices(
+	VertexLayout & layout,
+	const std::vector<glm::vec3> & vertices,
+	const std::vector<glm::vec2> & uvs,
+	const std::vector<glm::vec3> & normals,
+	const std::vector<glm::vec3> * tangents,
+	const std::vector<glm::vec3> * bitangents,
+	std::vector<unsigned char> & out_interleaved
+);
+
+// Unpacks the i-th vertex of an interleaved buffer, like the shader would.
+// tangent is 0 if the layout has no tangents.
+void decodeInterleavedVertex(
+	const VertexLayout & layout,
+	const std::vector<unsigned char> & interleaved,
+	size_t i,
+	glm::vec3 & position, glm::vec2 & uv, glm::vec3 & normal, glm::vec4 & tangent
+);
+
+// Biggest difference between the decoded vertices and the SoA arrays, per attribute
+struct InterleavedErrors{
+	float position, uv, normal, tangent;
+	size_t badHandedness; // Tangents whose w doesn't match the bitangent
+};
+
+// CPU-side check of an interleaved buffer : decodes every vertex and compares it with the
+// SoA arrays it was made from. Returns false if an error is bigger than packingErrorBound.
+// If errors isn't NULL, it receives the biggest errors found.
+bool validateInterleavedVertices(
+	const VertexLayout & layout,
+	const std::vector<unsigned char> & interleaved,
+	const std::vector<glm::vec3> & vertices,
+	const std::vector<glm::vec2> & uvs,
+	const std::vector<glm::vec3> & normals,
+	const std::vector<glm::vec3> * tangents,
+	const std::vector<glm::vec3> * bitangents,
+	InterleavedErrors * errors = NULL
+);
+
+// indexVBO, with an interleaved output instead of 3 arrays
+template <typename T_INDEX>
+bool indexVBO_interleaved(
+	std::vector<glm::vec3> & in_vertices,
+	std::vector<glm::vec2> & in_uvs,
+	std::vector<glm::vec3> & in_normals,
+
+	VertexLayout & layout,
+	std::vector<T_INDEX> & out_indices,
+	std::vector<unsigned char> & out_interleaved
+);
+
+// indexVBO_TBN, with an interleaved output. The layout must have tangents.
+template <typename T_INDEX>
+bool indexVBO_TBN_interleaved(
+	std::vector<glm::vec3> & in_vertices,
+	std::vector<glm::vec2> & in_uvs,
+	std::vector<glm::vec3> & in_normals,
+	std::vector<glm::vec3> & in_tangents,
+	std::vector<glm::vec3> & in_bitangents,
+
+	VertexLayout & layout,
+	std::vector<T_INDEX> & out_indices,
+	std::vector<unsigned char> & out_interleaved
+);
+
+#endif
@@ -0,0 +1,168 @@
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+#include <glm/glm.hpp>
+
+#include "vertexhash.hpp"
+#include "parallel.hpp"
+#include "vertexnormals.hpp"
+
+// Triangles or corners per thread, at least
+static const size_t NORMALS_GRAIN = 16384;
+
+static inline float cornerAngle(const glm::vec3 & a, const glm::vec3 & b){
+	float lengths = std::sqrt(glm::dot(a, a) * glm::dot(b, b));
+	if ( !(lengths > 0.0f) )
+		return 0.0f;
+	return std::acos(std::min(std::max(glm::dot(a, b) / lengths, -1.0f), 1.0f));
+}
+
+template <typename T_INDEX>
+void computeCornerNormals(
+	const T_INDEX * indices,
+	size_t indexCount,
+	const glm::vec3 * positions,
+	size_t positionCount,
+	float creaseAngle,
+	NormalWeighting weighting,
+	glm::vec3 * out_normals
+){
+	size_t triangleCount = indexCount / 3;
+	const unsigned int NONE = ~0u;
+
+	// Unit normal of each triangle, and what it weighs at each of its corners
+	std::vector<glm::vec3> faceNormals(triangleCount), cornerWeights(triangleCount);
+	parallelFor(triangleCount, threadCount(triangleCount, NORMALS_GRAIN), [&](size_t begin, size_t end){
+		for (size_t t = begin; t < end; t++){
+			const glm::vec3 & p0 = positions[ indices[3*t+0] ];
+			const glm::vec3 & p1 = positions[ indices[3*t+1] ];
+			const glm::vec3 & p2 = positions[ indices[3*t+2] ];
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			float length = glm::length(normal);
+			if ( !(length > 0.0f) ){
+				faceNormals[t] = cornerWeights[t] = glm::vec3(0.0f);
+				continue;
+			}
+			faceNormals[t] = normal / length;
+			if ( weighting == NORMALS_WEIGHT_AREA )
+				cornerWeights[t] = glm::vec3(0.5f * length);
+			else
+				cornerWeights[t] = glm::vec3(cornerAngle(p1 - p0, p2 - p0), cornerAngle(p2 - p1, p0 - p1), cornerAngle(p0 - p2, p1 - p2));
+		}
+	});
+
+	// Vertices at the same position : group is the first of them. Adding 0 turns -0.0 into 0.0,
+	// which aren't the same bytes for the hash table.
+	std::vector<unsigned int> group(positionCount, NONE);
+	{
+		VertexHashTable<glm::vec3> table(positionCount);
+		for (size_t i = 0; i < triangleCount * 3; i++){
+			unsigned int v = indices[i];
+			if ( group[v] != NONE )
+				continue;
+			if ( !table.findOrInsert(positions[v] + glm::vec3(0.0f), v, group[v]) )
+				group[v] = v;
+		}
+	}
+
+	// Corners of each group : corners[offsets[g] .. offsets[g+1])
+	std::vector<unsigned int> offsets(positionCount + 1, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		offsets[ group[ indices[i] ] + 1 ]++;
+	for (size_t v = 0; v < positionCount; v++)
+		offsets[v+1] += offsets[v];
+	std::vector<unsigned int> corners(triangleCount * 3);
+	{
+		std::vector<unsigned int> filled(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < triangleCount * 3; i++)
+			corners[ filled[ group[ indices[i] ] ]++ ] = (unsigned int)i;
+	}
+
+	// Each corner sums the triangles of its group which aren't across a crease. Always in the
+	// order of the corners list : corners which keep the same triangles get exactly the same normal.
+	float creaseCosine = std::cos(std::min(std::max(creaseAngle, 0.0f), 180.0f) * 3.14159265f / 180.0f);
+	parallelFor(triangleCount * 3, threadCount(triangleCount * 3, NORMALS_GRAIN), [&](size_t begin, size_t end){
+		for (size_t i = begin; i < end; i++){
+			const glm::vec3 & own = faceNormals[i / 3];
+			bool degenerate = own == glm::vec3(0.0f); // Takes everything around
+			unsigned int g = group[ indices[i] ];
+			glm::vec3 normal(0.0f);
+			for (unsigned int c = offsets[g]; c < offsets[g+1]; c++){
+				unsigned int other = corners[c];
+				const glm::vec3 & face = faceNormals[other / 3];
+				if ( degenerate || glm::dot(own, face) >= creaseCosine )
+					normal += face * cornerWeights[other / 3][other % 3];
+			}
+			float length = glm::length(normal);
+			out_normals[i] = length > 0.0f ? normal / length : glm::vec3(0.0f);
+		}
+	});
+}
+
+template <typename T_INDEX>
+bool generateNormals(
+	std::vector<T_INDEX> & indices,
+	std::vector<glm::vec3> & vertices,
+	std::vector<glm::vec2> & uvs,
+	std::vector<glm::vec3> & out_normals,
+	float creaseAngle,
+	NormalWeighting weighting
+){
+	size_t indexCount = indices.size() - indices.size() % 3;
+	size_t vertexCount = vertices.size();
+	std::vector<glm::vec3> cornerNormals(indexCount);
+	computeCornerNormals(indices.data(), indexCount, vertices.data(), vertexCount, creaseAngle, weighting, cornerNormals.data());
+
+	// The first normal of a vertex stays in the vertex, the other ones go in copies of it.
+	// copies links a vertex to its next copy.
+	const unsigned int NONE = ~0u;
+	std::vector<T_INDEX> newIndices(indices);
+	std::vector<glm::vec3> normals(vertexCount, glm::vec3(0.0f));
+	std::vector<unsigned int> copies(vertexCount, NONE), original;
+	std::vector<char> assigned(vertexCount, 0);
+	for (size_t i = 0; i < indexCount; i++){
+		unsigned int v = indices[i];
+		if ( !assigned[v] ){
+			assigned[v] = 1;
+			normals[v] = cornerNormals[i];
+			continue;
+		}
+		unsigned int u = v, last = v;
+		while ( u != NONE && normals[u] != cornerNormals[i] ){
+			last = u;
+			u = copies[u];
+		}
+		if ( u == NONE ){
+			u = (unsigned int)normals.size();
+			if ( u > (size_t)std::numeric_limits<T_INDEX>::max() )
+				return false;
+			normals.push_back(cornerNormals[i]);
+			copies.push_back(NONE);
+			copies[last] = u;
+			original.push_back(v);
+		}
+		newIndices[i] = (T_INDEX)u;
+	}
+
+	indices.swap(newIndices);
+	for (size_t c = 0; c < original.size(); c++){
+		glm::vec3 position = vertices[ original[c] ];
+		vertices.push_back(position);
+		if ( uvs.size() == vertexCount + c ){
+			glm::vec2 uv = uvs[ original[c] ];
+			uvs.push_back(uv);
+		}
+	}
+	out_normals.swap(normals);
+	return true;
+}
+
+#define INSTANTIATE_VERTEXNORMALS(T_INDEX) \
+	template void computeCornerNormals<T_INDEX>(const T_INDEX *, size_t, const glm::vec3 *, size_t, float, NormalWeighting, glm::vec3 *); \
+	template bool generateNormals<T_INDEX>(std::vector<T_INDEX> &, std::vector<glm::vec3> &, std::vector<glm::vec2> &, \
+		std::vector<glm::vec3> &, float, NormalWeighting);
+
+INSTANTIATE_VERTEXNORMALS(unsigned short)
+INSTANTIATE_VERTEXNORMALS(unsigned int)
@@ -0,0 +1,48 @@
+#ifndef VERTEXNORMALS_HPP
+#define VERTEXNORMALS_HPP
+
+#include <vector>
+#include <glm/glm.hpp>
+
+// Smooth normals, for meshes which come without them (OBJ files without vn lines).
+// The normal of a corner is the sum of the normals of the triangles around the same position,
+// except the triangles which make an angle bigger than creaseAngle (in degrees) with its own
+// triangle : so a cube keeps its hard edges, and a sphere is smooth.
+// The triangles around a position are found with a hash table on the positions, not on the
+// vertices : the UV seams, where a position has several vertices, don't show.
+// Everything is linear in the number of triangles (as long as the number of triangles around a
+// position stays reasonable), and done on several threads.
+
+enum NormalWeighting{
+	NORMALS_WEIGHT_ANGLE, // By the angle of each triangle at the position (doesn't depend on how faces are cut in triangles)
+	NORMALS_WEIGHT_AREA,  // By the area of each triangle (big triangles win)
+};
+
+// One normal per corner : out_normals[i] is the normal of the corner indices[i].
+// indices[i] must be < positionCount. Triangles without area have a zero normal, and add nothing.
+// Instantiated for unsigned short and unsigned int indices.
+template <typename T_INDEX>
+void computeCornerNormals(
+	const T_INDEX * indices,
+	size_t indexCount,
+	const glm::vec3 * positions,
+	size_t positionCount,
+	float creaseAngle,
+	NormalWeighting weighting,
+	glm::vec3 * out_normals
+);
+
+// Same thing for an indexed mesh, replacing its normals. A vertex whose corners get different
+// normals (on a crease) is split : the copies are added at the end of vertices and uvs.
+// Returns false if that makes more vertices than T_INDEX can address (nothing is changed then).
+template <typename T_INDEX>
+bool generateNormals(
+	std::vector<T_INDEX> & indices,
+	std::vector<glm::vec3> & vertices,
+	std::vector<glm::vec2> & uvs,
+	std::vector<glm::vec3> & out_normals,
+	float creaseAngle = 60.0f,
+	NormalWeighting weighting = NORMALS_WEIGHT_ANGLE
+);
+
+#endif
@@ -29,6 +29,7 @@ using namespace glm;
 #include <common/controls.hpp>
 #include <common/objloader.hpp>
 #include <common/vboindexer.hpp>
+#include <common/meshcache.hpp>
 
 
 void ScreenPosToWorldRay(
@@ -160,17 +161,13 @@ int main( void )
 	// Get a handle for our "myTextureSampler" uniform
 	GLuint TextureID  = glGetUniformLocation(programID, "myTextureSampler");
 
-	// Read our .obj file
-	std::vector<glm::vec3> vertices;
-	std::vector<glm::vec2> uvs;
-	std::vector<glm::vec3> normals;
-	bool res = loadOBJ("suzanne.obj", vertices, uvs, normals);
-
+	// Read our .obj file, and index it (see tutorial 9).
+	// The result is cached (see common/assetcache.hpp) : next time, it's just a few memcpy's.
 	std::vector<unsigned short> indices;
 	std::vector<glm::vec3> indexed_vertices;
 	std::vector<glm::vec2> indexed_uvs;
 	std::vector<glm::vec3> indexed_normals;
-	indexVBO(vertices, uvs, normals, indices, indexed_vertices, indexed_uvs, indexed_normals);
+	bool res = loadIndexedOBJ("suzanne.obj", indices, indexed_vertices, indexed_uvs, indexed_normals);
 
 	// Load it into a VBO
 
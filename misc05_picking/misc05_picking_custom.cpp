@@ -26,6 +26,9 @@ using namespace glm;
 #include <common/controls.hpp>
 #include <common/objloader.hpp>
 #include <common/vboindexer.hpp>
+#include <common/meshcache.hpp>
+#include <common/meshsimplifier.hpp>
+#include <common/raypicking.hpp>
 
 void ScreenPosToWorldRay(
 	int mouseX, int mouseY,             // Mouse position, in pixels, from bottom-left corner of the window
@@ -85,7 +88,7 @@ bool TestRayOBBIntersection(
 	glm::vec3 ray_direction,     // Ray direction (NOT target position!), in world space. Must be normalize()'d.
 	glm::vec3 aabb_min,          // Minimum X,Y,Z coords of the mesh when not transformed at all.
 	glm::vec3 aabb_max,          // Maximum X,Y,Z coords. Often aabb_min*-1 if your mesh is centered, but it's not always the case.
-	glm::mat4 ModelMatrix,       // Transformation applied to the mesh (which will thus be also applied to its bounding box)
+	const glm::mat4 & ModelMatrix, // Transformation applied to the mesh (which will thus be also applied to its bounding box)
 	float& intersection_distance // Output : distance between ray_origin and the intersection with the OBB
 ){
 	
@@ -130,7 +133,7 @@ bool TestRayOBBIntersection(
 				return false;
 
 		}else{ // Rare case : the ray is almost parallel to the planes, so they don't have any "intersection"
-			if(-e+aabb_min.x > 0.0f || -e+aabb_max.x < 0.0f)
+			if(e+aabb_min.x > 0.0f || e+aabb_max.x < 0.0f)
 				return false;
 		}
 	}
@@ -158,7 +161,7 @@ bool TestRayOBBIntersection(
 				return false;
 
 		}else{
-			if(-e+aabb_min.y > 0.0f || -e+aabb_max.y < 0.0f)
+			if(e+aabb_min.y > 0.0f || e+aabb_max.y < 0.0f)
 				return false;
 		}
 	}
@@ -186,7 +189,7 @@ bool TestRayOBBIntersection(
 				return false;
 
 		}else{
-			if(-e+aabb_min.z > 0.0f || -e+aabb_max.z < 0.0f)
+			if(e+aabb_min.z > 0.0f || e+aabb_max.z < 0.0f)
 				return false;
 		}
 	}
@@ -273,17 +276,28 @@ int main( void )
 	// Get a handle for our "myTextureSampler" uniform
 	GLuint TextureID  = glGetUniformLocation(programID, "myTextureSampler");
 
-	// Read our .obj file
-	std::vector<glm::vec3> vertices;
-	std::vector<glm::vec2> uvs;
-	std::vector<glm::vec3> normals;
-	bool res = loadOBJ("suzanne.obj", vertices, uvs, normals);
-
+	// Read our .obj file, and index it (see tutorial 9).
+	// The result is cached (see common/assetcache.hpp) : next time, it's just a few memcpy's.
+	// Its bounding volumes are in the cache too (see common/meshbounds.hpp).
 	std::vector<unsigned short> indices;
 	std::vector<glm::vec3> indexed_vertices;
 	std::vector<glm::vec2> indexed_uvs;
 	std::vector<glm::vec3> indexed_normals;
-	indexVBO(vertices, uvs, normals, indices, indexed_vertices, indexed_uvs, indexed_normals);
+	MeshBounds bounds;
+	bool res = loadIndexedOBJ("suzanne.obj", indices, indexed_vertices, indexed_uvs, indexed_normals, &bounds);
+
+	// The box used for picking : the mesh's own AABB, or its OBB if that's smaller.
+	// picking_matrix goes from the space of the box to the space of the mesh.
+	glm::vec3 picking_min = bounds.aabbMin;
+	glm::vec3 picking_max = bounds.aabbMax;
+	glm::mat4 picking_matrix(1.0f);
+	glm::vec3 aabb_size = bounds.aabbMax - bounds.aabbMin;
+	glm::vec3 obb_size = 2.0f * bounds.obbHalfSize;
+	if ( obb_size.x * obb_size.y * obb_size.z < aabb_size.x * aabb_size.y * aabb_size.z ){
+		picking_min = -bounds.obbHalfSize;
+		picking_max =  bounds.obbHalfSize;
+		picking_matrix = obbMatrix(bounds);
+	}
 
 	// Load it into a VBO
 
@@ -302,11 +316,28 @@ int main( void )
 	glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
 	glBufferData(GL_ARRAY_BUFFER, indexed_normals.size() * sizeof(glm::vec3), &indexed_normals[0], GL_STATIC_DRAW);
 
+	// Simplified versions of the monkey for the far away ones : 1/2, 1/4 and 1/8 of the triangles.
+	// They all use the same vertices, so they all go in the same element buffer, one after the other.
+	std::vector<float> ratios;
+	ratios.push_back(0.5f);
+	ratios.push_back(0.25f);
+	ratios.push_back(0.125f);
+	std::vector< MeshLOD<unsigned short> > lods;
+	generateLODs(indices, indexed_vertices, ratios, lods);
+
+	std::vector<unsigned short> lod_indices;
+	std::vector<size_t> lod_offsets;
+	for (size_t l = 0; l < lods.size(); l++){
+		lod_offsets.push_back(lod_indices.size());
+		lod_indices.insert(lod_indices.end(), lods[l].indices.begin(), lods[l].indices.end());
+		printf("LOD %d : %d triangles, error %f\n", (int)l, (int)lods[l].indices.size() / 3, lods[l].error);
+	}
+
 	// Generate a buffer for the indices as well
 	GLuint elementbuffer;
 	glGenBuffers(1, &elementbuffer);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned short), &indices[0] , GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, lod_indices.size() * sizeof(unsigned short), &lod_indices[0] , GL_STATIC_DRAW);
 
 
 
@@ -318,6 +349,20 @@ int main( void )
 		orientations[i] = glm::quat(glm::vec3(rand()%360, rand()%360, rand()%360));
 	}
 
+	// Their boxes, for picking (see common/raypicking.hpp).
+	// The ModelMatrix transforms :
+	// - the mesh to its desired position and orientation
+	// - but also the box (defined with picking_min and picking_max) into an OBB
+	// picking_matrix puts the box along the mesh first, when it's the mesh's OBB.
+	// The monkeys don't move, so this is done once.
+	OBBBatch pickingBoxes;
+	for(int i=0; i<100; i++){
+		glm::mat4 RotationMatrix = glm::toMat4(orientations[i]);
+		glm::mat4 TranslationMatrix = translate(mat4(), positions[i]);
+		glm::mat4 ModelMatrix = TranslationMatrix * RotationMatrix * picking_matrix;
+		pickingBoxes.add(ModelMatrix, picking_min, picking_max);
+	}
+
 
 
 	// Get a handle for our "LightPosition" uniform
@@ -368,38 +413,19 @@ int main( void )
 
 			message = "background";
 
-			// Test each each Oriented Bounding Box (OBB).
+			// Test each each Oriented Bounding Box (OBB), and keep the nearest one.
+			// intersectRaysOBBs does what TestRayOBBIntersection does, but for all the boxes
+			// at once : 4 at a time with SSE, skipping those behind the nearest hit so far.
 			// A physics engine can be much smarter than this, 
 			// because it already has some spatial partitionning structure, 
 			// like Binary Space Partitionning Tree (BSP-Tree),
 			// Bounding Volume Hierarchy (BVH) or other.
-			for(int i=0; i<100; i++){
-
-				float intersection_distance; // Output of TestRayOBBIntersection()
-				glm::vec3 aabb_min(-1.0f, -1.0f, -1.0f);
-				glm::vec3 aabb_max( 1.0f,  1.0f,  1.0f);
-
-				// The ModelMatrix transforms :
-				// - the mesh to its desired position and orientation
-				// - but also the AABB (defined with aabb_min and aabb_max) into an OBB
-				glm::mat4 RotationMatrix = glm::toMat4(orientations[i]);
-				glm::mat4 TranslationMatrix = translate(mat4(), positions[i]);
-				glm::mat4 ModelMatrix = TranslationMatrix * RotationMatrix;
-
-
-				if ( TestRayOBBIntersection(
-					ray_origin, 
-					ray_direction, 
-					aabb_min, 
-					aabb_max,
-					ModelMatrix,
-					intersection_distance)
-				){
-					std::ostringstream oss;
-					oss << "mesh " << i;
-					message = oss.str();
-					break;
-				}
+			RayHit hit;
+			intersectRaysOBBs(&ray_origin, &ray_direction, 1, pickingBoxes, &hit);
+			if ( hit.box >= 0 ){
+				std::ostringstream oss;
+				oss << "mesh " << hit.box;
+				message = oss.str();
 			}
 
 
@@ -415,12 +441,17 @@ int main( void )
 		// Use our shader
 		glUseProgram(programID);
 
+		glm::vec3 cameraPosition = glm::vec3(glm::inverse(ViewMatrix)[3]);
+
 		glEnableVertexAttribArray(0);
 		glEnableVertexAttribArray(1);
 		glEnableVertexAttribArray(2);
 
 		for(int i=0; i<100; i++){
 
+			// Less than a pixel of error on the screen : nobody will notice
+			size_t lod = selectLOD(lods, glm::length(positions[i] - cameraPosition), ProjectionMatrix[1][1], 768.0f);
+
 
 			glm::mat4 RotationMatrix = glm::toMat4(orientations[i]);
 			glm::mat4 TranslationMatrix = translate(mat4(), positions[i]);
@@ -482,9 +513,9 @@ int main( void )
 			// Draw the triangles !
 			glDrawElements(
 				GL_TRIANGLES,      // mode
-				indices.size(),    // count
+				lods[lod].indices.size(),    // count
 				GL_UNSIGNED_SHORT,   // type
-				(void*)0           // element array buffer offset
+				(void*)(lod_offsets[lod] * sizeof(unsigned short))           // element array buffer offset
 			);
 
 
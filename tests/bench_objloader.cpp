@@ -0,0 +1,217 @@
+// Benchmark of loadOBJ (see common/objloader.cpp) against the fscanf loader it replaced,
+// in MB of OBJ text per second. Three files are generated :
+// - copies of suzanne.obj one after the other, like a big exported scene ;
+// - random coordinates, and faces with random indices (no cache locality) ;
+// - the same, with numbers in every printf format (long mantissas, exponents...).
+// Both loaders must give exactly the same arrays, byte for byte.
+//
+//	bench_objloader [megabytes per file] [directory for the generated files]
+//
+// Run from the root of the repository. Returns 1 if the outputs differ.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include <glm/glm.hpp>
+
+#include <common/objloader.hpp>
+#include <common/parallel.hpp>
+
+// loadOBJ as it was before the mapping : fscanf, one token at a time
+static bool loadOBJ_fscanf(
+	const char * path,
+	std::vector<glm::vec3> & out_vertices,
+	std::vector<glm::vec2> & out_uvs,
+	std::vector<glm::vec3> & out_normals
+){
+	std::vector<unsigned int> vertexIndices, uvIndices, normalIndices;
+	std::vector<glm::vec3> temp_vertices;
+	std::vector<glm::vec2> temp_uvs;
+	std::vector<glm::vec3> temp_normals;
+
+	FILE * file = fopen(path, "r");
+	if( file == NULL )
+		return false;
+	while( 1 ){
+		char lineHeader[128];
+		int res = fscanf(file, "%s", lineHeader);
+		if (res == EOF)
+			break;
+		if ( strcmp( lineHeader, "v" ) == 0 ){
+			glm::vec3 vertex;
+			if ( fscanf(file, "%f %f %f\n", &vertex.x, &vertex.y, &vertex.z ) != 3 )
+				break;
+			temp_vertices.push_back(vertex);
+		}else if ( strcmp( lineHeader, "vt" ) == 0 ){
+			glm::vec2 uv;
+			if ( fscanf(file, "%f %f\n", &uv.x, &uv.y ) != 2 )
+				break;
+			uv.y = -uv.y;
+			temp_uvs.push_back(uv);
+		}else if ( strcmp( lineHeader, "vn" ) == 0 ){
+			glm::vec3 normal;
+			if ( fscanf(file, "%f %f %f\n", &normal.x, &normal.y, &normal.z ) != 3 )
+				break;
+			temp_normals.push_back(normal);
+		}else if ( strcmp( lineHeader, "f" ) == 0 ){
+			unsigned int vertexIndex[3], uvIndex[3], normalIndex[3];
+			int matches = fscanf(file, "%u/%u/%u %u/%u/%u %u/%u/%u\n", &vertexIndex[0], &uvIndex[0], &normalIndex[0], &vertexIndex[1], &uvIndex[1], &normalIndex[1], &vertexIndex[2], &uvIndex[2], &normalIndex[2] );
+			if (matches != 9){
+				fclose(file);
+				return false;
+			}
+			for (int k = 0; k < 3; k++){
+				vertexIndices.push_back(vertexIndex[k]);
+				uvIndices    .push_back(uvIndex[k]);
+				normalIndices.push_back(normalIndex[k]);
+			}
+		}else{
+			char stupidBuffer[1000];
+			if ( !fgets(stupidBuffer, 1000, file) )
+				break;
+		}
+	}
+	fclose(file);
+
+	for( unsigned int i=0; i<vertexIndices.size(); i++ ){
+		out_vertices.push_back(temp_vertices[ vertexIndices[i]-1 ]);
+		out_uvs     .push_back(temp_uvs[ uvIndices[i]-1 ]);
+		out_normals .push_back(temp_normals[ normalIndices[i]-1 ]);
+	}
+	return true;
+}
+
+// Small and fast, and the same numbers on every machine
+static unsigned int nextRandom(unsigned int & state){
+	state = state * 1664525u + 1013904223u;
+	return state >> 8;
+}
+
+static double randomUniform(unsigned int & state){
+	return nextRandom(state) / 16777216.0;
+}
+
+// Copies of suzanne.obj, each one with its indices moved past the previous ones
+static bool writeSuzannes(const char * sourcePath, const char * path, size_t bytes){
+	FILE * source = fopen(sourcePath, "r");
+	if ( !source ){
+		printf("Can't read %s : run from the root of the repository\n", sourcePath);
+		return false;
+	}
+	std::vector<std::string> lines;
+	unsigned int counts[3] = { 0, 0, 0 }; // v, vt, vn
+	char line[1024];
+	while ( fgets(line, sizeof(line), source) ){
+		lines.push_back(line);
+		if ( strncmp(line, "v ", 2) == 0 ) counts[0]++;
+		if ( strncmp(line, "vt ", 3) == 0 ) counts[1]++;
+		if ( strncmp(line, "vn ", 3) == 0 ) counts[2]++;
+	}
+	fclose(source);
+
+	FILE * file = fopen(path, "w");
+	if ( !file )
+		return false;
+	size_t written = 0;
+	for (unsigned int copy = 0; written < bytes; copy++){
+		for (size_t i = 0; i < lines.size(); i++){
+			unsigned int a[9];
+			if ( sscanf(lines[i].c_str(), "f %u/%u/%u %u/%u/%u %u/%u/%u", &a[0], &a[1], &a[2], &a[3], &a[4], &a[5], &a[6], &a[7], &a[8]) == 9 ){
+				for (int k = 0; k < 9; k++)
+					a[k] += copy * counts[k % 3];
+				written += fprintf(file, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], a[8]);
+			}else{
+				written += fprintf(file, "%s", lines[i].c_str());
+			}
+		}
+	}
+	return fclose(file) == 0;
+}
+
+static int printNumber(FILE * file, unsigned int & state, bool allFormats){
+	if ( !allFormats )
+		return fprintf(file, " %f", randomUniform(state) * 4.0 - 2.0);
+	double x = (randomUniform(state) * 2.0 - 1.0) * pow(10.0, (int)(randomUniform(state) * 17.0) - 8);
+	switch ( nextRandom(state) % 7 ){
+	case 0:  return fprintf(file, " %f", x);
+	case 1:  return fprintf(file, " %.9g", x);
+	case 2:  return fprintf(file, " %e", x);
+	case 3:  return fprintf(file, " %.17g", x);
+	case 4:  return fprintf(file, " %.3f", x);
+	case 5:  return fprintf(file, " %.12f", x);
+	default: return fprintf(file, " %g", x);
+	}
+}
+
+// Random attributes, and twice as many triangles which pick them at random
+static bool writeRandom(const char * path, size_t bytes, bool allFormats){
+	FILE * file = fopen(path, "w");
+	if ( !file )
+		return false;
+	unsigned int state = 12345;
+	// Bytes per vertex, with its uv and normal and its 2 triangles
+	unsigned int count = (unsigned int)(bytes / (allFormats ? 250 : 220)) + 1;
+	for (unsigned int i = 0; i < count; i++){
+		fprintf(file, "v");  for (int k = 0; k < 3; k++) printNumber(file, state, allFormats); fprintf(file, "\n");
+		fprintf(file, "vt"); for (int k = 0; k < 2; k++) printNumber(file, state, allFormats); fprintf(file, "\n");
+		fprintf(file, "vn"); for (int k = 0; k < 3; k++) printNumber(file, state, allFormats); fprintf(file, "\n");
+	}
+	for (unsigned int i = 0; i < 2 * count; i++){
+		fprintf(file, "f");
+		for (int k = 0; k < 9; k++)
+			fprintf(file, "%s%u", k % 3 == 0 ? " " : "/", nextRandom(state) % count + 1);
+		fprintf(file, "\n");
+	}
+	return fclose(file) == 0;
+}
+
+template <typename T>
+static bool sameBytes(const std::vector<T> & a, const std::vector<T> & b){
+	return a.size() == b.size() && (a.empty() || memcmp(&a[0], &b[0], a.size() * sizeof(T)) == 0);
+}
+
+static double seconds(std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end){
+	return std::chrono::duration<double>(end - begin).count();
+}
+
+int main(int argc, char ** argv){
+	size_t megabytes = argc > 1 ? (size_t)atoi(argv[1]) : 32;
+	std::string directory = argc > 2 ? argv[2] : ".";
+	std::string paths[3] = { directory + "/bench_suzannes.obj", directory + "/bench_random.obj", directory + "/bench_formats.obj" };
+	const char * names[3] = { "suzanne copies", "random indices", "all formats" };
+	if ( !writeSuzannes("tutorial09_vbo_indexing/suzanne.obj", paths[0].c_str(), megabytes << 20)
+		|| !writeRandom(paths[1].c_str(), megabytes << 20, false) || !writeRandom(paths[2].c_str(), megabytes << 20, true) ){
+		printf("Can't write the OBJ files in %s\n", directory.c_str());
+		return 1;
+	}
+	printf("loadOBJ on %u threads\n", threadCount(megabytes << 20, 1 << 20));
+
+	bool allSame = true;
+	for (int f = 0; f < 3; f++){
+		FILE * file = fopen(paths[f].c_str(), "rb");
+		fseek(file, 0, SEEK_END);
+		double size = ftell(file) / 1e6;
+		fclose(file);
+
+		std::vector<glm::vec3> vertices1, normals1, vertices2, normals2;
+		std::vector<glm::vec2> uvs1, uvs2;
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+		bool ok1 = loadOBJ_fscanf(paths[f].c_str(), vertices1, uvs1, normals1);
+		std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+		bool ok2 = loadOBJ(paths[f].c_str(), vertices2, uvs2, normals2);
+		std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+
+		bool same = ok1 && ok2 && sameBytes(vertices1, vertices2) && sameBytes(uvs1, uvs2) && sameBytes(normals1, normals2);
+		allSame = allSame && same;
+		printf("%s, %.1f MB, %u triangles : fscanf %.1f MB/s, mapped %.1f MB/s (%.1fx), output %s\n",
+			names[f], size, (unsigned int)(vertices2.size() / 3), size / seconds(t0, t1), size / seconds(t1, t2),
+			seconds(t0, t1) / seconds(t1, t2), same ? "identical" : "DIFFERENT");
+		remove(paths[f].c_str());
+	}
+	return allSame ? 0 : 1;
+}
@@ -0,0 +1,226 @@
+// Benchmark of the block compression (see common/texturecompression.cpp) : encode and decode
+// speed of each format, in Mpixel/s, on a noisy gradient. And round trips through decompressImage :
+// - solid blocks come back exactly (in BC1 and BC3, colors which 565 can hold),
+// - images which aren't a multiple of 4 pixels (1x1, 3x5, 7x2, 13x17...) give the same pixels as
+//   the image padded to whole blocks, without a byte written past the end,
+// - BC1 keeps the pixels with alpha < 128 transparent (and black), and the others opaque,
+// - a smooth gradient stays above a minimum PSNR.
+//
+//	bench_texturecompression [size of the benchmark image, 2048 by default]
+//
+// Run from the root of the repository. Returns 1 if a round trip fails.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+#include <common/texturecompression.hpp>
+
+static const char * formatNames[] = { "BC1", "BC3", "BC4", "BC5" };
+
+// Channels which a format keeps : BC1 rgb, BC3 rgba, BC4 r, BC5 rg
+static const int formatChannels[] = { 3, 4, 1, 2 };
+
+// Deterministic, unlike rand()
+static unsigned int random32(unsigned int & seed){
+	seed = seed * 1664525u + 1013904223u;
+	return seed ^ (seed >> 16);
+}
+
+// Smooth in every channel, plus `noise` levels of noise
+static void makeGradient(std::vector<unsigned char> & rgba, unsigned int width, unsigned int height, int noise){
+	rgba.resize((size_t)width * height * 4);
+	unsigned int seed = width * 7919 + height;
+	for (unsigned int y = 0; y < height; y++){
+		for (unsigned int x = 0; x < width; x++){
+			float u = width  > 1 ? (float)x / (width - 1)  : 0.5f;
+			float v = height > 1 ? (float)y / (height - 1) : 0.5f;
+			float channels[4] = { u, v, 0.5f + 0.5f * sinf(3.0f * (u + v)), 1.0f - 0.5f * u * v };
+			for (int c = 0; c < 4; c++){
+				int value = (int)(channels[c] * 255.0f + 0.5f);
+				if ( noise > 0 )
+					value += (int)(random32(seed) % (2 * noise + 1)) - noise;
+				rgba[((size_t)y * width + x) * 4 + c] = (unsigned char)std::min(255, std::max(0, value));
+			}
+		}
+	}
+}
+
+static double psnr(BlockFormat format, const std::vector<unsigned char> & a, const std::vector<unsigned char> & b){
+	double squares = 0;
+	size_t count = 0;
+	for (size_t i = 0; i < a.size(); i += 4){
+		for (int c = 0; c < formatChannels[format]; c++){
+			double difference = (double)a[i + c] - b[i + c];
+			squares += difference * difference;
+			count++;
+		}
+	}
+	if ( squares == 0 )
+		return 99.0;
+	return 10.0 * log10(255.0 * 255.0 / (squares / count));
+}
+
+// Compresses and decompresses, with guard bytes after both buffers
+static bool roundTrip(BlockFormat format, const std::vector<unsigned char> & rgba, unsigned int width, unsigned int height, std::vector<unsigned char> & decoded){
+	const unsigned char GUARD = 0xA5;
+	size_t size = compressedSize(format, width, height);
+	std::vector<unsigned char> blocks(size + 16, GUARD);
+	decoded.assign((size_t)width * height * 4 + 16, GUARD);
+	compressImage(format, rgba.data(), width, height, blocks.data());
+	decompressImage(format, blocks.data(), width, height, decoded.data());
+	bool guards = true;
+	for (int i = 0; i < 16; i++)
+		guards = guards && blocks[size + i] == GUARD && decoded[(size_t)width * height * 4 + i] == GUARD;
+	decoded.resize((size_t)width * height * 4);
+	return guards;
+}
+
+static bool checkSolid(){
+	// In BC1 and BC3, 565 colors : 5 bits expanded to 8 is (v << 3) | (v >> 2), 6 bits (v << 2) | (v >> 4)
+	const unsigned char colors[][4] = {
+		{ 0, 0, 0, 255 }, { 255, 255, 255, 255 }, { 255, 0, 0, 0 }, { 0, 255, 0, 128 },
+		{ 132, 130, 123, 77 }, { 16, 223, 57, 200 }, { 8, 4, 8, 1 },
+	};
+	bool ok = true;
+	for (int f = 0; f < 4; f++){
+		BlockFormat format = (BlockFormat)f;
+		size_t wrong = 0;
+		for (size_t c = 0; c < sizeof(colors) / sizeof(colors[0]); c++){
+			std::vector<unsigned char> rgba, decoded;
+			for (int i = 0; i < 8 * 8; i++)
+				rgba.insert(rgba.end(), colors[c], colors[c] + 4);
+			if ( format == BLOCK_BC1 ) // Opaque : alpha < 128 would be transparent
+				for (size_t i = 3; i < rgba.size(); i += 4)
+					rgba[i] = 255;
+			if ( !roundTrip(format, rgba, 8, 8, decoded) || psnr(format, rgba, decoded) != 99.0 )
+				wrong++;
+		}
+		printf("  %s solid blocks : %u wrong %s\n", formatNames[f], (unsigned int)wrong, wrong ? "FAILED" : "");
+		ok = ok && wrong == 0;
+	}
+	return ok;
+}
+
+// The last row and column are repeated to fill the blocks : the same image padded that way to a
+// multiple of 4 pixels must give the same pixels, byte for byte
+static bool checkOddSizes(){
+	const unsigned int sizes[][2] = { { 1, 1 }, { 3, 5 }, { 7, 2 }, { 13, 17 }, { 4, 1 }, { 1, 9 } };
+	bool ok = true;
+	for (int f = 0; f < 4; f++){
+		BlockFormat format = (BlockFormat)f;
+		size_t wrong = 0;
+		bool guards = true;
+		for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++){
+			unsigned int width = sizes[s][0], height = sizes[s][1];
+			unsigned int paddedWidth = (width + 3) & ~3u, paddedHeight = (height + 3) & ~3u;
+			std::vector<unsigned char> rgba, padded((size_t)paddedWidth * paddedHeight * 4), decoded, decodedPadded;
+			makeGradient(rgba, width, height, 40);
+			for (unsigned int y = 0; y < paddedHeight; y++)
+				for (unsigned int x = 0; x < paddedWidth; x++)
+					memcpy(&padded[((size_t)y * paddedWidth + x) * 4], &rgba[((size_t)std::min(y, height-1) * width + std::min(x, width-1)) * 4], 4);
+			guards = roundTrip(format, rgba, width, height, decoded) && guards;
+			guards = roundTrip(format, padded, paddedWidth, paddedHeight, decodedPadded) && guards;
+			for (unsigned int y = 0; y < height; y++)
+				if ( memcmp(&decoded[(size_t)y * width * 4], &decodedPadded[(size_t)y * paddedWidth * 4], width * 4) != 0 )
+					wrong++;
+		}
+		bool good = guards && wrong == 0;
+		printf("  %s odd sizes : %u rows differ from the padded image%s %s\n", formatNames[f], (unsigned int)wrong,
+			guards ? "" : ", written past the end", good ? "" : "FAILED");
+		ok = ok && good;
+	}
+	return ok;
+}
+
+static bool checkTransparency(){
+	// Alpha 0, 127, 128 and 255 in every block, on colors
+	std::vector<unsigned char> rgba, decoded;
+	makeGradient(rgba, 64, 64, 0);
+	const unsigned char alphas[4] = { 0, 127, 128, 255 };
+	for (size_t i = 0; i < rgba.size() / 4; i++)
+		rgba[i * 4 + 3] = alphas[(i + i / 64) % 4];
+	bool ok = roundTrip(BLOCK_BC1, rgba, 64, 64, decoded);
+	size_t wrong = 0;
+	for (size_t i = 0; i < rgba.size(); i += 4){
+		bool transparent = rgba[i + 3] < 128;
+		if ( transparent ? (decoded[i] | decoded[i+1] | decoded[i+2] | decoded[i+3]) != 0 : decoded[i+3] != 255 )
+			wrong++;
+	}
+	// The same image without any transparent pixel must stay opaque
+	for (size_t i = 3; i < rgba.size(); i += 4)
+		rgba[i] = std::max(rgba[i], (unsigned char)128);
+	ok = roundTrip(BLOCK_BC1, rgba, 64, 64, decoded) && ok;
+	for (size_t i = 3; i < rgba.size(); i += 4)
+		if ( decoded[i] != 255 )
+			wrong++;
+	ok = ok && wrong == 0;
+	printf("  BC1 transparency : %u wrong pixels %s\n", (unsigned int)wrong, ok ? "" : "FAILED");
+	return ok;
+}
+
+static bool checkGradient(){
+	// Minimum PSNR on a smooth 256x256 gradient
+	const double minimum[] = { 40.0, 40.0, 50.0, 50.0 };
+	std::vector<unsigned char> rgba, decoded;
+	makeGradient(rgba, 256, 256, 0);
+	bool ok = true;
+	for (int f = 0; f < 4; f++){
+		BlockFormat format = (BlockFormat)f;
+		std::vector<unsigned char> source = rgba;
+		if ( format == BLOCK_BC1 )
+			for (size_t i = 3; i < source.size(); i += 4)
+				source[i] = 255;
+		bool good = roundTrip(format, source, 256, 256, decoded);
+		double db = psnr(format, source, decoded);
+		good = good && db >= minimum[f];
+		printf("  %s gradient : PSNR %.1f dB (at least %.0f) %s\n", formatNames[f], db, minimum[f], good ? "" : "FAILED");
+		ok = ok && good;
+	}
+	return ok;
+}
+
+// Best of several runs, for at least 0.5 s
+template <typename F>
+static double bestSeconds(F function){
+	double best = 1e30, total = 0;
+	while ( total < 0.5 ){
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		function();
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		best = std::min(best, seconds);
+		total += seconds;
+	}
+	return best;
+}
+
+int main(int argc, char ** argv){
+	unsigned int size = argc > 1 ? (unsigned int)atoi(argv[1]) : 2048;
+	bool ok = true;
+
+	printf("Round trips\n");
+	ok = checkSolid() && ok;
+	ok = checkOddSizes() && ok;
+	ok = checkTransparency() && ok;
+	ok = checkGradient() && ok;
+
+	printf("Speed, %ux%u noisy gradient\n", size, size);
+	std::vector<unsigned char> rgba, decoded((size_t)size * size * 4);
+	makeGradient(rgba, size, size, 8);
+	double megapixels = (double)size * size * 1e-6;
+	for (int f = 0; f < 4; f++){
+		BlockFormat format = (BlockFormat)f;
+		std::vector<unsigned char> blocks(compressedSize(format, size, size));
+		double encode = bestSeconds([&](){ compressImage(format, rgba.data(), size, size, blocks.data()); });
+		double decode = bestSeconds([&](){ decompressImage(format, blocks.data(), size, size, decoded.data()); });
+		printf("  %s : encode %7.1f Mpixel/s, decode %7.1f Mpixel/s, PSNR %.1f dB\n", formatNames[f],
+			megapixels / encode, megapixels / decode, psnr(format, rgba, decoded));
+	}
+
+	printf(ok ? "OK\n" : "FAILED\n");
+	return ok ? 0 : 1;
+}
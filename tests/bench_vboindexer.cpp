@@ -0,0 +1,136 @@
+// Benchmark of indexVBO_TBN (see common/vboindexer.cpp) against the linear search it replaced.
+// The meshes are subdivided a few times to get more vertices (the linear search is O(n^2)),
+// and both outputs must be exactly the same, byte for byte.
+//
+//	bench_vboindexer [levels] [file.obj ...]
+//
+// Run from the root of the repository. Returns 1 if the outputs differ.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <chrono>
+
+#include <glm/glm.hpp>
+
+#include <common/objloader.hpp>
+#include <common/vboindexer.hpp>
+#include <common/tangentspace.hpp>
+
+// In vboindexer.cpp : the linear search, still used by indexVBO_slow
+bool getSimilarVertexIndex(
+	glm::vec3 & in_vertex,
+	glm::vec2 & in_uv,
+	glm::vec3 & in_normal,
+	std::vector<glm::vec3> & out_vertices,
+	std::vector<glm::vec2> & out_uvs,
+	std::vector<glm::vec3> & out_normals,
+	unsigned int & result
+);
+
+// indexVBO_TBN as it was before the grid
+static void indexVBO_TBN_linear(
+	std::vector<glm::vec3> & in_vertices,
+	std::vector<glm::vec2> & in_uvs,
+	std::vector<glm::vec3> & in_normals,
+	std::vector<glm::vec3> & in_tangents,
+	std::vector<glm::vec3> & in_bitangents,
+
+	std::vector<unsigned int> & out_indices,
+	std::vector<glm::vec3> & out_vertices,
+	std::vector<glm::vec2> & out_uvs,
+	std::vector<glm::vec3> & out_normals,
+	std::vector<glm::vec3> & out_tangents,
+	std::vector<glm::vec3> & out_bitangents
+){
+	for ( unsigned int i=0; i<in_vertices.size(); i++ ){
+		unsigned int index;
+		if ( getSimilarVertexIndex(in_vertices[i], in_uvs[i], in_normals[i], out_vertices, out_uvs, out_normals, index) ){
+			out_indices.push_back( index );
+			out_tangents[index] += in_tangents[i];
+			out_bitangents[index] += in_bitangents[i];
+		}else{
+			out_vertices.push_back( in_vertices[i]);
+			out_uvs     .push_back( in_uvs[i]);
+			out_normals .push_back( in_normals[i]);
+			out_tangents .push_back( in_tangents[i]);
+			out_bitangents .push_back( in_bitangents[i]);
+			out_indices .push_back( (unsigned int)out_vertices.size() - 1 );
+		}
+	}
+}
+
+// Cuts each triangle in 4, through the middles of its edges
+static void subdivide(std::vector<glm::vec3> & vertices, std::vector<glm::vec2> & uvs, std::vector<glm::vec3> & normals){
+	static const int corners[12] = { 0,3,5, 3,1,4, 5,4,2, 3,4,5 };
+	std::vector<glm::vec3> newVertices, newNormals;
+	std::vector<glm::vec2> newUvs;
+	for (size_t i = 0; i + 2 < vertices.size(); i += 3){
+		glm::vec3 v[6] = { vertices[i], vertices[i+1], vertices[i+2],
+			(vertices[i] + vertices[i+1]) * 0.5f, (vertices[i+1] + vertices[i+2]) * 0.5f, (vertices[i+2] + vertices[i]) * 0.5f };
+		glm::vec2 t[6] = { uvs[i], uvs[i+1], uvs[i+2],
+			(uvs[i] + uvs[i+1]) * 0.5f, (uvs[i+1] + uvs[i+2]) * 0.5f, (uvs[i+2] + uvs[i]) * 0.5f };
+		glm::vec3 n[6] = { normals[i], normals[i+1], normals[i+2],
+			glm::normalize(normals[i] + normals[i+1]), glm::normalize(normals[i+1] + normals[i+2]), glm::normalize(normals[i+2] + normals[i]) };
+		for (int k = 0; k < 12; k++){
+			newVertices.push_back(v[corners[k]]);
+			newUvs.push_back(t[corners[k]]);
+			newNormals.push_back(n[corners[k]]);
+		}
+	}
+	vertices.swap(newVertices);
+	uvs.swap(newUvs);
+	normals.swap(newNormals);
+}
+
+template <typename T>
+static bool sameBytes(const std::vector<T> & a, const std::vector<T> & b){
+	return a.size() == b.size() && (a.empty() || memcmp(&a[0], &b[0], a.size() * sizeof(T)) == 0);
+}
+
+static double milliseconds(std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end){
+	return std::chrono::duration<double, std::milli>(end - begin).count();
+}
+
+int main(int argc, char ** argv){
+	int levels = argc > 1 ? atoi(argv[1]) : 3;
+	std::vector<const char *> files;
+	for (int a = 2; a < argc; a++)
+		files.push_back(argv[a]);
+	if ( files.empty() ){
+		files.push_back("tutorial13_normal_mapping/cylinder.obj");
+		files.push_back("tutorial09_vbo_indexing/suzanne.obj");
+	}
+
+	bool allSame = true;
+	for (size_t f = 0; f < files.size(); f++){
+		std::vector<glm::vec3> vertices, normals;
+		std::vector<glm::vec2> uvs;
+		if ( !loadOBJ(files[f], vertices, uvs, normals) )
+			return 1;
+		for (int level = 0; level <= levels; level++){
+			if ( level > 0 )
+				subdivide(vertices, uvs, normals);
+			std::vector<glm::vec3> tangents, bitangents;
+			computeTangentBasis(vertices, uvs, normals, tangents, bitangents);
+
+			std::vector<unsigned int> indices1, indices2;
+			std::vector<glm::vec3> vertices1, normals1, tangents1, bitangents1, vertices2, normals2, tangents2, bitangents2;
+			std::vector<glm::vec2> uvs1, uvs2;
+			std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+			indexVBO_TBN_linear(vertices, uvs, normals, tangents, bitangents, indices1, vertices1, uvs1, normals1, tangents1, bitangents1);
+			std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+			indexVBO_TBN(vertices, uvs, normals, tangents, bitangents, indices2, vertices2, uvs2, normals2, tangents2, bitangents2);
+			std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+
+			bool same = sameBytes(indices1, indices2) && sameBytes(vertices1, vertices2) && sameBytes(uvs1, uvs2)
+				&& sameBytes(normals1, normals2) && sameBytes(tangents1, tangents2) && sameBytes(bitangents1, bitangents2);
+			allSame = allSame && same;
+			printf("%s, %d subdivisions : %7u in -> %6u out : linear %8.1f ms, grid %6.1f ms (%5.1fx), output %s\n",
+				files[f], level, (unsigned int)vertices.size(), (unsigned int)vertices2.size(),
+				milliseconds(t0, t1), milliseconds(t1, t2), milliseconds(t0, t1) / milliseconds(t1, t2), same ? "identical" : "DIFFERENT");
+		}
+	}
+	return allSame ? 0 : 1;
+}
@@ -0,0 +1,221 @@
+// Tests of the DDS parser (see common/ddsfile.cpp) on headers written here :
+// - a DX10 BC7 sRGB cube array : the format, the flags, and where every level is,
+// - a 300x20 BC1 chain (not a power of two, 9 levels) : the exact offset and size of each level,
+// - files which must be refused : truncated by a byte, a partial cubemap, more levels than
+//   the chain can have, a huge arraySize, an unknown FourCC, a DX10 header cut short...,
+// - a DDSFile parsing another file mustn't keep the format of the last one,
+// - the DDS files of the tutorials : they must open, and their last level end exactly at the
+//   end of the file.
+//
+//	test_ddsfile [file.DDS ...]
+//
+// Run from the root of the repository. Returns 1 if a check fails.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <common/ddsfile.hpp>
+
+#define FOURCC(a, b, c, d) ((unsigned int)(a) | ((unsigned int)(b) << 8) | ((unsigned int)(c) << 16) | ((unsigned int)(d) << 24))
+
+static void writeUint(std::vector<unsigned char> & file, size_t offset, unsigned int value){
+	for (int i = 0; i < 4; i++)
+		file[offset + i] = (unsigned char)(value >> (8 * i));
+}
+
+// "DDS " and the 124 bytes of the header, then the DX10 header if dxgiFormat != 0,
+// then dataSize bytes of data (0, 1, 2, ... to tell the levels apart)
+static std::vector<unsigned char> makeDDS(unsigned int width, unsigned int height, unsigned int mipCount,
+                                          unsigned int fourCC, unsigned int caps2, size_t dataSize,
+                                          unsigned int dxgiFormat = 0, unsigned int miscFlags = 0, unsigned int arraySize = 1){
+	size_t headerSize = 128 + (dxgiFormat ? 20 : 0);
+	std::vector<unsigned char> file(headerSize + dataSize, 0);
+	memcpy(&file[0], "DDS ", 4);
+	writeUint(file, 4, 124);
+	writeUint(file, 4 + 4, 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000); // caps, height, width, pixel format, mipmap count
+	writeUint(file, 4 + 8, height);
+	writeUint(file, 4 + 12, width);
+	writeUint(file, 4 + 24, mipCount);
+	writeUint(file, 4 + 72, 32);
+	writeUint(file, 4 + 72 + 4, 0x4); // DDPF_FOURCC
+	writeUint(file, 4 + 72 + 8, dxgiFormat ? FOURCC('D','X','1','0') : fourCC);
+	writeUint(file, 4 + 104, 0x1000 | (mipCount > 1 ? 0x400008 : 0));
+	writeUint(file, 4 + 108, caps2);
+	if ( dxgiFormat ){
+		writeUint(file, 128, dxgiFormat);
+		writeUint(file, 128 + 4, 3); // TEXTURE2D
+		writeUint(file, 128 + 8, miscFlags);
+		writeUint(file, 128 + 12, arraySize);
+	}
+	for (size_t i = 0; i < dataSize; i++)
+		file[headerSize + i] = (unsigned char)i;
+	return file;
+}
+
+static bool report(const char * name, bool good){
+	printf("  %s%s\n", name, good ? "" : " FAILED");
+	return good;
+}
+
+// 3 layers of 6 faces of 64x64 BC7 sRGB, 7 levels down to 1x1
+static bool checkCubeArray(){
+	// 16 bytes per 4x4 block : 4096, 1024, 256, 64, then a single block for 4x4, 2x2 and 1x1
+	const size_t sizes[7] = { 4096, 1024, 256, 64, 16, 16, 16 };
+	const size_t chain = 5488;
+	std::vector<unsigned char> file = makeDDS(64, 64, 7, 0, 0, 3 * 6 * chain, 99, 0x4, 3);
+	DDSFile dds;
+	if ( !dds.parse(file.data(), file.size()) )
+		return report("BC7 sRGB cube array : refused", false);
+	bool good = dds.format == DDS_FORMAT_BC7 && dds.srgb && !dds.signedFormat && dds.cubemap && dds.faces == 6
+	         && dds.arraySize == 3 && dds.mipCount == 7 && dds.width == 64 && dds.height == 64 && dds.depth == 1
+	         && dds.compressed() && dds.bytesPerBlock == 16;
+	size_t wrong = 0;
+	for (unsigned int layer = 0; layer < 3; layer++){
+		for (unsigned int face = 0; face < 6; face++){
+			size_t offset = 148 + (layer * 6 + face) * chain;
+			for (unsigned int mip = 0; mip < 7; mip++){
+				const DDSLevel & level = dds.level(layer, face, mip);
+				if ( level.data != file.data() + offset || level.size != sizes[mip] || level.width != (64u >> mip) || level.height != (64u >> mip) || level.depth != 1 )
+					wrong++;
+				offset += sizes[mip];
+			}
+		}
+	}
+	good = good && wrong == 0;
+	printf("  BC7 sRGB cube array : 3 layers x 6 faces x 7 levels, %u misplaced%s\n", (unsigned int)wrong, good ? "" : " FAILED");
+	return good;
+}
+
+// 300x20 BC1 : 9 levels, the height stays at 1 from the 5th one
+static bool checkChain(){
+	const unsigned int widths[9]  = { 300, 150, 75, 37, 18, 9, 4, 2, 1 };
+	const unsigned int heights[9] = { 20, 10, 5, 2, 1, 1, 1, 1, 1 };
+	// 8 bytes per block : 75x5, 38x3, 19x2, 10x1, 5x1, 3x1, then single blocks
+	const size_t offsets[9] = { 128, 3128, 4040, 4344, 4424, 4464, 4488, 4496, 4504 };
+	const size_t sizes[9]   = { 3000, 912, 304, 80, 40, 24, 8, 8, 8 };
+	std::vector<unsigned char> file = makeDDS(300, 20, 9, FOURCC('D','X','T','1'), 0, 4512 - 128);
+	DDSFile dds;
+	if ( !dds.parse(file.data(), file.size()) )
+		return report("300x20 BC1 chain : refused", false);
+	bool good = dds.format == DDS_FORMAT_BC1 && !dds.srgb && !dds.cubemap && dds.faces == 1 && dds.arraySize == 1 && dds.mipCount == 9;
+	size_t wrong = 0;
+	for (unsigned int mip = 0; mip < 9; mip++){
+		const DDSLevel & level = dds.level(0, 0, mip);
+		if ( level.data != file.data() + offsets[mip] || level.size != sizes[mip] || level.width != widths[mip] || level.height != heights[mip] )
+			wrong++;
+	}
+	good = good && wrong == 0;
+	printf("  300x20 BC1 chain : 9 levels, %u misplaced%s\n", (unsigned int)wrong, good ? "" : " FAILED");
+	return good;
+}
+
+// The parser says why on the line before
+static bool checkRefused(const char * name, const std::vector<unsigned char> & file){
+	DDSFile dds;
+	bool refused = !dds.parse(file.data(), file.size());
+	printf("  %s : %s%s\n", name, refused ? "refused" : "accepted", refused ? "" : " FAILED");
+	return refused;
+}
+
+static bool checkRejections(){
+	bool ok = true;
+	std::vector<unsigned char> truncated = makeDDS(300, 20, 9, FOURCC('D','X','T','1'), 0, 4512 - 128 - 1);
+	ok = checkRefused("a byte missing at the end", truncated) && ok;
+	std::vector<unsigned char> header(truncated.begin(), truncated.begin() + 127);
+	ok = checkRefused("a header cut short", header) && ok;
+	// Only +X : the other faces are missing
+	std::vector<unsigned char> partial = makeDDS(16, 16, 1, FOURCC('D','X','T','1'), 0x200 | 0x400, 6 * 128);
+	ok = checkRefused("a partial cubemap", partial) && ok;
+	std::vector<unsigned char> mips = makeDDS(300, 20, 10, FOURCC('D','X','T','1'), 0, 8192);
+	ok = checkRefused("10 levels for 300x20", mips) && ok;
+	std::vector<unsigned char> huge = makeDDS(4, 4, 1, 0, 0, 1024, 71, 0, 0x40000000);
+	ok = checkRefused("an arraySize of 2^30", huge) && ok;
+	std::vector<unsigned char> unknown = makeDDS(4, 4, 1, FOURCC('A','B','C','D'), 0, 1024);
+	ok = checkRefused("an unknown FourCC", unknown) && ok;
+	std::vector<unsigned char> dx10 = makeDDS(4, 4, 1, 0, 0, 0, 71);
+	dx10.resize(128 + 19);
+	ok = checkRefused("a DX10 header cut short", dx10) && ok;
+	std::vector<unsigned char> notSquare = makeDDS(16, 8, 1, 0, 0, 6 * 128, 71, 0x4);
+	ok = checkRefused("a cubemap which isn't square", notSquare) && ok;
+	std::vector<unsigned char> empty = makeDDS(0, 16, 1, FOURCC('D','X','T','1'), 0, 1024);
+	ok = checkRefused("a width of 0", empty) && ok;
+	return ok;
+}
+
+// Parsed again with the same DDSFile : nothing must be left from the file before
+static bool checkReuse(){
+	std::vector<unsigned char> bc7 = makeDDS(4, 4, 1, 0, 0, 16, 99);
+	std::vector<unsigned char> noFormat = makeDDS(4, 4, 1, 0, 0, 16);
+	writeUint(noFormat, 4 + 72 + 4, 0); // Neither FourCC nor RGB
+	DDSFile dds;
+	bool good = dds.parse(bc7.data(), bc7.size()) && dds.srgb;
+	good = good && !dds.parse(noFormat.data(), noFormat.size());
+	std::vector<unsigned char> bc1 = makeDDS(4, 4, 1, FOURCC('D','X','T','1'), 0, 8);
+	good = good && dds.parse(bc1.data(), bc1.size()) && dds.format == DDS_FORMAT_BC1 && !dds.srgb;
+	return report("parsed again : nothing left from the previous file", good);
+}
+
+static bool checkFile(const char * path){
+	// Read here, to know where the file starts : open() maps it again, and must agree
+	std::vector<unsigned char> file;
+	FILE * stream = fopen(path, "rb");
+	if ( stream ){
+		unsigned char buffer[4096];
+		size_t count;
+		while ( (count = fread(buffer, 1, sizeof(buffer), stream)) > 0 )
+			file.insert(file.end(), buffer, buffer + count);
+		fclose(stream);
+	}
+	DDSFile opened, parsed;
+	if ( file.empty() || !opened.open(path) || !parsed.parse(file.data(), file.size()) )
+		return report(path, false);
+	const DDSLevel & last = parsed.level(parsed.arraySize - 1, parsed.faces - 1, parsed.mipCount - 1);
+	size_t end = (size_t)(last.data - file.data()) + last.size;
+	bool good = end == file.size() && opened.format == parsed.format && opened.mipCount == parsed.mipCount
+	         && memcmp(opened.level(0, 0, 0).data, parsed.level(0, 0, 0).data, parsed.level(0, 0, 0).size) == 0;
+	printf("  %s : %ux%u, %u levels, %u bytes, the levels end at %u%s\n", path, parsed.width, parsed.height, parsed.mipCount,
+		(unsigned int)file.size(), (unsigned int)end, good ? "" : " FAILED");
+	return good;
+}
+
+int main(int argc, char * argv[]){
+	std::vector<const char *> files;
+	for (int i=1; i<argc; i++)
+		files.push_back(argv[i]);
+	if ( files.empty() ){
+		files.push_back("tutorial05_textured_cube/uvtemplate.DDS");
+		files.push_back("tutorial06_keyboard_and_mouse/uvtemplate.DDS");
+		files.push_back("tutorial07_model_loading/uvmap.DDS");
+		files.push_back("tutorial08_basic_shading/uvmap.DDS");
+		files.push_back("tutorial09_vbo_indexing/uvmap.DDS");
+		files.push_back("tutorial10_transparency/uvmap.DDS");
+		files.push_back("tutorial11_2d_fonts/Holstein.DDS");
+		files.push_back("tutorial11_2d_fonts/uvmap.DDS");
+		files.push_back("tutorial12_extensions/uvmap.DDS");
+		files.push_back("tutorial13_normal_mapping/diffuse.DDS");
+		files.push_back("tutorial13_normal_mapping/specular.DDS");
+		files.push_back("tutorial14_render_to_texture/uvmap.DDS");
+		files.push_back("tutorial15_lightmaps/lightmap.DDS");
+		files.push_back("tutorial16_shadowmaps/uvmap.DDS");
+		files.push_back("tutorial17_rotations/uvmap.DDS");
+		files.push_back("tutorial18_billboards_and_particles/ExampleBillboard.DDS");
+		files.push_back("tutorial18_billboards_and_particles/particle.DDS");
+		files.push_back("misc05_picking/uvmap.DDS");
+	}
+
+	bool ok = true;
+	printf("Synthetic headers\n");
+	ok = checkCubeArray() && ok;
+	ok = checkChain() && ok;
+	ok = checkRejections() && ok;
+	ok = checkReuse() && ok;
+
+	printf("Files\n");
+	for (size_t f=0; f<files.size(); f++)
+		ok = checkFile(files[f]) && ok;
+
+	printf(ok ? "OK\n" : "FAILED\n");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,240 @@
+// Tests of the index buffer compression (see common/indexcodec.cpp) :
+// - round trips in 16 and 32 bits : empty, degenerate triangles, the whole 32 bit range,
+//   random triangles, and optimized meshes (suzanne, a grid),
+// - corrupted data : every truncation and every single bit flip must be rejected (unless it still
+//   decodes to the same triangles : degenerate triangles have several encodings), and the decoder
+//   must never write an index which isn't below vertexCount, even from random bytes,
+// - decoding speed, in GB/s of indices written, on suzanne and on a big grid.
+//
+//	test_indexcodec [file.obj]
+//
+// Run from the root of the repository. Returns 1 if a check fails.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <chrono>
+
+#include <glm/glm.hpp>
+
+#include <common/objloader.hpp>
+#include <common/meshoptimizer.hpp>
+#include <common/indexcodec.hpp>
+
+// Deterministic, unlike rand()
+static unsigned int random32(unsigned int & seed){
+	seed = seed * 1664525u + 1013904223u;
+	return seed ^ (seed >> 16);
+}
+
+// The decoder can rotate the triangles : (b,c,a) is the same triangle as (a,b,c)
+template <typename T_INDEX>
+static bool sameTriangles(const std::vector<T_INDEX> & expected, const std::vector<T_INDEX> & decoded){
+	if ( expected.size() != decoded.size() )
+		return false;
+	for (size_t i = 0; i + 2 < expected.size(); i += 3){
+		const T_INDEX * e = &expected[i];
+		const T_INDEX * d = &decoded[i];
+		bool same = false;
+		for (int r = 0; r < 3 && !same; r++)
+			same = e[0] == d[r] && e[1] == d[(r+1) % 3] && e[2] == d[(r+2) % 3];
+		if ( !same )
+			return false;
+	}
+	return true;
+}
+
+template <typename T_INDEX>
+static bool roundTrip(const char * name, const std::vector<T_INDEX> & indices, size_t vertexCount){
+	std::vector<unsigned char> encoded;
+	encodeIndexBuffer(indices, encoded);
+	std::vector<T_INDEX> decoded(indices.size());
+	bool ok = decodeIndexBuffer(decoded.data(), decoded.size(), vertexCount, encoded.data(), encoded.size())
+		&& sameTriangles(indices, decoded)
+		&& encoded.size() <= indexBufferBound(indices.size());
+	printf("  %-30s %2u bits : %8u triangles, %8u bytes %s\n", name, (unsigned int)(8 * sizeof(T_INDEX)),
+		(unsigned int)(indices.size() / 3), (unsigned int)encoded.size(), ok ? "" : "FAILED");
+
+	// One vertex less : the biggest index isn't valid anymore
+	if ( ok && !indices.empty() ){
+		T_INDEX biggest = 0;
+		for (size_t i = 0; i < indices.size(); i++)
+			if ( indices[i] > biggest )
+				biggest = indices[i];
+		if ( decodeIndexBuffer(decoded.data(), decoded.size(), (size_t)biggest, encoded.data(), encoded.size()) ){
+			printf("  %s : decoded with vertexCount = %u, the biggest index\n", name, (unsigned int)biggest);
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+// Decodes corrupted data : must return false, and anything written must be below vertexCount
+template <typename T_INDEX>
+static bool rejected(std::vector<T_INDEX> & decoded, size_t vertexCount, const std::vector<unsigned char> & corrupted, size_t size, bool & outOfRange){
+	for (size_t i = 0; i < decoded.size(); i++)
+		decoded[i] = 0;
+	bool decodedOk = decodeIndexBuffer(decoded.data(), decoded.size(), vertexCount, corrupted.data(), size);
+	for (size_t i = 0; i < decoded.size(); i++)
+		if ( decoded[i] >= vertexCount )
+			outOfRange = true;
+	return !decodedOk;
+}
+
+template <typename T_INDEX>
+static bool corruption(const char * name, const std::vector<T_INDEX> & indices, size_t vertexCount){
+	std::vector<unsigned char> encoded;
+	encodeIndexBuffer(indices, encoded);
+	std::vector<T_INDEX> decoded(indices.size());
+	std::vector<unsigned char> corrupted = encoded;
+	bool outOfRange = false;
+	size_t truncations = 0, flips = 0, garbage = 0;
+
+	for (size_t size = 0; size < encoded.size(); size++)
+		if ( !rejected(decoded, vertexCount, encoded, size, outOfRange) )
+			truncations++;
+
+	for (size_t bit = 0; bit < 8 * encoded.size(); bit++){
+		corrupted[bit / 8] ^= (unsigned char)(1 << (bit % 8));
+		if ( !rejected(decoded, vertexCount, corrupted, corrupted.size(), outOfRange) && !sameTriangles(indices, decoded) )
+			flips++;
+		corrupted[bit / 8] = encoded[bit / 8];
+	}
+
+	// Random bytes after a valid version byte : they may happen to decode, but never out of range
+	unsigned int seed = 1;
+	for (int n = 0; n < 1000; n++){
+		for (size_t i = 1; i < corrupted.size(); i++)
+			corrupted[i] = (unsigned char)random32(seed);
+		if ( !rejected(decoded, vertexCount, corrupted, corrupted.size(), outOfRange) )
+			garbage++;
+	}
+
+	bool ok = truncations == 0 && flips == 0 && !outOfRange;
+	printf("  %-30s %2u bits : %u truncations and %u bit flips wrongly accepted, %u/1000 random buffers accepted%s %s\n",
+		name, (unsigned int)(8 * sizeof(T_INDEX)), (unsigned int)truncations, (unsigned int)flips, (unsigned int)garbage,
+		outOfRange ? ", indices out of range" : "", ok ? "" : "FAILED");
+	return ok;
+}
+
+template <typename T_INDEX>
+static void speed(const char * name, const std::vector<T_INDEX> & indices, size_t vertexCount){
+	std::vector<unsigned char> encoded;
+	encodeIndexBuffer(indices, encoded);
+	std::vector<T_INDEX> decoded(indices.size());
+
+	// Repeated for at least 0.5 s, the best run counts
+	double best = 1e30, total = 0;
+	while ( total < 0.5 ){
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		decodeIndexBuffer(decoded.data(), decoded.size(), vertexCount, encoded.data(), encoded.size());
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		if ( seconds < best )
+			best = seconds;
+		total += seconds;
+	}
+	printf("  %-30s %2u bits : %.2f bytes per triangle, decoded at %.2f GB/s (%.0f M triangles/s)\n",
+		name, (unsigned int)(8 * sizeof(T_INDEX)), (double)encoded.size() / (indices.size() / 3),
+		indices.size() * sizeof(T_INDEX) / best * 1e-9, indices.size() / 3 / best * 1e-6);
+}
+
+// width x height quads, optimized like the mesh cache does
+static void makeGrid(std::vector<unsigned int> & indices, std::vector<glm::vec3> & vertices, unsigned int width, unsigned int height){
+	for (unsigned int y = 0; y <= height; y++)
+		for (unsigned int x = 0; x <= width; x++)
+			vertices.push_back(glm::vec3((float)x, (float)y, 0.0f));
+	for (unsigned int y = 0; y < height; y++){
+		for (unsigned int x = 0; x < width; x++){
+			unsigned int a = y * (width+1) + x, b = a + width+1;
+			unsigned int quad[6] = { a, a+1, b, a+1, b+1, b };
+			indices.insert(indices.end(), quad, quad+6);
+		}
+	}
+	optimizeVertexCache(indices, vertices.size());
+	std::vector<glm::vec2> uvs(vertices.size());
+	std::vector<glm::vec3> normals(vertices.size());
+	optimizeVertexFetch(indices, vertices, uvs, normals, NULL, NULL);
+}
+
+template <typename T_INDEX>
+static std::vector<T_INDEX> narrow(const std::vector<unsigned int> & indices){
+	return std::vector<T_INDEX>(indices.begin(), indices.end());
+}
+
+int main(int argc, char * argv[]){
+	const char * path = argc > 1 ? argv[1] : "tutorial09_vbo_indexing/suzanne.obj";
+	bool ok = true;
+
+	// Suzanne, optimized like the mesh cache does
+	std::vector<unsigned int> suzanne;
+	std::vector<glm::vec3> vertices;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+	if ( !loadOBJ(path, suzanne, vertices, uvs, normals) ){
+		printf("Can't load %s\n", path);
+		return 1;
+	}
+	optimizeVertexCache(suzanne, vertices.size());
+	optimizeVertexFetch(suzanne, vertices, uvs, normals, NULL, NULL);
+	size_t suzanneVertices = vertices.size();
+
+	std::vector<unsigned int> grid;
+	std::vector<glm::vec3> gridVertices;
+	makeGrid(grid, gridVertices, 200, 200); // 40401 vertices : too many for 16 bits
+
+	// No locality at all : every vertex is explicit
+	unsigned int seed = 12345;
+	std::vector<unsigned int> random16, random32bits;
+	for (int i = 0; i < 3 * 1000; i++){
+		random16.push_back(random32(seed) & 0xffff);
+		random32bits.push_back(random32(seed));
+	}
+
+	// (a,a,a), (a,a,b), (a,b,a), (b,a,a), and the same with a vertex seen before
+	unsigned int degenerateTriangles[] = { 0,0,0, 1,1,2, 3,4,3, 6,5,5, 0,0,1, 7,2,2, 3,3,3, 8,9,10, 9,8,8 };
+	std::vector<unsigned int> degenerate(degenerateTriangles, degenerateTriangles + sizeof(degenerateTriangles) / sizeof(unsigned int));
+
+	// The ends of the 32 bit range : the differences between explicit vertices wrap around
+	unsigned int extremeTriangles[] = { 0,0xffffffffu,1, 0xfffffffeu,0,0xffffffffu, 0x80000000u,0x7fffffffu,0, 0xffffffffu,0x80000000u,0xfffffffdu };
+	std::vector<unsigned int> extreme(extremeTriangles, extremeTriangles + sizeof(extremeTriangles) / sizeof(unsigned int));
+	unsigned int extreme16Triangles[] = { 0,0xffff,1, 0xfffe,0,0xffff, 0x8000,0x7fff,0, 0xffff,0x8000,0xfffd };
+	std::vector<unsigned int> extreme16(extreme16Triangles, extreme16Triangles + sizeof(extreme16Triangles) / sizeof(unsigned int));
+
+	printf("Round trips\n");
+	ok = roundTrip("empty", std::vector<unsigned short>(), 0) && ok;
+	ok = roundTrip("empty", std::vector<unsigned int>(), 0) && ok;
+	ok = roundTrip("degenerate", narrow<unsigned short>(degenerate), 11) && ok;
+	ok = roundTrip("degenerate", degenerate, 11) && ok;
+	ok = roundTrip("0 to 0xffff", narrow<unsigned short>(extreme16), 0x10000) && ok;
+	ok = roundTrip("0 to 0xffff", extreme16, 0x10000) && ok;
+	if ( sizeof(size_t) > 4 )
+		ok = roundTrip("0 to 0xffffffff", extreme, (size_t)0xffffffffu + 1) && ok;
+	ok = roundTrip("random", narrow<unsigned short>(random16), 0x10000) && ok;
+	if ( sizeof(size_t) > 4 )
+		ok = roundTrip("random", random32bits, (size_t)0xffffffffu + 1) && ok;
+	ok = roundTrip(path, narrow<unsigned short>(suzanne), suzanneVertices) && ok;
+	ok = roundTrip(path, suzanne, suzanneVertices) && ok;
+	ok = roundTrip("grid 200x200", grid, gridVertices.size()) && ok;
+
+	printf("Corrupted data\n");
+	ok = corruption("degenerate", narrow<unsigned short>(degenerate), 11) && ok;
+	ok = corruption("0 to 0xffff", extreme16, 0x10000) && ok;
+	ok = corruption("random", narrow<unsigned short>(random16), 0x10000) && ok;
+	ok = corruption(path, narrow<unsigned short>(suzanne), suzanneVertices) && ok;
+	ok = corruption(path, suzanne, suzanneVertices) && ok;
+	std::vector<unsigned int> smallGrid;
+	std::vector<glm::vec3> smallGridVertices;
+	makeGrid(smallGrid, smallGridVertices, 30, 30);
+	ok = corruption("grid 30x30", smallGrid, smallGridVertices.size()) && ok;
+
+	printf("Decoding speed\n");
+	speed(path, narrow<unsigned short>(suzanne), suzanneVertices);
+	speed(path, suzanne, suzanneVertices);
+	std::vector<unsigned int> bigGrid;
+	std::vector<glm::vec3> bigGridVertices;
+	makeGrid(bigGrid, bigGridVertices, 1000, 1000);
+	speed("grid 1000x1000", bigGrid, bigGridVertices.size());
+
+	printf(ok ? "OK\n" : "FAILED\n");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,228 @@
+// Tests of buildMeshlets and cullMeshlets (see common/meshlets.cpp) :
+// - every meshlet has at most 64 vertices and 124 triangles, and the meshlets cover the
+//   index buffer one after the other,
+// - the reordered index buffer has exactly the triangles of the input (same corners, same winding),
+// - every vertex of a meshlet is inside its bounding sphere, and from any camera position inside
+//   the back of its cone, none of its triangles faces the camera,
+// - from random views, cullMeshlets never culls a meshlet with a triangle which faces the
+//   camera and has a corner inside the frustum. What it culls is printed (MeshletCullStats).
+//
+//	test_meshlets [file.obj ...]
+//
+// Run from the root of the repository. Returns 1 if a check fails.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <common/objloader.hpp>
+#include <common/meshoptimizer.hpp>
+#include <common/meshlets.hpp>
+
+static const int VIEWS = 200;
+
+// Deterministic, unlike rand()
+static unsigned int random32(unsigned int & seed){
+	seed = seed * 1664525u + 1013904223u;
+	return seed ^ (seed >> 16);
+}
+
+static float random01(unsigned int & seed){
+	return (random32(seed) >> 8) / 16777216.0f;
+}
+
+struct Triangle{
+	unsigned int corners[3];
+	bool operator<(const Triangle & other) const {
+		return std::lexicographical_compare(corners, corners + 3, other.corners, other.corners + 3);
+	}
+	bool operator==(const Triangle & other) const {
+		return std::equal(corners, corners + 3, other.corners);
+	}
+};
+
+// The smallest corner first : the same triangle with the same winding gives the same Triangle
+static std::vector<Triangle> sortedTriangles(const std::vector<unsigned int> & indices){
+	std::vector<Triangle> triangles(indices.size() / 3);
+	for (size_t t = 0; t < triangles.size(); t++){
+		const unsigned int * corners = &indices[3 * t];
+		int first = corners[1] < corners[0] ? (corners[2] < corners[1] ? 2 : 1) : (corners[2] < corners[0] ? 2 : 0);
+		for (int c = 0; c < 3; c++)
+			triangles[t].corners[c] = corners[(first + c) % 3];
+	}
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+static bool facesCamera(const std::vector<glm::vec3> & vertices, const unsigned int * corners, const glm::vec3 & camera){
+	const glm::vec3 & a = vertices[corners[0]];
+	glm::vec3 normal = glm::cross(vertices[corners[1]] - a, vertices[corners[2]] - a);
+	return glm::dot(normal, camera - a) > 1e-5f * glm::length(normal) * (1.0f + glm::length(camera - a));
+}
+
+static bool insideFrustum(const glm::mat4 & MVP, const glm::vec3 & p){
+	glm::vec4 clip = MVP * glm::vec4(p, 1.0f);
+	float w = clip.w * 0.999f;
+	return w > 0.0f && fabsf(clip.x) < w && fabsf(clip.y) < w && fabsf(clip.z) < w;
+}
+
+// Meshlet sizes, order and triangles
+static bool checkMeshlets(const std::vector<unsigned int> & input, const std::vector<unsigned int> & indices,
+                          const std::vector<Meshlet> & meshlets, size_t vertexCount){
+	size_t tooBig = 0, wrongCount = 0, maxVertices = 0, maxTriangles = 0, next = 0;
+	std::vector<unsigned int> seen(vertexCount, (unsigned int)-1);
+	for (size_t m = 0; m < meshlets.size(); m++){
+		const Meshlet & meshlet = meshlets[m];
+		if ( meshlet.indexOffset != next || meshlet.indexCount == 0 || meshlet.indexCount % 3 != 0 )
+			break;
+		next += meshlet.indexCount;
+		size_t vertices = 0;
+		for (unsigned int i = meshlet.indexOffset; i < meshlet.indexOffset + meshlet.indexCount && i < indices.size(); i++){
+			if ( seen[indices[i]] != m ){
+				seen[indices[i]] = (unsigned int)m;
+				vertices++;
+			}
+		}
+		if ( vertices > 64 || meshlet.indexCount / 3 > 124 )
+			tooBig++;
+		if ( vertices != meshlet.vertexCount )
+			wrongCount++;
+		maxVertices = std::max(maxVertices, vertices);
+		maxTriangles = std::max(maxTriangles, (size_t)meshlet.indexCount / 3);
+	}
+	bool covered = next == indices.size();
+	bool permutation = indices.size() == input.size() && sortedTriangles(indices) == sortedTriangles(input);
+	bool good = covered && permutation && tooBig == 0 && wrongCount == 0;
+	printf("  %u meshlets, at most %u vertices and %u triangles, %.1f triangles on average%s%s%s%s%s\n",
+		(unsigned int)meshlets.size(), (unsigned int)maxVertices, (unsigned int)maxTriangles,
+		meshlets.empty() ? 0.0 : (double)indices.size() / 3 / meshlets.size(),
+		covered ? "" : ", the index buffer isn't covered", permutation ? "" : ", triangles changed",
+		tooBig ? ", too big" : "", wrongCount ? ", wrong vertexCount" : "", good ? "" : " FAILED");
+	return good;
+}
+
+// Spheres around the vertices, cones behind the triangles
+static bool checkBounds(const std::vector<unsigned int> & indices, const std::vector<glm::vec3> & vertices,
+                        const std::vector<Meshlet> & meshlets, const glm::vec3 & low, const glm::vec3 & high){
+	size_t outside = 0, facing = 0, cones = 0, tested = 0;
+	unsigned int seed = 12345;
+	glm::vec3 size = high - low;
+	for (size_t m = 0; m < meshlets.size(); m++){
+		const Meshlet & meshlet = meshlets[m];
+		const unsigned int * first = &indices[meshlet.indexOffset];
+		for (unsigned int i = 0; i < meshlet.indexCount; i++)
+			if ( glm::length(vertices[first[i]] - meshlet.center) > meshlet.radius * 1.0001f + 1e-5f )
+				outside++;
+		if ( meshlet.coneCutoff > 1.0f )
+			continue;
+		cones++;
+		// Random positions around the mesh, and along the back of the cone
+		for (int p = 0; p < 64; p++){
+			glm::vec3 camera = p % 2 == 0
+				? low - size + 3.0f * size * glm::vec3(random01(seed), random01(seed), random01(seed))
+				: meshlet.coneApex - meshlet.coneAxis * (0.01f + 4.0f * random01(seed)) * glm::length(size);
+			glm::vec3 toApex = meshlet.coneApex - camera;
+			float distance = glm::length(toApex);
+			if ( !(distance > 0.0f) || glm::dot(toApex, meshlet.coneAxis) < meshlet.coneCutoff * distance )
+				continue;
+			tested++;
+			for (unsigned int t = 0; t < meshlet.indexCount; t += 3)
+				if ( facesCamera(vertices, first + t, camera) )
+					facing++;
+		}
+	}
+	bool good = outside == 0 && facing == 0;
+	printf("  bounds : %u vertices outside of their sphere, %u meshlets with a cone, %u cameras behind one see %u triangles%s\n",
+		(unsigned int)outside, (unsigned int)cones, (unsigned int)tested, (unsigned int)facing, good ? "" : " FAILED");
+	return good;
+}
+
+// Random cameras in and around the mesh, looking anywhere
+static bool checkCulling(const std::vector<unsigned int> & indices, const std::vector<glm::vec3> & vertices,
+                         const std::vector<Meshlet> & meshlets, const glm::vec3 & low, const glm::vec3 & high){
+	unsigned int seed = 4242;
+	glm::vec3 size = high - low;
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 4.0f * glm::length(size));
+	MeshletCullStats total = { 0, 0, 0, 0, 0, 0 };
+	size_t wrong = 0;
+	std::vector<MeshletDrawRange> ranges;
+	std::vector<bool> drawn;
+	for (int v = 0; v < VIEWS; v++){
+		glm::vec3 camera = low - 0.5f * size + 2.0f * size * glm::vec3(random01(seed), random01(seed), random01(seed));
+		glm::vec3 direction(random01(seed) - 0.5f, random01(seed) - 0.5f, random01(seed) - 0.5f);
+		if ( !(glm::length(direction) > 0.01f) )
+			direction = glm::vec3(0, 0, -1);
+		glm::vec3 up = fabsf(glm::normalize(direction).y) > 0.99f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+		glm::mat4 view = glm::lookAt(camera, camera + direction, up);
+		glm::mat4 MVP = projection * view;
+		glm::vec3 position = glm::vec3(glm::inverse(view)[3]);
+
+		MeshletCullStats stats = cullMeshlets(meshlets, MVP, position, ranges);
+		total.meshlets += stats.meshlets;
+		total.frustumCulled += stats.frustumCulled;
+		total.backfaceCulled += stats.backfaceCulled;
+		total.visible += stats.visible;
+		total.triangles += stats.triangles;
+		total.visibleTriangles += stats.visibleTriangles;
+
+		drawn.assign(indices.size() / 3, false);
+		for (size_t r = 0; r < ranges.size(); r++)
+			for (unsigned int i = ranges[r].indexOffset; i < ranges[r].indexOffset + ranges[r].indexCount; i += 3)
+				drawn[i / 3] = true;
+		for (size_t t = 0; t < drawn.size(); t++){
+			const unsigned int * corners = &indices[3 * t];
+			if ( !drawn[t] && facesCamera(vertices, corners, position)
+			  && (insideFrustum(MVP, vertices[corners[0]]) || insideFrustum(MVP, vertices[corners[1]]) || insideFrustum(MVP, vertices[corners[2]])) )
+				wrong++;
+		}
+	}
+	bool good = wrong == 0 && total.visible + total.frustumCulled + total.backfaceCulled == total.meshlets;
+	printf("  %d views : %.1f%% of the meshlets outside of the frustum, %.1f%% facing away, %.1f%% of the triangles drawn, "
+		"%u visible triangles culled%s\n", VIEWS, 100.0 * total.frustumCulled / total.meshlets, 100.0 * total.backfaceCulled / total.meshlets,
+		100.0 * total.visibleTriangles / total.triangles, (unsigned int)wrong, good ? "" : " FAILED");
+	return good;
+}
+
+int main(int argc, char * argv[]){
+	std::vector<const char *> files;
+	for (int i=1; i<argc; i++)
+		files.push_back(argv[i]);
+	if ( files.empty() ){
+		files.push_back("tutorial16_shadowmaps/room_thickwalls.obj");
+		files.push_back("tutorial09_vbo_indexing/suzanne.obj");
+	}
+
+	bool ok = true;
+	for (size_t f=0; f<files.size(); f++){
+		std::vector<unsigned int> input;
+		std::vector<glm::vec3> vertices, normals;
+		std::vector<glm::vec2> uvs;
+		if ( !loadOBJ(files[f], input, vertices, uvs, normals) ){
+			printf("Can't load %s\n", files[f]);
+			return 1;
+		}
+		printf("%s : %u triangles, %u vertices\n", files[f], (unsigned int)(input.size() / 3), (unsigned int)vertices.size());
+		optimizeVertexCache(input, vertices.size());
+
+		std::vector<unsigned int> indices = input;
+		std::vector<Meshlet> meshlets;
+		buildMeshlets(indices, vertices, meshlets);
+
+		glm::vec3 low = vertices[0], high = vertices[0];
+		for (size_t i = 1; i < vertices.size(); i++){
+			low = glm::min(low, vertices[i]);
+			high = glm::max(high, vertices[i]);
+		}
+		ok = checkMeshlets(input, indices, meshlets, vertices.size()) && ok;
+		ok = checkBounds(indices, vertices, meshlets, low, high) && ok;
+		ok = checkCulling(indices, vertices, meshlets, low, high) && ok;
+	}
+
+	printf(ok ? "OK\n" : "FAILED\n");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,129 @@
+// Measures what optimizeOverdraw (see common/meshoptimizer.cpp) gains, with analyzeOverdraw,
+// on the meshes of the tutorials and on generated nested spheres (where the inner spheres
+// are hidden : the order of the triangles matters most), and checks that optimizeMesh :
+// - doesn't run it unless asked,
+// - when asked, never keeps an order which draws more than the vertex cache order.
+//
+//	test_meshoptimizer [file.obj ...]
+//
+// Run from the root of the repository. Returns 1 if a check fails.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <common/objloader.hpp>
+#include <common/meshoptimizer.hpp>
+
+struct Mesh{
+	std::vector<unsigned int> indices;
+	std::vector<glm::vec3> vertices;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+};
+
+// shells spheres of radius 1, 2, ..., the innermost first
+static void makeSpheres(Mesh & mesh, int shells, int rings, int sectors){
+	for (int s=0; s<shells; s++){
+		float radius = float(s+1);
+		unsigned int first = (unsigned int)mesh.vertices.size();
+		for (int r=0; r<=rings; r++){
+			float theta = 3.14159265f * r / rings;
+			for (int t=0; t<=sectors; t++){
+				float phi = 2.0f * 3.14159265f * t / sectors;
+				glm::vec3 n(sinf(theta)*cosf(phi), cosf(theta), sinf(theta)*sinf(phi));
+				mesh.vertices.push_back(n * radius);
+				mesh.uvs.push_back(glm::vec2(float(t)/sectors, float(r)/rings));
+				mesh.normals.push_back(n);
+			}
+		}
+		for (int r=0; r<rings; r++){
+			for (int t=0; t<sectors; t++){
+				unsigned int a = first + r*(sectors+1) + t;
+				unsigned int b = a + sectors+1;
+				unsigned int tri[6] = { a, a+1, b, a+1, b+1, b };
+				mesh.indices.insert(mesh.indices.end(), tri, tri+6);
+			}
+		}
+	}
+}
+
+static bool check(const char * name, Mesh & mesh){
+	bool ok = true;
+	size_t vertexCount = mesh.vertices.size();
+
+	std::vector<unsigned int> cacheOrder = mesh.indices;
+	optimizeVertexCache(cacheOrder, vertexCount);
+	std::vector<unsigned int> overdrawOrder = cacheOrder;
+	optimizeOverdraw(overdrawOrder, mesh.vertices);
+
+	OverdrawStats loaded = analyzeOverdraw(mesh.indices, mesh.vertices);
+	OverdrawStats cache = analyzeOverdraw(cacheOrder, mesh.vertices);
+	OverdrawStats overdraw = analyzeOverdraw(overdrawOrder, mesh.vertices);
+	VertexCacheStats loadedCache = analyzeVertexCache(mesh.indices, vertexCount);
+	VertexCacheStats cacheCache = analyzeVertexCache(cacheOrder, vertexCount);
+	VertexCacheStats overdrawCache = analyzeVertexCache(overdrawOrder, vertexCount);
+
+	printf("%s : %u triangles\n", name, (unsigned int)(mesh.indices.size()/3));
+	printf("  as loaded              : overdraw %.4f, ACMR %.3f\n", loaded.overdraw, loadedCache.acmr);
+	printf("  optimizeVertexCache    : overdraw %.4f, ACMR %.3f\n", cache.overdraw, cacheCache.acmr);
+	printf("  + optimizeOverdraw     : overdraw %.4f, ACMR %.3f\n", overdraw.overdraw, overdrawCache.acmr);
+	printf("  gain of the overdraw pass : %+.1f%% fragments shaded, %+.1f%% vertices transformed\n",
+		100.0 * ((double)overdraw.shaded / cache.shaded - 1.0), 100.0 * (overdrawCache.acmr / cacheCache.acmr - 1.0));
+
+	// optimizeMesh without overdraw : the vertex cache order, whatever analyzeOverdraw says
+	Mesh plain = mesh;
+	optimizeMesh(plain.indices, plain.vertices, plain.uvs, plain.normals, NULL, NULL);
+	OverdrawStats plainStats = analyzeOverdraw(plain.indices, plain.vertices);
+	if ( plainStats.shaded != cache.shaded ){
+		printf("  FAILED : optimizeMesh reordered for overdraw without being asked (%.4f, expected %.4f)\n", plainStats.overdraw, cache.overdraw);
+		ok = false;
+	}
+
+	// optimizeMesh with overdraw : never worse than the vertex cache order
+	Mesh reordered = mesh;
+	optimizeMesh(reordered.indices, reordered.vertices, reordered.uvs, reordered.normals, NULL, NULL, true);
+	OverdrawStats reorderedStats = analyzeOverdraw(reordered.indices, reordered.vertices);
+	size_t expected = overdraw.shaded < cache.shaded ? overdraw.shaded : cache.shaded;
+	if ( reorderedStats.shaded != expected ){
+		printf("  FAILED : optimizeMesh with overdraw shades %u fragments, expected %u\n", (unsigned int)reorderedStats.shaded, (unsigned int)expected);
+		ok = false;
+	}
+
+	if ( plain.indices.size() != mesh.indices.size() || reordered.indices.size() != mesh.indices.size() ){
+		printf("  FAILED : triangles lost\n");
+		ok = false;
+	}
+	return ok;
+}
+
+int main(int argc, char * argv[]){
+	std::vector<const char *> files;
+	for (int i=1; i<argc; i++)
+		files.push_back(argv[i]);
+	if ( files.empty() ){
+		files.push_back("tutorial09_vbo_indexing/suzanne.obj");
+		files.push_back("tutorial13_normal_mapping/cylinder.obj");
+		files.push_back("tutorial16_shadowmaps/room_thickwalls.obj");
+	}
+
+	bool ok = true;
+	for (size_t f=0; f<files.size(); f++){
+		Mesh mesh;
+		if ( !loadOBJ(files[f], mesh.indices, mesh.vertices, mesh.uvs, mesh.normals) ){
+			printf("Can't load %s\n", files[f]);
+			return 1;
+		}
+		ok = check(files[f], mesh) && ok;
+	}
+
+	Mesh spheres;
+	makeSpheres(spheres, 4, 32, 64);
+	ok = check("4 nested spheres", spheres) && ok;
+
+	printf(ok ? "OK\n" : "FAILED\n");
+	return ok ? 0 : 1;
+}
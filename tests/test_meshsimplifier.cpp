@@ -0,0 +1,183 @@
+// Tests of simplifyMesh, generateLODs and selectLOD (see common/meshsimplifier.cpp), on suzanne
+// and on a generated bumpy grid (open, with a UV seam down the middle) :
+// - each LOD has fewer triangles than the one before, close to its ratio of the full mesh,
+//   without degenerate triangles, and the errors never decrease,
+// - no vertex on a UV seam or a border leaves it : every open edge of a LOD (a border, or
+//   a side of a seam) goes along open edges of the full mesh,
+// - simplifyMesh stops before its error goes over targetError,
+// - selectLOD picks coarser and coarser LODs as the distance grows, each one the coarsest
+//   whose error is under a pixel.
+//
+//	test_meshsimplifier [file.obj ...]
+//
+// Run from the root of the repository. Returns 1 if a check fails.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include <map>
+#include <set>
+#include <utility>
+
+#include <glm/glm.hpp>
+
+#include <common/objloader.hpp>
+#include <common/meshsimplifier.hpp>
+
+typedef std::pair<unsigned int, unsigned int> Edge;
+
+// Edges (a, b) of a triangle without a triangle with (b, a) : borders, and the sides of the seams
+static std::set<Edge> openEdges(const std::vector<unsigned short> & indices){
+	std::set<Edge> edges, open;
+	for (size_t i = 0; i < indices.size(); i++)
+		edges.insert(Edge(indices[i], indices[i - i%3 + (i+1)%3]));
+	for (std::set<Edge>::const_iterator e = edges.begin(); e != edges.end(); ++e)
+		if ( edges.find(Edge(e->second, e->first)) == edges.end() )
+			open.insert(*e);
+	return open;
+}
+
+// Is there a path from a to b along the open edges of the full mesh ?
+static bool alongOpenEdges(const std::multimap<unsigned int, unsigned int> & next, unsigned int a, unsigned int b){
+	std::set<unsigned int> seen;
+	std::vector<unsigned int> stack(1, a);
+	while ( !stack.empty() ){
+		unsigned int v = stack.back();
+		stack.pop_back();
+		if ( v == b )
+			return true;
+		if ( !seen.insert(v).second )
+			continue;
+		typedef std::multimap<unsigned int, unsigned int>::const_iterator Iterator;
+		std::pair<Iterator, Iterator> range = next.equal_range(v);
+		for (Iterator i = range.first; i != range.second; ++i)
+			stack.push_back(i->second);
+	}
+	return false;
+}
+
+// (size+1) x (size+1) vertices, with a bump in the middle. The middle column is there twice,
+// with other UVs (in a real mesh) : the triangles on the right use the second one.
+static void makeGrid(int size, std::vector<unsigned short> & indices, std::vector<glm::vec3> & vertices){
+	int row = size + 2;
+	for (int y = 0; y <= size; y++){
+		for (int x = 0; x <= size + 1; x++){
+			int column = x <= size / 2 ? x : x - 1;
+			float fx = (float)column / size - 0.5f, fy = (float)y / size - 0.5f;
+			vertices.push_back(glm::vec3(fx, fy, 0.2f * expf(-8.0f * (fx*fx + fy*fy))));
+		}
+	}
+	for (int y = 0; y < size; y++){
+		for (int x = 0; x < size; x++){
+			int column = x < size / 2 ? x : x + 1;
+			unsigned short a = (unsigned short)(y * row + column), b = a + 1, c = a + row + 1, d = a + row;
+			unsigned short triangles[6] = { a, b, c, a, c, d };
+			indices.insert(indices.end(), triangles, triangles + 6);
+		}
+	}
+}
+
+static bool checkLODs(const char * name, const std::vector<unsigned short> & indices, const std::vector<glm::vec3> & vertices){
+	bool ok = true;
+	size_t triangles = indices.size() / 3;
+	printf("%s : %u triangles, %u vertices\n", name, (unsigned int)triangles, (unsigned int)vertices.size());
+
+	std::set<Edge> fullOpen = openEdges(indices);
+	std::multimap<unsigned int, unsigned int> next;
+	for (std::set<Edge>::const_iterator e = fullOpen.begin(); e != fullOpen.end(); ++e)
+		next.insert(*e);
+
+	std::vector<float> ratios;
+	ratios.push_back(0.5f);
+	ratios.push_back(0.25f);
+	ratios.push_back(0.125f);
+	ratios.push_back(0.0625f);
+	std::vector< MeshLOD<unsigned short> > lods;
+	generateLODs(indices, vertices, ratios, lods);
+	if ( lods.size() != ratios.size() + 1 || lods[0].indices != indices || lods[0].error != 0.0f ){
+		printf("  FAILED : %u LODs instead of %u\n", (unsigned int)lods.size(), (unsigned int)ratios.size() + 1);
+		return false;
+	}
+
+	for (size_t l = 1; l < lods.size(); l++){
+		const std::vector<unsigned short> & lod = lods[l].indices;
+		size_t count = lod.size() / 3;
+		size_t target = (size_t)(triangles * ratios[l-1]);
+		size_t degenerate = 0;
+		for (size_t i = 0; i < lod.size(); i += 3)
+			if ( lod[i] == lod[i+1] || lod[i+1] == lod[i+2] || lod[i+2] == lod[i] || lod[i] >= vertices.size()
+			  || lod[i+1] >= vertices.size() || lod[i+2] >= vertices.size() )
+				degenerate++;
+		// A LOD can stop a little above its target when what is left can't move
+		bool sizes = count < lods[l-1].indices.size() / 3 && count <= target + target / 10 + 2 && count >= target / 2;
+		bool errors = lods[l].error >= lods[l-1].error;
+
+		std::set<Edge> open = openEdges(lod);
+		size_t offSeam = 0;
+		for (std::set<Edge>::const_iterator e = open.begin(); e != open.end(); ++e)
+			if ( !alongOpenEdges(next, e->first, e->second) )
+				offSeam++;
+
+		bool good = sizes && errors && degenerate == 0 && offSeam == 0;
+		printf("  LOD %u : %4u triangles (target %4u), error %.5f, %u open edges, %u off the seams and borders, %u degenerate%s\n",
+			(unsigned int)l, (unsigned int)count, (unsigned int)target, lods[l].error, (unsigned int)open.size(),
+			(unsigned int)offSeam, (unsigned int)degenerate, good ? "" : " FAILED");
+		ok = ok && good;
+	}
+
+	// With a limit on the error instead of the triangle count
+	float limit = 0.5f * lods[2].error;
+	std::vector<unsigned short> limited;
+	float error = simplifyMesh(indices, vertices, 0, limit, limited);
+	bool stopped = error <= limit && !limited.empty() && limited.size() < indices.size();
+	printf("  targetError %.5f : %u triangles, error %.5f%s\n", limit, (unsigned int)(limited.size() / 3), error, stopped ? "" : " FAILED");
+	ok = ok && stopped;
+
+	// 45 degrees, 768 pixels high : from near to far
+	float projectionScale = 1.0f / tanf(0.5f * 45.0f * 3.14159265f / 180.0f);
+	size_t previous = 0, wrong = 0;
+	for (int step = 0; step <= 600; step++){
+		float distance = 0.01f * powf(10.0f, step / 100.0f); // 0.01 to 10000
+		size_t lod = selectLOD(lods, distance, projectionScale, 768.0f);
+		float pixel = distance / (projectionScale * 768.0f * 0.5f);
+		// The coarsest under a pixel : the next ones are all above it
+		bool coarsest = lods[lod].error <= pixel || lod == 0;
+		for (size_t l = lod + 1; l < lods.size(); l++)
+			coarsest = coarsest && lods[l].error > pixel;
+		if ( lod < previous || !coarsest )
+			wrong++;
+		previous = lod;
+	}
+	bool selected = wrong == 0 && selectLOD(lods, 0.01f, projectionScale, 768.0f) == 0 && previous == lods.size() - 1;
+	printf("  selectLOD : LOD 0 up close, LOD %u at 10000, %u wrong choices%s\n", (unsigned int)previous, (unsigned int)wrong, selected ? "" : " FAILED");
+	return ok && selected;
+}
+
+int main(int argc, char * argv[]){
+	std::vector<const char *> files;
+	for (int i=1; i<argc; i++)
+		files.push_back(argv[i]);
+	if ( files.empty() )
+		files.push_back("tutorial09_vbo_indexing/suzanne.obj");
+
+	bool ok = true;
+	for (size_t f=0; f<files.size(); f++){
+		std::vector<unsigned short> indices;
+		std::vector<glm::vec3> vertices, normals;
+		std::vector<glm::vec2> uvs;
+		if ( !loadOBJ(files[f], indices, vertices, uvs, normals) ){
+			printf("Can't load %s\n", files[f]);
+			return 1;
+		}
+		ok = checkLODs(files[f], indices, vertices) && ok;
+	}
+
+	std::vector<unsigned short> indices;
+	std::vector<glm::vec3> vertices;
+	makeGrid(40, indices, vertices);
+	ok = checkLODs("bumpy grid with a seam", indices, vertices) && ok;
+
+	printf(ok ? "OK\n" : "FAILED\n");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,267 @@
+// Tests of buildMipChain (see common/mipmaps.cpp) :
+// - a black and white checker averages to sRGB 188 (128 without sRGB, and in alpha),
+// - constant images stay exact down to 1x1, with both filters, for every byte value,
+// - the average of every pair of sRGB values rounds like the exact conversion (the tables),
+// - box and Kaiser levels are the same, bit for bit, as a reference written here in doubles,
+//   on noise of several sizes and channel counts. Only the values within 1e-4 of halfway
+//   between two bytes may round the other way. The 45x301 image wraps the ring of converted
+//   rows of level 1 many times : a row used after it was replaced in the ring shows here.
+//
+//	test_mipmaps
+//
+// Run from the root of the repository. Returns 1 if a check fails.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+#include <common/mipmaps.hpp>
+
+static const char * filterNames[] = { "box", "Kaiser" };
+
+// Deterministic, unlike rand()
+static unsigned int random32(unsigned int & seed){
+	seed = seed * 1664525u + 1013904223u;
+	return seed ^ (seed >> 16);
+}
+
+static double srgbToLinear(double value){
+	return value <= 0.04045 ? value / 12.92 : pow((value + 0.055) / 1.055, 2.4);
+}
+
+static double linearToSrgb(double value){
+	return value <= 0.0031308 ? value * 12.92 : 1.055 * pow(value, 1.0 / 2.4) - 0.055;
+}
+
+static double kaiser(double x){
+	const double width = 3.0, alpha = 4.0, pi = 3.14159265358979323846;
+	if ( fabs(x) >= width )
+		return 0.0;
+	double r = x / width;
+	double sinc = x == 0.0 ? 1.0 : sin(pi * x) / (pi * x);
+	double a = alpha * sqrt(1.0 - r * r), b = alpha;
+	// I0 of a and b, by their series
+	double i0a = 1.0, i0b = 1.0, termA = 1.0, termB = 1.0;
+	for (int k = 1; k < 40; k++){
+		termA *= (a / (2.0 * k)) * (a / (2.0 * k));
+		termB *= (b / (2.0 * k)) * (b / (2.0 * k));
+		i0a += termA;
+		i0b += termB;
+	}
+	return sinc * i0a / i0b;
+}
+
+// Weights of the old pixels in new pixel i, in one direction, as written in the header :
+// box is the area under the new pixel, Kaiser is centered on it, with the edges clamped.
+// Only the old pixels with a weight are kept.
+struct Weights{
+	std::vector<unsigned int> sources;
+	std::vector<double> weights;
+};
+
+static Weights referenceWeights(MipFilter filter, unsigned int oldSize, unsigned int newSize, unsigned int i){
+	std::vector<double> all(oldSize, 0.0);
+	double scale = (double)oldSize / newSize, total = 0.0;
+	if ( filter == MIP_FILTER_BOX ){
+		for (unsigned int j = 0; j < oldSize; j++)
+			all[j] = std::max(0.0, std::min((i + 1) * scale, j + 1.0) - std::max(i * scale, (double)j));
+	}else{
+		double center = (i + 0.5) * scale;
+		for (int j = (int)floor(center - 3.0 * scale); j <= (int)ceil(center + 3.0 * scale); j++)
+			all[std::min(std::max(j, 0), (int)oldSize - 1)] += kaiser((j + 0.5 - center) / scale);
+	}
+	for (unsigned int j = 0; j < oldSize; j++)
+		total += all[j];
+	Weights weights;
+	for (unsigned int j = 0; j < oldSize; j++){
+		if ( all[j] != 0.0 ){
+			weights.sources.push_back(j);
+			weights.weights.push_back(all[j] / total);
+		}
+	}
+	return weights;
+}
+
+// Rounded to a byte like buildMipChain : value in 0..1, in linear light for an sRGB channel.
+// unrounded : the byte before rounding, to see how close it is to halfway between two bytes.
+static unsigned char toByte(double value, bool srgb, double & unrounded){
+	unrounded = (srgb ? linearToSrgb(value) : value) * 255.0;
+	return (unsigned char)floor(unrounded + 0.5);
+}
+
+// Floats and doubles can round differently only when the exact value is this close to
+// halfway between two bytes (in bytes : the floats of buildMipChain are good to about 1e-7)
+static const double TIE = 1e-4;
+
+static bool isTie(double unrounded){
+	return fabs(unrounded - floor(unrounded) - 0.5) < TIE;
+}
+
+// The whole chain in doubles, each level from the doubles of the previous one.
+// out_unrounded : the bytes of each level before rounding.
+static void referenceChain(const std::vector<unsigned char> & pixels, unsigned int width, unsigned int height, unsigned int channels,
+                           MipFilter filter, bool srgb, std::vector<MipLevel> & out_levels, std::vector< std::vector<double> > & out_unrounded){
+	out_levels.clear();
+	out_unrounded.clear();
+	std::vector<double> current(pixels.size());
+	for (size_t i = 0; i < pixels.size(); i++)
+		current[i] = srgb && i % channels < 3 ? srgbToLinear(pixels[i] / 255.0) : pixels[i] / 255.0;
+	while ( width > 1 || height > 1 ){
+		unsigned int newWidth = width > 1 ? width / 2 : 1, newHeight = height > 1 ? height / 2 : 1;
+		std::vector<double> next((size_t)newWidth * newHeight * channels, 0.0);
+		MipLevel level;
+		level.width = newWidth;
+		level.height = newHeight;
+		level.pixels.resize(next.size());
+		std::vector<double> unrounded(next.size());
+		std::vector<Weights> weightsX;
+		for (unsigned int x = 0; x < newWidth; x++)
+			weightsX.push_back(referenceWeights(filter, width, newWidth, x));
+		for (unsigned int y = 0; y < newHeight; y++){
+			Weights weightsY = referenceWeights(filter, height, newHeight, y);
+			for (unsigned int x = 0; x < newWidth; x++){
+				for (unsigned int c = 0; c < channels; c++){
+					double sum = 0.0;
+					for (size_t j = 0; j < weightsY.sources.size(); j++)
+						for (size_t i = 0; i < weightsX[x].sources.size(); i++)
+							sum += weightsY.weights[j] * weightsX[x].weights[i]
+							     * current[((size_t)weightsY.sources[j] * width + weightsX[x].sources[i]) * channels + c];
+					sum = std::min(std::max(sum, 0.0), 1.0);
+					size_t index = ((size_t)y * newWidth + x) * channels + c;
+					next[index] = sum;
+					level.pixels[index] = toByte(sum, srgb && c < 3, unrounded[index]);
+				}
+			}
+		}
+		out_levels.push_back(level);
+		out_unrounded.push_back(unrounded);
+		current.swap(next);
+		width = newWidth;
+		height = newHeight;
+	}
+}
+
+static bool checkChecker(){
+	bool ok = true;
+	for (int s = 0; s < 2; s++){
+		// 2x2 : black and white in the colors, 0 and 255 in alpha
+		const unsigned char pixels[16] = { 0,0,0,0, 255,255,255,255, 255,255,255,255, 0,0,0,0 };
+		std::vector<MipLevel> levels;
+		buildMipChain(pixels, 2, 2, 4, MIP_FILTER_BOX, s != 0, levels);
+		unsigned int expected = s ? 188 : 128;
+		bool good = levels.size() == 1 && levels[0].pixels.size() == 4
+		         && levels[0].pixels[0] == expected && levels[0].pixels[1] == expected && levels[0].pixels[2] == expected
+		         && levels[0].pixels[3] == 128;
+		printf("  checker %s : %u %u %u %u (expected %u %u %u 128)%s\n", s ? "sRGB" : "linear",
+			levels.empty() ? 0 : levels[0].pixels[0], levels.empty() ? 0 : levels[0].pixels[1],
+			levels.empty() ? 0 : levels[0].pixels[2], levels.empty() ? 0 : levels[0].pixels[3],
+			expected, expected, expected, good ? "" : " FAILED");
+		ok = ok && good;
+	}
+	return ok;
+}
+
+// Every byte value in every channel : the sRGB tables must give back what they were given
+static bool checkConstant(){
+	bool ok = true;
+	for (int f = 0; f < 2; f++){
+		for (int s = 0; s < 2; s++){
+			size_t wrong = 0;
+			for (unsigned int v = 0; v < 256; v++){
+				const unsigned int width = 37, height = 11;
+				const unsigned char pixel[4] = { (unsigned char)v, (unsigned char)(255 - v), (unsigned char)(v * 7), (unsigned char)v };
+				std::vector<unsigned char> pixels;
+				for (unsigned int i = 0; i < width * height; i++)
+					pixels.insert(pixels.end(), pixel, pixel + 4);
+				std::vector<MipLevel> levels;
+				buildMipChain(pixels.data(), width, height, 4, (MipFilter)f, s != 0, levels);
+				if ( levels.size() != 5 || levels.back().width != 1 || levels.back().height != 1 )
+					wrong++;
+				for (size_t l = 0; l < levels.size(); l++)
+					for (size_t i = 0; i < levels[l].pixels.size(); i++)
+						if ( levels[l].pixels[i] != pixel[i % 4] )
+							wrong++;
+			}
+			printf("  constant images, %s%s : %u wrong bytes%s\n", filterNames[f], s ? ", sRGB" : "", (unsigned int)wrong, wrong ? " FAILED" : "");
+			ok = ok && wrong == 0;
+		}
+	}
+	return ok;
+}
+
+// 2x1 images : every average of two sRGB values, near every threshold of the tables
+static bool checkPairs(){
+	size_t wrong = 0, ties = 0;
+	std::vector<MipLevel> levels;
+	for (unsigned int a = 0; a < 256; a++){
+		for (unsigned int b = a; b < 256; b++){
+			const unsigned char pixels[2] = { (unsigned char)a, (unsigned char)b };
+			buildMipChain(pixels, 2, 1, 1, MIP_FILTER_BOX, true, levels);
+			double unrounded;
+			unsigned char expected = toByte(0.5 * (srgbToLinear(a / 255.0) + srgbToLinear(b / 255.0)), true, unrounded);
+			if ( levels.size() != 1 )
+				wrong++;
+			else if ( levels[0].pixels[0] != expected && isTie(unrounded) )
+				ties++;
+			else if ( levels[0].pixels[0] != expected )
+				wrong++;
+		}
+	}
+	printf("  averages of two sRGB values : %u wrong out of %u (%u halfway, rounded the other way)%s\n",
+		(unsigned int)wrong, 256 * 257 / 2, (unsigned int)ties, wrong ? " FAILED" : "");
+	return wrong == 0;
+}
+
+static bool checkReference(MipFilter filter, unsigned int width, unsigned int height, unsigned int channels, bool srgb){
+	unsigned int seed = width * 7919 + height * 31 + channels;
+	std::vector<unsigned char> pixels((size_t)width * height * channels);
+	for (size_t i = 0; i < pixels.size(); i++)
+		pixels[i] = (unsigned char)(random32(seed) >> 8);
+	std::vector<MipLevel> levels, reference;
+	std::vector< std::vector<double> > unrounded;
+	buildMipChain(pixels.data(), width, height, channels, filter, srgb, levels);
+	referenceChain(pixels, width, height, channels, filter, srgb, reference, unrounded);
+
+	size_t wrong = 0, ties = 0, bytes = 0;
+	bool sizes = levels.size() == reference.size();
+	for (size_t l = 0; sizes && l < levels.size(); l++){
+		if ( levels[l].width != reference[l].width || levels[l].height != reference[l].height || levels[l].pixels.size() != reference[l].pixels.size() ){
+			sizes = false;
+			break;
+		}
+		for (size_t i = 0; i < levels[l].pixels.size(); i++){
+			if ( levels[l].pixels[i] == reference[l].pixels[i] )
+				continue;
+			if ( isTie(unrounded[l][i]) && abs((int)levels[l].pixels[i] - (int)reference[l].pixels[i]) == 1 )
+				ties++;
+			else
+				wrong++;
+		}
+		bytes += levels[l].pixels.size();
+	}
+	bool good = sizes && wrong == 0;
+	printf("  %-6s %3ux%-3u %u channel%s%s : %u levels, %u bytes differ from the reference out of %u (%u halfway)%s\n",
+		filterNames[filter], width, height, channels, channels > 1 ? "s" : "", srgb ? ", sRGB" : "",
+		(unsigned int)levels.size(), (unsigned int)wrong, (unsigned int)bytes, (unsigned int)ties, good ? "" : " FAILED");
+	return good;
+}
+
+int main(){
+	bool ok = true;
+	ok = checkChecker() && ok;
+	ok = checkConstant() && ok;
+	ok = checkPairs() && ok;
+
+	// Odd sizes take 3 old pixels for some new ones ; 1x9 and 300x1 halve in one direction only.
+	// 45x301 wraps the ring of converted rows many times, 512x300 splits level 1 in bands of rows.
+	const unsigned int sizes[][2] = { { 64, 48 }, { 13, 7 }, { 1, 9 }, { 300, 1 }, { 45, 301 }, { 512, 300 } };
+	for (int f = 0; f < 2; f++)
+		for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+			for (unsigned int channels = 1; channels <= 4; channels++)
+				ok = checkReference((MipFilter)f, sizes[s][0], sizes[s][1], channels, channels != 2) && ok;
+
+	printf(ok ? "OK\n" : "FAILED\n");
+	return ok ? 0 : 1;
+}
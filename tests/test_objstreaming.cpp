@@ -0,0 +1,205 @@
+// Tests of loadOBJ_streaming (see common/objloader.cpp) on a generated grid, big enough for
+// its v/vt/vn to be spilled to temporary files under budgets of 1 and 4 MB :
+// - the batches, one after the other, must give exactly the triangles of the indexed loadOBJ
+//   (same positions, UVs and normals at each corner ; the indices are per batch),
+// - the peak RSS must not grow by more than the budget while streaming (only on Linux),
+// - a line which doesn't fit in the budget must be refused, and a long one which fits accepted.
+//
+//	test_objstreaming [directory for the generated files]
+//
+// Run from the root of the repository. Returns 1 if a check fails.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <common/objloader.hpp>
+
+// Peak resident memory of the process since the last resetPeakRSS(), in bytes.
+// Only on Linux : 0 elsewhere, and the budget isn't checked.
+static size_t peakRSS(){
+	size_t kilobytes = 0;
+#ifdef __linux__
+	FILE * file = fopen("/proc/self/status", "r");
+	char line[256];
+	while ( file && fgets(line, sizeof(line), file) )
+		if ( strncmp(line, "VmHWM:", 6) == 0 )
+			kilobytes = (size_t)strtoul(line + 6, NULL, 10);
+	if ( file )
+		fclose(file);
+#endif
+	return kilobytes * 1024;
+}
+
+// The peak starts again from the memory used right now
+static bool resetPeakRSS(){
+#ifdef __linux__
+	FILE * file = fopen("/proc/self/clear_refs", "w");
+	if ( !file )
+		return false;
+	bool ok = fputs("5", file) >= 0;
+	return fclose(file) == 0 && ok;
+#else
+	return false;
+#endif
+}
+
+// (width+1) x (height+1) vertices, then width x height quads : as polygons on even rows,
+// as 2 triangles on odd rows, the first one with negative indices.
+// commentLength > 0 adds a comment line that long in the middle.
+static bool writeGrid(const char * path, unsigned int width, unsigned int height, size_t commentLength){
+	FILE * file = fopen(path, "w");
+	if ( !file )
+		return false;
+	unsigned int count = (width+1) * (height+1);
+	for (unsigned int y = 0; y <= height; y++){
+		for (unsigned int x = 0; x <= width; x++){
+			float fx = (float)x / width, fy = (float)y / height;
+			fprintf(file, "v %f %f %f\n", fx, fy, 0.1f * (fx*fx - fy));
+			fprintf(file, "vt %f %f\n", fx, 1.0f - fy);
+			fprintf(file, "vn %f %f %f\n", 0.2f*fx, 0.2f*fy, 0.96f);
+		}
+	}
+	for (unsigned int y = 0; y < height; y++){
+		if ( commentLength > 0 && y == height/2 ){
+			fputc('#', file);
+			for (size_t i = 1; i < commentLength; i++)
+				fputc('x', file);
+			fputc('\n', file);
+		}
+		for (unsigned int x = 0; x < width; x++){
+			unsigned int a = y*(width+1) + x + 1, b = a + 1, c = b + width+1, d = a + width+1;
+			if ( y % 2 == 0 ){
+				fprintf(file, "f %u/%u/%u %u/%u/%u %u/%u/%u %u/%u/%u\n", a,a,a, b,b,b, c,c,c, d,d,d);
+			}else{
+				int na = (int)a - (int)count - 1, nb = (int)b - (int)count - 1, nc = (int)c - (int)count - 1;
+				fprintf(file, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", na,na,na, nb,nb,nb, nc,nc,nc);
+				fprintf(file, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a,a,a, c,c,c, d,d,d);
+			}
+		}
+	}
+	return fclose(file) == 0;
+}
+
+// The triangles of the indexed loadOBJ, to compare the batches with
+struct Reference{
+	std::vector<unsigned int> indices;
+	std::vector<glm::vec3> vertices;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+};
+
+struct Streamed{
+	const Reference * reference; // NULL : just count
+	size_t batches, triangles, vertices, mismatches;
+};
+
+static bool stream(const char * path, size_t budget, Streamed & streamed){
+	streamed.batches = streamed.triangles = streamed.vertices = streamed.mismatches = 0;
+	return loadOBJ_streaming(path, budget, [&streamed](const OBJBatch & batch){
+		if ( batch.firstTriangle != streamed.triangles )
+			streamed.mismatches++;
+		const Reference * reference = streamed.reference;
+		for (size_t i = 0; reference && i < batch.indices.size(); i++){
+			size_t corner = 3*streamed.triangles + i;
+			unsigned int b = batch.indices[i];
+			if ( corner >= reference->indices.size() ){
+				streamed.mismatches++;
+				break;
+			}
+			unsigned int r = reference->indices[corner];
+			if ( b >= batch.vertices.size() || batch.vertices[b] != reference->vertices[r]
+			  || batch.uvs[b] != reference->uvs[r] || batch.normals[b] != reference->normals[r] )
+				streamed.mismatches++;
+		}
+		streamed.batches++;
+		streamed.triangles += batch.indices.size() / 3;
+		streamed.vertices  += batch.vertices.size();
+		return true;
+	});
+}
+
+int main(int argc, char ** argv){
+	std::string directory = argc > 1 ? argv[1] : ".";
+	std::string gridPath = directory + "/test_objstreaming_grid.obj";
+	std::string longLinePath = directory + "/test_objstreaming_long.obj";
+	bool ok = true;
+
+	// 160801 vertices : 1.9 MB of positions, more than a sixth of both budgets
+	if ( !writeGrid(gridPath.c_str(), 400, 400, 0) ){
+		printf("Can't write %s\n", gridPath.c_str());
+		return 1;
+	}
+
+	// A small file first : the code and the buffers of the C library are in memory once,
+	// they don't count in the budget
+	if ( !writeGrid(longLinePath.c_str(), 20, 20, 0) ){
+		printf("Can't write %s\n", longLinePath.c_str());
+		return 1;
+	}
+	Streamed warmUp;
+	warmUp.reference = NULL;
+	stream(longLinePath.c_str(), 1 << 20, warmUp);
+
+	// The budgets, before anything big is allocated
+	const size_t budgets[] = { 1 << 20, 4 << 20 };
+	for (int b = 0; b < 2; b++){
+		Streamed streamed;
+		streamed.reference = NULL;
+		bool measured = resetPeakRSS();
+		size_t before = peakRSS();
+		bool loaded = stream(gridPath.c_str(), budgets[b], streamed);
+		size_t growth = peakRSS() - before;
+		bool within = !measured || growth <= budgets[b];
+		printf("  budget %u MB : %u triangles in %u batches, ", (unsigned int)(budgets[b] >> 20),
+			(unsigned int)streamed.triangles, (unsigned int)streamed.batches);
+		if ( measured )
+			printf("peak RSS +%.2f MB", growth / 1048576.0);
+		else
+			printf("peak RSS not measured");
+		printf("%s\n", !loaded ? " FAILED to load" : !within ? " FAILED : over the budget" : "");
+		ok = ok && loaded && within;
+	}
+
+	// Then the same batches, compared with loadOBJ
+	Reference reference;
+	if ( !loadOBJ(gridPath.c_str(), reference.indices, reference.vertices, reference.uvs, reference.normals) ){
+		printf("Can't load %s\n", gridPath.c_str());
+		return 1;
+	}
+	for (int b = 0; b < 2; b++){
+		Streamed streamed;
+		streamed.reference = &reference;
+		bool loaded = stream(gridPath.c_str(), budgets[b], streamed);
+		bool same = loaded && streamed.mismatches == 0 && streamed.triangles == reference.indices.size() / 3;
+		printf("  budget %u MB : %u vertices in the batches (%u in loadOBJ), %u corners differ%s\n", (unsigned int)(budgets[b] >> 20),
+			(unsigned int)streamed.vertices, (unsigned int)reference.vertices.size(), (unsigned int)streamed.mismatches,
+			same ? "" : " FAILED");
+		ok = ok && same;
+	}
+
+	// With 1 MB, a block is 64 KB and a line can take up to 2 blocks
+	const size_t lengths[] = { 100 << 10, 200 << 10 };
+	for (int l = 0; l < 2; l++){
+		if ( !writeGrid(longLinePath.c_str(), 20, 20, lengths[l]) ){
+			printf("Can't write %s\n", longLinePath.c_str());
+			return 1;
+		}
+		Streamed streamed;
+		streamed.reference = NULL;
+		bool loaded = stream(longLinePath.c_str(), 1 << 20, streamed);
+		bool expected = l == 0;
+		printf("  line of %u KB with a 1 MB budget : %s%s\n", (unsigned int)(lengths[l] >> 10),
+			loaded ? "loaded" : "refused", loaded == expected && (!loaded || streamed.triangles == 800) ? "" : " FAILED");
+		ok = ok && loaded == expected && (!loaded || streamed.triangles == 800);
+	}
+
+	remove(gridPath.c_str());
+	remove(longLinePath.c_str());
+	printf(ok ? "OK\n" : "FAILED\n");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,136 @@
+// Tests of the index range of the indexers (see common/vboindexer.cpp), with unsigned short indices,
+// on meshes of exactly 65,536 vertices (the most 16 bits can address) and of 65,537 :
+// - indexVBO, indexVBO_slow and indexVBO_TBN must accept the first one, with the right indices,
+//   and refuse the second one, with their outputs left as they were given : empty, or holding
+//   a mesh which the new one was appended to (whose tangents the new one adds to),
+// - with unsigned int indices, 65,537 vertices are fine,
+// - indexVBO_auto must pick 16 bits for the first one and 32 bits for the second one.
+//
+//	test_vboindexer
+//
+// Run from the root of the repository. Returns 1 if a check fails.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <common/vboindexer.hpp>
+
+static const char * indexerNames[] = { "indexVBO", "indexVBO_slow", "indexVBO_TBN" };
+
+struct Mesh{
+	std::vector<glm::vec3> vertices, normals, tangents, bitangents;
+	std::vector<glm::vec2> uvs;
+};
+
+template <typename T_INDEX>
+struct Indexed{
+	std::vector<T_INDEX> indices;
+	Mesh mesh;
+};
+
+// A vertex which is like no other : on a grid of points 0.05 apart, further than is_near()
+static void addVertex(Mesh & mesh, int i){
+	mesh.vertices.push_back(glm::vec3(0.05f * (i % 256), 0.05f * (i / 256), 1.0f));
+	mesh.uvs.push_back(glm::vec2(0.5f, 0.5f));
+	mesh.normals.push_back(glm::vec3(0.0f, 0.0f, 1.0f));
+	mesh.tangents.push_back(glm::vec3(1.0f, 0.0f, 0.0f));
+	mesh.bitangents.push_back(glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+static void copyVertex(Mesh & to, const Mesh & from, size_t i){
+	to.vertices.push_back(from.vertices[i]);
+	to.uvs.push_back(from.uvs[i]);
+	to.normals.push_back(from.normals[i]);
+	to.tangents.push_back(from.tangents[i]);
+	to.bitangents.push_back(from.bitangents[i]);
+}
+
+static bool same(const Mesh & a, const Mesh & b, bool tangents){
+	return a.vertices == b.vertices && a.uvs == b.uvs && a.normals == b.normals
+	    && (!tangents || (a.tangents == b.tangents && a.bitangents == b.bitangents));
+}
+
+template <typename T_INDEX>
+static bool runIndexer(int indexer, Mesh & in, Indexed<T_INDEX> & out){
+	switch (indexer){
+	case 0 : return indexVBO(in.vertices, in.uvs, in.normals, out.indices, out.mesh.vertices, out.mesh.uvs, out.mesh.normals);
+	case 1 : return indexVBO_slow(in.vertices, in.uvs, in.normals, out.indices, out.mesh.vertices, out.mesh.uvs, out.mesh.normals);
+	default : return indexVBO_TBN(in.vertices, in.uvs, in.normals, in.tangents, in.bitangents,
+	                              out.indices, out.mesh.vertices, out.mesh.uvs, out.mesh.normals, out.mesh.tangents, out.mesh.bitangents);
+	}
+}
+
+// `existing` vertices already in the outputs (with an index each), then `count` new ones
+// (one in 1000 twice : the second time, it must be found), and one in 1000 of the existing
+// ones again : indexVBO_slow and indexVBO_TBN find them in the outputs (indexVBO doesn't look
+// there, so it doesn't get them).
+template <typename T_INDEX>
+static bool check(int indexer, size_t existing, size_t count, bool expected){
+	Indexed<T_INDEX> out;
+	for (size_t i = 0; i < existing; i++){
+		addVertex(out.mesh, -1 - (int)i);
+		out.indices.push_back((T_INDEX)i);
+	}
+	Mesh in;
+	for (size_t i = 0; i < count; i++)
+		addVertex(in, (int)i);
+	for (size_t i = 0; i < count; i += 1000)
+		copyVertex(in, in, i);
+	for (size_t i = 0; indexer != 0 && i < existing; i += 1000)
+		copyVertex(in, out.mesh, i);
+
+	Indexed<T_INDEX> before = out;
+	bool indexed = runIndexer(indexer, in, out);
+	bool tangents = indexer == 2;
+	bool good = indexed == expected;
+	if ( indexed ){
+		// Every corner must give back its vertex
+		good = good && out.mesh.vertices.size() == existing + count && out.indices.size() == existing + in.vertices.size();
+		for (size_t i = 0; good && i < in.vertices.size(); i++){
+			size_t index = out.indices[existing + i];
+			good = index < out.mesh.vertices.size() && out.mesh.vertices[index] == in.vertices[i];
+		}
+	}else{
+		good = good && out.indices == before.indices && same(out.mesh, before.mesh, tangents);
+	}
+	printf("  %-13s %u-bit, %5u + %5u vertices : %s%s\n", indexerNames[indexer], (unsigned int)(8 * sizeof(T_INDEX)),
+		(unsigned int)existing, (unsigned int)count, indexed ? "indexed" : "refused, outputs as they were", good ? "" : " FAILED");
+	return good;
+}
+
+static bool checkAuto(size_t count, bool expected32bits){
+	Mesh in;
+	for (size_t i = 0; i < count; i++)
+		addVertex(in, (int)i);
+	MeshIndices indices;
+	Mesh out;
+	bool good = indexVBO_auto(in.vertices, in.uvs, in.normals, indices, out.vertices, out.uvs, out.normals)
+		&& indices.use32bits == expected32bits && indices.size() == count
+		&& (expected32bits ? indices.indices16.empty() : indices.indices32.empty());
+	for (size_t i = 0; good && i < count; i++)
+		good = indices[i] == i;
+	printf("  indexVBO_auto %5u vertices : %s indices%s\n", (unsigned int)count, indices.use32bits ? "32-bit" : "16-bit", good ? "" : " FAILED");
+	return good;
+}
+
+int main(){
+	bool ok = true;
+	for (int indexer = 0; indexer < 3; indexer++){
+		// indexVBO_slow is O(n^2) : only with most of the vertices already in the outputs
+		if ( indexer != 1 ){
+			ok = check<unsigned short>(indexer, 0, 65536, true) && ok;
+			ok = check<unsigned short>(indexer, 0, 65537, false) && ok;
+		}
+		ok = check<unsigned short>(indexer, 65530, 6, true) && ok;
+		ok = check<unsigned short>(indexer, 65530, 7, false) && ok;
+		ok = check<unsigned int>(indexer, 65530, 7, true) && ok;
+	}
+	ok = checkAuto(65536, false) && ok;
+	ok = checkAuto(65537, true) && ok;
+
+	printf(ok ? "OK\n" : "FAILED\n");
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,178 @@
+// Tests of the interleaved vertex layouts (see common/vertexlayout.cpp) : every packing of
+// positions, normals and UVs, with and without tangents, is built with indexVBO_interleaved or
+// indexVBO_TBN_interleaved, then :
+// - the indices must be the same as the ones of indexVBO / indexVBO_TBN,
+// - validateInterleavedVertices must accept the buffer against the SoA outputs,
+// - every decoded value must be within packingErrorBound, measured here independently,
+// - a flipped bit in a UV must be caught by validateInterleavedVertices.
+// Invalid packings (unit vector packings for positions or UVs, VERTEX_UNORM16 for normals)
+// must be refused by makeVertexLayout.
+//
+//	test_vertexlayout [file.obj ...]
+//
+// Run from the root of the repository. Returns 1 if a check fails.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include <common/objloader.hpp>
+#include <common/vboindexer.hpp>
+#include <common/tangentspace.hpp>
+#include <common/vertexlayout.hpp>
+
+static const char * packingNames[] = { "float", "snorm16", "half", "unorm16", "oct16", "2_10_10_10" };
+
+static bool isDirectionPacking(VertexPacking packing){
+	return packing == VERTEX_SNORM16 || packing == VERTEX_OCT16 || packing == VERTEX_INT_2_10_10_10;
+}
+
+// Biggest error / packingErrorBound over `count` components. Above 1 : out of bounds.
+static float worstRatio(VertexPacking packing, const float * decoded, const float * expected, const float * scale, int count, float & maxError){
+	float worst = 0.0f;
+	for (int c = 0; c < count; c++){
+		float error = fabsf(decoded[c] - expected[c]);
+		float bound = packingErrorBound(packing, expected[c], scale ? scale[c] : 1.0f);
+		float ratio = error == 0.0f ? 0.0f : bound > 0.0f ? error / bound : 1e30f;
+		if ( !(ratio <= worst) )
+			worst = ratio;
+		if ( error > maxError )
+			maxError = error;
+	}
+	return worst;
+}
+
+// Unit vector packings normalize first
+static glm::vec3 expectedDirection(const glm::vec3 & v, VertexPacking packing){
+	float length = glm::length(v);
+	if ( !isDirectionPacking(packing) || !(length > 0.0f) )
+		return v;
+	return v / length;
+}
+
+struct Soa{
+	std::vector<unsigned short> indices;
+	std::vector<glm::vec3> vertices, normals, tangents, bitangents;
+	std::vector<glm::vec2> uvs;
+};
+
+static bool check(Soa & in, const Soa & soa, const Soa & soaTBN,
+                  VertexPacking positionPacking, VertexPacking normalPacking, VertexPacking uvPacking, bool withTangents){
+	VertexLayout layout;
+	if ( !makeVertexLayout(positionPacking, normalPacking, uvPacking, withTangents, layout) ){
+		printf("  FAILED : %s/%s/%s refused\n", packingNames[positionPacking], packingNames[normalPacking], packingNames[uvPacking]);
+		return false;
+	}
+
+	std::vector<unsigned short> indices;
+	std::vector<unsigned char> interleaved;
+	bool built = withTangents
+		? indexVBO_TBN_interleaved(in.vertices, in.uvs, in.normals, in.tangents, in.bitangents, layout, indices, interleaved)
+		: indexVBO_interleaved(in.vertices, in.uvs, in.normals, layout, indices, interleaved);
+	const Soa & expected = withTangents ? soaTBN : soa;
+	const char * failure = !built ? "FAILED to build" : indices != expected.indices ? "FAILED : other indices" : NULL;
+
+	InterleavedErrors errors;
+	if ( !failure && !validateInterleavedVertices(layout, interleaved, expected.vertices, expected.uvs, expected.normals,
+			withTangents ? &expected.tangents : NULL, withTangents ? &expected.bitangents : NULL, &errors) )
+		failure = "FAILED to validate";
+
+	// The same check as validateInterleavedVertices, but written again here
+	float worst = 0.0f;
+	InterleavedErrors measured = { 0.0f, 0.0f, 0.0f, 0.0f, 0 };
+	for (size_t i = 0; !failure && i < expected.vertices.size(); i++){
+		glm::vec3 position, normal;
+		glm::vec2 uv;
+		glm::vec4 tangent;
+		decodeInterleavedVertex(layout, interleaved, i, position, uv, normal, tangent);
+		glm::vec3 n = expectedDirection(expected.normals[i], normalPacking);
+		worst = glm::max(worst, worstRatio(positionPacking, &position.x, &expected.vertices[i].x, &layout.positionScale.x, 3, measured.position));
+		worst = glm::max(worst, worstRatio(normalPacking, &normal.x, &n.x, NULL, 3, measured.normal));
+		worst = glm::max(worst, worstRatio(uvPacking, &uv.x, &expected.uvs[i].x, &layout.uvScale.x, 2, measured.uv));
+		if ( withTangents ){
+			glm::vec3 t = expectedDirection(expected.tangents[i], normalPacking);
+			worst = glm::max(worst, worstRatio(normalPacking, &tangent.x, &t.x, NULL, 3, measured.tangent));
+			float w = glm::dot(glm::cross(expected.normals[i], expected.tangents[i]), expected.bitangents[i]) < 0.0f ? -1.0f : 1.0f;
+			if ( tangent.w != w )
+				measured.badHandedness++;
+		}
+	}
+	if ( !failure && (worst > 1.0f || measured.badHandedness != 0) )
+		failure = "FAILED : out of bounds";
+	if ( !failure && (measured.position != errors.position || measured.normal != errors.normal
+	               || measured.uv != errors.uv || measured.tangent != errors.tangent) )
+		failure = "FAILED : the validator reports other errors";
+
+	// A flipped bit in the high byte of the v of the first vertex : far beyond any bound
+	if ( !failure && !interleaved.empty() ){
+		size_t byte = layout.uv.offset + (uvPacking == VERTEX_FLOAT ? 7 : 3);
+		interleaved[byte] ^= 0x40;
+		if ( validateInterleavedVertices(layout, interleaved, expected.vertices, expected.uvs, expected.normals,
+				withTangents ? &expected.tangents : NULL, withTangents ? &expected.bitangents : NULL) )
+			failure = "FAILED : corruption not caught";
+	}
+
+	printf("  %-8s %-10s %-8s %-8s : %2u bytes, errors %.2e %.2e %.2e %.2e, worst %3.0f%% of the bound %s\n",
+		packingNames[positionPacking], packingNames[normalPacking], packingNames[uvPacking], withTangents ? "tangents" : "",
+		layout.stride, measured.position, measured.normal, measured.uv, measured.tangent, 100.0f * worst, failure ? failure : "");
+	return !failure;
+}
+
+int main(int argc, char * argv[]){
+	std::vector<const char *> files;
+	for (int i=1; i<argc; i++)
+		files.push_back(argv[i]);
+	if ( files.empty() ){
+		files.push_back("tutorial13_normal_mapping/cylinder.obj");
+		files.push_back("tutorial09_vbo_indexing/suzanne.obj");
+	}
+
+	const VertexPacking scalarPackings[] = { VERTEX_FLOAT, VERTEX_HALF, VERTEX_UNORM16 };
+	const VertexPacking directionPackings[] = { VERTEX_FLOAT, VERTEX_SNORM16, VERTEX_HALF, VERTEX_OCT16, VERTEX_INT_2_10_10_10 };
+	bool ok = true;
+
+	// Positions and UVs aren't unit vectors, normals aren't in a bounding box
+	VertexLayout layout;
+	for (int p = 0; p < 6; p++){
+		VertexPacking packing = (VertexPacking)p;
+		bool refused = isDirectionPacking(packing);
+		if ( makeVertexLayout(packing, VERTEX_FLOAT, VERTEX_FLOAT, false, layout) == refused
+		  || makeVertexLayout(VERTEX_FLOAT, VERTEX_FLOAT, packing, false, layout) == refused ){
+			printf("FAILED : %s positions or UVs %s\n", packingNames[p], refused ? "accepted" : "refused");
+			ok = false;
+		}
+	}
+	if ( makeVertexLayout(VERTEX_FLOAT, VERTEX_UNORM16, VERTEX_FLOAT, false, layout) ){
+		printf("FAILED : unorm16 normals accepted\n");
+		ok = false;
+	}
+
+	for (size_t f = 0; f < files.size(); f++){
+		Soa in, soa, soaTBN;
+		if ( !loadOBJ(files[f], in.vertices, in.uvs, in.normals) ){
+			printf("Can't load %s\n", files[f]);
+			return 1;
+		}
+		computeTangentBasis(in.vertices, in.uvs, in.normals, in.tangents, in.bitangents);
+		if ( !indexVBO(in.vertices, in.uvs, in.normals, soa.indices, soa.vertices, soa.uvs, soa.normals)
+		  || !indexVBO_TBN(in.vertices, in.uvs, in.normals, in.tangents, in.bitangents,
+		                   soaTBN.indices, soaTBN.vertices, soaTBN.uvs, soaTBN.normals, soaTBN.tangents, soaTBN.bitangents) ){
+			printf("Can't index %s\n", files[f]);
+			return 1;
+		}
+		printf("%s : %u vertices (%u with tangents)\n", files[f], (unsigned int)soa.vertices.size(), (unsigned int)soaTBN.vertices.size());
+		printf("  position normal     uv                  stride, biggest errors (position, normal, uv, tangent)\n");
+
+		for (int withTangents = 0; withTangents < 2; withTangents++)
+			for (int p = 0; p < 3; p++)
+				for (int n = 0; n < 5; n++)
+					for (int u = 0; u < 3; u++)
+						ok = check(in, soa, soaTBN, scalarPackings[p], directionPackings[n], scalarPackings[u], withTangents != 0) && ok;
+	}
+
+	printf(ok ? "OK\n" : "FAILED\n");
+	return ok ? 0 : 1;
+}
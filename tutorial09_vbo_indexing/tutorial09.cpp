@@ -100,11 +100,17 @@ int main( void )
 	std::vector<glm::vec3> normals;
 	bool res = loadOBJ("suzanne.obj", vertices, uvs, normals);
 
-	std::vector<unsigned short> indices;
+	// 16-bit indices if suzanne has few enough vertices, 32-bit otherwise
+	MeshIndices indices;
 	std::vector<glm::vec3> indexed_vertices;
 	std::vector<glm::vec2> indexed_uvs;
 	std::vector<glm::vec3> indexed_normals;
-	indexVBO(vertices, uvs, normals, indices, indexed_vertices, indexed_uvs, indexed_normals);
+	if ( !indexVBO_auto(vertices, uvs, normals, indices, indexed_vertices, indexed_uvs, indexed_normals) ){
+		fprintf( stderr, "Failed to index suzanne.obj\n" );
+		getchar();
+		glfwTerminate();
+		return -1;
+	}
 
 	// Load it into a VBO
 
@@ -127,7 +133,7 @@ int main( void )
 	GLuint elementbuffer;
 	glGenBuffers(1, &elementbuffer);
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned short), &indices[0] , GL_STATIC_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * indices.elementSize(), indices.data() , GL_STATIC_DRAW);
 
 	// Get a handle for our "LightPosition" uniform
 	glUseProgram(programID);
@@ -220,7 +226,7 @@ int main( void )
 		glDrawElements(
 			GL_TRIANGLES,      // mode
 			indices.size(),    // count
-			GL_UNSIGNED_SHORT,   // type
+			indices.use32bits ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT, // type
 			(void*)0           // element array buffer offset
 		);
 
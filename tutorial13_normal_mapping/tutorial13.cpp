@@ -21,6 +21,8 @@ using namespace glm;
 #include <common/objloader.hpp>
 #include <common/vboindexer.hpp>
 #include <common/tangentspace.hpp>
+#include <common/assetloader.hpp>
+#include <common/assetcache.hpp>
 
 int main( void )
 {
@@ -91,39 +93,36 @@ int main( void )
 	GLuint ModelMatrixID = glGetUniformLocation(programID, "M");
 	GLuint ModelView3x3MatrixID = glGetUniformLocation(programID, "MV3x3");
 
-	// Load the texture
-	GLuint DiffuseTexture = loadDDS("diffuse.DDS");
-	GLuint NormalTexture = loadBMP_custom("normal.bmp");
-	GLuint SpecularTexture = loadDDS("specular.DDS");
+	// Load the textures and the mesh, all at the same time, on other threads (see common/assetloader.hpp).
+	// Only glTexImage2D & co are left for this thread, in loader.finish().
+	AssetLoader loader;
+	GLuint DiffuseTexture, NormalTexture, SpecularTexture;
+	loader.loadDDS("diffuse.DDS", &DiffuseTexture);
+	loader.loadBMP_compressed("normal.bmp", BLOCK_BC5, &NormalTexture);
+	loader.loadDDS("specular.DDS", &SpecularTexture);
 	
 	// Get a handle for our "myTextureSampler" uniform
 	GLuint DiffuseTextureID  = glGetUniformLocation(programID, "DiffuseTextureSampler");
 	GLuint NormalTextureID  = glGetUniformLocation(programID, "NormalTextureSampler");
 	GLuint SpecularTextureID  = glGetUniformLocation(programID, "SpecularTextureSampler");
 
-	// Read our .obj file
-	std::vector<glm::vec3> vertices;
-	std::vector<glm::vec2> uvs;
-	std::vector<glm::vec3> normals;
-	bool res = loadOBJ("cylinder.obj", vertices, uvs, normals);
-
-	std::vector<glm::vec3> tangents;
-	std::vector<glm::vec3> bitangents;
-	computeTangentBasis(
-		vertices, uvs, normals, // input
-		tangents, bitangents    // output
-	);
-
+	// Read our .obj file, compute the tangents and bitangents, and index everything.
+	// See loadIndexedOBJ_TBN in common/tangentspace.cpp : it calls computeTangents on the indexed mesh,
+	// and caches the result (see common/assetcache.hpp).
 	std::vector<unsigned short> indices;
 	std::vector<glm::vec3> indexed_vertices;
 	std::vector<glm::vec2> indexed_uvs;
 	std::vector<glm::vec3> indexed_normals;
 	std::vector<glm::vec3> indexed_tangents;
 	std::vector<glm::vec3> indexed_bitangents;
-	indexVBO_TBN(
-		vertices, uvs, normals, tangents, bitangents, 
-		indices, indexed_vertices, indexed_uvs, indexed_normals, indexed_tangents, indexed_bitangents
-	);
+	bool res;
+	loader.add([&](){
+		res = loadIndexedOBJ_TBN("cylinder.obj", indices, indexed_vertices, indexed_uvs, indexed_normals, indexed_tangents, indexed_bitangents);
+	});
+
+	// Wait for everything
+	loader.finish();
+	printAssetCacheStats();
 
 	// Load it into a VBO
 
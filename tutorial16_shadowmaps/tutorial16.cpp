@@ -20,6 +20,8 @@ using namespace glm;
 #include <common/controls.hpp>
 #include <common/objloader.hpp>
 #include <common/vboindexer.hpp>
+#include <common/meshcache.hpp>
+#include <common/meshlets.hpp>
 
 int main( void )
 {
@@ -96,17 +98,20 @@ int main( void )
 	// Load the texture
 	GLuint Texture = loadDDS("uvmap.DDS");
 	
-	// Read our .obj file
-	std::vector<glm::vec3> vertices;
-	std::vector<glm::vec2> uvs;
-	std::vector<glm::vec3> normals;
-	bool res = loadOBJ("room_thickwalls.obj", vertices, uvs, normals);
-
+	// Read our .obj file, and index it (see tutorial 9).
+	// The result is cached (see common/assetcache.hpp) : next time, it's just a few memcpy's.
 	std::vector<unsigned short> indices;
 	std::vector<glm::vec3> indexed_vertices;
 	std::vector<glm::vec2> indexed_uvs;
 	std::vector<glm::vec3> indexed_normals;
-	indexVBO(vertices, uvs, normals, indices, indexed_vertices, indexed_uvs, indexed_normals);
+	bool res = loadIndexedOBJ("room_thickwalls.obj", indices, indexed_vertices, indexed_uvs, indexed_normals);
+
+	// Cut it in meshlets, so that we can skip the walls which are behind the camera or facing away from it.
+	// This reorders the triangles : do it before filling the element buffer.
+	std::vector<Meshlet> meshlets;
+	buildMeshlets(indices, indexed_vertices, meshlets);
+	printf("%d triangles in %d meshlets\n", (int)indices.size() / 3, (int)meshlets.size());
+	std::vector<MeshletDrawRange> visibleRanges;
 
 	// Load it into a VBO
 
@@ -251,7 +256,7 @@ int main( void )
 		// Index buffer
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
 
-		// Draw the triangles !
+		// Draw the triangles ! All of them : the walls the camera can't see still cast shadows.
 		glDrawElements(
 			GL_TRIANGLES,      // mode
 			indices.size(),    // count
@@ -283,6 +288,10 @@ int main( void )
 		//ViewMatrix = glm::lookAt(glm::vec3(14,6,4), glm::vec3(0,1,0), glm::vec3(0,1,0));
 		glm::mat4 ModelMatrix = glm::mat4(1.0);
 		glm::mat4 MVP = ProjectionMatrix * ViewMatrix * ModelMatrix;
+
+		// Which meshlets can be seen ? The camera position must be in model space, like the meshlets.
+		glm::vec3 cameraPosition_modelspace = glm::vec3(glm::inverse(ViewMatrix * ModelMatrix)[3]);
+		cullMeshlets(meshlets, MVP, cameraPosition_modelspace, visibleRanges);
 		
 		glm::mat4 biasMatrix(
 			0.5, 0.0, 0.0, 0.0, 
@@ -351,13 +360,15 @@ int main( void )
 		// Index buffer
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
 
-		// Draw the triangles !
-		glDrawElements(
-			GL_TRIANGLES,      // mode
-			indices.size(),    // count
-			GL_UNSIGNED_SHORT, // type
-			(void*)0           // element array buffer offset
-		);
+		// Draw the visible triangles only !
+		for (size_t r = 0; r < visibleRanges.size(); r++){
+			glDrawElements(
+				GL_TRIANGLES,                  // mode
+				visibleRanges[r].indexCount,   // count
+				GL_UNSIGNED_SHORT,             // type
+				(void*)(visibleRanges[r].indexOffset * sizeof(unsigned short)) // element array buffer offset
+			);
+		}
 
 		glDisableVertexAttribArray(0);
 		glDisableVertexAttribArray(1);
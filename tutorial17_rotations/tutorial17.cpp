@@ -28,6 +28,8 @@ using namespace glm;
 #include <common/controls.hpp>
 #include <common/objloader.hpp>
 #include <common/vboindexer.hpp>
+#include <common/meshcache.hpp>
+#include <common/vertexlayout.hpp>
 #include <common/quaternion_utils.hpp> // See quaternion_utils.cpp for RotationBetweenVectors, LookAt and RotateTowards
 
 vec3 gPosition1(-1.5f, 0.0f, 0.0f);
@@ -128,9 +130,11 @@ int main( void )
 	GLuint MatrixID = glGetUniformLocation(programID, "MVP");
 	GLuint ViewMatrixID = glGetUniformLocation(programID, "V");
 	GLuint ModelMatrixID = glGetUniformLocation(programID, "M");
+	GLuint PositionOffsetID = glGetUniformLocation(programID, "PositionOffset");
+	GLuint PositionScaleID = glGetUniformLocation(programID, "PositionScale");
  
 	// Get a handle for our buffers
-	GLuint vertexPosition_modelspaceID = glGetAttribLocation(programID, "vertexPosition_modelspace");
+	GLuint vertexPosition_modelspaceID = glGetAttribLocation(programID, "vertexPosition_quantized");
 	GLuint vertexUVID = glGetAttribLocation(programID, "vertexUV");
 	GLuint vertexNormal_modelspaceID = glGetAttribLocation(programID, "vertexNormal_modelspace");
  
@@ -140,34 +144,27 @@ int main( void )
 	// Get a handle for our "myTextureSampler" uniform
 	GLuint TextureID  = glGetUniformLocation(programID, "myTextureSampler");
  
-	// Read our .obj file
-	std::vector<glm::vec3> vertices;
-	std::vector<glm::vec2> uvs;
-	std::vector<glm::vec3> normals;
-	bool res = loadOBJ("suzanne.obj", vertices, uvs, normals);
- 
+	// Read our .obj file, and index it (see tutorial 9).
+	// The result is cached (see common/assetcache.hpp) : next time, it's just a few memcpy's.
 	std::vector<unsigned short> indices;
 	std::vector<glm::vec3> indexed_vertices;
 	std::vector<glm::vec2> indexed_uvs;
 	std::vector<glm::vec3> indexed_normals;
-	indexVBO(vertices, uvs, normals, indices, indexed_vertices, indexed_uvs, indexed_normals);
- 
-	// Load it into a VBO
+	bool res = loadIndexedOBJ("suzanne.obj", indices, indexed_vertices, indexed_uvs, indexed_normals);
+
+	// Load it into a VBO.
+	// All the attributes of a vertex are packed together, in a single VBO, and quantized :
+	// 16-bit positions within the bounding box of the mesh, 10-bit normals and 16-bit UVs.
+	// 16 bytes per vertex instead of 32, in 3 VBOs.
+	VertexLayout layout;
+	makeVertexLayout(VERTEX_UNORM16, VERTEX_INT_2_10_10_10, VERTEX_HALF, false, layout);
+	std::vector<unsigned char> interleaved_vertices;
+	buildInterleavedVertices(layout, indexed_vertices, indexed_uvs, indexed_normals, NULL, NULL, interleaved_vertices);
  
 	GLuint vertexbuffer;
 	glGenBuffers(1, &vertexbuffer);
 	glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
-	glBufferData(GL_ARRAY_BUFFER, indexed_vertices.size() * sizeof(glm::vec3), &indexed_vertices[0], GL_STATIC_DRAW);
- 
-	GLuint uvbuffer;
-	glGenBuffers(1, &uvbuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
-	glBufferData(GL_ARRAY_BUFFER, indexed_uvs.size() * sizeof(glm::vec2), &indexed_uvs[0], GL_STATIC_DRAW);
- 
-	GLuint normalbuffer;
-	glGenBuffers(1, &normalbuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
-	glBufferData(GL_ARRAY_BUFFER, indexed_normals.size() * sizeof(glm::vec3), &indexed_normals[0], GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, interleaved_vertices.size(), &interleaved_vertices[0], GL_STATIC_DRAW);
  
 	// Generate a buffer for the indices as well
 	GLuint elementbuffer;
@@ -217,40 +214,40 @@ int main( void )
 		// Set our "myTextureSampler" sampler to user Texture Unit 0
 		glUniform1i(TextureID, 0);
  
-		// 1rst attribute buffer : vertices
-		glEnableVertexAttribArray(0);
+		// All the attributes are in the same buffer : only their offsets in the vertex differ
 		glBindBuffer(GL_ARRAY_BUFFER, vertexbuffer);
+
+		// 1rst attribute : vertices
+		glEnableVertexAttribArray(0);
 		glVertexAttribPointer(
-			vertexPosition_modelspaceID,  // The attribute we want to configure
-			3,                            // size
-			GL_FLOAT,                     // type
-			GL_FALSE,                     // normalized?
-			0,                            // stride
-			(void*)0                      // array buffer offset
+			vertexPosition_modelspaceID,            // The attribute we want to configure
+			layout.position.components,             // size
+			layout.position.type,                   // type : GL_UNSIGNED_SHORT
+			layout.position.normalized,             // normalized? yes : [0, 65535] becomes [0, 1], and the shader scales it
+			layout.stride,                          // stride : the size of a whole vertex
+			(void*)(size_t)layout.position.offset   // offset of the attribute in the vertex
 		);
  
-		// 2nd attribute buffer : UVs
+		// 2nd attribute : UVs
 		glEnableVertexAttribArray(1);
-		glBindBuffer(GL_ARRAY_BUFFER, uvbuffer);
 		glVertexAttribPointer(
-			vertexUVID,                   // The attribute we want to configure
-			2,                            // size : U+V => 2
-			GL_FLOAT,                     // type
-			GL_FALSE,                     // normalized?
-			0,                            // stride
-			(void*)0                      // array buffer offset
+			vertexUVID,                             // The attribute we want to configure
+			layout.uv.components,                   // size : U+V => 2
+			layout.uv.type,                         // type : GL_HALF_FLOAT
+			layout.uv.normalized,                   // normalized?
+			layout.stride,                          // stride
+			(void*)(size_t)layout.uv.offset         // offset
 		);
  
-		// 3rd attribute buffer : normals
+		// 3rd attribute : normals
 		glEnableVertexAttribArray(2);
-		glBindBuffer(GL_ARRAY_BUFFER, normalbuffer);
 		glVertexAttribPointer(
-			vertexNormal_modelspaceID,    // The attribute we want to configure
-			3,                            // size
-			GL_FLOAT,                     // type
-			GL_FALSE,                     // normalized?
-			0,                            // stride
-			(void*)0                      // array buffer offset
+			vertexNormal_modelspaceID,              // The attribute we want to configure
+			layout.normal.components,               // size
+			layout.normal.type,                     // type : GL_INT_2_10_10_10_REV
+			layout.normal.normalized,               // normalized? yes : [-511, 511] becomes [-1, 1]
+			layout.stride,                          // stride
+			(void*)(size_t)layout.normal.offset     // offset
 		);
  
 		// Index buffer
@@ -258,6 +255,10 @@ int main( void )
  
 		glm::vec3 lightPos = glm::vec3(4,4,4);
 		glUniform3f(LightID, lightPos.x, lightPos.y, lightPos.z);
+
+		// The positions are in [0, 1] in the VBO : this brings them back to the bounding box of the mesh
+		glUniform3f(PositionOffsetID, layout.positionOffset.x, layout.positionOffset.y, layout.positionOffset.z);
+		glUniform3f(PositionScaleID,  layout.positionScale.x,  layout.positionScale.y,  layout.positionScale.z);
  
 		{ // Euler
  
@@ -343,8 +344,6 @@ int main( void )
  
 	// Cleanup VBO and shader
 	glDeleteBuffers(1, &vertexbuffer);
-	glDeleteBuffers(1, &uvbuffer);
-	glDeleteBuffers(1, &normalbuffer);
 	glDeleteBuffers(1, &elementbuffer);
 	glDeleteProgram(programID);
 	glDeleteTextures(1, &Texture);